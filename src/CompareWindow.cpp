@@ -6,32 +6,10 @@
 #include <QHeaderView>
 
 #include "Stats.hpp"   // Usa TissueStats y SliceStats
-#include <opencv2/imgproc.hpp>
+#include "pipeline.hpp"
 
 using namespace cv;
 
-// =============================
-// cv::Mat -> QImage
-// =============================
-QImage CompareWindow::cvMatToQImage(const cv::Mat& mat) {
-    if (mat.empty()) return {};
-
-    if (mat.type() == CV_8UC1) {
-        return QImage(mat.data, mat.cols, mat.rows, mat.step,
-                      QImage::Format_Grayscale8).copy();
-    } else if (mat.type() == CV_8UC3) {
-        Mat rgb;
-        cvtColor(mat, rgb, COLOR_BGR2RGB);
-        return QImage(rgb.data, rgb.cols, rgb.rows, rgb.step,
-                      QImage::Format_RGB888).copy();
-    }
-
-    Mat tmp;
-    mat.convertTo(tmp, CV_8U);
-    return QImage(tmp.data, tmp.cols, tmp.rows, tmp.step,
-                  QImage::Format_Grayscale8).copy();
-}
-
 // =============================
 // Constructor
 // =============================
@@ -44,7 +22,10 @@ CompareWindow::CompareWindow(QWidget* parent,
                              const cv::Mat& overlayGauss,
                              const cv::Mat& overlayNL,
                              const cv::Mat& overlayDncnn,
-                             const SliceStats& stats)
+                             const SliceStats& stats,
+                             const SliceQuality& quality,
+                             PixmapCache* cache,
+                             const QString& slice)
     : QDialog(parent)
 {
     setWindowTitle("Comparativa de resultados – Gauss vs NLMeans vs DnCNN");
@@ -54,7 +35,14 @@ CompareWindow::CompareWindow(QWidget* parent,
     auto* columnsLayout = new QHBoxLayout();
 
     // Helper para crear una columna: título + overlay + gris
+    // Pixmap de una evidencia: de la caché si la hay, si no envolviendo el Mat
+    auto toPixmap = [&](int evidence, const cv::Mat& mat) {
+        if (!cache) return matToPixmap(mat);
+        return cache->get({ slice, evidence, kDisplayWindowCenter, kDisplayWindowWidth }, mat);
+    };
+
     auto makeColumn = [&](const QString& title,
+                          int column,
                           const cv::Mat& overlay,
                           const cv::Mat& gray,
                           QLabel*& outOverlayLbl,
@@ -91,33 +79,34 @@ CompareWindow::CompareWindow(QWidget* parent,
         columnsLayout->addWidget(colWidget);
 
         // Asignar imágenes
-        outOverlayLbl->setPixmap(QPixmap::fromImage(cvMatToQImage(overlay)));
-        outGrayLbl->setPixmap(QPixmap::fromImage(cvMatToQImage(gray)));
+        // (evidencias 0..3 en gris, 9..12 sus overlays)
+        outOverlayLbl->setPixmap(toPixmap(9 + column, overlay));
+        outGrayLbl->setPixmap(toPixmap(column, gray));
     };
 
     // Columna 0: Original
-    makeColumn("Original",
+    makeColumn("Original", 0,
                overlayOrig,
                origGray,
                m_lblOverlayOrig,
                m_lblGrayOrig);
 
     // Columna 1: Gaussiano
-    makeColumn("Filtro Gaussiano",
+    makeColumn("Filtro Gaussiano", 1,
                overlayGauss,
                gaussGray,
                m_lblOverlayGauss,
                m_lblGrayGauss);
 
     // Columna 2: NLMeans
-    makeColumn("Filtro NLMeans",
+    makeColumn("Filtro NLMeans", 2,
                overlayNL,
                nlGray,
                m_lblOverlayNL,
                m_lblGrayNL);
 
     // Columna 3: DnCNN
-    makeColumn("Red DnCNN",
+    makeColumn("Red DnCNN", 3,
                overlayDncnn,
                dncnnGray,
                m_lblOverlayDncnn,
@@ -128,9 +117,9 @@ CompareWindow::CompareWindow(QWidget* parent,
     // =============================
     // Tabla de HU por tejido
     // =============================
-    m_table = new QTableWidget(3, 3, this); // 3 tejidos x 3 columnas
+    m_table = new QTableWidget(3, 5, this); // 3 tejidos x 5 columnas
     QStringList colHeaders;
-    colHeaders << "Media HU" << "Desv. estándar" << "Nº píxeles";
+    colHeaders << "Media HU" << "Desv. estándar" << "Mín HU" << "Máx HU" << "Nº píxeles";
     m_table->setHorizontalHeaderLabels(colHeaders);
 
     QStringList rowHeaders;
@@ -144,6 +133,26 @@ CompareWindow::CompareWindow(QWidget* parent,
     m_table->setEditTriggers(QAbstractItemView::NoEditTriggers);
 
     mainLayout->addWidget(m_table);
+
+    // =============================
+    // Métricas de calidad por filtro
+    // =============================
+    m_quality = new QTableWidget(kNumDenoiseVariants, 7, this);
+    QStringList qualityHeaders;
+    qualityHeaders << "Ruido (σ HU)" << "EPI"
+                   << (quality.hasReference ? "PSNR ref (dB)" : "PSNR vs orig (dB)")
+                   << (quality.hasReference ? "SSIM ref" : "SSIM vs orig")
+                   << "Dice grasa" << "Dice músculo" << "Dice hueso";
+    m_quality->setHorizontalHeaderLabels(qualityHeaders);
+    m_quality->setVerticalHeaderLabels({ "Original", "Gauss", "NLMeans", "DnCNN" });
+
+    fillQualityTable(quality);
+
+    m_quality->horizontalHeader()->setSectionResizeMode(QHeaderView::Stretch);
+    m_quality->verticalHeader()->setSectionResizeMode(QHeaderView::ResizeToContents);
+    m_quality->setEditTriggers(QAbstractItemView::NoEditTriggers);
+
+    mainLayout->addWidget(m_quality);
 }
 
 // =============================
@@ -158,6 +167,10 @@ void CompareWindow::fillTable(const SliceStats& stats)
         m_table->setItem(row, 1,
             new QTableWidgetItem(QString::number(t.stdHU,  'f', 1)));
         m_table->setItem(row, 2,
+            new QTableWidgetItem(QString::number(t.minHU,  'f', 1)));
+        m_table->setItem(row, 3,
+            new QTableWidgetItem(QString::number(t.maxHU,  'f', 1)));
+        m_table->setItem(row, 4,
             new QTableWidgetItem(QString::number(t.pixelCount)));
     };
 
@@ -165,3 +178,22 @@ void CompareWindow::fillTable(const SliceStats& stats)
     setRow(1, stats.muscle);
     setRow(2, stats.bone);
 }
+
+// =============================
+// Tabla de métricas
+// =============================
+void CompareWindow::fillQualityTable(const SliceQuality& quality)
+{
+    for (int v = 0; v < kNumDenoiseVariants; ++v) {
+        const VariantQuality& m = quality.variants[v];
+        const double values[] = { m.noiseStdHU, m.epi, m.psnr, m.ssim,
+                                  m.dice[LABEL_FAT], m.dice[LABEL_MUSCLE], m.dice[LABEL_BONE] };
+        const int decimals[] = { 1, 3, 2, 4, 3, 3, 3 };
+        for (int c = 0; c < 7; ++c) {
+            const bool dice = c >= 4;
+            m_quality->setItem(v, c, new QTableWidgetItem(dice && !m.hasDice
+                                                              ? QStringLiteral("—")   // sin segmentación propia
+                                                              : QString::number(values[c], 'f', decimals[c])));
+        }
+    }
+}
@@ -6,6 +6,8 @@
 #include <opencv2/core.hpp>
 
 #include "Stats.hpp"   // Usa TissueStats y SliceStats
+#include "display_adapter.hpp"
+#include "denoise_quality.hpp"
 
 class CompareWindow : public QDialog {
     Q_OBJECT
@@ -20,6 +22,9 @@ public:
     // overlayGauss  : overlay color gaussiano
     // overlayNL     : overlay color NLMeans
     // overlayDncnn  : overlay color DnCNN
+    // quality       : métricas de las cuatro variantes (computeSliceQuality)
+    // cache/slice   : caché de pixmaps de la ventana principal (opcional); las
+    //                 evidencias ya mostradas allí no se vuelven a convertir
     explicit CompareWindow(QWidget* parent,
                            const cv::Mat& origGray,
                            const cv::Mat& gaussGray,
@@ -29,7 +34,10 @@ public:
                            const cv::Mat& overlayGauss,
                            const cv::Mat& overlayNL,
                            const cv::Mat& overlayDncnn,
-                           const SliceStats& stats);
+                           const SliceStats& stats,
+                           const SliceQuality& quality,
+                           PixmapCache* cache = nullptr,
+                           const QString& slice = {});
 
 private:
     // Overlays (fila de arriba)
@@ -45,7 +53,8 @@ private:
     QLabel* m_lblGrayDncnn     = nullptr;
 
     QTableWidget* m_table      = nullptr;
+    QTableWidget* m_quality    = nullptr;
 
-    QImage cvMatToQImage(const cv::Mat& mat);
     void   fillTable(const SliceStats& stats);
+    void   fillQualityTable(const SliceQuality& quality);
 };
@@ -4,7 +4,14 @@
 #include "itk_opencv_bridge.hpp"
 #include "highlight.hpp"
 #include "dnn_denoising.hpp"
+#include "model_registry.hpp"
+#include "dnn_precision.hpp"
+#include "tissue_stats.hpp"
 #include "CompareWindow.hpp"
+#include "evidence_store.hpp"
+#include "slice_server.hpp"
+#include "startup_profile.hpp"
+#include "metrics.hpp"
 
 #include <QVBoxLayout>
 #include <QHBoxLayout>
@@ -12,38 +19,24 @@
 #include <QMessageBox>
 #include <QScrollArea>
 #include <QDir>
-
+#include <QFileInfo>
+#include <QDateTime>
+#include <QDockWidget>
+#include <QFontDatabase>
+#include <QStatusBar>
+#include <QTimer>
+
+#include <cstdlib>
 #include <filesystem>
+#include <iostream>
 #include <algorithm>
+#include <memory>
 
 #include <opencv2/imgproc.hpp>
-#include <opencv2/photo.hpp>
 
 namespace fs = std::filesystem;
 using namespace cv;
 
-// ----------------------
-// Helper para stats HU
-// ----------------------
-static TissueStats computeTissueStats(const cv::Mat& hu32f, const cv::Mat& mask8u) {
-    TissueStats ts;
-    if (hu32f.empty() || mask8u.empty()) return ts;
-
-    cv::Mat validMask;
-    // el mask está en 0/255 → lo pasamos a binario
-    threshold(mask8u, validMask, 0, 255, THRESH_BINARY);
-
-    ts.pixelCount = countNonZero(validMask);
-    if (ts.pixelCount == 0) return ts;
-
-    cv::Scalar mean, stddev;
-    meanStdDev(hu32f, mean, stddev, validMask);
-    ts.meanHU = mean[0];
-    ts.stdHU  = stddev[0];
-
-    return ts;
-}
-
 // ============================
 // Constructor
 // ============================
@@ -80,6 +73,75 @@ QtMainWindow::QtMainWindow(QWidget* parent)
     m_viewCombo->addItem("13. Seg. DnCNN");  
     m_viewCombo->setCurrentIndex(12); 
 
+    // Modelos DnCNN y backends disponibles
+    m_modelCombo   = new QComboBox(central);
+    m_backendCombo = new QComboBox(central);
+    for (const auto& model : listDnnModels()) {
+        m_modelCombo->addItem(QString::fromStdString(model.name),
+                              QString::fromStdString(model.path));
+    }
+    int defaultModel = m_modelCombo->findText("dncnn_compatible");
+    if (defaultModel >= 0) m_modelCombo->setCurrentIndex(defaultModel);
+
+    // Los backends fijos se añaden al terminar la precarga (startWarmUp)
+    m_backendCombo->addItem("DnCNN: Auto (benchmark)");
+
+    m_precisionCombo = new QComboBox(central);
+    m_precisionCombo->addItem("FP32", static_cast<int>(DnnPrecision::FP32));
+    m_precisionCombo->addItem("FP16", static_cast<int>(DnnPrecision::FP16));
+    m_precisionCombo->addItem("INT8", static_cast<int>(DnnPrecision::INT8));
+
+    // Parámetros de etapas (por defecto, los del pipeline)
+    const PipelineParams defaults;
+    m_cannyLowSpin  = new QSpinBox(central);
+    m_cannyHighSpin = new QSpinBox(central);
+    m_nlmHSpin      = new QDoubleSpinBox(central);
+    m_boneMinSpin   = new QSpinBox(central);
+    m_cannyLowSpin->setRange(0, 1000);
+    m_cannyLowSpin->setValue(static_cast<int>(defaults.cannyLow));
+    m_cannyHighSpin->setRange(0, 1000);
+    m_cannyHighSpin->setValue(static_cast<int>(defaults.cannyHigh));
+    m_nlmHSpin->setRange(1.0, 50.0);
+    m_nlmHSpin->setSingleStep(1.0);
+    m_nlmHSpin->setValue(defaults.nlmH);
+    m_boneMinSpin->setRange(0, 3000);
+    m_boneMinSpin->setValue(static_cast<int>(defaults.tissue.boneMin));
+
+    // Plano de visualización (reformateo desde el volumen cargado)
+    m_planeCombo = new QComboBox(central);
+    m_planeCombo->addItem("Axial",   static_cast<int>(Plane::Axial));
+    m_planeCombo->addItem("Coronal", static_cast<int>(Plane::Coronal));
+    m_planeCombo->addItem("Sagital", static_cast<int>(Plane::Sagittal));
+    m_planeIndexSpin = new QSpinBox(central);
+    m_planeIndexSpin->setRange(0, 0);
+    m_planeIndexSpin->setEnabled(false);   // en axial manda el archivo elegido
+    m_projectionCombo = new QComboBox(central);
+    m_projectionCombo->addItem("Corte", -1);
+    m_projectionCombo->addItem("MIP",   static_cast<int>(Projection::Max));
+    m_projectionCombo->addItem("MinIP", static_cast<int>(Projection::Min));
+    m_projectionCombo->addItem("Media", static_cast<int>(Projection::Mean));
+    m_slabSpin = new QSpinBox(central);
+    m_slabSpin->setRange(0, 512);
+    m_slabSpin->setValue(16);
+    m_slabSpin->setSpecialValueText("Volumen");   // 0 = todo el eje
+    m_slabSpin->setSuffix(" cortes");
+
+    auto* paramsLayout = new QHBoxLayout();
+    paramsLayout->addWidget(new QLabel("Plano:", central));
+    paramsLayout->addWidget(m_planeCombo);
+    paramsLayout->addWidget(m_planeIndexSpin);
+    paramsLayout->addWidget(m_projectionCombo);
+    paramsLayout->addWidget(m_slabSpin);
+    paramsLayout->addWidget(new QLabel("Canny bajo:", central));
+    paramsLayout->addWidget(m_cannyLowSpin);
+    paramsLayout->addWidget(new QLabel("Canny alto:", central));
+    paramsLayout->addWidget(m_cannyHighSpin);
+    paramsLayout->addWidget(new QLabel("NLMeans h:", central));
+    paramsLayout->addWidget(m_nlmHSpin);
+    paramsLayout->addWidget(new QLabel("Hueso ≥ HU:", central));
+    paramsLayout->addWidget(m_boneMinSpin);
+    paramsLayout->addStretch();
+
 
     // Orden: ruta | seleccionar | procesar | comparativa | combo
     topLayout->addWidget(m_pathEdit);
@@ -87,8 +149,12 @@ QtMainWindow::QtMainWindow(QWidget* parent)
     topLayout->addWidget(m_processButton);
     topLayout->addWidget(m_compareButton);
     topLayout->addWidget(m_viewCombo);
+    topLayout->addWidget(m_modelCombo);
+    topLayout->addWidget(m_backendCombo);
+    topLayout->addWidget(m_precisionCombo);
 
     mainLayout->addLayout(topLayout);
+    mainLayout->addLayout(paramsLayout);
 
     // -------- Zona de imágenes --------
     auto* imagesLayout = new QHBoxLayout();
@@ -112,7 +178,13 @@ QtMainWindow::QtMainWindow(QWidget* parent)
     imagesLayout->addWidget(scrollLeft);
     imagesLayout->addWidget(scrollRight);
 
+    // Métricas de los filtros del corte mostrado (se rehacen en cada corte)
+    m_qualityLabel = new QLabel(central);
+    m_qualityLabel->setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+    m_qualityLabel->setTextInteractionFlags(Qt::TextSelectableByMouse);
+
     mainLayout->addLayout(imagesLayout);
+    mainLayout->addWidget(m_qualityLabel);
 
     setCentralWidget(central);
 
@@ -125,6 +197,150 @@ QtMainWindow::QtMainWindow(QWidget* parent)
             this, &QtMainWindow::onViewChanged);
     connect(m_compareButton, &QPushButton::clicked,
             this,            &QtMainWindow::onOpenCompare);
+    connect(m_planeCombo, QOverload<int>::of(&QComboBox::currentIndexChanged),
+            this, &QtMainWindow::onPlaneChanged);
+
+    createPerformanceHud();
+    startWarmUp();
+}
+
+QtMainWindow::~QtMainWindow() {
+    if (m_warmUp.valid()) m_warmUp.wait();
+}
+
+// ============================
+// Panel de rendimiento
+// ============================
+// Lee metrics() cada medio segundo (solo con el panel visible) y al terminar
+// cada corte; "Volcar" guarda todas las métricas en outputs/metrics/
+void QtMainWindow::createPerformanceHud() {
+    m_hudDock = new QDockWidget("Rendimiento", this);
+    m_hudDock->setFeatures(QDockWidget::DockWidgetMovable | QDockWidget::DockWidgetFloatable);
+
+    auto* panel  = new QWidget(m_hudDock);
+    auto* layout = new QVBoxLayout(panel);
+    m_hudLabel = new QLabel(panel);
+    m_hudLabel->setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+    m_hudLabel->setAlignment(Qt::AlignTop | Qt::AlignLeft);
+    m_hudLabel->setTextInteractionFlags(Qt::TextSelectableByMouse);
+    auto* dumpButton = new QPushButton("Volcar métricas", panel);
+    layout->addWidget(m_hudLabel);
+    layout->addStretch();
+    layout->addWidget(dumpButton);
+    m_hudDock->setWidget(panel);
+    addDockWidget(Qt::RightDockWidgetArea, m_hudDock);
+
+    m_hudTimer = new QTimer(this);
+    m_hudTimer->setInterval(500);
+    connect(m_hudTimer, &QTimer::timeout, this, &QtMainWindow::onRefreshHud);
+    connect(dumpButton, &QPushButton::clicked, this, &QtMainWindow::onDumpMetrics);
+    m_hudTimer->start();
+}
+
+void QtMainWindow::onRefreshHud() {
+    if (!m_hudDock->isVisible()) return;
+    const MetricsSnapshot s = metrics().snapshot();
+    auto v = [&s](const std::string& key) {
+        auto it = s.find(key);
+        return it == s.end() ? 0.0 : it->second;
+    };
+    auto rate = [](double hits, double total) {
+        return total > 0 ? QString::asprintf("%3.0f%%", 100.0 * hits / total) : QString("  —");
+    };
+
+    QString text = QString::asprintf("Última pasada      %8.1f ms\n", v("pipeline.total.ultimo_ms"));
+    for (int i = 0; i < kNumPipelineStages; ++i)
+        text += QString::asprintf("  %-16s %8.1f ms\n", kPipelineStageNames[i],
+                                  v(std::string("etapa.") + kPipelineStageNames[i] + ".ultimo_ms"));
+
+    text += QString::asprintf("\nDnCNN / forward    %8.1f ms\n  media %.1f, máx %.1f (%.0f forwards, %.0f imágenes)\n",
+                              v("dncnn.forward.ultimo_ms"), v("dncnn.forward.media_ms"), v("dncnn.forward.max_ms"),
+                              v("dncnn.forward.n"), v("dncnn.imagenes"));
+
+    const double volHits = v("volumen.aciertos"), volTotal = volHits + v("volumen.fallos");
+    text += "\nVolumen            " + rate(volHits, volTotal) +
+            QString::asprintf(" (%.0f de %.0f)\n", volHits, volTotal);
+    const double cacheHits = v("cache_etapas.aciertos") + v("cache_etapas.disco") + v("cache_etapas.intercambio");
+    text += "Resultados         " + rate(cacheHits, cacheHits + v("cache_etapas.fallos")) +
+            QString::asprintf(" (%.0f mem, %.0f disco, %.0f interc., %.0f fallos; %.0f MB)\n",
+                              v("cache_etapas.aciertos"), v("cache_etapas.disco"), v("cache_etapas.intercambio"),
+                              v("cache_etapas.fallos"), v("cache_etapas.mb"));
+    const double arenaHits = v("arena.aciertos");
+    text += "Buffers (arena)    " + rate(arenaHits, arenaHits + v("arena.fallos")) +
+            QString::asprintf(" (%.0f MB retenidos)\n", v("arena.mb"));
+
+    text += QString::asprintf("\nPools              %.0f/%.0f ocupados, %.0f en cola\n  OpenCV: %d hilos\n",
+                              v("pools.ocupados"), v("pools.workers"), v("pools.en_cola"), cv::getNumThreads());
+
+    const double budget = v("memoria.presupuesto_mb");
+    text += QString::asprintf("\nMemoria            %.0f MB de ", v("memoria.en_uso_mb")) +
+            (budget > 0 ? QString::asprintf("%.0f MB", budget) : QString("(sin límite)")) +
+            QString::asprintf("\n  pico %.0f MB, %.0f expulsiones\n  intercambio %.0f MB volcados, %.0f recargados",
+                              v("memoria.pico_mb"), v("memoria.expulsiones"), v("memoria.volcado_mb"),
+                              v("memoria.recargado_mb"));
+    m_hudLabel->setText(text);
+}
+
+void QtMainWindow::onDumpMetrics() {
+    const QString path = "outputs/metrics/metricas_" +
+                         QDateTime::currentDateTime().toString("yyyyMMdd_HHmmss") + ".tsv";
+    if (metrics().dumpTo(path.toStdString()))
+        statusBar()->showMessage("Métricas guardadas en " + path, 5000);
+    else
+        QMessageBox::warning(this, "Advertencia", "No se pudieron guardar las métricas en " + path);
+}
+
+// ============================
+// Precarga en segundo plano
+// ============================
+void QtMainWindow::startWarmUp() {
+    const std::string modelPath = m_modelCombo->currentData().toString().toStdString();
+    m_warmUp = std::async(std::launch::async, [this, modelPath] {
+        WarmUp w;
+        registerDicomIo();
+        startupProfile().mark("precarga: GDCM");
+
+        w.candidates = candidateDnnConfigs("");
+        startupProfile().mark("precarga: backends DNN");
+
+        if (!modelPath.empty()) {
+            try {
+                DnnConfig cfg = selectDnnConfig(modelPath);   // cacheado en disco
+                cfg.precision = DnnPrecision::FP32;
+                w.denoiser = createDnnDenoiser(cfg);
+                // Primer forward: reserva las capas para el tamaño habitual
+                w.denoiser->denoise(Mat::zeros(512, 512, CV_8U));
+                w.request = cfg;
+                startupProfile().mark("precarga: DnCNN");
+            } catch (...) {
+                w.denoiser.reset();   // se intentará al procesar
+            }
+        }
+
+        // El combo se rellena en el hilo de la interfaz
+        QMetaObject::invokeMethod(this, [this] { adoptWarmUp(); }, Qt::QueuedConnection);
+        return w;
+    });
+}
+
+void QtMainWindow::adoptWarmUp() {
+    if (!m_warmUp.valid()) return;
+    WarmUp w = m_warmUp.get();
+
+    m_dnnCandidates = std::move(w.candidates);
+    for (const auto& cfg : m_dnnCandidates) {
+        m_backendCombo->addItem("DnCNN: " + QString::fromStdString(describeDnnConfig(cfg)));
+    }
+    if (!m_denoiser && w.denoiser) {
+        m_denoiser = std::move(w.denoiser);
+        m_denoiserRequest = w.request;
+    }
+}
+
+bool QtMainWindow::processFile(const QString& filePath) {
+    m_pathEdit->setText(filePath);
+    onProcess();
+    return m_hasResults;
 }
 
 // ============================
@@ -151,20 +367,43 @@ void QtMainWindow::onProcess() {
     }
 
     try {
-        runPipelineForFile(filePath, m_results, m_stats);
+        runPipelineForFile(filePath, m_results);
         m_hasResults = true;
+        // Reprocesar (otro modelo, otra precisión...) invalida lo ya mostrado
+        m_resultsSlice = currentSliceKey(filePath);
+        m_pixmaps.invalidateSlice(m_resultsSlice);
     } catch (const std::exception& e) {
         QMessageBox::critical(this, "Error", e.what());
         m_hasResults = false;
+        m_qualityLabel->clear();
         return;
     }
 
     // Mostrar original a la izquierda
-    QImage imgOrig = cvMatToQImage(m_results[0]);
-    m_originalLabel->setPixmap(QPixmap::fromImage(imgOrig));
+    m_originalLabel->setPixmap(evidencePixmap(0));
 
     // Panel derecho según el combo
     refreshResultView();
+    refreshQualityView();
+    onRefreshHud();
+}
+
+// Ruido, EPI, SSIM y Dice de cada filtro frente a la original, una línea por
+// variante. Se recalcula con cada corte procesado para ver el efecto de los
+// filtros al ir recorriendo la serie sin abrir la comparativa.
+void QtMainWindow::refreshQualityView() {
+    m_quality = computeSliceQuality(m_results);
+    QString text;
+    for (int v = 0; v < kNumDenoiseVariants; ++v) {
+        const VariantQuality& m = m_quality.variants[v];
+        text += QString::asprintf("%-9s ruido %5.1f HU  EPI %.3f  SSIM %.4f  Dice ", kDenoiseVariantNames[v],
+                                  m.noiseStdHU, m.epi, m.ssim);
+        text += m.hasDice ? QString::asprintf("%.3f/%.3f/%.3f", m.dice[LABEL_FAT], m.dice[LABEL_MUSCLE],
+                                              m.dice[LABEL_BONE])
+                          : QStringLiteral("—");
+        if (v + 1 < kNumDenoiseVariants) text += QLatin1Char('\n');
+    }
+    m_qualityLabel->setText(text);
 }
 
 void QtMainWindow::onViewChanged(int) {
@@ -172,6 +411,11 @@ void QtMainWindow::onViewChanged(int) {
     refreshResultView();
 }
 
+void QtMainWindow::onPlaneChanged(int) {
+    m_planeIndexSpin->setEnabled(currentPlane() != Plane::Axial);
+    updatePlaneRange();
+}
+
 void QtMainWindow::onOpenCompare() {
     if (!m_hasResults) {
         QMessageBox::information(this, "Información",
@@ -181,38 +425,118 @@ void QtMainWindow::onOpenCompare() {
 
     CompareWindow dlg(
         this,
-        m_results[0],   // origGray
-        m_results[1],   // gaussGray
-        m_results[2],   // nlGray
-        m_results[3],   // dncnnGray
-        m_results[9],   // overlayOrig
-        m_results[10],  // overlayGauss
-        m_results[11],  // overlayNLMeans
-        m_results[12],  // overlayDncnn
-        m_stats
+        m_results.images[0],   // origGray
+        m_results.images[1],   // gaussGray
+        m_results.images[2],   // nlGray
+        m_results.images[3],   // dncnnGray
+        m_results.images[9],   // overlayOrig
+        m_results.images[10],  // overlayGauss
+        m_results.images[11],  // overlayNLMeans
+        m_results.images[12],  // overlayDncnn
+        m_results.stats,
+        m_quality,
+        &m_pixmaps,
+        m_resultsSlice
     );
     dlg.exec();
 }
 
 // ============================
-// cv::Mat -> QImage
+// cv::Mat -> QPixmap (cacheado)
+// ============================
+QPixmap QtMainWindow::evidencePixmap(int idx) {
+    const DisplayKey key{ m_resultsSlice, idx, kDisplayWindowCenter, kDisplayWindowWidth };
+    return m_pixmaps.get(key, m_results.images[idx]);
+}
+
+// ============================
+// DnCNN según los combos
 // ============================
-QImage QtMainWindow::cvMatToQImage(const cv::Mat& mat) {
-    if (mat.empty()) return {};
-
-    if (mat.type() == CV_8UC1) {
-        return QImage(mat.data, mat.cols, mat.rows, mat.step,
-                      QImage::Format_Grayscale8).copy();
-    } else if (mat.type() == CV_8UC3) {
-        Mat rgb;
-        cvtColor(mat, rgb, COLOR_BGR2RGB);
-        return QImage(rgb.data, rgb.cols, rgb.rows, rgb.step,
-                      QImage::Format_RGB888).copy();
+// Config pedida en los combos (también la que se manda al servidor).
+// false si no hay modelos; lanza si falla el benchmark del modo Auto.
+bool QtMainWindow::currentDnnRequest(const std::string& dicomDir, DnnConfig& cfg) {
+    adoptWarmUp();   // si la precarga sigue en curso, se espera a ella
+    const std::string modelPath = m_modelCombo->currentData().toString().toStdString();
+    if (modelPath.empty()) return false;
+
+    const int b = m_backendCombo->currentIndex();
+    if (b <= 0) {
+        cfg = selectDnnConfig(modelPath);          // cacheado en disco
+    } else {
+        cfg = m_dnnCandidates[b - 1];
+        cfg.modelPath = modelPath;
     }
-    Mat tmp;
-    mat.convertTo(tmp, CV_8U);
-    return QImage(tmp.data, tmp.cols, tmp.rows, tmp.step,
-                  QImage::Format_Grayscale8).copy();
+    cfg.precision = static_cast<DnnPrecision>(m_precisionCombo->currentData().toInt());
+    // INT8 se calibra con la serie abierta: otra serie → otro denoiser
+    if (cfg.precision == DnnPrecision::INT8) cfg.calibDir = dicomDir;
+    return true;
+}
+
+DnnDenoiser* QtMainWindow::currentDenoiser(const std::string& dicomDir) {
+    try {
+        DnnConfig cfg;
+        if (!currentDnnRequest(dicomDir, cfg)) return nullptr;   // sin modelos → evidencia 4 = original
+
+        // Se compara con lo pedido (FP16/INT8 ajustan target/backend al crear)
+        const DnnConfig& prev = m_denoiserRequest;
+        const bool same = m_denoiser &&
+                          prev.modelPath == cfg.modelPath &&
+                          prev.backend   == cfg.backend &&
+                          prev.target    == cfg.target &&
+                          prev.threads   == cfg.threads &&
+                          prev.precision == cfg.precision &&
+                          prev.calibDir  == cfg.calibDir;
+        if (!same) {
+            // INT8 se calibra con la serie abierta
+            m_denoiser = createDnnDenoiser(cfg, dicomDir);
+            m_denoiserRequest = cfg;
+        }
+    } catch (...) {
+        // si el modelo no carga, la evidencia 4 es la original
+        m_denoiser.reset();
+    }
+    return m_denoiser.get();
+}
+
+PipelineParams QtMainWindow::currentParams() const {
+    PipelineParams p;
+    p.cannyLow       = m_cannyLowSpin->value();
+    p.cannyHigh      = m_cannyHighSpin->value();
+    p.nlmH           = static_cast<float>(m_nlmHSpin->value());
+    p.tissue.boneMin = static_cast<float>(m_boneMinSpin->value());
+    return p;
+}
+
+Plane QtMainWindow::currentPlane() const {
+    return static_cast<Plane>(m_planeCombo->currentData().toInt());
+}
+
+bool QtMainWindow::currentProjection(Projection& mode) const {
+    const int data = m_projectionCombo->currentData().toInt();
+    if (data < 0) return false;
+    mode = static_cast<Projection>(data);
+    return true;
+}
+
+// Identificador del corte mostrado (clave de la caché de pixmaps)
+QString QtMainWindow::currentSliceKey(const QString& filePath) const {
+    const Plane plane = currentPlane();
+    QString key = plane == Plane::Axial ? filePath
+                                        : QFileInfo(filePath).absolutePath() + "#" + planeName(plane) + "#" +
+                                              QString::number(m_planeIndexSpin->value());
+    Projection mode;
+    if (currentProjection(mode))
+        key += QString("#") + projectionName(mode) + "#" + QString::number(m_slabSpin->value());
+    return key;
+}
+
+// Rango del índice según el plano y el volumen cargado (centro por defecto)
+void QtMainWindow::updatePlaneRange() {
+    if (m_volume.image.IsNull()) return;
+    const int n = planeSliceCount(m_volume.image, currentPlane());
+    const bool keep = m_planeIndexSpin->maximum() == n - 1;
+    m_planeIndexSpin->setRange(0, std::max(0, n - 1));
+    if (!keep) m_planeIndexSpin->setValue(n / 2);
 }
 
 // ============================
@@ -220,20 +544,47 @@ QImage QtMainWindow::cvMatToQImage(const cv::Mat& mat) {
 // ============================
 void QtMainWindow::refreshResultView() {
     int idx = m_viewCombo->currentIndex();
-    if (idx < 0 || idx >= static_cast<int>(m_results.size())) return;
+    if (idx < 0 || idx >= kNumEvidences) return;
 
-    const Mat& m = m_results[idx];
-    QImage qimg = cvMatToQImage(m);
-    m_resultLabel->setPixmap(QPixmap::fromImage(qimg));
+    // Vista ya vista → el QPixmap cacheado, sin conversión ni subida
+    m_resultLabel->setPixmap(evidencePixmap(idx));
 }
 
 // ============================
 // Pipeline de imagenes
 // ============================
+// Corte axial pedido al servidor local, con el modelo y la precisión de los
+// combos. false si no responde: se procesa en este proceso.
+bool QtMainWindow::runPipelineRemote(const std::string& dicomDir, int index,
+                                     PipelineResults& outResults)
+{
+    SliceRequest req;
+    req.dicomDir = fs::absolute(dicomDir).string();
+    req.first    = index;
+    req.last     = index;
+    req.params   = currentParams();
+    try {
+        // El modelo y la precisión de los combos (el servidor carga esa config
+        // si no es la suya); sin modelos, el DnCNN del servidor
+        if (currentDnnRequest(dicomDir, req.dnn)) {
+            req.dnn.modelPath = fs::absolute(req.dnn.modelPath).string();   // el servidor tiene otro cwd
+            if (!req.dnn.calibDir.empty()) req.dnn.calibDir = req.dicomDir;
+        }
+        bool got = false;
+        SliceClient().process(req, [&](int, PipelineResults& res) {
+            outResults = std::move(res);
+            got = true;
+        });
+        return got;
+    } catch (const std::exception& e) {
+        std::cerr << "[AVISO] Servidor no disponible (" << e.what() << "), se procesa en local\n";
+        return false;
+    }
+}
+
 void QtMainWindow::runPipelineForFile(
         const QString& qFilePath,
-        std::array<cv::Mat, 13>& outResults,
-        SliceStats& outStats)
+        PipelineResults& outResults)
 {
     std::string filePath = qFilePath.toStdString();
     fs::path p(filePath);
@@ -241,126 +592,72 @@ void QtMainWindow::runPipelineForFile(
     std::string dicomDir         = p.parent_path().string();
     std::string selectedFileName = p.filename().string();
 
-    // --- Carga serie ITK ---
-    auto vol = loadDicomSeries(dicomDir);
-    if (vol.image.IsNull()) {
-        throw std::runtime_error("Error al leer la serie DICOM.");
-    }
-
-    // Encontrar índice del archivo seleccionado
-    std::vector<std::string> filesInDir;
-    for (const auto & entry : fs::directory_iterator(dicomDir)) {
-        std::string ext = entry.path().extension().string();
-        std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
-        if (ext == ".ima" || ext == ".dcm") {
-            filesInDir.push_back(entry.path().filename().string());
-        }
-    }
-    std::sort(filesInDir.begin(), filesInDir.end());
-
+    // Índice del archivo elegido en el orden de la serie (el del volumen):
+    // del catálogo si está indexada, sin recorrer el directorio
+    const std::vector<std::string> seriesFiles =
+        m_volumeDir == dicomDir && !m_volume.image.IsNull() ? m_volume.files : listDicomSeriesFiles(dicomDir);
     int targetIndex = 0;
-    for (size_t i = 0; i < filesInDir.size(); ++i) {
-        if (filesInDir[i] == selectedFileName) {
+    for (size_t i = 0; i < seriesFiles.size(); ++i) {
+        if (fs::path(seriesFiles[i]).filename() == selectedFileName) {
             targetIndex = static_cast<int>(i);
             break;
         }
     }
 
-    auto slice = extractSlice(vol.image, targetIndex);
-
-    // Convertir a HU (float)
-    double huMin = 0.0, huMax = 0.0;
-    Mat hu32f_raw = itk2cv32fHU(slice, &huMin, &huMax);
-
-    // ================== GRUPO A: LIMPIEZA ==================
-    Mat img_1_original = huTo8u(hu32f_raw, 40.0f, 400.0f);    // 1
-
-    Mat img_2_gauss;                                         // 2
-    GaussianBlur(img_1_original, img_2_gauss, Size(5, 5), 1.0);
-
-    Mat img_3_nlmeans;                                       // 3
-    fastNlMeansDenoising(img_1_original, img_3_nlmeans, 10, 7, 21);
+    // --- Carga serie ITK (solo si es otra serie) ---
+    // También con servidor: el rango de coronal/sagital y los reformateos
+    // salen del volumen local, que tiene que ser el de la serie abierta
+    static MetricCounter& volumeHits   = metrics().counter("volumen.aciertos");
+    static MetricCounter& volumeMisses = metrics().counter("volumen.fallos");
+    if (m_volumeDir != dicomDir || m_volume.image.IsNull()) {
+        volumeMisses.add();
+        m_volume = loadDicomSeries(seriesFiles);
+        m_volumeMemory.resize(volumeBytes(m_volume));
+        m_volumeDir = dicomDir;
+        updatePlaneRange();
+    } else {
+        volumeHits.add();
+    }
+    const Volume& vol = m_volume;
+    if (vol.image.IsNull()) {
+        m_volumeDir.clear();
+        throw std::runtime_error("Error al leer la serie DICOM.");
+    }
 
-    Mat img_4_dncnn;                                         // 4
-    try {
-        DnnDenoiser denoiser("../models/dncnn_compatible.onnx");
-        img_4_dncnn = denoiser.denoise(img_1_original);
-    } catch (...) {
-        img_4_dncnn = img_1_original.clone();
+    // Con un servidor local (VISION_SERVER) el corte axial se procesa allí:
+    // DnCNN ya caliente y forwards agrupados con los de otros clientes
+    const Plane plane = currentPlane();
+    Projection  projection;
+    const bool  projected = currentProjection(projection);
+    if (plane == Plane::Axial && !projected && std::getenv("VISION_SERVER") && runPipelineRemote(dicomDir, targetIndex, outResults)) {
+        EvidenceWriter store(evidenceStorePath("outputs/final_qt", dicomDir), /*append*/true);
+        store.addSlice(static_cast<uint32_t>(targetIndex), outResults);
+        return;
     }
 
-    // ========== GRUPO B: MORFOLOGÍA + BORDES ==============
-    Mat k = getStructuringElement(MORPH_RECT, Size(3, 3));
-
-    Mat img_5_bordes;                                        // 5
-    Canny(img_2_gauss, img_5_bordes, 50, 150);
-
-    Mat img_6_tophat;                                        // 6
-    morphologyEx(img_1_original, img_6_tophat, MORPH_TOPHAT, k);
-
-    Mat img_7_blackhat;                                      // 7
-    morphologyEx(img_1_original, img_7_blackhat, MORPH_BLACKHAT, k);
-
-    Mat img_8_erosion;                                       // 8
-    erode(img_1_original, img_8_erosion, k);
-
-    Mat img_9_dilatacion;                                    // 9
-    dilate(img_1_original, img_9_dilatacion, k);
-
-    // ================== GRUPO C: SEGMENTACIÓN =============
-
-// 10. Seg. en original
-AnatomyMasks masks_raw = generateAnatomicalMasksHU(hu32f_raw);
-Mat img_10_seg_original = colorizeAndOverlay(img_1_original, masks_raw);
-
-// 11. Seg. en Gauss (segmentación clásica)
-Mat hu_gauss;
-GaussianBlur(hu32f_raw, hu_gauss, Size(3, 3), 1.0);
-AnatomyMasks masks_gauss = generateAnatomicalMasksHU(hu_gauss);
-Mat img_11_seg_gauss = colorizeAndOverlay(img_2_gauss, masks_gauss);
-
-// 12. Seg. en NLMeans (usamos las mismas máscaras que Gauss)
-Mat img_12_seg_nlmeans = colorizeAndOverlay(img_3_nlmeans, masks_gauss);
-
-// 13. Seg. en DnCNN (segmentación avanzada)
-Mat hu_dnn_proxy;
-GaussianBlur(hu32f_raw, hu_dnn_proxy, Size(3, 3), 0.8);
-AnatomyMasks masks_dnn = generateAnatomicalMasksHU(hu_dnn_proxy);
-Mat img_13_seg_dncnn = colorizeAndOverlay(img_4_dncnn, masks_dnn);
-
-// ================== Estadísticas HU (igual que antes) =================
-outStats.fat    = computeTissueStats(hu32f_raw, masks_raw.fat);
-outStats.muscle = computeTissueStats(hu32f_raw, masks_raw.muscle_tendon);
-outStats.bone   = computeTissueStats(hu32f_raw, masks_raw.bones);
-
-// Guardado en disco
-fs::create_directories("outputs/final_qt");
-imwrite("outputs/final_qt/1_Original.png",          img_1_original);
-imwrite("outputs/final_qt/2_Suavizada_Gaus.png",    img_2_gauss);
-imwrite("outputs/final_qt/3_Suavizada_NLMeans.png", img_3_nlmeans);
-imwrite("outputs/final_qt/4_Suavizada_DnCNN.png",   img_4_dncnn);
-imwrite("outputs/final_qt/5_Bordes_Canny.png",      img_5_bordes);
-imwrite("outputs/final_qt/6_TopHat.png",            img_6_tophat);
-imwrite("outputs/final_qt/7_BlackHat.png",          img_7_blackhat);
-imwrite("outputs/final_qt/8_Erosion.png",           img_8_erosion);
-imwrite("outputs/final_qt/9_Dilatacion.png",        img_9_dilatacion);
-imwrite("outputs/final_qt/10_Seg_Original.png",     img_10_seg_original);
-imwrite("outputs/final_qt/11_Seg_Gaus.png",         img_11_seg_gauss);
-imwrite("outputs/final_qt/12_Seg_NLMeans.png",      img_12_seg_nlmeans);
-imwrite("outputs/final_qt/13_Seg_DnCNN.png",        img_13_seg_dncnn);
-
-// Copiar a arreglo de salida (OJO con los índices)
-outResults[0]  = img_1_original;
-outResults[1]  = img_2_gauss;
-outResults[2]  = img_3_nlmeans;
-outResults[3]  = img_4_dncnn;
-outResults[4]  = img_5_bordes;
-outResults[5]  = img_6_tophat;
-outResults[6]  = img_7_blackhat;
-outResults[7]  = img_8_erosion;
-outResults[8]  = img_9_dilatacion;
-outResults[9]  = img_10_seg_original;
-outResults[10] = img_11_seg_gauss;
-outResults[11] = img_12_seg_nlmeans; // NUEVO
-outResults[12] = img_13_seg_dncnn;   // DnCNN ahora es índice 12
-}
\ No newline at end of file
+    // HU nativos (CV_16S) copiados del volumen en memoria: el axial es el
+    // archivo elegido; coronal/sagital, el índice del selector (Z remuestreado)
+    // Con proyección: losa centrada en ese índice (o todo el eje) en su lugar
+    const int   index = plane == Plane::Axial ? targetIndex : m_planeIndexSpin->value();
+    Mat hu16s_raw;
+    if (!projected)
+        hu16s_raw = reformatSlice(vol.image, plane, index);
+    else if (m_slabSpin->value() == 0)
+        volumeProjection(vol.image, plane, projection, hu16s_raw);
+    else
+        m_projector.project(vol.image, plane, index, m_slabSpin->value(), projection, hu16s_raw);
+
+    // 13 evidencias + máscaras + estadísticas HU (pipeline compartido)
+    // Etapas ya calculadas con las mismas entradas/parámetros salen del caché
+    PipelineOptions opts;
+    opts.params = currentParams();
+    runSlicePipeline(hu16s_raw, currentDenoiser(dicomDir), outResults, opts);
+
+    // Guardado en disco: un contenedor por serie con todos los cortes axiales
+    // procesados (evidencias + mapas de etiquetas), en vez de 13 PNG que se
+    // sobrescriben. Reformateos y proyecciones se derivan del volumen y no se guardan.
+    if (plane == Plane::Axial && !projected) {
+        EvidenceWriter store(evidenceStorePath("outputs/final_qt", dicomDir), /*append*/true);
+        store.addSlice(static_cast<uint32_t>(index), outResults);
+    }
+}
@@ -5,24 +5,46 @@
 #include <QPushButton>
 #include <QLabel>
 #include <QComboBox>
+#include <QSpinBox>
+#include <QDoubleSpinBox>
 
 #include <array>
+#include <future>
+#include <memory>
+#include <vector>
 #include <opencv2/core.hpp>
 
 #include "Stats.hpp"   // <-- structs TissueStats y SliceStats
+#include "pipeline.hpp"
+#include "itk_loader.hpp"
+#include "reformat.hpp"
+#include "projection.hpp"
+#include "dnn_denoising.hpp"
+#include "display_adapter.hpp"
+#include "denoise_quality.hpp"
+#include "memory_governor.hpp"
+
+class QDockWidget;
+class QTimer;
 
 class QtMainWindow : public QMainWindow {
     Q_OBJECT
 
 public:
     explicit QtMainWindow(QWidget* parent = nullptr);
-    ~QtMainWindow() override = default;
+    ~QtMainWindow() override;
+
+    // Procesa un archivo como el botón "Procesar" (banco de arranque)
+    bool processFile(const QString& filePath);
 
 private slots:
     void onBrowseDicom();
     void onProcess();
     void onViewChanged(int index);
     void onOpenCompare();     // botón de comparativa
+    void onPlaneChanged(int index);
+    void onRefreshHud();      // panel de rendimiento (temporizador y tras procesar)
+    void onDumpMetrics();
 
 private:
     QLineEdit*   m_pathEdit   = nullptr;
@@ -30,17 +52,71 @@ private:
     QPushButton* m_processButton = nullptr;
     QPushButton* m_compareButton = nullptr;
     QComboBox*   m_viewCombo  = nullptr;
+    QComboBox*   m_modelCombo   = nullptr;   // modelos ONNX de models/
+    QComboBox*   m_backendCombo = nullptr;   // Auto (benchmark) o backend/target fijo
+    QComboBox*   m_precisionCombo = nullptr; // FP32 / FP16 / INT8
+    // Plano del corte: axial = el archivo elegido; coronal/sagital = índice
+    QComboBox*   m_planeCombo     = nullptr;
+    QSpinBox*    m_planeIndexSpin = nullptr;
+    // Proyección de losa (Corte = sin proyección) y grosor en cortes (0 = volumen)
+    QComboBox*   m_projectionCombo = nullptr;
+    QSpinBox*    m_slabSpin        = nullptr;
+    // Parámetros de etapas (el caché de etapas solo recalcula lo afectado)
+    QSpinBox*       m_cannyLowSpin  = nullptr;
+    QSpinBox*       m_cannyHighSpin = nullptr;
+    QDoubleSpinBox* m_nlmHSpin      = nullptr;
+    QSpinBox*       m_boneMinSpin   = nullptr;
     QLabel*      m_originalLabel = nullptr;
     QLabel*      m_resultLabel   = nullptr;
+    QLabel*      m_qualityLabel  = nullptr;   // métricas de los filtros del corte mostrado
+    // Panel de rendimiento: métricas del proceso (metrics())
+    QDockWidget* m_hudDock  = nullptr;
+    QLabel*      m_hudLabel = nullptr;
+    QTimer*      m_hudTimer = nullptr;
 
     bool m_hasResults = false;
-    std::array<cv::Mat, 13> m_results;
-    SliceStats              m_stats;   // viene de Stats.hpp
+    PipelineResults m_results;   // 13 evidencias + máscaras + SliceStats
+    QString         m_resultsSlice;  // corte al que pertenecen m_results
+    SliceQuality    m_quality;       // computeSliceQuality(m_results), al cambiar de corte
+    PixmapCache     m_pixmaps;       // pixmaps ya subidos por (corte, evidencia, ventana)
+
+    // DnCNN cargado una sola vez; se recrea si cambia modelo o backend
+    std::unique_ptr<DnnDenoiser> m_denoiser;
+    DnnConfig                    m_denoiserRequest;   // config pedida para m_denoiser
+    std::vector<DnnConfig>       m_dnnCandidates;
+
+    // Precarga tras mostrar la ventana: GDCM, backends DNN y el modelo por
+    // defecto (FP32, backend de la caché de benchmark) ya inicializado
+    struct WarmUp {
+        std::vector<DnnConfig>       candidates;
+        std::unique_ptr<DnnDenoiser> denoiser;
+        DnnConfig                    request;
+    };
+    std::future<WarmUp> m_warmUp;
+    void startWarmUp();
+    void refreshQualityView();   // recalcula m_quality y la línea bajo las imágenes
+    void adoptWarmUp();   // recoge la precarga (espera si aún no terminó)
+
+    // Última serie cargada: otro corte de la misma serie no la vuelve a leer
+    Volume      m_volume;
+    std::string m_volumeDir;
+    MemoryReservation m_volumeMemory{ "serie abierta (Qt)" };   // m_volume en el gobernador
+    SlabProjector m_projector;   // losa incremental al mover el índice
+
+    DnnDenoiser*   currentDenoiser(const std::string& dicomDir);
+    bool           currentDnnRequest(const std::string& dicomDir, DnnConfig& cfg);
+    PipelineParams currentParams() const;
+    Plane          currentPlane() const;
+    bool           currentProjection(Projection& mode) const;   // false = corte simple
+    QString        currentSliceKey(const QString& filePath) const;
+    void           updatePlaneRange();
 
     void runPipelineForFile(const QString& qFilePath,
-                        std::array<cv::Mat, 13>& outResults,
-                        SliceStats& outStats);
+                            PipelineResults& outResults);
+    bool runPipelineRemote(const std::string& dicomDir, int index,
+                           PipelineResults& outResults);
 
-    void   refreshResultView();
-    QImage cvMatToQImage(const cv::Mat& mat);
+    void    createPerformanceHud();
+    void    refreshResultView();
+    QPixmap evidencePixmap(int idx);
 };
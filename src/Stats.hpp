@@ -5,6 +5,8 @@
 struct TissueStats {
     double meanHU     = 0.0;
     double stdHU      = 0.0;
+    double minHU      = 0.0;
+    double maxHU      = 0.0;
     int    pixelCount = 0;
 };
 
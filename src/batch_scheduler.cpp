@@ -0,0 +1,217 @@
+#include "batch_scheduler.hpp"
+
+#include "dicom_mmap.hpp"
+#include "dnn_precision.hpp"
+#include "evidence_store.hpp"
+#include "memory_governor.hpp"
+#include "pipeline.hpp"
+#include "slice_server.hpp"
+#include "work_pool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+
+namespace fs = std::filesystem;
+using namespace cv;
+
+namespace {
+
+// Memoria de un corte en vuelo por píxel: HU, intermedios float del pipeline
+// y las 13 evidencias (medido a grandes rasgos con 512²)
+constexpr size_t kSliceBytesPerPixel = 48;
+constexpr char   kSliceReservation[] = "cortes en vuelo";
+
+struct SeriesState {
+    const SeriesJob* job = nullptr;
+    std::unique_ptr<EvidenceWriter> writer;   // solo bajo writerMutex
+    std::mutex writerMutex;
+
+    int  next     = 0;       // siguiente corte a leer
+    int  inFlight = 0;       // leídos o en cálculo, sin escribir
+    int  done     = 0;
+    bool started  = false;
+    bool finished = false;
+    std::chrono::steady_clock::time_point t0;
+    SeriesProgress progress;
+};
+
+} // namespace
+
+std::vector<SeriesProgress> processSeriesBatch(const std::vector<SeriesJob>& jobs, const BatchOptions& opts,
+                                               const std::function<void(const SeriesProgress&)>& onFinished) {
+    std::vector<std::unique_ptr<SeriesState>> series;
+    for (const auto& j : jobs) {
+        auto s = std::make_unique<SeriesState>();
+        s->job = &j;
+        s->progress.name    = j.name;
+        s->progress.outPath = j.outPath;
+        s->progress.total   = static_cast<int>(j.files.size());
+        series.push_back(std::move(s));
+    }
+
+    // Un solo modelo para todas las series; sus forwards se agrupan por lotes.
+    // Si se pidió y no carga, el lote no empieza: si no, todos los .vev
+    // llevarían copias de la original como evidencia "DnCNN".
+    std::unique_ptr<BatchingDenoiser> denoiser;
+    if (!opts.dnn.modelPath.empty()) {
+        try {
+            denoiser = std::make_unique<BatchingDenoiser>(createDnnDenoiser(opts.dnn), opts.maxBatch,
+                                                          opts.batchWaitMs);
+        } catch (const std::exception& e) {
+            throw std::runtime_error("No se pudo cargar DnCNN (" + opts.dnn.modelPath + "): " + e.what());
+        }
+    }
+
+    std::mutex mutex;                 // estado de planificación de todas las series
+    std::condition_variable slotFree;
+    const int window = std::max(1, opts.window);
+    const int maxActive = opts.activeSeries > 0 ? opts.activeSeries : static_cast<int>(series.size());
+
+    // Cada corte en vuelo reserva su memoria en el gobernador. Si no cabe, se
+    // espera a que termine otro: con poca RAM baja la concurrencia en vez de
+    // pasarse. Tamaño de corte supuesto hasta leer el primero.
+    MemoryGovernor& memory = memoryGovernor();
+    std::atomic<size_t> sliceBytes{ size_t(512) * 512 * kSliceBytesPerPixel };
+    int inFlightTotal = 0;
+    uint64_t slicesFinished = 0;   // cortes terminados: despierta al planificador
+
+    WorkStealingPool io(std::max(1, opts.ioWorkers));
+    WorkStealingPool cpu(opts.cpuWorkers);
+
+    // Cierre de una serie (con 'mutex' tomado por el llamador)
+    auto finishSeries = [&](SeriesState& s) {
+        s.finished = true;
+        s.progress.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - s.t0).count();
+        s.progress.done = s.done;
+        {
+            std::lock_guard<std::mutex> lock(s.writerMutex);
+            try {
+                if (s.writer) s.writer->close();
+            } catch (const std::exception& e) {
+                if (s.progress.error.empty()) s.progress.error = e.what();
+            }
+            s.writer.reset();
+        }
+        if (onFinished) onFinished(s.progress);
+    };
+
+    // Corte terminado (bien o mal): libera su hueco
+    auto sliceDone = [&](SeriesState& s, const std::string& error, size_t reserved) {
+        memory.unreserve(kSliceReservation, reserved);
+        std::lock_guard<std::mutex> lock(mutex);
+        --s.inFlight;
+        --inFlightTotal;
+        ++slicesFinished;
+        if (error.empty()) ++s.done;
+        else if (s.progress.error.empty()) s.progress.error = error;
+        const bool failed = !s.progress.error.empty();
+        if (s.inFlight == 0 && (failed || s.done == s.progress.total) && !s.finished) finishSeries(s);
+        slotFree.notify_all();
+    };
+
+    // E/S → CPU (+ inferencia) → escritura
+    auto launchSlice = [&](SeriesState& s, int index, size_t reserved) {
+        io.submit([&, index, reserved] {
+            std::shared_ptr<Mat> hu;
+            try {
+                hu = std::make_shared<Mat>(loadSliceHU(s.job->files[index]));
+                sliceBytes = hu->total() * kSliceBytesPerPixel;
+            } catch (const std::exception& e) {
+                sliceDone(s, e.what(), reserved);
+                return;
+            }
+            cpu.submit([&, index, hu, reserved] {
+                try {
+                    thread_local PipelineResults res;   // buffers del worker
+                    PipelineOptions popts;
+                    popts.useCache = false;   // cada corte se ve una vez: el caché solo copiaría
+                    runSlicePipeline(*hu, denoiser.get(), res, popts);
+                    std::lock_guard<std::mutex> lock(s.writerMutex);
+                    if (s.writer) s.writer->addSlice(static_cast<uint32_t>(index), res);
+                } catch (const std::exception& e) {
+                    sliceDone(s, e.what(), reserved);
+                    return;
+                }
+                sliceDone(s, {}, reserved);
+            });
+        });
+    };
+
+    // Planificador: reparte huecos libres en turno rotatorio
+    size_t cursor = 0;
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        int active = 0;
+        bool pending = false;
+        for (auto& s : series) {
+            if (s->finished) continue;
+            pending = true;
+            if (s->started) ++active;
+        }
+        if (!pending) break;
+
+        // Nuevas series mientras haya sitio
+        for (auto& s : series) {
+            if (active >= maxActive) break;
+            if (s->started || s->finished) continue;
+            s->started = true;
+            s->t0 = std::chrono::steady_clock::now();
+            ++active;
+            try {
+                fs::create_directories(fs::path(s->job->outPath).parent_path());
+                std::lock_guard<std::mutex> wl(s->writerMutex);
+                s->writer = std::make_unique<EvidenceWriter>(s->job->outPath);
+            } catch (const std::exception& e) {
+                s->progress.error = e.what();
+            }
+            if (!s->progress.error.empty() || s->progress.total == 0) finishSeries(*s);
+        }
+
+        // Un corte por serie y vuelta, hasta llenar las ventanas
+        bool launched = false;
+        for (size_t k = 0; k < series.size(); ++k) {
+            SeriesState& s = *series[(cursor + k) % series.size()];
+            if (!s.started || s.finished || !s.progress.error.empty()) continue;
+            if (s.inFlight >= window || s.next >= s.progress.total) continue;
+
+            // La reserva puede expulsar (volcar a disco): sin el cerrojo, que
+            // los cortes en vuelo puedan ir terminando mientras tanto
+            const size_t bytes = sliceBytes;
+            const bool force = inFlightTotal == 0;
+            const uint64_t seen = slicesFinished;
+            lock.unlock();
+            const bool granted = memory.reserve(kSliceReservation, bytes, force);
+            lock.lock();
+            if (!granted) {
+                launched = slicesFinished != seen;   // algo terminó entretanto: reintentar ya
+                break;
+            }
+            if (s.finished || !s.progress.error.empty()) {   // falló mientras se reservaba
+                memory.unreserve(kSliceReservation, bytes);
+                launched = true;
+                break;
+            }
+            ++s.inFlight;
+            ++inFlightTotal;
+            launchSlice(s, s.next++, bytes);
+            launched = true;
+            cursor = (cursor + k + 1) % series.size();
+            break;
+        }
+        if (!launched) slotFree.wait(lock);
+    }
+    lock.unlock();
+
+    io.waitIdle();
+    cpu.waitIdle();
+
+    std::vector<SeriesProgress> out;
+    for (auto& s : series) out.push_back(s->progress);
+    return out;
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "dnn_denoising.hpp"
+
+// ==========================================================
+// Procesado concurrente de varias series (cola de estudios)
+// ==========================================================
+// Cada corte pasa por tres clases de tarea:
+//  - E/S:       lectura + decodificación DICOM → HU (pool de E/S pequeño)
+//  - CPU:       pipeline completo del corte (pool con robo de tareas)
+//  - inferencia: los forwards DnCNN de todas las tareas CPU en curso se
+//               agrupan en lotes en un único hilo (BatchingDenoiser)
+// y termina escrito en el contenedor .vev de su serie.
+//
+// Contrapresión: cada serie tiene como mucho 'window' cortes en vuelo (leídos
+// y aún no escritos), así la E/S no se adelanta más que eso al cálculo.
+// Equidad: los huecos libres se reparten en turno rotatorio entre las series
+// activas, de modo que un estudio grande avanza al mismo ritmo que los demás
+// en vez de ocupar todas las colas.
+
+struct SeriesJob {
+    std::string name;                 // para el progreso (p.ej. descripción o directorio)
+    std::vector<std::string> files;   // cortes ordenados
+    std::string outPath;              // contenedor .vev
+};
+
+struct SeriesProgress {
+    std::string name;
+    std::string outPath;
+    int    total   = 0;
+    int    done    = 0;
+    double seconds = 0.0;
+    std::string error;                // vacío si terminó bien
+};
+
+struct BatchOptions {
+    int cpuWorkers   = 0;   // 0 → núcleos de la máquina
+    int ioWorkers    = 2;
+    int window       = 4;   // cortes en vuelo por serie
+    int activeSeries = 0;   // series a la vez (0 → todas)
+    DnnConfig dnn;          // modelPath vacío → sin DnCNN
+    int maxBatch     = 8;   // imágenes por forward DnCNN
+    int batchWaitMs  = 4;
+};
+
+// Procesa todas las series y devuelve una fila por serie (en el orden de
+// 'jobs'). onFinished se llama al terminar cada serie, desde un worker.
+// Lanza runtime_error si opts.dnn pide un modelo que no se puede cargar.
+std::vector<SeriesProgress> processSeriesBatch(
+    const std::vector<SeriesJob>& jobs, const BatchOptions& opts,
+    const std::function<void(const SeriesProgress&)>& onFinished = {});
@@ -0,0 +1,54 @@
+#include "body_roi.hpp"
+#include <opencv2/imgproc.hpp>
+
+using namespace cv;
+
+namespace {
+constexpr int kScale = 4;   // detección a 1/4 de resolución (128x128 para 512²)
+}
+
+cv::Rect detectBodyRoi(const cv::Mat& hu) {
+    CV_Assert(hu.type() == CV_32F || hu.type() == CV_16S);
+    if (hu.empty()) return {};
+
+    // Submuestreo por vecino más próximo: 16 veces menos píxeles que recorrer
+    Mat small;
+    resize(hu, small, Size(), 1.0 / kScale, 1.0 / kScale, INTER_NEAREST);
+
+    Mat body;
+    compare(small, Scalar(kBodyThresholdHU), body, CMP_GT);
+
+    // La apertura separa la camilla (fina) del cuerpo
+    morphologyEx(body, body, MORPH_OPEN, getStructuringElement(MORPH_ELLIPSE, Size(3, 3)));
+
+    Mat labels, stats, centroids;
+    const int n = connectedComponentsWithStats(body, labels, stats, centroids, 8, CV_32S);
+    int best = 0, bestArea = 0;
+    for (int i = 1; i < n; ++i) {
+        const int area = stats.at<int>(i, CC_STAT_AREA);
+        if (area > bestArea) { bestArea = area; best = i; }
+    }
+    if (best == 0) return {};
+
+    // De vuelta a resolución completa, cubriendo el píxel submuestreado entero
+    Rect r(stats.at<int>(best, CC_STAT_LEFT)  * kScale,
+           stats.at<int>(best, CC_STAT_TOP)   * kScale,
+           stats.at<int>(best, CC_STAT_WIDTH) * kScale,
+           stats.at<int>(best, CC_STAT_HEIGHT)* kScale);
+    return expandRoi(r, kScale, hu.size());
+}
+
+cv::Rect detectBodyRoi(const std::vector<cv::Mat>& huSlices) {
+    Rect acc;
+    for (const Mat& hu : huSlices) {
+        const Rect r = detectBodyRoi(hu);
+        if (r.empty()) continue;
+        acc = acc.empty() ? r : (acc | r);
+    }
+    return acc;
+}
+
+cv::Rect expandRoi(const cv::Rect& r, int margin, const cv::Size& bounds) {
+    Rect e(r.x - margin, r.y - margin, r.width + 2 * margin, r.height + 2 * margin);
+    return e & Rect(0, 0, bounds.width, bounds.height);
+}
@@ -0,0 +1,18 @@
+#pragma once
+#include <vector>
+#include <opencv2/core.hpp>
+
+// Umbral de "cuerpo": por encima de -500 HU (piel, grasa, órganos, hueso)
+constexpr float kBodyThresholdHU = -500.0f;
+
+// Caja envolvente del paciente en un corte HU (CV_32F o CV_16S): componente
+// conexa más grande por encima del umbral, calculada a 1/4 de resolución.
+// Descarta el aire y la camilla (estructura fina, separada del cuerpo).
+// Rect vacío si el corte no contiene cuerpo.
+cv::Rect detectBodyRoi(const cv::Mat& hu);
+
+// Unión de las cajas de varios cortes (ROI única para todo un volumen)
+cv::Rect detectBodyRoi(const std::vector<cv::Mat>& huSlices);
+
+// Rect ampliado 'margin' píxeles por lado y recortado al tamaño de la imagen
+cv::Rect expandRoi(const cv::Rect& r, int margin, const cv::Size& bounds);
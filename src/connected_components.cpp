@@ -0,0 +1,253 @@
+#include "connected_components.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include <opencv2/core/utility.hpp>
+
+using namespace cv;
+
+namespace {
+
+// Union-find sobre índices globales de tramo. La raíz es siempre el índice
+// menor, así dos bloques que solo tocan sus rangos no interfieren.
+struct UnionFind {
+    std::vector<uint32_t> parent;
+
+    explicit UnionFind(size_t n) : parent(n) {
+        for (size_t i = 0; i < n; ++i) parent[i] = static_cast<uint32_t>(i);
+    }
+
+    uint32_t find(uint32_t x) {
+        while (parent[x] != x) {
+            parent[x] = parent[parent[x]];   // compresión a medias
+            x = parent[x];
+        }
+        return x;
+    }
+
+    void unite(uint32_t a, uint32_t b) {
+        a = find(a);
+        b = find(b);
+        if (a == b) return;
+        if (a < b) parent[b] = a;
+        else       parent[a] = b;
+    }
+};
+
+// Une los tramos de dos filas que se tocan con la misma etiqueta.
+// slack = 1 → también en diagonal (8-conexo); 0 → solo solape (4-conexo).
+void uniteRows(const LabelRun* a, const LabelRun* ae, uint32_t aBase,
+               const LabelRun* b, const LabelRun* be, uint32_t bBase,
+               int slack, UnionFind& uf) {
+    const LabelRun* b0 = b;
+    for (uint32_t ia = aBase; a != ae; ++a, ++ia) {
+        const int aEnd = a->start + a->length;
+        // Tramos de 'b' que acaban antes de alcanzar a 'a' ya no tocan a ninguno de los siguientes
+        while (b != be && b->start + b->length + slack <= a->start) ++b;
+        for (const LabelRun* t = b; t != be && t->start < aEnd + slack; ++t)
+            if (t->label == a->label) uf.unite(ia, bBase + static_cast<uint32_t>(t - b0));
+    }
+}
+
+struct PartialStats {
+    uint64_t n = 0;
+    double   shift = 0.0, sum = 0.0, sumSq = 0.0;
+    double   mn = std::numeric_limits<double>::infinity();
+    double   mx = -std::numeric_limits<double>::infinity();
+
+    void add(double v) {
+        if (n == 0) shift = v;
+        const double d = v - shift;
+        sum += d;
+        sumSq += d * d;
+        ++n;
+        mn = std::min(mn, v);
+        mx = std::max(mx, v);
+    }
+};
+
+template <typename T>
+void accumulateRunHU(const Mat& hu, int row, const LabelRun& run, PartialStats& s) {
+    const T* p = hu.ptr<T>(row) + run.start;
+    for (int i = 0; i < run.length; ++i) s.add(static_cast<double>(p[i]));
+}
+
+} // namespace
+
+ComponentResult analyzeComponents(const std::vector<RleLabelMap>& slices, const std::vector<Mat>& hu,
+                                  const ComponentOptions& opts) {
+    ComponentResult res;
+    if (slices.empty()) return res;
+    const int nz = static_cast<int>(slices.size());
+    const Size size = slices.front().size();
+    for (const auto& s : slices) CV_Assert(s.size() == size);
+    CV_Assert(hu.empty() || hu.size() == slices.size());
+
+    // Índice global del primer tramo de cada corte
+    std::vector<uint32_t> base(nz + 1, 0);
+    for (int z = 0; z < nz; ++z) base[z + 1] = base[z] + static_cast<uint32_t>(slices[z].numRuns());
+    UnionFind uf(base[nz]);
+    const int slack = opts.inPlane8 ? 1 : 0;
+
+    auto rowBase = [&](int z, int r) {
+        return base[z] + static_cast<uint32_t>(slices[z].runIndex(slices[z].rowBegin(r)));
+    };
+
+    // 1. Bloques de cortes en paralelo: plano + entre cortes del mismo bloque
+    const int slab = std::max(1, opts.slabSlices);
+    const int nSlabs = (nz + slab - 1) / slab;
+    parallel_for_(Range(0, nSlabs), [&](const Range& range) {
+        for (int k = range.start; k < range.end; ++k) {
+            const int z0 = k * slab, z1 = std::min(nz, z0 + slab);
+            for (int z = z0; z < z1; ++z) {
+                const RleLabelMap& m = slices[z];
+                for (int r = 1; r < size.height; ++r)
+                    uniteRows(m.rowBegin(r), m.rowEnd(r), rowBase(z, r),
+                              m.rowBegin(r - 1), m.rowEnd(r - 1), rowBase(z, r - 1), slack, uf);
+                if (z == z0) continue;
+                const RleLabelMap& prev = slices[z - 1];
+                for (int r = 0; r < size.height; ++r)
+                    uniteRows(m.rowBegin(r), m.rowEnd(r), rowBase(z, r),
+                              prev.rowBegin(r), prev.rowEnd(r), rowBase(z - 1, r), 0, uf);
+            }
+        }
+    });
+
+    // 2. Fronteras entre bloques (secuencial: pocas filas)
+    for (int k = 1; k < nSlabs; ++k) {
+        const int z = k * slab;
+        for (int r = 0; r < size.height; ++r)
+            uniteRows(slices[z].rowBegin(r), slices[z].rowEnd(r), rowBase(z, r),
+                      slices[z - 1].rowBegin(r), slices[z - 1].rowEnd(r), rowBase(z - 1, r), 0, uf);
+    }
+
+    // 3. Raíces → componentes: tamaño, centroide y caja solo con los tramos
+    const uint32_t nRuns = base[nz];
+    std::vector<uint32_t> compOf(nRuns);
+    std::vector<int32_t>  compIndex(nRuns, -1);   // por raíz
+    std::vector<Component> all;
+    for (int z = 0; z < nz; ++z) {
+        const RleLabelMap& m = slices[z];
+        for (int r = 0; r < size.height; ++r) {
+            for (const LabelRun* run = m.rowBegin(r); run != m.rowEnd(r); ++run) {
+                const uint32_t id = base[z] + static_cast<uint32_t>(m.runIndex(run));
+                const uint32_t root = uf.find(id);
+                if (compIndex[root] < 0) {
+                    compIndex[root] = static_cast<int32_t>(all.size());
+                    Component c;
+                    c.label = run->label;
+                    c.bboxMin[0] = run->start; c.bboxMin[1] = r; c.bboxMin[2] = z;
+                    c.bboxMax[0] = run->start + run->length - 1; c.bboxMax[1] = r; c.bboxMax[2] = z;
+                    all.push_back(c);
+                }
+                const uint32_t ci = static_cast<uint32_t>(compIndex[root]);
+                compOf[id] = ci;
+                Component& c = all[ci];
+                const double len = run->length;
+                c.voxels += run->length;
+                c.centroid[0] += len * (run->start + (run->length - 1) * 0.5);
+                c.centroid[1] += len * r;
+                c.centroid[2] += len * z;
+                c.bboxMin[0] = std::min<int>(c.bboxMin[0], run->start);
+                c.bboxMin[1] = std::min(c.bboxMin[1], r);
+                c.bboxMin[2] = std::min(c.bboxMin[2], z);
+                c.bboxMax[0] = std::max<int>(c.bboxMax[0], run->start + run->length - 1);
+                c.bboxMax[1] = std::max(c.bboxMax[1], r);
+                c.bboxMax[2] = std::max(c.bboxMax[2], z);
+            }
+        }
+    }
+
+    // 4. Filtro por tamaño: índice compacto de las que se quedan
+    std::vector<int32_t> keptIndex(all.size(), -1);
+    for (size_t i = 0; i < all.size(); ++i) {
+        Component& c = all[i];
+        if (static_cast<int64_t>(c.voxels) < opts.minVoxels) {
+            ++res.removedComponents;
+            res.removedVoxels += c.voxels;
+            continue;
+        }
+        for (double& v : c.centroid) v /= static_cast<double>(c.voxels);
+        keptIndex[i] = static_cast<int32_t>(res.components.size());
+        res.components.push_back(c);
+    }
+
+    // 5. Mapas filtrados + estadísticas HU, por bloques en paralelo
+    const size_t nKept = res.components.size();
+    std::vector<std::vector<PartialStats>> partial(hu.empty() ? 0 : nSlabs);
+    res.filtered.resize(nz);
+    parallel_for_(Range(0, nSlabs), [&](const Range& range) {
+        std::vector<uint8_t> keep;
+        for (int k = range.start; k < range.end; ++k) {
+            if (!hu.empty()) partial[k].assign(nKept, PartialStats());
+            const int z0 = k * slab, z1 = std::min(nz, z0 + slab);
+            for (int z = z0; z < z1; ++z) {
+                const RleLabelMap& m = slices[z];
+                keep.assign(m.numRuns(), 0);
+                for (int r = 0; r < size.height; ++r) {
+                    for (const LabelRun* run = m.rowBegin(r); run != m.rowEnd(r); ++run) {
+                        const size_t local = m.runIndex(run);
+                        const int32_t ki = keptIndex[compOf[base[z] + local]];
+                        if (ki < 0) continue;
+                        keep[local] = 1;
+                        if (hu.empty()) continue;
+                        PartialStats& s = partial[k][ki];
+                        if (hu[z].type() == CV_16S) accumulateRunHU<short>(hu[z], r, *run, s);
+                        else                        accumulateRunHU<float>(hu[z], r, *run, s);
+                    }
+                }
+                res.filtered[z] = m.keepRuns(keep.data());
+            }
+        }
+    });
+
+    if (!hu.empty()) {
+        for (size_t i = 0; i < nKept; ++i) {
+            // Fusión de los parciales (Chan et al.), como TissueAccumulator
+            double n = 0.0, mean = 0.0, m2 = 0.0, mn = 0.0, mx = 0.0;
+            for (int k = 0; k < nSlabs; ++k) {
+                const PartialStats& s = partial[k][i];
+                if (s.n == 0) continue;
+                const double nb = static_cast<double>(s.n);
+                const double mb = s.shift + s.sum / nb;
+                const double m2b = std::max(0.0, s.sumSq - s.sum * s.sum / nb);
+                if (n == 0.0) {
+                    n = nb; mean = mb; m2 = m2b; mn = s.mn; mx = s.mx;
+                    continue;
+                }
+                const double delta = mb - mean;
+                const double tot = n + nb;
+                mean += delta * nb / tot;
+                m2   += m2b + delta * delta * n * nb / tot;
+                n = tot;
+                mn = std::min(mn, s.mn);
+                mx = std::max(mx, s.mx);
+            }
+            Component& c = res.components[i];
+            c.meanHU = mean;
+            c.stdHU  = n > 0.0 ? std::sqrt(m2 / n) : 0.0;
+            c.minHU  = mn;
+            c.maxHU  = mx;
+        }
+    }
+
+    std::stable_sort(res.components.begin(), res.components.end(),
+                     [](const Component& a, const Component& b) { return a.voxels > b.voxels; });
+    return res;
+}
+
+ComponentResult analyzeComponents(const RleLabelMap& slice, const Mat& hu, const ComponentOptions& opts) {
+    std::vector<RleLabelMap> slices{ slice };
+    std::vector<Mat> hus;
+    if (!hu.empty()) hus.push_back(hu);
+    return analyzeComponents(slices, hus, opts);
+}
+
+RleLabelMap removeSmallComponents(const RleLabelMap& labels, int minPixels) {
+    if (minPixels <= 0 || labels.numRuns() == 0) return labels;
+    ComponentOptions opts;
+    opts.minVoxels = minPixels;
+    return std::move(analyzeComponents(labels, Mat(), opts).filtered.front());
+}
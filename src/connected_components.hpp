@@ -0,0 +1,58 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <opencv2/core.hpp>
+
+#include "label_rle.hpp"
+
+// ==========================================================
+// Componentes conexas de mapas de etiquetas (2D y 3D)
+// ==========================================================
+// Trabaja sobre los tramos de RleLabelMap, no sobre píxeles: cada tramo es un
+// nodo de un union-find y se une con los tramos de la misma etiqueta que lo
+// tocan en la fila anterior (8-conexo en el plano, o 4) y en la misma fila
+// del corte anterior (6-conexo entre cortes).
+// El volumen se reparte en bloques de cortes que se etiquetan en paralelo
+// (cada bloque solo toca sus propios nodos); después se unen las fronteras
+// entre bloques, se resuelven las raíces y, en la misma pasada, se descartan
+// las componentes pequeñas y se calculan las estadísticas de las que quedan.
+
+// Área mínima (px) de una isla de tejido en las segmentaciones por corte:
+// por debajo son ruido del umbral (a 0.7 mm/px, 16 px ≈ 8 mm²)
+constexpr int kMinComponentPx = 16;
+
+struct Component {
+    uint8_t  label  = 0;      // etiqueta de tejido (TissueLabel)
+    uint64_t voxels = 0;
+    double   centroid[3] = { 0.0, 0.0, 0.0 };   // x, y, z (píxeles / índice de corte)
+    int      bboxMin[3]  = { 0, 0, 0 };          // x, y, z inclusive
+    int      bboxMax[3]  = { 0, 0, 0 };
+    // HU (solo si se pasan los cortes HU)
+    double   meanHU = 0.0, stdHU = 0.0, minHU = 0.0, maxHU = 0.0;
+};
+
+struct ComponentOptions {
+    int  minVoxels = 0;           // componentes más pequeñas se eliminan (0 → ninguna)
+    bool inPlane8  = true;        // 8-conexo en el plano (false → 4)
+    int  slabSlices = 16;         // cortes por bloque paralelo
+};
+
+struct ComponentResult {
+    std::vector<Component>   components;   // solo las que superan minVoxels, de mayor a menor
+    std::vector<RleLabelMap> filtered;     // mapas de entrada sin las componentes eliminadas
+    uint64_t removedComponents = 0;
+    uint64_t removedVoxels     = 0;
+};
+
+// Volumen: un mapa por corte (mismo tamaño). 'hu' vacío → sin estadísticas HU;
+// si no, un Mat por corte (CV_16S o CV_32F, p.ej. vistas del volumen ITK).
+ComponentResult analyzeComponents(const std::vector<RleLabelMap>& slices,
+                                  const std::vector<cv::Mat>& hu = {},
+                                  const ComponentOptions& opts = {});
+
+// Un corte (2D)
+ComponentResult analyzeComponents(const RleLabelMap& slice, const cv::Mat& hu = {},
+                                  const ComponentOptions& opts = {});
+
+// Atajo del pipeline: quita las componentes 2D de menos de minPixels
+RleLabelMap removeSmallComponents(const RleLabelMap& labels, int minPixels);
@@ -0,0 +1,197 @@
+#include "denoise_quality.hpp"
+
+#include "dicom_mmap.hpp"
+#include "itk_opencv_bridge.hpp"
+#include "quality_metrics.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+#include <opencv2/core/utility.hpp>
+#include <opencv2/imgproc.hpp>
+
+namespace fs = std::filesystem;
+using namespace cv;
+
+const char* const kDenoiseVariantNames[kNumDenoiseVariants] = { "original", "gauss", "nlmeans", "dncnn" };
+
+namespace {
+
+// Temporales de la original, uno por hilo (se reutilizan entre cortes)
+struct QualityScratch {
+    Mat labels, homogeneous;
+    Mat lapRef;
+    SsimReference ssimRef;
+};
+thread_local QualityScratch t_scratch;
+
+// Desviación local media dentro de 'mask' (niveles de gris)
+double localNoiseStd(const Mat& img8u, const Mat& mask, int win) {
+    Mat x, mu, mu2;
+    img8u.convertTo(x, CV_32F);
+    const Size k(win, win);
+    boxFilter(x, mu, CV_32F, k, Point(-1, -1), true, BORDER_REFLECT);
+    boxFilter(x.mul(x), mu2, CV_32F, k, Point(-1, -1), true, BORDER_REFLECT);
+    mu2 -= mu.mul(mu);
+    max(mu2, 0.0, mu2);
+    sqrt(mu2, mu2);
+    return mean(mu2, mask)[0];
+}
+
+// Correlación de dos laplacianos ya centrados
+double edgePreservation(const Mat& lapRef, const Mat& img8u) {
+    Mat lap;
+    Laplacian(img8u, lap, CV_32F, 3);
+    lap -= mean(lap);
+    const double den = std::sqrt(lapRef.dot(lapRef) * lap.dot(lap));
+    return den > 0.0 ? lapRef.dot(lap) / den : 1.0;
+}
+
+// Segmentación propia de cada variante. NLMeans no tiene: su overlay reutiliza
+// las máscaras de Gauss y su Dice sería el de Gauss
+const RleLabelMap* variantLabels(const PipelineResults& r, int v) {
+    switch (v) {
+    case 0:  return &r.labelsRaw;
+    case 1:  return &r.labelsGauss;
+    case 3:  return &r.labelsDnn;
+    default: return nullptr;
+    }
+}
+
+} // namespace
+
+SliceQuality computeSliceQuality(const PipelineResults& r, const Mat& reference, const QualityOptions& opts) {
+    const Mat& orig = r.images[0];
+    CV_Assert(orig.type() == CV_8UC1);
+    CV_Assert(reference.empty() || (reference.size() == orig.size() && reference.type() == CV_8UC1));
+    QualityScratch& s = t_scratch;
+    SliceQuality q;
+    q.hasReference = !reference.empty();
+
+    // Solo el cuerpo: fuera es fondo constante en todas las variantes
+    const Rect full(0, 0, orig.cols, orig.rows);
+    const Rect roi = r.roi.empty() ? full : (r.roi & full);
+    if (roi.empty()) return q;
+
+    // Interior de grasa y músculo: la ventana entera cae dentro del tejido
+    const RleLabelMap labelsRoi = r.labelsRaw.empty() ? RleLabelMap(roi.size()) : r.labelsRaw.crop(roi);
+    labelsRoi.rasterize(s.labels);
+    inRange(s.labels, Scalar(LABEL_FAT), Scalar(LABEL_MUSCLE), s.homogeneous);
+    erode(s.homogeneous, s.homogeneous,
+          getStructuringElement(MORPH_RECT, Size(opts.noiseWindow, opts.noiseWindow)));
+    q.homogeneousPx = static_cast<uint64_t>(countNonZero(s.homogeneous));
+
+    const Mat refImg = q.hasReference ? reference(roi) : orig(roi);
+    prepareSsimReference(refImg, s.ssimRef);
+    Laplacian(orig(roi), s.lapRef, CV_32F, 3);
+    s.lapRef -= mean(s.lapRef);
+
+    const std::vector<uint64_t> rawCounts = labelsRoi.counts(kNumTissueLabels);
+    const double toHU = opts.windowWidth / 255.0;
+    const QualityScratch& ref = s;   // los workers solo leen lo de la original
+
+    parallel_for_(Range(0, kNumDenoiseVariants), [&](const Range& range) {
+        for (int v = range.start; v < range.end; ++v) {
+            VariantQuality& m = q.variants[v];
+            const Mat img = r.images[v](roi);
+            if (img.empty()) continue;   // sin esa evidencia
+
+            if (q.homogeneousPx > 0) m.noiseStdHU = localNoiseStd(img, ref.homogeneous, opts.noiseWindow) * toHU;
+
+            // La original contra sí misma: valores de identidad sin calcular
+            if (v != 0) m.epi = edgePreservation(ref.lapRef, img);
+            if (v != 0 || q.hasReference) {
+                m.psnr = computePSNR(refImg, img);
+                m.ssim = computeSSIM(ref.ssimRef, img);
+            }
+
+            const RleLabelMap* lv = variantLabels(r, v);
+            if (!lv || lv->empty() || r.labelsRaw.empty()) continue;
+            m.hasDice = true;
+            const RleLabelMap labels = lv->crop(roi);
+            const std::vector<uint64_t> inter  = labels.overlap(labelsRoi, kNumTissueLabels);
+            const std::vector<uint64_t> counts = labels.counts(kNumTissueLabels);
+            for (int l = 1; l < kNumTissueLabels; ++l) {
+                const uint64_t sum = counts[l] + rawCounts[l];
+                m.dice[l] = sum ? 2.0 * inter[l] / static_cast<double>(sum) : 1.0;
+            }
+        }
+    });
+    return q;
+}
+
+SeriesQuality computeSeriesQuality(const std::vector<std::string>& files, Denoiser* denoiser,
+                                   const std::vector<std::string>& referenceFiles, const QualityOptions& opts) {
+    if (!referenceFiles.empty() && referenceFiles.size() != files.size())
+        throw std::runtime_error("La serie de referencia no tiene el mismo número de cortes");
+
+    const auto t0 = std::chrono::steady_clock::now();
+    SeriesQuality out;
+    out.slices.reserve(files.size());
+    PipelineResults res;   // buffers reutilizados corte a corte
+    PipelineOptions popts;
+    popts.useCache = false;   // cada corte se ve una vez
+    Mat ref8u;
+    for (size_t i = 0; i < files.size(); ++i) {
+        runSlicePipeline(loadSliceHU(files[i]), denoiser, res, popts);
+        if (!referenceFiles.empty()) huTo8u(loadSliceHU(referenceFiles[i]), opts.windowCenter, opts.windowWidth, ref8u);
+        out.slices.push_back(computeSliceQuality(res, referenceFiles.empty() ? Mat() : ref8u, opts));
+    }
+
+    // Medias de la serie
+    SliceQuality& mean = out.mean;
+    mean.hasReference = !referenceFiles.empty();
+    if (!out.slices.empty()) {
+        for (auto& v : mean.variants) {
+            v.noiseStdHU = v.epi = v.psnr = v.ssim = 0.0;
+            v.dice.fill(0.0);
+            v.hasDice = true;
+        }
+        const double inv = 1.0 / static_cast<double>(out.slices.size());
+        for (const auto& sq : out.slices) {
+            mean.homogeneousPx += sq.homogeneousPx;
+            for (int v = 0; v < kNumDenoiseVariants; ++v) {
+                const VariantQuality& a = sq.variants[v];
+                VariantQuality& m = mean.variants[v];
+                m.noiseStdHU += a.noiseStdHU * inv;
+                m.epi        += a.epi * inv;
+                m.psnr       += a.psnr * inv;
+                m.ssim       += a.ssim * inv;
+                for (int l = 0; l < kNumTissueLabels; ++l) m.dice[l] += a.dice[l] * inv;
+                m.hasDice = m.hasDice && a.hasDice;
+            }
+        }
+    }
+    out.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    return out;
+}
+
+namespace {
+
+void writeQualityRows(std::ostream& os, const std::string& slice, const SliceQuality& q) {
+    for (int v = 0; v < kNumDenoiseVariants; ++v) {
+        const VariantQuality& m = q.variants[v];
+        os << slice << ',' << kDenoiseVariantNames[v] << ',' << m.noiseStdHU << ',' << m.epi
+           << ',' << m.psnr << ',' << m.ssim << ',';
+        if (m.hasDice) os << m.dice[LABEL_FAT] << ',' << m.dice[LABEL_MUSCLE] << ',' << m.dice[LABEL_BONE];
+        else os << ",,";   // sin segmentación propia
+        os << '\n';
+    }
+}
+
+} // namespace
+
+void writeSeriesQualityCsv(const SeriesQuality& q, const std::string& path) {
+    const fs::path p(path);
+    if (p.has_parent_path()) fs::create_directories(p.parent_path());
+    std::ofstream os(path);
+    if (!os) throw std::runtime_error("No se pudo escribir: " + path);
+    os.precision(6);
+
+    os << "slice,variant,noise_std_hu,epi,psnr,ssim,dice_fat,dice_muscle,dice_bone\n";
+    for (size_t i = 0; i < q.slices.size(); ++i) writeQualityRows(os, std::to_string(i), q.slices[i]);
+    writeQualityRows(os, "serie", q.mean);
+}
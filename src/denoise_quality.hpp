@@ -0,0 +1,66 @@
+#pragma once
+#include <array>
+#include <string>
+#include <vector>
+#include <opencv2/core.hpp>
+
+#include "pipeline.hpp"
+#include "tissue_stats.hpp"
+
+// ==========================================================
+// Métricas de los filtros de la comparativa
+// ==========================================================
+// Las cuatro variantes de CompareWindow (evidencias 0..3: original, Gauss,
+// NLMeans, DnCNN) se miden contra la original en el recorte del cuerpo:
+//  - ruido: desviación local (ventana deslizante con boxFilter) media en el
+//    interior de grasa y músculo, donde el tejido es homogéneo → en HU;
+//  - EPI: correlación de los laplacianos con la original (1 = bordes intactos);
+//  - PSNR/SSIM: contra una referencia externa (p.ej. la dosis completa) si se
+//    pasa; si no, contra la original (fidelidad, no calidad absoluta);
+//  - Dice por tejido de su segmentación frente a la de la original (solo las
+//    variantes con segmentación propia: NLMeans usa las máscaras de Gauss).
+// Las variantes se calculan en paralelo y los momentos de la original
+// (SSIM, laplaciano) una sola vez.
+
+constexpr int kNumDenoiseVariants = 4;
+
+struct VariantQuality {
+    double noiseStdHU = 0.0;
+    double epi        = 1.0;
+    double psnr       = 100.0;
+    double ssim       = 1.0;
+    std::array<double, kNumTissueLabels> dice{};   // índice = etiqueta (0 sin uso)
+    bool   hasDice    = false;   // false: sin segmentación propia (NLMeans) o sin etiquetas
+};
+
+struct SliceQuality {
+    std::array<VariantQuality, kNumDenoiseVariants> variants;
+    bool     hasReference  = false;   // PSNR/SSIM frente a referencia externa
+    uint64_t homogeneousPx = 0;       // píxeles usados para el ruido
+};
+
+struct QualityOptions {
+    int   noiseWindow = 7;                        // ventana de la desviación local
+    float windowWidth = kDisplayWindowWidth;      // niveles de gris → HU
+    float windowCenter = kDisplayWindowCenter;    // ventaneo de la referencia externa
+};
+
+extern const char* const kDenoiseVariantNames[kNumDenoiseVariants];
+
+// 'reference': 8 bits con el mismo ventaneo que la evidencia 0 (vacía → sin referencia)
+SliceQuality computeSliceQuality(const PipelineResults& r, const cv::Mat& reference = {},
+                                 const QualityOptions& opts = {});
+
+// Serie completa: pipeline + métricas corte a corte (referenceFiles vacío o
+// un archivo por corte, p.ej. la serie de dosis completa)
+struct SeriesQuality {
+    std::vector<SliceQuality> slices;
+    SliceQuality              mean;
+    double                    seconds = 0.0;
+};
+SeriesQuality computeSeriesQuality(const std::vector<std::string>& files, Denoiser* denoiser,
+                                   const std::vector<std::string>& referenceFiles = {},
+                                   const QualityOptions& opts = {});
+
+// Una fila por corte y variante + filas "serie" con las medias
+void writeSeriesQualityCsv(const SeriesQuality& q, const std::string& path);
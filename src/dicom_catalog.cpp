@@ -0,0 +1,368 @@
+#include "dicom_catalog.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
+
+#include <gdcmReader.h>
+#include <gdcmStringFilter.h>
+#include <gdcmTag.h>
+
+#include <opencv2/core/utility.hpp>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr const char* kIndexHeader = "# vision_interciclo catalog v1";
+
+// ==========================================================
+// Lectura de cabeceras
+// ==========================================================
+struct SliceRecord {
+    CatalogSlice slice;
+    std::string  patientId, studyUID, seriesUID, description;
+    int    rows = 0, cols = 0;
+    double pixelSpacing[2] = { 1.0, 1.0 };   // fila, columna (DICOM)
+    double thickness = 0.0;
+};
+
+std::string trim(std::string s) {
+    const auto notSpace = [](unsigned char c) { return !std::isspace(c) && c != '\0'; };
+    s.erase(s.begin(), std::find_if(s.begin(), s.end(), notSpace));
+    s.erase(std::find_if(s.rbegin(), s.rend(), notSpace).base(), s.end());
+    return s;
+}
+
+// "a\b\c" → hasta n doubles; devuelve cuántos se leyeron
+int parseMulti(const std::string& s, double* out, int n) {
+    std::stringstream ss(s);
+    std::string item;
+    int i = 0;
+    while (i < n && std::getline(ss, item, '\\')) {
+        try { out[i] = std::stod(item); ++i; } catch (...) { return i; }
+    }
+    return i;
+}
+
+bool readHeader(const fs::path& path, SliceRecord& rec) {
+    gdcm::Reader reader;
+    reader.SetFileName(path.string().c_str());
+    // Se para en PixelData sin leerlo: solo cabecera
+    const gdcm::Tag pixelData(0x7fe0, 0x0010);
+    if (!reader.ReadUpToTag(pixelData, std::set<gdcm::Tag>{ pixelData })) return false;
+
+    gdcm::StringFilter sf;
+    sf.SetFile(reader.GetFile());
+    auto get = [&](uint16_t g, uint16_t e) { return trim(sf.ToString(gdcm::Tag(g, e))); };
+
+    rec.seriesUID = get(0x0020, 0x000e);
+    if (rec.seriesUID.empty()) return false;   // no es una imagen DICOM
+    rec.patientId   = get(0x0010, 0x0020);
+    rec.studyUID    = get(0x0020, 0x000d);
+    rec.description = get(0x0008, 0x103e);
+
+    const std::string inst = get(0x0020, 0x0013);
+    rec.slice.instance = inst.empty() ? 0 : std::atoi(inst.c_str());
+    rec.rows = std::atoi(get(0x0028, 0x0010).c_str());
+    rec.cols = std::atoi(get(0x0028, 0x0011).c_str());
+    parseMulti(get(0x0028, 0x0030), rec.pixelSpacing, 2);
+    const std::string thick = get(0x0018, 0x0050);
+    rec.thickness = thick.empty() ? 0.0 : std::atof(thick.c_str());
+
+    parseMulti(get(0x0020, 0x0032), rec.slice.position, 3);
+    double cosines[6] = { 1, 0, 0, 0, 1, 0 };
+    parseMulti(get(0x0020, 0x0037), cosines, 6);
+    // Normal = fila × columna: ordena bien también cortes no axiales
+    const double nx = cosines[1] * cosines[5] - cosines[2] * cosines[4];
+    const double ny = cosines[2] * cosines[3] - cosines[0] * cosines[5];
+    const double nz = cosines[0] * cosines[4] - cosines[1] * cosines[3];
+    rec.slice.sortKey = rec.slice.position[0] * nx + rec.slice.position[1] * ny + rec.slice.position[2] * nz;
+    return true;
+}
+
+// ==========================================================
+// Índice TSV (un corte por línea)
+// ==========================================================
+// file mtime size patient study series description instance px py pz sortKey rows cols sx sy thick
+std::string clean(const std::string& s) {
+    std::string out = s;
+    std::replace_if(out.begin(), out.end(), [](char c) { return c == '\t' || c == '\n' || c == '\r'; }, ' ');
+    return out;
+}
+
+void writeIndex(const std::string& path, const std::vector<SliceRecord>& records) {
+    std::error_code ec;
+    fs::create_directories(fs::path(path).parent_path(), ec);
+
+    const std::string tmp = path + ".tmp";
+    {
+        std::ofstream os(tmp, std::ios::trunc);
+        if (!os) return;
+        os.precision(10);
+        os << kIndexHeader << '\n';
+        for (const auto& r : records) {
+            const auto& s = r.slice;
+            os << clean(s.file) << '\t' << s.mtime << '\t' << s.size << '\t'
+               << clean(r.patientId) << '\t' << clean(r.studyUID) << '\t' << clean(r.seriesUID) << '\t'
+               << clean(r.description) << '\t' << s.instance << '\t'
+               << s.position[0] << '\t' << s.position[1] << '\t' << s.position[2] << '\t' << s.sortKey << '\t'
+               << r.rows << '\t' << r.cols << '\t' << r.pixelSpacing[0] << '\t' << r.pixelSpacing[1] << '\t'
+               << r.thickness << '\n';
+        }
+        if (!os) { fs::remove(tmp, ec); return; }
+    }
+    fs::rename(tmp, path, ec);
+}
+
+std::vector<SliceRecord> readIndex(const std::string& path) {
+    std::vector<SliceRecord> records;
+    std::ifstream in(path);
+    std::string line;
+    if (!in || !std::getline(in, line) || line != kIndexHeader) return records;   // otra versión → se rehace
+
+    while (std::getline(in, line)) {
+        std::vector<std::string> f;
+        std::stringstream ss(line);
+        std::string item;
+        while (std::getline(ss, item, '\t')) f.push_back(item);
+        if (f.size() != 17) continue;
+
+        try {
+            SliceRecord r;
+            r.slice.file     = f[0];
+            r.slice.mtime    = std::stoll(f[1]);
+            r.slice.size     = std::stoull(f[2]);
+            r.patientId      = f[3];
+            r.studyUID       = f[4];
+            r.seriesUID      = f[5];
+            r.description    = f[6];
+            r.slice.instance = std::stoi(f[7]);
+            for (int i = 0; i < 3; ++i) r.slice.position[i] = std::stod(f[8 + i]);
+            r.slice.sortKey  = std::stod(f[11]);
+            r.rows           = std::stoi(f[12]);
+            r.cols           = std::stoi(f[13]);
+            r.pixelSpacing[0] = std::stod(f[14]);
+            r.pixelSpacing[1] = std::stod(f[15]);
+            r.thickness       = std::stod(f[16]);
+            records.push_back(std::move(r));
+        } catch (...) { /* línea corrupta: ese archivo se relee */ }
+    }
+    return records;
+}
+
+// ==========================================================
+// Agrupado en series
+// ==========================================================
+std::vector<CatalogSeries> groupSeries(const std::vector<SliceRecord>& records) {
+    std::map<std::string, CatalogSeries> byUID;
+    std::map<std::string, double> thickness;
+    for (const auto& r : records) {
+        if (r.seriesUID.empty()) continue;   // archivo no DICOM (recordado para no releerlo)
+        auto& s = byUID[r.seriesUID];
+        if (s.slices.empty()) {
+            s.patientId   = r.patientId;
+            s.studyUID    = r.studyUID;
+            s.seriesUID   = r.seriesUID;
+            s.description = r.description;
+            s.rows = r.rows;
+            s.cols = r.cols;
+            s.spacing[0] = r.pixelSpacing[1];   // x = columnas
+            s.spacing[1] = r.pixelSpacing[0];   // y = filas
+            thickness[r.seriesUID] = r.thickness;
+        }
+        s.slices.push_back(r.slice);
+    }
+
+    std::vector<CatalogSeries> out;
+    for (auto& [uid, s] : byUID) {
+        std::sort(s.slices.begin(), s.slices.end(), [](const CatalogSlice& a, const CatalogSlice& b) {
+            return a.sortKey != b.sortKey ? a.sortKey < b.sortKey : a.instance < b.instance;
+        });
+        // Espaciado Z = mediana de las distancias entre cortes (el grosor si hay uno solo)
+        std::vector<double> gaps;
+        for (size_t i = 1; i < s.slices.size(); ++i)
+            gaps.push_back(std::abs(s.slices[i].sortKey - s.slices[i - 1].sortKey));
+        if (!gaps.empty()) {
+            std::nth_element(gaps.begin(), gaps.begin() + gaps.size() / 2, gaps.end());
+            s.spacing[2] = gaps[gaps.size() / 2];
+        }
+        if (s.spacing[2] <= 0.0) s.spacing[2] = thickness[uid] > 0.0 ? thickness[uid] : 1.0;
+        out.push_back(std::move(s));
+    }
+    std::sort(out.begin(), out.end(), [](const CatalogSeries& a, const CatalogSeries& b) {
+        return a.patientId != b.patientId ? a.patientId < b.patientId
+             : a.description != b.description ? a.description < b.description
+             : a.directory() < b.directory();
+    });
+    return out;
+}
+
+bool isCandidate(const fs::directory_entry& e) {
+    if (!e.is_regular_file()) return false;
+    std::string ext = e.path().extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+    return ext == ".ima" || ext == ".dcm" || ext.empty();
+}
+
+} // namespace
+
+// ==========================================================
+// API
+// ==========================================================
+std::vector<std::string> CatalogSeries::files() const {
+    std::vector<std::string> f;
+    f.reserve(slices.size());
+    for (const auto& s : slices) f.push_back(s.file);
+    return f;
+}
+
+std::string CatalogSeries::directory() const {
+    return slices.empty() ? std::string() : fs::path(slices.front().file).parent_path().string();
+}
+
+const CatalogSeries* DicomCatalog::findSeries(const std::string& seriesUID) const {
+    for (const auto& s : series)
+        if (s.seriesUID == seriesUID) return &s;
+    return nullptr;
+}
+
+const CatalogSeries* DicomCatalog::findByDirectory(const std::string& dir) const {
+    std::error_code ec;
+    const fs::path want = fs::weakly_canonical(dir, ec);
+    for (const auto& s : series)
+        if (fs::path(s.directory()) == want) return &s;
+    return nullptr;
+}
+
+std::string defaultCatalogIndexPath(const std::string& root) {
+    fs::path base;
+    if (const char* xdg = std::getenv("XDG_CACHE_HOME")) base = xdg;
+    else if (const char* home = std::getenv("HOME")) base = fs::path(home) / ".cache";
+    else base = fs::temp_directory_path();
+
+    std::error_code ec;
+    const std::string canon = fs::weakly_canonical(root, ec).string();
+    std::ostringstream name;
+    name << "catalog_" << std::hex << std::hash<std::string>{}(canon) << ".tsv";
+    return (base / "vision_interciclo" / name.str()).string();
+}
+
+DicomCatalog loadDicomCatalog(const std::string& root, const std::string& indexPath) {
+    DicomCatalog cat;
+    std::error_code ec;
+    cat.root      = fs::weakly_canonical(root, ec).string();
+    cat.indexPath = indexPath.empty() ? defaultCatalogIndexPath(root) : indexPath;
+    const auto records = readIndex(cat.indexPath);
+    cat.reusedFiles = records.size();
+    cat.series = groupSeries(records);
+    return cat;
+}
+
+std::vector<std::string> catalogSeriesFiles(const std::string& dir) {
+    // Índice → catálogo leído (y mtime del índice al leerlo)
+    struct Loaded {
+        fs::file_time_type indexTime;
+        DicomCatalog catalog;
+    };
+    static std::mutex mutex;
+    static std::map<std::string, Loaded> loaded;
+
+    std::error_code ec;
+    const fs::path want = fs::weakly_canonical(dir, ec);
+    if (ec || want.empty()) return {};
+    for (fs::path root = want; ; root = root.parent_path()) {
+        const std::string indexPath = defaultCatalogIndexPath(root.string());
+        const auto indexTime = fs::last_write_time(indexPath, ec);
+        if (!ec) {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto it = loaded.find(indexPath);
+            if (it == loaded.end() || it->second.indexTime != indexTime)
+                it = loaded.insert_or_assign(indexPath, Loaded{ indexTime, loadDicomCatalog(root.string(), indexPath) })
+                         .first;
+            if (const CatalogSeries* s = it->second.catalog.findByDirectory(want.string())) {
+                // Solo stat por archivo: si algo cambió, el índice ya no vale
+                for (const auto& slice : s->slices) {
+                    const int64_t  mtime = fs::last_write_time(slice.file, ec).time_since_epoch().count();
+                    if (ec || mtime != slice.mtime || fs::file_size(slice.file, ec) != slice.size || ec) return {};
+                }
+                return s->files();
+            }
+        }
+        if (!root.has_relative_path()) break;   // llegó a la raíz del sistema
+    }
+    return {};
+}
+
+DicomCatalog buildDicomCatalog(const std::string& root, const std::string& indexPath, int workers) {
+    DicomCatalog cat;
+    std::error_code ec;
+    cat.root      = fs::weakly_canonical(root, ec).string();
+    cat.indexPath = indexPath.empty() ? defaultCatalogIndexPath(root) : indexPath;
+    if (!fs::is_directory(cat.root)) throw std::runtime_error("Catálogo: no existe el directorio " + root);
+
+    // Índice anterior por ruta
+    std::unordered_map<std::string, SliceRecord> previous;
+    for (auto& r : readIndex(cat.indexPath)) previous.emplace(r.slice.file, std::move(r));
+
+    // Recorrido del árbol: solo metadatos del sistema de archivos
+    std::vector<SliceRecord> records;
+    std::vector<std::pair<fs::path, size_t>> toParse;   // archivo → posición en 'records'
+    for (const auto& e : fs::recursive_directory_iterator(cat.root, fs::directory_options::skip_permission_denied, ec)) {
+        if (!isCandidate(e)) continue;
+        const std::string file = e.path().string();
+        const int64_t  mtime = e.last_write_time(ec).time_since_epoch().count();
+        const uint64_t size  = e.file_size(ec);
+
+        auto it = previous.find(file);
+        if (it != previous.end() && it->second.slice.mtime == mtime && it->second.slice.size == size) {
+            records.push_back(std::move(it->second));
+            ++cat.reusedFiles;
+            continue;
+        }
+        SliceRecord r;
+        r.slice.file  = file;
+        r.slice.mtime = mtime;
+        r.slice.size  = size;
+        toParse.emplace_back(e.path(), records.size());
+        records.push_back(std::move(r));
+    }
+
+    // Cabeceras nuevas o modificadas, en paralelo. Un archivo que no es DICOM
+    // se queda sin serie en el índice: así tampoco se relee la próxima vez.
+    const int n = static_cast<int>(toParse.size());
+    if (n > 0) {
+        const int nWorkers = std::max(1, std::min(n, workers > 0 ? workers : cv::getNumThreads()));
+        std::atomic<int> next{0};
+        auto worker = [&]() {
+            for (int i = next++; i < n; i = next++) {
+                SliceRecord& r = records[toParse[i].second];
+                bool ok = false;
+                try { ok = readHeader(toParse[i].first, r); } catch (...) {}
+                if (!ok) r.seriesUID.clear();
+            }
+        };
+        std::vector<std::thread> pool;
+        for (int w = 1; w < nWorkers; ++w) pool.emplace_back(worker);
+        worker();
+        for (auto& t : pool) t.join();
+    }
+    cat.parsedFiles = static_cast<size_t>(n);
+
+    // Solo se reescribe si algo cambió (archivos nuevos, modificados o borrados)
+    if (n > 0 || records.size() != previous.size()) writeIndex(cat.indexPath, records);
+
+    cat.series = groupSeries(records);
+    return cat;
+}
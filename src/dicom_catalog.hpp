@@ -0,0 +1,67 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// ==========================================================
+// Catálogo de series DICOM bajo un directorio raíz
+// ==========================================================
+// Recorre el árbol una vez, lee solo las cabeceras (se para antes de
+// PixelData) en paralelo y guarda un índice TSV compacto:
+// paciente / serie / corte → archivo, posición, espaciado y tamaño.
+// En la siguiente ejecución solo se vuelven a leer los archivos cuyo mtime o
+// tamaño cambió. Abrir una serie del catálogo no requiere recorrer directorios
+// ni el descubrimiento de series de GDCM.
+
+struct CatalogSlice {
+    std::string file;
+    int64_t  mtime    = 0;
+    uint64_t size     = 0;
+    int      instance = 0;
+    double   position[3] = { 0.0, 0.0, 0.0 };   // ImagePositionPatient
+    double   sortKey  = 0.0;                     // posición sobre la normal del corte
+};
+
+struct CatalogSeries {
+    std::string patientId;
+    std::string studyUID;
+    std::string seriesUID;
+    std::string description;
+    int    rows = 0, cols = 0;
+    double spacing[3] = { 1.0, 1.0, 1.0 };   // x, y (PixelSpacing) y z (entre cortes)
+    std::vector<CatalogSlice> slices;        // ordenados por sortKey
+
+    std::vector<std::string> files() const;
+    std::string directory() const;          // directorio del primer corte
+};
+
+struct DicomCatalog {
+    std::string root;
+    std::string indexPath;
+    std::vector<CatalogSeries> series;   // por paciente y descripción
+    size_t parsedFiles = 0;              // cabeceras leídas en esta pasada
+    size_t reusedFiles = 0;              // entradas reutilizadas del índice
+
+    const CatalogSeries* findSeries(const std::string& seriesUID) const;
+    // Primera serie con cortes en 'dir' (lo que antes resolvía GDCM por directorio)
+    const CatalogSeries* findByDirectory(const std::string& dir) const;
+};
+
+// Índice por defecto para una raíz: ~/.cache/vision_interciclo/catalog_<hash>.tsv
+std::string defaultCatalogIndexPath(const std::string& root);
+
+// Construye o actualiza el catálogo. indexPath vacío → defaultCatalogIndexPath.
+// workers == 0 → hilos de OpenCV.
+DicomCatalog buildDicomCatalog(const std::string& root,
+                               const std::string& indexPath = {},
+                               int workers = 0);
+
+// Solo lee el índice guardado (sin recorrer el árbol); vacío si no existe
+DicomCatalog loadDicomCatalog(const std::string& root, const std::string& indexPath = {});
+
+// Archivos ordenados de la serie de 'dir' según el catálogo de 'dir' o de
+// alguno de sus directorios padre (índice por defecto), sin recorrer nada ni
+// pasar por GDCM. Vacío si ningún catálogo la cubre o si algún archivo cambió
+// (mtime/tamaño) desde que se indexó: entonces vale el recorrido de siempre.
+// Los catálogos leídos se guardan en memoria hasta que cambie su índice.
+std::vector<std::string> catalogSeriesFiles(const std::string& dir);
@@ -0,0 +1,297 @@
+#include "dicom_mmap.hpp"
+
+#include "itk_loader.hpp"
+#include "itk_opencv_bridge.hpp"
+
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace cv;
+
+namespace {
+
+// ==========================================================
+// Cabecera DICOM (little-endian, explícita o implícita)
+// ==========================================================
+constexpr uint32_t kUndefinedLength = 0xffffffffu;
+
+struct DicomHeader {
+    bool   ok = false;
+    size_t pixelOffset = 0;
+    size_t pixelLength = 0;
+    int    rows = 0, cols = 0;
+    int    bitsAllocated = 0, samples = 1, pixelRepresentation = 0;
+    int    bitsStored = 0, highBit = -1;   // 0 / -1: no estaban
+    double slope = 1.0, intercept = 0.0;
+    double spacing[2] = { 1.0, 1.0 };
+    double position[3] = { 0.0, 0.0, 0.0 };
+    double orientation[6] = { 1.0, 0.0, 0.0, 0.0, 1.0, 0.0 };
+    bool   hasPosition = false, hasOrientation = false;
+};
+
+uint16_t rd16(const uint8_t* p) { return static_cast<uint16_t>(p[0] | (p[1] << 8)); }
+uint32_t rd32(const uint8_t* p) { return p[0] | (p[1] << 8) | (p[2] << 16) | (uint32_t(p[3]) << 24); }
+
+// VR explícitas con 2 bytes reservados + longitud de 32 bits
+bool longVr(const uint8_t* vr) {
+    static const char* kLong[] = { "OB", "OD", "OF", "OL", "OV", "OW", "SQ", "SV", "UC", "UN", "UR", "UT", "UV" };
+    for (const char* v : kLong)
+        if (vr[0] == v[0] && vr[1] == v[1]) return true;
+    return false;
+}
+
+// Valores numéricos de una cadena DS/IS ("a\b\c")
+int parseNumbers(const uint8_t* p, size_t n, double* out, int maxValues) {
+    std::string s(reinterpret_cast<const char*>(p), n);
+    int count = 0;
+    const char* c = s.c_str();
+    while (count < maxValues && *c) {
+        char* end = nullptr;
+        const double v = std::strtod(c, &end);
+        if (end == c) break;
+        out[count++] = v;
+        c = end;
+        while (*c == ' ' || *c == '\\') ++c;
+    }
+    return count;
+}
+
+struct Cursor {
+    const uint8_t* p;
+    const uint8_t* end;
+    bool explicitVr;
+};
+
+bool skipUndefined(Cursor& c);
+
+// Lee un elemento: etiqueta, longitud y valor. false si el archivo se acaba
+bool nextElement(Cursor& c, uint16_t& group, uint16_t& elem, uint32_t& len, const uint8_t*& value, bool& isSq) {
+    if (c.end - c.p < 8) return false;
+    group = rd16(c.p);
+    elem  = rd16(c.p + 2);
+    isSq  = false;
+    // Delimitadores de ítem/secuencia: siempre sin VR
+    if (group == 0xfffe) {
+        len = rd32(c.p + 4);
+        c.p += 8;
+        value = c.p;
+        return true;
+    }
+    if (c.explicitVr) {
+        const uint8_t* vr = c.p + 4;
+        isSq = vr[0] == 'S' && vr[1] == 'Q';
+        if (longVr(vr)) {
+            if (c.end - c.p < 12) return false;
+            len = rd32(c.p + 8);
+            c.p += 12;
+        } else {
+            len = rd16(c.p + 6);
+            c.p += 8;
+        }
+    } else {
+        len = rd32(c.p + 4);
+        c.p += 8;
+    }
+    value = c.p;
+    return true;
+}
+
+// Salta el contenido de un elemento de longitud indefinida (SQ o ítem)
+bool skipUndefined(Cursor& c) {
+    uint16_t g, e;
+    uint32_t len;
+    const uint8_t* v;
+    bool sq;
+    while (nextElement(c, g, e, len, v, sq)) {
+        if (g == 0xfffe && (e == 0xe0dd || e == 0xe00d)) return true;   // fin de secuencia/ítem
+        if (len == kUndefinedLength) {
+            if (!skipUndefined(c)) return false;
+            continue;
+        }
+        if (static_cast<size_t>(c.end - c.p) < len) return false;
+        c.p += len;
+    }
+    return false;
+}
+
+DicomHeader parseHeader(const uint8_t* data, size_t size) {
+    DicomHeader h;
+    if (size < 132 || std::memcmp(data + 128, "DICM", 4) != 0) return h;
+
+    // Meta (grupo 0002): siempre explícita LE
+    Cursor c{ data + 132, data + size, true };
+    std::string transferSyntax;
+    while (c.end - c.p >= 8 && rd16(c.p) == 0x0002) {
+        uint16_t g, e;
+        uint32_t len;
+        const uint8_t* v;
+        bool sq;
+        if (!nextElement(c, g, e, len, v, sq) || len == kUndefinedLength ||
+            static_cast<size_t>(c.end - c.p) < len)
+            return h;
+        if (e == 0x0010) {
+            transferSyntax.assign(reinterpret_cast<const char*>(v), len);
+            while (!transferSyntax.empty() && (transferSyntax.back() == '\0' || transferSyntax.back() == ' '))
+                transferSyntax.pop_back();
+        }
+        c.p += len;
+    }
+    if (transferSyntax == "1.2.840.10008.1.2")        c.explicitVr = false;   // implícita LE
+    else if (transferSyntax == "1.2.840.10008.1.2.1") c.explicitVr = true;    // explícita LE
+    else return h;                                                             // comprimida / BE
+
+    uint16_t g, e;
+    uint32_t len;
+    const uint8_t* v;
+    bool sq;
+    while (nextElement(c, g, e, len, v, sq)) {
+        if (g == 0x7fe0 && e == 0x0010) {
+            if (len == kUndefinedLength) return h;   // encapsulado (comprimido)
+            h.pixelOffset = static_cast<size_t>(v - data);
+            h.pixelLength = len;
+            h.ok = true;
+            break;
+        }
+        if (len == kUndefinedLength) {
+            if (!skipUndefined(c)) return h;
+            continue;
+        }
+        if (static_cast<size_t>(c.end - c.p) < len) return h;
+
+        if (g == 0x0028) {
+            switch (e) {
+            case 0x0002: h.samples             = rd16(v); break;
+            case 0x0010: h.rows                = rd16(v); break;
+            case 0x0011: h.cols                = rd16(v); break;
+            case 0x0030: parseNumbers(v, len, h.spacing, 2); break;
+            case 0x0100: h.bitsAllocated       = rd16(v); break;
+            case 0x0101: h.bitsStored          = rd16(v); break;
+            case 0x0102: h.highBit             = rd16(v); break;
+            case 0x0103: h.pixelRepresentation = rd16(v); break;
+            case 0x1052: parseNumbers(v, len, &h.intercept, 1); break;
+            case 0x1053: parseNumbers(v, len, &h.slope, 1); break;
+            }
+        } else if (g == 0x0020) {
+            if (e == 0x0032) h.hasPosition    = parseNumbers(v, len, h.position, 3) == 3;
+            if (e == 0x0037) h.hasOrientation = parseNumbers(v, len, h.orientation, 6) == 6;
+        }
+        c.p += len;
+    }
+
+    // Solo 16 bits, una muestra, con el PixelData completo dentro del archivo
+    // y los bits útiles abajo (HighBit = BitsStored - 1)
+    if (h.bitsStored == 0) h.bitsStored = h.bitsAllocated;
+    if (h.highBit < 0) h.highBit = h.bitsStored - 1;
+    const size_t expected = size_t(h.rows) * size_t(h.cols) * 2;
+    if (!h.ok || h.bitsAllocated != 16 || h.samples != 1 || h.rows <= 0 || h.cols <= 0 ||
+        h.bitsStored < 1 || h.bitsStored > 16 || h.highBit != h.bitsStored - 1 ||
+        h.pixelLength < expected || h.pixelOffset + expected > size)
+        h.ok = false;
+    return h;
+}
+
+// Valores almacenados de 'src' en 'dst' (mismo tipo): fuera los bits por
+// encima de BitsStored (overlays antiguos o basura) y, con signo, extensión
+// desde el bit alto
+void storedValues(const Mat& src, int bits, Mat& dst) {
+    dst.create(src.size(), src.type());
+    const int shift = 16 - bits;
+    const uint16_t mask = static_cast<uint16_t>((1u << bits) - 1);
+    const bool isSigned = src.type() == CV_16S;
+    for (int y = 0; y < src.rows; ++y) {
+        const uint16_t* s = src.ptr<uint16_t>(y);
+        uint16_t* d = dst.ptr<uint16_t>(y);
+        if (isSigned) {
+            for (int x = 0; x < src.cols; ++x)
+                d[x] = static_cast<uint16_t>(static_cast<int16_t>(static_cast<uint16_t>(s[x] << shift)) >> shift);
+        } else {
+            for (int x = 0; x < src.cols; ++x) d[x] = s[x] & mask;
+        }
+    }
+}
+
+} // namespace
+
+// ==========================================================
+// MappedDicom
+// ==========================================================
+std::shared_ptr<MappedDicom> MappedDicom::open(const std::string& file) {
+    const int fd = ::open(file.c_str(), O_RDONLY);
+    if (fd < 0) return nullptr;
+    struct stat st{};
+    if (::fstat(fd, &st) != 0 || st.st_size <= 0) {
+        ::close(fd);
+        return nullptr;
+    }
+    void* p = ::mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);   // el mapeo sigue vivo sin el descriptor
+    if (p == MAP_FAILED) return nullptr;
+
+    std::shared_ptr<MappedDicom> m(new MappedDicom());
+    m->map_ = static_cast<const uint8_t*>(p);
+    m->mapSize_ = static_cast<size_t>(st.st_size);
+
+    const DicomHeader h = parseHeader(m->map_, m->mapSize_);
+    if (!h.ok) return nullptr;
+
+    m->pixelOffset_ = h.pixelOffset;
+    m->rows_ = h.rows;
+    m->cols_ = h.cols;
+    m->signed_ = h.pixelRepresentation == 1;
+    m->bitsStored_ = h.bitsStored;
+    m->slope_ = h.slope;
+    m->intercept_ = h.intercept;
+    std::memcpy(m->spacing_, h.spacing, sizeof(m->spacing_));
+    std::memcpy(m->position_, h.position, sizeof(m->position_));
+    std::memcpy(m->orientation_, h.orientation, sizeof(m->orientation_));
+    m->hasPosition_ = h.hasPosition;
+    m->hasOrientation_ = h.hasOrientation;
+
+    // readHU recorre siempre el PixelData entero de arriba abajo: que el
+    // kernel lea por delante desde su página (la cabecera ya está leída)
+    const size_t page = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+    const size_t start = h.pixelOffset / page * page;
+    ::madvise(const_cast<uint8_t*>(m->map_) + start, m->mapSize_ - start, MADV_SEQUENTIAL);
+    return m;
+}
+
+MappedDicom::~MappedDicom() {
+    if (map_) ::munmap(const_cast<uint8_t*>(map_), mapSize_);
+}
+
+Mat MappedDicom::raw() const {
+    // El PixelData empieza en offset par, pero no tiene por qué estar alineado
+    // a 2: OpenCV lo tolera en x86/ARM64
+    return Mat(rows_, cols_, signed_ ? CV_16S : CV_16U, const_cast<uint8_t*>(map_ + pixelOffset_));
+}
+
+void MappedDicom::readHU(Mat& out) const {
+    const Mat src = raw();
+    if (bitsStored_ == 16) {
+        if (rescaleIsIdentity()) src.copyTo(out);
+        else                     src.convertTo(out, CV_16S, slope_, intercept_);
+        return;
+    }
+    if (rescaleIsIdentity()) {
+        storedValues(src, bitsStored_, out);
+        return;
+    }
+    thread_local Mat stored;   // un corte por hilo a la vez
+    storedValues(src, bitsStored_, stored);
+    stored.convertTo(out, CV_16S, slope_, intercept_);
+}
+
+Mat loadSliceHU(const std::string& file) {
+    if (auto m = MappedDicom::open(file)) {
+        Mat hu;
+        m->readHU(hu);
+        return hu;
+    }
+    return itk2cv16sHU(loadDicomSlice(file));
+}
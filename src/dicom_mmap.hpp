@@ -0,0 +1,70 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <opencv2/core.hpp>
+
+// ==========================================================
+// Lectura directa de DICOM sin comprimir (archivo mapeado)
+// ==========================================================
+// Los .IMA de L096 son int16 little-endian sin comprimir: el PixelData es un
+// bloque contiguo de filas dentro del archivo. Se lee la cabecera una vez
+// (meta explícita + dataset explícito o implícito LE) hasta el PixelData, se
+// mapea el archivo y los píxeles se ven como un cv::Mat sin copiar. El paso
+// a HU (BitsStored + RescaleSlope/Intercept) se aplica al copiar.
+// Sintaxis comprimidas, big-endian, píxeles que no sean de 16 bits con una
+// muestra o HighBit != BitsStored - 1 → open() devuelve nullptr y se usa GDCM.
+
+class MappedDicom {
+public:
+    // nullptr si el archivo no es un DICOM sin comprimir soportado
+    static std::shared_ptr<MappedDicom> open(const std::string& file);
+    ~MappedDicom();
+
+    MappedDicom(const MappedDicom&) = delete;
+    MappedDicom& operator=(const MappedDicom&) = delete;
+
+    int  rows() const { return rows_; }
+    int  cols() const { return cols_; }
+    bool isSigned() const { return signed_; }
+    int  bitsStored() const { return bitsStored_; }
+
+    double slope()     const { return slope_; }
+    double intercept() const { return intercept_; }
+    bool   rescaleIsIdentity() const { return signed_ && slope_ == 1.0 && intercept_ == 0.0; }
+
+    // Geometría (valores DICOM; hasX == false si la etiqueta no estaba)
+    const double* pixelSpacing() const { return spacing_; }       // fila, columna (mm)
+    const double* position()     const { return position_; }      // ImagePositionPatient
+    const double* orientation()  const { return orientation_; }   // cosenos fila + columna
+    bool hasPosition()    const { return hasPosition_; }
+    bool hasOrientation() const { return hasOrientation_; }
+
+    // Palabras de 16 bits tal cual (CV_16S o CV_16U) sobre el mapeo, sin
+    // copia ni enmascarar a BitsStored. Válido mientras viva este objeto.
+    cv::Mat raw() const;
+
+    // HU en CV_16S: valor almacenado (BitsStored bits, con signo si
+    // PixelRepresentation = 1) * slope + intercept, saturado. Si 'out' ya
+    // tiene el tamaño y tipo se escribe en su buffer.
+    void readHU(cv::Mat& out) const;
+
+private:
+    MappedDicom() = default;
+
+    const uint8_t* map_ = nullptr;
+    size_t mapSize_ = 0;
+    size_t pixelOffset_ = 0;
+
+    int  rows_ = 0, cols_ = 0;
+    bool signed_ = true;
+    int  bitsStored_ = 16;
+    double slope_ = 1.0, intercept_ = 0.0;
+    double spacing_[2] = { 1.0, 1.0 };
+    double position_[3] = { 0.0, 0.0, 0.0 };
+    double orientation_[6] = { 1.0, 0.0, 0.0, 0.0, 1.0, 0.0 };
+    bool hasPosition_ = false, hasOrientation_ = false;
+};
+
+// Corte en HU (CV_16S): archivo mapeado si se puede, GDCM si no
+cv::Mat loadSliceHU(const std::string& file);
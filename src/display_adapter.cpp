@@ -0,0 +1,90 @@
+#include "display_adapter.hpp"
+
+#include <QtGlobal>
+#include <opencv2/imgproc.hpp>
+#include <algorithm>
+
+using namespace cv;
+
+namespace {
+// La QImage guarda un Mat en el heap: su refcount mantiene vivo el buffer
+void releaseMat(void* info) {
+    delete static_cast<Mat*>(info);
+}
+
+QImage wrap(const Mat& m, QImage::Format fmt) {
+    auto* owner = new Mat(m);
+    return QImage(owner->data, owner->cols, owner->rows, static_cast<int>(owner->step),
+                  fmt, releaseMat, owner);
+}
+} // namespace
+
+QImage matToQImageShared(const cv::Mat& mat) {
+    if (mat.empty()) return {};
+
+    if (mat.type() == CV_8UC1) return wrap(mat, QImage::Format_Grayscale8);
+
+    if (mat.type() == CV_8UC3) {
+#if QT_VERSION >= QT_VERSION_CHECK(5, 14, 0)
+        return wrap(mat, QImage::Format_BGR888);
+#else
+        Mat rgb;
+        cvtColor(mat, rgb, COLOR_BGR2RGB);
+        return wrap(rgb, QImage::Format_RGB888);
+#endif
+    }
+
+    Mat tmp;
+    mat.convertTo(tmp, CV_8U);
+    return wrap(tmp, QImage::Format_Grayscale8);
+}
+
+QPixmap matToPixmap(const cv::Mat& mat) {
+    if (mat.empty()) return {};
+    return QPixmap::fromImage(matToQImageShared(mat), Qt::NoFormatConversion);
+}
+
+// ==========================================================
+// PixmapCache
+// ==========================================================
+QString DisplayKey::toString() const {
+    return QStringLiteral("%1|%2|%3|%4")
+        .arg(slice).arg(evidence).arg(windowCenter).arg(windowWidth);
+}
+
+PixmapCache::PixmapCache(int budgetKB) {
+    m_cache.setMaxCost(budgetKB);
+}
+
+QPixmap PixmapCache::get(const DisplayKey& key, const cv::Mat& mat) {
+    const QString k = key.toString();
+    if (const QPixmap* hit = m_cache.object(k)) return *hit;
+
+    // Copia propia: el pixmap puede compartir el buffer con su Mat, y los Mats
+    // de PipelineResults se reescriben en el siguiente corte
+    QPixmap pm = matToPixmap(mat.clone());
+    if (pm.isNull()) return pm;
+
+    const int costKB = std::max(1, static_cast<int>(mat.total() * mat.elemSize() / 1024));
+    m_cache.insert(k, new QPixmap(pm), costKB);
+    syncMemory();
+    return pm;
+}
+
+void PixmapCache::invalidateSlice(const QString& slice) {
+    const QString prefix = slice + QLatin1Char('|');
+    for (const QString& k : m_cache.keys()) {
+        if (k.startsWith(prefix)) m_cache.remove(k);
+    }
+    syncMemory();
+}
+
+void PixmapCache::clear() {
+    m_cache.clear();
+    m_memory.resize(0);
+}
+
+void PixmapCache::syncMemory() {
+    const size_t bytes = static_cast<size_t>(m_cache.totalCost()) * 1024;
+    if (!m_memory.resize(bytes, /*force*/false)) clear();   // lo más barato de rehacer
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <QCache>
+#include <QImage>
+#include <QPixmap>
+#include <QString>
+#include <opencv2/core.hpp>
+
+#include "memory_governor.hpp"
+
+// ==========================================================
+// cv::Mat → QImage / QPixmap sin copias
+// ==========================================================
+
+// QImage que apunta a la memoria del Mat (8UC1 o 8UC3 BGR). La QImage se
+// queda con una referencia al Mat, así que el buffer vive mientras ella viva.
+// Las overlays BGR se leen tal cual con Format_BGR888 (Qt >= 5.14); solo en Qt
+// anteriores se hace un cvtColor (sin copia adicional).
+QImage matToQImageShared(const cv::Mat& mat);
+
+// QPixmap listo para un QLabel (una sola subida, sin QImage intermedia copiada).
+// Puede compartir el buffer del Mat: no escribir en él mientras viva el pixmap.
+QPixmap matToPixmap(const cv::Mat& mat);
+
+// ==========================================================
+// Caché de QPixmaps por (corte, evidencia, ventana)
+// ==========================================================
+struct DisplayKey {
+    QString slice;          // identificador del corte (ruta del archivo)
+    int     evidence = 0;   // índice 0..kNumEvidences-1
+    float   windowCenter = 0.0f;
+    float   windowWidth  = 0.0f;
+
+    QString toString() const;
+};
+
+class PixmapCache {
+public:
+    // Presupuesto en KB (QCache usa el coste de cada entrada)
+    explicit PixmapCache(int budgetKB = 256 * 1024);
+
+    // Devuelve el pixmap cacheado o lo genera desde una copia de 'mat' y lo
+    // guarda (una copia al insertar; 'mat' se puede reescribir después).
+    // Repetir una vista ya vista es copiar un QPixmap (compartido implícitamente).
+    QPixmap get(const DisplayKey& key, const cv::Mat& mat);
+
+    // Olvida todas las evidencias de un corte (p.ej. al reprocesarlo)
+    void invalidateSlice(const QString& slice);
+    void clear();
+
+private:
+    // Apunta el coste total en el gobernador. Es una reserva y no un
+    // consumidor: QCache/QPixmap solo se tocan desde el hilo de la GUI.
+    // Si el presupuesto no da para más, se vacía la caché.
+    void syncMemory();
+
+    QCache<QString, QPixmap> m_cache;
+    MemoryReservation        m_memory{ "pixmaps (Qt)" };
+};
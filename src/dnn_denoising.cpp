@@ -1,5 +1,7 @@
 // src/dnn_denoising.cpp
 #include "dnn_denoising.hpp"
+#include "metrics.hpp"
+#include <chrono>
 #include <opencv2/dnn.hpp>
 #include <opencv2/core.hpp>
 #include <iostream>
@@ -7,51 +9,119 @@
 using namespace cv;
 using namespace std;
 
+// DnCNN: 64 mapas float por píxel, dos vivos a la vez (entrada y salida de capa)
+constexpr size_t kWorkspaceBytesPerPixel = 2 * 64 * sizeof(float);
+
 // Constructor
-DnnDenoiser::DnnDenoiser(const std::string& modelPath) {
+DnnDenoiser::DnnDenoiser(const std::string& modelPath)
+    : DnnDenoiser(DnnConfig{modelPath}) {}
+
+DnnDenoiser::DnnDenoiser(const DnnConfig& config)
+    : cfg(config), modelLoaded(false) {
     // Intentar cargar la red. Si el archivo es incompatible, esto lanzará una excepción
     // que será atrapada en el main.
-    net = dnn::readNetFromONNX(modelPath);
+    net = dnn::readNetFromONNX(cfg.modelPath);
     
     if (net.empty()) {
         CV_Error(Error::StsError, "La red neuronal se cargó pero está vacía.");
     }
     
-    // Configurar backend preferido (CPU es más seguro para compatibilidad)
-    net.setPreferableBackend(dnn::DNN_BACKEND_OPENCV);
-    net.setPreferableTarget(dnn::DNN_TARGET_CPU);
+    // FP16: en CPU solo existe como target propio (OpenCV >= 4.9)
+    if (cfg.precision == DnnPrecision::FP16) {
+#if CV_VERSION_MAJOR > 4 || (CV_VERSION_MAJOR == 4 && CV_VERSION_MINOR >= 9)
+        if (cfg.target == dnn::DNN_TARGET_CPU) cfg.target = dnn::DNN_TARGET_CPU_FP16;
+#else
+        cout << "[AVISO] FP16 en CPU no disponible en este OpenCV, se usa FP32.\n";
+        cfg.precision = DnnPrecision::FP32;
+#endif
+    }
+
+    // Backend/target elegidos (por defecto OpenCV + CPU, lo más compatible)
+    net.setPreferableBackend(cfg.backend);
+    net.setPreferableTarget(cfg.target);
+
+    // Hilos intra-op: en OpenCV es un ajuste de todo el proceso, así que se
+    // fija una vez aquí y no alrededor de cada forward (llegan de varios hilos)
+    if (cfg.threads > 0) setNumThreads(cfg.threads);
+    modelLoaded = true;
+}
+
+// Cuantización INT8 post-entrenamiento
+void DnnDenoiser::quantizeInt8(const std::vector<Mat>& calibration8u, const std::string& calibDir) {
+    CV_Assert(!calibration8u.empty());
+
+    std::vector<Mat> blobs;
+    for (const Mat& img : calibration8u) {
+        Mat f;
+        img.convertTo(f, CV_32F, 1.0 / 255.0);
+        blobs.push_back(dnn::blobFromImage(f));
+    }
+
+    // Entrada/salida siguen en float: denoise() no cambia
+    net = net.quantize(blobs, CV_32F, CV_32F, /*perChannel*/true);
+    cfg.backend   = dnn::DNN_BACKEND_OPENCV;
+    cfg.target    = dnn::DNN_TARGET_CPU;
+    cfg.precision = DnnPrecision::INT8;
+    cfg.calibDir  = calibDir;
+    net.setPreferableBackend(cfg.backend);
+    net.setPreferableTarget(cfg.target);
 }
 
 // Método Denoise
 Mat DnnDenoiser::denoise(const Mat& noisy8u) {
     if (net.empty()) return noisy8u.clone();
+    return denoiseBatch({ noisy8u }).front();
+}
+
+// Lote: todas las imágenes deben tener el mismo tamaño
+std::vector<Mat> DnnDenoiser::denoiseBatch(const std::vector<Mat>& noisy8u) {
+    std::vector<Mat> out;
+    if (noisy8u.empty()) return out;
+    if (net.empty()) {
+        for (const Mat& img : noisy8u) out.push_back(img.clone());
+        return out;
+    }
     
     // 1. Convertir a Float [0, 1]
-    Mat input_mat;
-    noisy8u.convertTo(input_mat, CV_32F, 1.0 / 255.0);
+    std::vector<Mat> inputs(noisy8u.size());
+    for (size_t i = 0; i < noisy8u.size(); ++i) {
+        CV_Assert(noisy8u[i].size() == noisy8u.front().size());
+        noisy8u[i].convertTo(inputs[i], CV_32F, 1.0 / 255.0);
+    }
 
     // 2. Crear Blob (N, C, H, W)
-    Mat blob = dnn::blobFromImage(input_mat); 
+    Mat blob = dnn::blobFromImages(inputs); 
+
+    // OpenCV conserva los buffers de la red del forward más grande: se apunta
+    // ese máximo (las cachés ceden sitio si hace falta)
+    const size_t workspaceBytes = kWorkspaceBytesPerPixel * blob.total();
+    if (workspaceBytes > workspace.bytes()) workspace.resize(workspaceBytes);
 
     // 3. Inferencia
+    static MetricTimer&   forwardTime = metrics().timer("dncnn.forward");
+    static MetricCounter& forwardImages = metrics().counter("dncnn.imagenes");
+    const auto t0 = chrono::steady_clock::now();
     net.setInput(blob);
     Mat residual_blob = net.forward(); // La red DnCNN predice el RUIDO
+    forwardTime.record(chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count());
+    forwardImages.add(noisy8u.size());
 
-    // 4. Postprocesamiento: Convertir blob a Mat 2D
-    // El blob tiene dimensiones [1, 1, H, W]. Lo convertimos a [H, W]
+    // 4. Postprocesamiento: cada imagen del blob [N, 1, H, W] como Mat 2D
     std::vector<int> sizes = {residual_blob.size[2], residual_blob.size[3]};
-    Mat residual_mat(2, sizes.data(), CV_32F, residual_blob.ptr<float>());
+    for (size_t i = 0; i < inputs.size(); ++i) {
+        Mat residual_mat(2, sizes.data(), CV_32F, residual_blob.ptr<float>(static_cast<int>(i)));
 
-    // 5. APRENDIZAJE RESIDUAL: Imagen Limpia = Entrada - Ruido Predicho
-    Mat output_mat;
-    subtract(input_mat, residual_mat, output_mat);
+        // 5. APRENDIZAJE RESIDUAL: Imagen Limpia = Entrada - Ruido Predicho
+        Mat output_mat;
+        subtract(inputs[i], residual_mat, output_mat);
 
-    // 6. Clamping y conversión a 8-bit
-    output_mat.setTo(0.0f, output_mat < 0.0f);
-    output_mat.setTo(1.0f, output_mat > 1.0f);
-    
-    Mat denoised8u;
-    output_mat.convertTo(denoised8u, CV_8U, 255.0);
+        // 6. Clamping y conversión a 8-bit
+        output_mat.setTo(0.0f, output_mat < 0.0f);
+        output_mat.setTo(1.0f, output_mat > 1.0f);
 
-    return denoised8u;
-}
\ No newline at end of file
+        Mat denoised8u;
+        output_mat.convertTo(denoised8u, CV_8U, 255.0);
+        out.push_back(denoised8u);
+    }
+    return out;
+}
@@ -4,21 +4,62 @@
 #include <opencv2/opencv.hpp>
 #include <opencv2/dnn.hpp>
 #include <string>
+#include <vector>
 #include <iostream>
 
-class DnnDenoiser {
+#include "memory_governor.hpp"
+
+// Precisión numérica de la inferencia
+enum class DnnPrecision { FP32, FP16, INT8 };
+
+// Configuración de inferencia de una instancia
+struct DnnConfig {
+    std::string modelPath;
+    int backend = cv::dnn::DNN_BACKEND_OPENCV;
+    int target  = cv::dnn::DNN_TARGET_CPU;
+    int threads = 0;   // hilos de OpenCV (ajuste del proceso), fijados al crear la red (0 = no se tocan)
+    DnnPrecision precision = DnnPrecision::FP32;
+    std::string  calibDir;   // INT8: serie de calibración (otra calibración → otra salida)
+};
+
+// Lo que el pipeline usa de un filtro DnCNN: la imagen limpia y la config
+// (entra en la clave del caché de etapas). DnnDenoiser lleva la red; otros
+// (BatchingDenoiser) la envuelven sin ser una.
+class Denoiser {
+public:
+    virtual ~Denoiser() = default;
+    virtual cv::Mat denoise(const cv::Mat& input8u) = 0;
+    virtual const DnnConfig& config() const = 0;
+};
+
+class DnnDenoiser : public Denoiser {
 public:
     // Constructor: Carga el modelo ONNX desde la ruta especificada
     DnnDenoiser(const std::string& modelPath);
 
+    // Constructor con backend/target/hilos explícitos
+    explicit DnnDenoiser(const DnnConfig& config);
+
     // Método principal para limpiar la imagen
     // input: Imagen en escala de grises (CV_8U o CV_32F)
     // return: Imagen limpia (denoised)
-    cv::Mat denoise(const cv::Mat& inputImage);
+    cv::Mat denoise(const cv::Mat& inputImage) override;
+
+    // Varias imágenes del mismo tamaño en un solo forward (blob N x 1 x H x W)
+    std::vector<cv::Mat> denoiseBatch(const std::vector<cv::Mat>& inputImages);
+
+    // Convierte la red a INT8 (pesos y activaciones) calibrando los rangos con
+    // imágenes reales en 8-bit. Solo con backend OpenCV/CPU.
+    void quantizeInt8(const std::vector<cv::Mat>& calibration8u, const std::string& calibDir = "");
+
+    const DnnConfig& config() const override { return cfg; }
 
 private:
+    DnnConfig cfg;
     cv::dnn::Net net;
     bool modelLoaded;
+    // Activaciones que la red retiene entre forwards (gobernador de memoria)
+    MemoryReservation workspace{ "espacio de trabajo DnCNN" };
 };
 
-#endif // DNN_DENOISER_HPP
\ No newline at end of file
+#endif // DNN_DENOISER_HPP
@@ -0,0 +1,151 @@
+#include "dnn_precision.hpp"
+
+#include "itk_loader.hpp"
+#include "itk_opencv_bridge.hpp"
+#include "dicom_mmap.hpp"
+#include "quality_metrics.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <stdexcept>
+
+namespace fs = std::filesystem;
+using namespace cv;
+
+namespace {
+const char* kBundledSeries =
+    "data/CT_low_dose_reconstruction_dataset/Original Data/Full Dose/"
+    "3mm Slice Thickness/Sharp Kernel (D45)/L096/full_3mm_sharp";
+
+// Cortes usados para calibrar INT8 (los rangos dependen del contenido,
+// no del tamaño: basta un recorte central de 256x256)
+constexpr int kCalibrationSlices = 8;
+constexpr int kCalibrationCrop   = 256;
+} // namespace
+
+std::string findBundledSeriesDir() {
+    std::vector<fs::path> roots = { fs::current_path(), fs::current_path().parent_path() };
+    std::error_code ec;
+    const fs::path exe = fs::read_symlink("/proc/self/exe", ec);
+    if (!ec) roots.push_back(exe.parent_path().parent_path());
+
+    for (const auto& r : roots) {
+        const fs::path p = r / kBundledSeries;
+        if (fs::is_directory(p, ec)) return p.string();
+    }
+    return {};
+}
+
+std::vector<cv::Mat> loadCalibrationSlices(const std::string& dicomDir, int count, double phase) {
+    const auto files = listDicomSeriesFiles(dicomDir);
+    const int n = static_cast<int>(files.size());
+    count = std::max(1, std::min(count, n));
+
+    std::vector<Mat> out;
+    const double step = static_cast<double>(n) / count;
+    for (int i = 0; i < count; ++i) {
+        const int idx = std::min(n - 1, static_cast<int>((i + phase) * step));
+        Mat hu = loadSliceHU(files[idx]);
+        out.push_back(huTo8u(hu, 40.0f, 400.0f));
+    }
+    return out;
+}
+
+std::unique_ptr<DnnDenoiser> createDnnDenoiser(const DnnConfig& cfg, const std::string& calibDir) {
+    if (cfg.precision != DnnPrecision::INT8) return std::make_unique<DnnDenoiser>(cfg);
+
+    DnnConfig fp32 = cfg;
+    fp32.precision = DnnPrecision::FP32;
+    auto den = std::make_unique<DnnDenoiser>(fp32);
+
+    const std::string dir = calibDir.empty() ? findBundledSeriesDir() : calibDir;
+    if (dir.empty()) throw std::runtime_error("INT8: no hay cortes de calibración (serie L096 no encontrada)");
+
+    std::vector<Mat> calib;
+    for (const Mat& img : loadCalibrationSlices(dir, kCalibrationSlices)) {
+        const int s = std::min({ kCalibrationCrop, img.rows, img.cols });
+        const Rect center((img.cols - s) / 2, (img.rows - s) / 2, s, s);
+        calib.push_back(img(center).clone());
+    }
+    den->quantizeInt8(calib, dir);
+    return den;
+}
+
+DnnPrecision parseDnnPrecision(const std::string& name) {
+    if (name == "fp32") return DnnPrecision::FP32;
+    if (name == "fp16") return DnnPrecision::FP16;
+    if (name == "int8") return DnnPrecision::INT8;
+    throw std::runtime_error("Precisión DNN desconocida: " + name);
+}
+
+const char* dnnPrecisionName(DnnPrecision p) {
+    switch (p) {
+        case DnnPrecision::FP16: return "FP16";
+        case DnnPrecision::INT8: return "INT8";
+        default:                 return "FP32";
+    }
+}
+
+// ==========================================================
+// Chequeo de precisión
+// ==========================================================
+std::vector<PrecisionCheckRow> runPrecisionCheck(const DnnConfig& base,
+                                                 const std::string& dicomDir,
+                                                 int count)
+{
+    // Cortes intermedios: no coinciden con los de calibración INT8
+    const std::vector<Mat> slices = loadCalibrationSlices(dicomDir, count, 0.5);
+
+    auto runAll = [&](DnnDenoiser& den, std::vector<Mat>& outputs) {
+        den.denoise(slices.front());   // calentamiento
+        const auto t0 = std::chrono::steady_clock::now();
+        outputs.clear();
+        for (const Mat& s : slices) outputs.push_back(den.denoise(s));
+        const double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        return 1000.0 * sec / slices.size();
+    };
+
+    std::vector<PrecisionCheckRow> rows;
+    std::vector<Mat> reference;
+
+    for (DnnPrecision p : { DnnPrecision::FP32, DnnPrecision::FP16, DnnPrecision::INT8 }) {
+        PrecisionCheckRow row;
+        row.precision = p;
+        try {
+            // FP32 = referencia: OpenCV/CPU siempre (el backend elegido por
+            // benchmark puede ser CPU_FP16 y entonces la referencia sería FP16)
+            DnnConfig cfg = base;
+            cfg.precision = p;
+            cfg.backend = dnn::DNN_BACKEND_OPENCV;
+            if (p != DnnPrecision::FP16) cfg.target = dnn::DNN_TARGET_CPU;
+
+            auto den = createDnnDenoiser(cfg, dicomDir);
+            if (p == DnnPrecision::FP16 && den->config().precision != DnnPrecision::FP16)
+                throw std::runtime_error("target FP16 no disponible");
+
+            std::vector<Mat> outputs;
+            row.msPerSlice = runAll(*den, outputs);
+            if (p == DnnPrecision::FP32) reference = outputs;
+
+            row.minSsim = 1.0;
+            for (size_t i = 0; i < outputs.size(); ++i) {
+                const double ssim = computeSSIM(reference[i], outputs[i]);
+                row.psnr += computePSNR(reference[i], outputs[i]);
+                row.ssim += ssim;
+                row.minSsim = std::min(row.minSsim, ssim);
+            }
+            row.psnr /= outputs.size();
+            row.ssim /= outputs.size();
+            row.available = true;
+        } catch (const std::exception& e) {
+            row.error = e.what();
+            if (p == DnnPrecision::FP32) {   // sin referencia no hay comparación posible
+                rows.push_back(row);
+                break;
+            }
+        }
+        rows.push_back(row);
+    }
+    return rows;
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <vector>
+#include <opencv2/core.hpp>
+
+#include "dnn_denoising.hpp"
+
+// Serie L096 incluida en data/ (se busca junto al ejecutable y en el cwd).
+// Vacío si no está.
+std::string findBundledSeriesDir();
+
+// N cortes repartidos uniformemente por la serie, ventaneados a 8-bit (40/400).
+// 'phase' en [0,1) desplaza la muestra dentro de cada tramo (0.5 → cortes
+// intermedios, distintos de los de calibración).
+std::vector<cv::Mat> loadCalibrationSlices(const std::string& dicomDir, int count,
+                                           double phase = 0.0);
+
+// Crea el denoiser con la precisión pedida. INT8 se calibra con cortes de
+// calibDir (o de la serie incluida si está vacío).
+std::unique_ptr<DnnDenoiser> createDnnDenoiser(const DnnConfig& cfg,
+                                               const std::string& calibDir = "");
+
+DnnPrecision parseDnnPrecision(const std::string& name);   // "fp32" | "fp16" | "int8"
+const char*  dnnPrecisionName(DnnPrecision p);
+
+// Resultado de una precisión frente a la salida FP32
+struct PrecisionCheckRow {
+    DnnPrecision precision   = DnnPrecision::FP32;
+    bool         available   = false;
+    double       msPerSlice  = 0.0;
+    double       psnr        = 0.0;   // dB, media sobre los cortes
+    double       ssim        = 0.0;
+    double       minSsim     = 0.0;   // peor corte
+    std::string  error;
+};
+
+// Ejecuta FP32, FP16 e INT8 sobre 'count' cortes de la serie y compara con FP32
+std::vector<PrecisionCheckRow> runPrecisionCheck(const DnnConfig& base,
+                                                 const std::string& dicomDir,
+                                                 int count = 8);
@@ -0,0 +1,584 @@
+#include "evidence_store.hpp"
+
+#include "pipeline.hpp"
+#include "label_rle.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <map>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <opencv2/core/utility.hpp>
+
+namespace fs = std::filesystem;
+using namespace cv;
+
+namespace {
+
+// VEV2: los chunks Rle son un RleLabelMap serializado. Los VEV1 llevaban otro
+// RLE (varint por píxel) incompatible: se rechazan y no se mezclan al añadir.
+constexpr char   kMagic[4]       = { 'V', 'E', 'V', '2' };
+constexpr char   kLegacyMagic[4] = { 'V', 'E', 'V', '1' };
+constexpr char   kFooterMagic[4] = { 'V', 'E', 'V', 'I' };
+constexpr size_t kEntryBytes     = 44;
+constexpr size_t kFooterBytes    = 8 + 8 + 4;
+
+// ==========================================================
+// LZ rápido (formato de secuencias tipo LZ4)
+// ==========================================================
+// token (4 bits literales | 4 bits match-4), extensiones de 255, literales,
+// offset u16. La última secuencia solo lleva literales.
+constexpr int    kHashBits    = 14;
+constexpr size_t kMinMatch    = 4;
+constexpr size_t kLastLiterals = 5;    // los últimos bytes siempre como literales
+constexpr size_t kMaxOffset   = 65535;
+
+inline uint32_t read32(const uint8_t* p) { uint32_t v; std::memcpy(&v, p, 4); return v; }
+inline uint32_t hash32(uint32_t v) { return (v * 2654435761u) >> (32 - kHashBits); }
+
+void putLength(std::vector<uint8_t>& out, size_t len) {
+    for (; len >= 255; len -= 255) out.push_back(255);
+    out.push_back(static_cast<uint8_t>(len));
+}
+
+void putSequence(std::vector<uint8_t>& out, const uint8_t* lit, size_t litLen,
+                 size_t offset, size_t matchLen) {
+    const size_t ml = matchLen ? matchLen - kMinMatch : 0;
+    out.push_back(static_cast<uint8_t>((std::min<size_t>(litLen, 15) << 4) | std::min<size_t>(ml, 15)));
+    if (litLen >= 15) putLength(out, litLen - 15);
+    out.insert(out.end(), lit, lit + litLen);
+    if (!matchLen) return;   // secuencia final
+    out.push_back(static_cast<uint8_t>(offset & 0xff));
+    out.push_back(static_cast<uint8_t>(offset >> 8));
+    if (ml >= 15) putLength(out, ml - 15);
+}
+
+void lzCompress(const uint8_t* src, size_t n, std::vector<uint8_t>& out) {
+    out.clear();
+    out.reserve(n + n / 255 + 16);
+
+    size_t anchor = 0;
+    if (n > kMinMatch + kLastLiterals + 8) {
+        std::vector<int64_t> table(size_t(1) << kHashBits, -1);
+        const size_t limit = n - kLastLiterals - kMinMatch;
+        size_t ip = 0;
+        while (ip < limit) {
+            const uint32_t seq = read32(src + ip);
+            const uint32_t h   = hash32(seq);
+            const int64_t  ref = table[h];
+            table[h] = static_cast<int64_t>(ip);
+
+            if (ref < 0 || ip - ref > kMaxOffset || read32(src + ref) != seq) {
+                // Sin coincidencia: se avanza más deprisa cuanto más dura la racha
+                ip += 1 + ((ip - anchor) >> 6);
+                continue;
+            }
+
+            size_t len = kMinMatch;
+            while (ip + len < n - kLastLiterals && src[ref + len] == src[ip + len]) ++len;
+            putSequence(out, src + anchor, ip - anchor, ip - ref, len);
+            ip += len;
+            anchor = ip;
+        }
+    }
+    putSequence(out, src + anchor, n - anchor, 0, 0);
+}
+
+bool lzDecompress(const uint8_t* src, size_t n, uint8_t* dst, size_t rawSize) {
+    const uint8_t* ip = src;
+    const uint8_t* const end = src + n;
+    size_t op = 0;
+
+    auto readLength = [&](size_t len) -> size_t {
+        if (len != 15) return len;
+        uint8_t b;
+        do {
+            if (ip >= end) return SIZE_MAX;
+            b = *ip++;
+            len += b;
+        } while (b == 255);
+        return len;
+    };
+
+    while (ip < end) {
+        const uint8_t token = *ip++;
+        const size_t litLen = readLength(token >> 4);
+        if (litLen == SIZE_MAX || litLen > static_cast<size_t>(end - ip) || op + litLen > rawSize) return false;
+        std::memcpy(dst + op, ip, litLen);
+        ip += litLen;
+        op += litLen;
+        if (ip == end) break;   // secuencia final
+
+        if (end - ip < 2) return false;
+        const size_t offset = ip[0] | (size_t(ip[1]) << 8);
+        ip += 2;
+        const size_t ml = readLength(token & 15);
+        if (ml == SIZE_MAX) return false;
+        const size_t matchLen = ml + kMinMatch;
+        if (offset == 0 || offset > op || op + matchLen > rawSize) return false;
+        // Byte a byte: el match puede solaparse con lo que se está escribiendo
+        const uint8_t* m = dst + op - offset;
+        for (size_t i = 0; i < matchLen; ++i) dst[op + i] = m[i];
+        op += matchLen;
+    }
+    return op == rawSize;
+}
+
+// ==========================================================
+// Filtro delta por fila (cada canal con su vecino izquierdo)
+// ==========================================================
+void deltaEncode(const Mat& img, std::vector<uint8_t>& out) {
+    const int cn = img.channels();
+    const size_t rowBytes = static_cast<size_t>(img.cols) * cn;
+    out.resize(rowBytes * img.rows);
+    for (int r = 0; r < img.rows; ++r) {
+        const uint8_t* s = img.ptr<uint8_t>(r);
+        uint8_t* d = out.data() + r * rowBytes;
+        for (int c = 0; c < cn && size_t(c) < rowBytes; ++c) d[c] = s[c];
+        for (size_t i = cn; i < rowBytes; ++i) d[i] = static_cast<uint8_t>(s[i] - s[i - cn]);
+    }
+}
+
+void deltaDecode(Mat& img) {
+    const int cn = img.channels();
+    const size_t rowBytes = static_cast<size_t>(img.cols) * cn;
+    for (int r = 0; r < img.rows; ++r) {
+        uint8_t* d = img.ptr<uint8_t>(r);
+        for (size_t i = cn; i < rowBytes; ++i) d[i] = static_cast<uint8_t>(d[i] + d[i - cn]);
+    }
+}
+
+// ==========================================================
+// Codificación de una capa: el códec más pequeño que aplique
+// ==========================================================
+struct EncodedLayer {
+    Mat img;
+    const RleLabelMap* labels = nullptr;   // capas de etiquetas ya en tramos
+    ChunkCodec codec = ChunkCodec::Raw;
+    std::vector<uint8_t> payload;
+
+    bool  empty() const { return labels ? labels->empty() : img.empty(); }
+    Size  size()  const { return labels ? labels->size() : img.size(); }
+    int   type()  const { return labels ? CV_8U : img.type(); }
+};
+
+void encodeLayer(uint16_t layer, EncodedLayer& e) {
+    // Mapas de etiquetas: los tramos serializados (RleLabelMap) son el chunk
+    if (e.labels) {
+        e.labels->serialize(e.payload);
+        e.codec = ChunkCodec::Rle;
+        if (e.payload.size() < static_cast<size_t>(e.labels->size().area())) return;
+        e.labels->rasterize(e.img);   // no compensa (no debería pasar): tal cual
+    }
+
+    const Mat& img = e.img;
+    CV_Assert(img.depth() == CV_8U);
+    const size_t rawSize = img.total() * img.elemSize();
+
+    std::vector<uint8_t> tmp;
+    if (e.labels) {
+        e.payload.clear();   // fuerza la copia tal cual de abajo
+    } else if (layer >= LAYER_LABELS_RAW) {
+        RleLabelMap::fromLabels(img).serialize(e.payload);
+        e.codec = ChunkCodec::Rle;
+    } else {
+        deltaEncode(img, tmp);
+        lzCompress(tmp.data(), tmp.size(), e.payload);
+        e.codec = ChunkCodec::DeltaLz;
+    }
+    if (e.payload.empty() || e.payload.size() >= rawSize) {   // no compensa: tal cual
+        e.codec = ChunkCodec::Raw;
+        e.payload.resize(rawSize);
+        const size_t rowBytes = img.cols * img.elemSize();
+        for (int r = 0; r < img.rows; ++r)
+            std::memcpy(e.payload.data() + r * rowBytes, img.ptr(r), rowBytes);
+    }
+}
+
+// Índice en disco: u32 slice | u16 layer | u8 codec | u8 0 | i32 type, rows, cols | u64 offset, size, raw
+void packEntry(const EvidenceEntry& e, uint8_t* p) {
+    const uint8_t codec = static_cast<uint8_t>(e.codec), pad = 0;
+    std::memcpy(p + 0,  &e.slice, 4);
+    std::memcpy(p + 4,  &e.layer, 2);
+    std::memcpy(p + 6,  &codec, 1);
+    std::memcpy(p + 7,  &pad, 1);
+    std::memcpy(p + 8,  &e.type, 4);
+    std::memcpy(p + 12, &e.rows, 4);
+    std::memcpy(p + 16, &e.cols, 4);
+    std::memcpy(p + 20, &e.offset, 8);
+    std::memcpy(p + 28, &e.size, 8);
+    std::memcpy(p + 36, &e.rawSize, 8);
+}
+
+EvidenceEntry unpackEntry(const uint8_t* p) {
+    EvidenceEntry e;
+    uint8_t codec = 0;
+    std::memcpy(&e.slice, p + 0, 4);
+    std::memcpy(&e.layer, p + 4, 2);
+    std::memcpy(&codec, p + 6, 1);
+    std::memcpy(&e.type, p + 8, 4);
+    std::memcpy(&e.rows, p + 12, 4);
+    std::memcpy(&e.cols, p + 16, 4);
+    std::memcpy(&e.offset, p + 20, 8);
+    std::memcpy(&e.size, p + 28, 8);
+    std::memcpy(&e.rawSize, p + 36, 8);
+    e.codec = static_cast<ChunkCodec>(codec);
+    return e;
+}
+
+// Una entrada leída del archivo: geometría coherente y chunk dentro de la
+// zona de datos. Con rows, cols ≤ 65536 y 3 canales nada de esto desborda.
+constexpr int32_t kMaxSide = 65536;
+
+bool validEntry(const EvidenceEntry& e, uint64_t indexOffset) {
+    if (e.type != CV_8UC1 && e.type != CV_8UC3) return false;   // lo único que escribe addLayer/addSlice
+    if (static_cast<uint8_t>(e.codec) > static_cast<uint8_t>(ChunkCodec::Rle)) return false;
+    if (e.rows <= 0 || e.cols <= 0 || e.rows > kMaxSide || e.cols > kMaxSide) return false;
+    if (e.rawSize != static_cast<uint64_t>(e.rows) * static_cast<uint64_t>(e.cols) * CV_ELEM_SIZE(e.type))
+        return false;
+    return e.offset >= sizeof(kMagic) && e.offset <= indexOffset && e.size <= indexOffset - e.offset;
+}
+
+// Pie: nº de entradas y offset del índice, acotados por el tamaño del
+// archivo sin desbordamientos (count e indexOffset se comprueban por separado)
+bool parseFooterBytes(const uint8_t* footer, uint64_t size, uint64_t& count, uint64_t& indexOffset) {
+    if (size < sizeof(kMagic) + kFooterBytes || std::memcmp(footer + 16, kFooterMagic, 4) != 0) return false;
+    std::memcpy(&count, footer, 8);
+    std::memcpy(&indexOffset, footer + 8, 8);
+    const uint64_t body = size - kFooterBytes;
+    return count <= body / kEntryBytes && indexOffset >= sizeof(kMagic) && indexOffset == body - count * kEntryBytes;
+}
+
+// Cualquier entrada incoherente invalida el archivo entero
+bool parseIndex(const uint8_t* index, uint64_t count, uint64_t indexOffset, std::vector<EvidenceEntry>& entries) {
+    entries.clear();
+    entries.reserve(count);
+    for (uint64_t i = 0; i < count; ++i) {
+        EvidenceEntry e = unpackEntry(index + i * kEntryBytes);
+        if (!validEntry(e, indexOffset)) return false;
+        entries.push_back(e);
+    }
+    return true;
+}
+
+// Contenedor en memoria; false si no es válido
+bool parseFooter(const uint8_t* data, size_t size, std::vector<EvidenceEntry>& entries, uint64_t& indexOffset) {
+    uint64_t count = 0;
+    if (size < sizeof(kMagic) + kFooterBytes || std::memcmp(data, kMagic, 4) != 0) return false;
+    return parseFooterBytes(data + size - kFooterBytes, size, count, indexOffset) &&
+           parseIndex(data + indexOffset, count, indexOffset, entries);
+}
+
+bool isLegacyContainer(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    char magic[4] = {};
+    return in.read(magic, 4) && std::memcmp(magic, kLegacyMagic, 4) == 0;
+}
+
+// Lo mismo leyendo del archivo solo la cabecera, el índice y el pie
+bool readFooter(const std::string& path, std::vector<EvidenceEntry>& entries, uint64_t& indexOffset) {
+    std::error_code ec;
+    const uint64_t size = fs::file_size(path, ec);
+    if (ec || size < sizeof(kMagic) + kFooterBytes) return false;
+    std::ifstream in(path, std::ios::binary);
+    char magic[4] = {};
+    uint8_t footer[kFooterBytes];
+    uint64_t count = 0;
+    in.read(magic, 4);
+    in.seekg(static_cast<std::streamoff>(size - kFooterBytes));
+    in.read(reinterpret_cast<char*>(footer), kFooterBytes);
+    if (!in || std::memcmp(magic, kMagic, 4) != 0 || !parseFooterBytes(footer, size, count, indexOffset))
+        return false;
+    std::vector<uint8_t> index(count * kEntryBytes);
+    in.seekg(static_cast<std::streamoff>(indexOffset));
+    in.read(reinterpret_cast<char*>(index.data()), static_cast<std::streamsize>(index.size()));
+    return in && parseIndex(index.data(), count, indexOffset, entries);
+}
+
+// Última versión de cada (corte, capa), ordenadas por (corte, capa)
+std::vector<EvidenceEntry> latestEntries(const std::vector<EvidenceEntry>& all) {
+    std::map<std::pair<uint32_t, uint16_t>, EvidenceEntry> latest;
+    for (const auto& e : all) latest[{ e.slice, e.layer }] = e;
+    std::vector<EvidenceEntry> out;
+    out.reserve(latest.size());
+    for (const auto& kv : latest) out.push_back(kv.second);
+    return out;
+}
+
+// Índice + pie al final de 'os' (los datos terminan en dataEnd)
+void writeIndex(std::ostream& os, const std::vector<EvidenceEntry>& index, uint64_t dataEnd) {
+    std::vector<uint8_t> buf(index.size() * kEntryBytes + kFooterBytes);
+    for (size_t i = 0; i < index.size(); ++i) packEntry(index[i], buf.data() + i * kEntryBytes);
+    const uint64_t count = index.size();
+    uint8_t* footer = buf.data() + index.size() * kEntryBytes;
+    std::memcpy(footer, &count, 8);
+    std::memcpy(footer + 8, &dataEnd, 8);
+    std::memcpy(footer + 16, kFooterMagic, 4);
+    os.write(reinterpret_cast<const char*>(buf.data()), static_cast<std::streamsize>(buf.size()));
+}
+
+// Con append, reprocesar un corte deja sus chunks anteriores como bytes
+// muertos. Pasada esta fracción del área de datos se reescribe el archivo.
+constexpr double kMaxDeadFraction = 0.25;
+
+} // namespace
+
+// ==========================================================
+// EvidenceWriter
+// ==========================================================
+EvidenceWriter::EvidenceWriter(const std::string& path, bool append) : path_(path) {
+    std::error_code ec;
+    if (fs::path(path).has_parent_path()) fs::create_directories(fs::path(path).parent_path(), ec);
+
+    if (append && fs::exists(path)) {
+        if (isLegacyContainer(path))
+            std::cerr << "[AVISO] " << path << " es un contenedor VEV1 (formato anterior): se reescribe\n";
+        // Se recupera el índice anterior (sin leer los chunks) y se escribe encima de él
+        uint64_t indexOffset = 0;
+        if (readFooter(path, index_, indexOffset)) {
+            offset_ = indexOffset;
+            for (const auto& e : index_) rawBytes_ += e.rawSize;
+        }
+        if (offset_ > 0) {
+            os_.open(path, std::ios::binary | std::ios::in | std::ios::out);
+            os_.seekp(static_cast<std::streamoff>(offset_));
+        }
+    }
+    if (!os_.is_open()) {
+        index_.clear();
+        rawBytes_ = 0;
+        os_.open(path, std::ios::binary | std::ios::trunc);
+        os_.write(kMagic, 4);
+        offset_ = 4;
+    }
+    if (!os_) throw std::runtime_error("No se pudo escribir el contenedor: " + path);
+}
+
+EvidenceWriter::~EvidenceWriter() {
+    try { close(); } catch (...) {}
+}
+
+void EvidenceWriter::writeChunk(uint32_t slice, uint16_t layer, Size size, int type,
+                                ChunkCodec codec, const std::vector<uint8_t>& payload) {
+    EvidenceEntry e;
+    e.slice   = slice;
+    e.layer   = layer;
+    e.codec   = codec;
+    e.type    = type;
+    e.rows    = size.height;
+    e.cols    = size.width;
+    e.offset  = offset_;
+    e.size    = payload.size();
+    e.rawSize = static_cast<uint64_t>(size.area()) * CV_ELEM_SIZE(type);
+
+    os_.write(reinterpret_cast<const char*>(payload.data()), static_cast<std::streamsize>(payload.size()));
+    if (!os_) throw std::runtime_error("Error escribiendo el contenedor: " + path_);
+    offset_   += payload.size();
+    rawBytes_ += e.rawSize;
+    index_.push_back(e);
+}
+
+void EvidenceWriter::addLayer(uint32_t slice, uint16_t layer, const Mat& img) {
+    if (closed_) throw std::runtime_error("Contenedor ya cerrado: " + path_);
+    if (img.empty()) return;
+    EncodedLayer e;
+    e.img = img;
+    encodeLayer(layer, e);
+    writeChunk(slice, layer, img.size(), img.type(), e.codec, e.payload);
+}
+
+void EvidenceWriter::addSlice(uint32_t slice, const PipelineResults& results) {
+    if (closed_) throw std::runtime_error("Contenedor ya cerrado: " + path_);
+
+    std::array<EncodedLayer, kNumEvidenceLayers> layers;
+    for (int i = 0; i < kNumEvidences; ++i) layers[i].img = results.images[i];
+    layers[LAYER_LABELS_RAW].labels   = &results.labelsRaw;
+    layers[LAYER_LABELS_GAUSS].labels = &results.labelsGauss;
+    layers[LAYER_LABELS_DNN].labels   = &results.labelsDnn;
+
+    // Compresión en paralelo; la escritura sigue siendo secuencial (streaming)
+    parallel_for_(Range(0, kNumEvidenceLayers), [&](const Range& r) {
+        for (int i = r.start; i < r.end; ++i)
+            if (!layers[i].empty()) encodeLayer(static_cast<uint16_t>(i), layers[i]);
+    });
+    for (int i = 0; i < kNumEvidenceLayers; ++i)
+        if (!layers[i].empty())
+            writeChunk(slice, static_cast<uint16_t>(i), layers[i].size(), layers[i].type(),
+                       layers[i].codec, layers[i].payload);
+}
+
+void EvidenceWriter::close() {
+    if (closed_) return;
+    closed_ = true;
+
+    // Solo la última versión de cada (corte, capa): lo sustituido queda muerto
+    index_ = latestEntries(index_);
+    writeIndex(os_, index_, offset_);
+    os_.close();
+    if (!os_) throw std::runtime_error("Error cerrando el contenedor: " + path_);
+
+    // Al añadir sobre un archivo existente puede sobrar cola del índice anterior
+    std::error_code ec;
+    fs::resize_file(path_, offset_ + index_.size() * kEntryBytes + kFooterBytes, ec);
+
+    uint64_t live = 0;
+    for (const auto& e : index_) live += e.size;
+    const uint64_t data = offset_ - sizeof(kMagic);
+    if (data > 0 && static_cast<double>(data - live) > kMaxDeadFraction * static_cast<double>(data)) compact();
+}
+
+// Copia los chunks vivos a un archivo nuevo (en su orden) y lo cambia por el actual
+void EvidenceWriter::compact() {
+    const std::string tmp = path_ + ".tmp";
+    {
+        std::ifstream in(path_, std::ios::binary);
+        std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+        out.write(kMagic, 4);
+        std::vector<EvidenceEntry> index = index_;
+        std::sort(index.begin(), index.end(),
+                  [](const EvidenceEntry& a, const EvidenceEntry& b) { return a.offset < b.offset; });
+        uint64_t offset = sizeof(kMagic);
+        std::vector<char> buf;
+        for (auto& e : index) {
+            buf.resize(e.size);
+            in.seekg(static_cast<std::streamoff>(e.offset));
+            in.read(buf.data(), static_cast<std::streamsize>(buf.size()));
+            out.write(buf.data(), static_cast<std::streamsize>(buf.size()));
+            e.offset = offset;
+            offset += e.size;
+        }
+        index = latestEntries(index);   // de vuelta al orden (corte, capa)
+        writeIndex(out, index, offset);
+        out.flush();
+        if (!in || !out) {
+            std::error_code ec;
+            fs::remove(tmp, ec);
+            return;   // el original sigue siendo válido
+        }
+        index_ = std::move(index);
+        offset_ = offset;
+    }
+    std::error_code ec;
+    fs::rename(tmp, path_, ec);
+    if (ec) fs::remove(tmp, ec);
+}
+
+// ==========================================================
+// EvidenceReader (mmap)
+// ==========================================================
+EvidenceReader::EvidenceReader(const std::string& path) {
+    fd_ = ::open(path.c_str(), O_RDONLY);
+    if (fd_ < 0) throw std::runtime_error("No se pudo abrir el contenedor: " + path);
+
+    struct stat st{};
+    if (::fstat(fd_, &st) != 0 || st.st_size <= 0) {
+        ::close(fd_);
+        throw std::runtime_error("Contenedor vacío: " + path);
+    }
+    size_ = static_cast<size_t>(st.st_size);
+    void* p = ::mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd_, 0);
+    if (p == MAP_FAILED) {
+        ::close(fd_);
+        throw std::runtime_error("mmap falló: " + path);
+    }
+    data_ = static_cast<const uint8_t*>(p);
+
+    std::vector<EvidenceEntry> all;
+    uint64_t indexOffset = 0;
+    if (!parseFooter(data_, size_, all, indexOffset)) {
+        const bool legacy = size_ >= 4 && std::memcmp(data_, kLegacyMagic, 4) == 0;
+        ::munmap(const_cast<uint8_t*>(data_), size_);
+        ::close(fd_);
+        throw std::runtime_error(legacy ? "Contenedor VEV1 (formato anterior, hay que regenerarlo): " + path
+                                        : "Contenedor no válido: " + path);
+    }
+
+    // Última versión de cada (corte, capa)
+    entries_ = latestEntries(all);
+}
+
+EvidenceReader::~EvidenceReader() {
+    if (data_) ::munmap(const_cast<uint8_t*>(data_), size_);
+    if (fd_ >= 0) ::close(fd_);
+}
+
+const EvidenceEntry* EvidenceReader::find(uint32_t slice, uint16_t layer) const {
+    auto it = std::lower_bound(entries_.begin(), entries_.end(), std::make_pair(slice, layer),
+        [](const EvidenceEntry& e, const std::pair<uint32_t, uint16_t>& k) {
+            return std::make_pair(e.slice, e.layer) < k;
+        });
+    if (it == entries_.end() || it->slice != slice || it->layer != layer) return nullptr;
+    return &*it;
+}
+
+bool EvidenceReader::has(uint32_t slice, uint16_t layer) const {
+    return find(slice, layer) != nullptr;
+}
+
+bool EvidenceReader::read(uint32_t slice, uint16_t layer, Mat& out) const {
+    const EvidenceEntry* e = find(slice, layer);
+    if (!e) return false;
+
+    // Geometría ya validada en parseFooter: rows·cols·elemSize == rawSize
+    out.create(e->rows, e->cols, e->type);
+    if (!out.isContinuous()) out = Mat(e->rows, e->cols, e->type);
+    CV_Assert(out.total() * out.elemSize() == e->rawSize);
+
+    const uint8_t* src = data_ + e->offset;
+    switch (e->codec) {
+    case ChunkCodec::Raw:
+        if (e->size != e->rawSize) return false;
+        std::memcpy(out.data, src, e->size);
+        return true;
+    case ChunkCodec::DeltaLz:
+        if (!lzDecompress(src, e->size, out.data, e->rawSize)) return false;
+        deltaDecode(out);
+        return true;
+    case ChunkCodec::Rle: {
+        RleLabelMap labels;
+        if (!RleLabelMap::deserialize(src, e->size, labels) || labels.size() != out.size()) return false;
+        labels.rasterize(out);
+        return true;
+    }
+    }
+    return false;
+}
+
+bool EvidenceReader::readLabels(uint32_t slice, uint16_t layer, RleLabelMap& out) const {
+    const EvidenceEntry* e = find(slice, layer);
+    if (!e || e->type != CV_8U) return false;
+    if (e->codec == ChunkCodec::Rle)
+        return RleLabelMap::deserialize(data_ + e->offset, e->size, out) &&
+               out.size() == Size(e->cols, e->rows);
+    Mat labels;
+    if (!read(slice, layer, labels)) return false;
+    out = RleLabelMap::fromLabels(labels);
+    return true;
+}
+
+Mat EvidenceReader::read(uint32_t slice, uint16_t layer) const {
+    Mat out;
+    if (!read(slice, layer, out)) return {};
+    return out;
+}
+
+std::vector<uint32_t> EvidenceReader::slices() const {
+    std::vector<uint32_t> s;
+    for (const auto& e : entries_)
+        if (s.empty() || s.back() != e.slice) s.push_back(e.slice);
+    return s;
+}
+
+std::string evidenceStorePath(const std::string& outDir, const std::string& dicomDir) {
+    fs::path dir(dicomDir);
+    if (!dir.has_filename()) dir = dir.parent_path();
+    return (fs::path(outDir) / (dir.filename().string() + ".vev")).string();
+}
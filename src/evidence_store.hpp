@@ -0,0 +1,114 @@
+#pragma once
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <opencv2/core.hpp>
+
+#include "label_rle.hpp"
+
+struct PipelineResults;
+
+// ==========================================================
+// Contenedor de evidencias por serie (.vev)
+// ==========================================================
+// Un único archivo binario por serie con las 13 evidencias y los mapas de
+// etiquetas de cada corte, en vez de 13 PNG por corte:
+//
+//   "VEV2" | chunk | chunk | ... | índice | nº entradas (u64) | offset índice (u64) | "VEVI"
+//
+// Cada chunk es una capa de un corte comprimida por separado:
+//  - evidencias 8-bit: filtro delta por fila + LZ rápido (tipo LZ4)
+//  - mapas de etiquetas: tramos por fila (RleLabelMap serializado)
+//  - sin comprimir si no compensa
+// El índice del final da acceso directo por (corte, capa). La escritura es en
+// streaming (un corte cada vez) y la lectura va sobre el archivo mapeado en
+// memoria. Si un (corte, capa) se escribe dos veces, vale la última; al
+// cerrar, si lo sustituido pasa de un 25 % de los datos, se compacta.
+
+// Capas: 0..12 = evidencias (ver pipeline.hpp); después, mapas de etiquetas
+// (LABEL_NONE/FAT/MUSCLE/BONE) de cada juego de máscaras
+enum EvidenceLayer : uint16_t {
+    LAYER_LABELS_RAW   = 13,
+    LAYER_LABELS_GAUSS = 14,
+    LAYER_LABELS_DNN   = 15,
+    kNumEvidenceLayers = 16
+};
+
+enum class ChunkCodec : uint8_t { Raw = 0, DeltaLz = 1, Rle = 2 };
+
+struct EvidenceEntry {
+    uint32_t   slice   = 0;
+    uint16_t   layer   = 0;
+    ChunkCodec codec   = ChunkCodec::Raw;
+    int32_t    type    = 0;   // tipo cv::Mat
+    int32_t    rows    = 0;
+    int32_t    cols    = 0;
+    uint64_t   offset  = 0;   // bytes desde el inicio del archivo
+    uint64_t   size    = 0;   // bytes comprimidos
+    uint64_t   rawSize = 0;
+};
+
+class EvidenceWriter {
+public:
+    // append == true y el archivo existe → se conservan sus cortes y se
+    // continúa detrás (los nuevos sustituyen a los repetidos). Solo se lee
+    // el índice, no los chunks.
+    explicit EvidenceWriter(const std::string& path, bool append = false);
+    ~EvidenceWriter();   // cierra (escribe el índice) si no se hizo antes
+
+    EvidenceWriter(const EvidenceWriter&) = delete;
+    EvidenceWriter& operator=(const EvidenceWriter&) = delete;
+
+    // Las 13 evidencias + los 3 mapas de etiquetas del corte
+    void addSlice(uint32_t slice, const PipelineResults& results);
+    // Una capa suelta (8-bit, 1 o 3 canales)
+    void addLayer(uint32_t slice, uint16_t layer, const cv::Mat& img);
+
+    void close();
+
+    uint64_t bytesWritten() const { return offset_; }
+    uint64_t rawBytes()     const { return rawBytes_; }
+
+private:
+    void writeChunk(uint32_t slice, uint16_t layer, cv::Size size, int type,
+                    ChunkCodec codec, const std::vector<uint8_t>& payload);
+    void compact();   // reescribe sin los chunks sustituidos
+
+    std::string   path_;
+    std::ofstream os_;
+    uint64_t      offset_   = 0;
+    uint64_t      rawBytes_ = 0;
+    std::vector<EvidenceEntry> index_;
+    bool closed_ = false;
+};
+
+class EvidenceReader {
+public:
+    explicit EvidenceReader(const std::string& path);   // lanza si no es un .vev válido
+    ~EvidenceReader();
+
+    EvidenceReader(const EvidenceReader&) = delete;
+    EvidenceReader& operator=(const EvidenceReader&) = delete;
+
+    bool has(uint32_t slice, uint16_t layer) const;
+    // Descomprime la capa en 'out' (reutiliza su buffer si la geometría coincide)
+    bool read(uint32_t slice, uint16_t layer, cv::Mat& out) const;
+    cv::Mat read(uint32_t slice, uint16_t layer) const;
+    // Capa de etiquetas sin pasar por píxeles (los chunks RLE ya son tramos)
+    bool readLabels(uint32_t slice, uint16_t layer, RleLabelMap& out) const;
+
+    std::vector<uint32_t> slices() const;   // cortes presentes, ordenados
+    const std::vector<EvidenceEntry>& entries() const { return entries_; }
+
+private:
+    const EvidenceEntry* find(uint32_t slice, uint16_t layer) const;
+
+    const uint8_t* data_ = nullptr;
+    size_t size_ = 0;
+    int    fd_   = -1;
+    std::vector<EvidenceEntry> entries_;   // última versión de cada (corte, capa), ordenadas
+};
+
+// Ruta del contenedor de una serie dentro de 'outDir' (<nombre del directorio>.vev)
+std::string evidenceStorePath(const std::string& outDir, const std::string& dicomDir);
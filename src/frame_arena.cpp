@@ -0,0 +1,199 @@
+#include "frame_arena.hpp"
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+using namespace cv;
+
+namespace {
+// Buffers pequeños (kernels, escalares...) no compensan el pool
+constexpr size_t kMinPooledBytes     = 16 * 1024;
+constexpr size_t kDefaultWorkerBytes = 64ull * 1024 * 1024;
+
+FrameArena* g_arena = nullptr;
+
+// Sin destructor: se puede consultar mientras se destruyen los demás
+// thread_local del hilo (Mat de scratch que se liberan después del Lease)
+thread_local bool t_leaseGone = false;
+} // namespace
+
+struct FrameArena::Lease {
+    std::shared_ptr<ShardPool> pool;
+    Shard* shard = nullptr;
+
+    // Suelta los buffers del shard y lo deja libre para otro hilo
+    void release() {
+        if (!shard) return;
+        freeShard(*pool, *shard);
+        {
+            std::lock_guard<std::mutex> lock(pool->mutex);
+            pool->idle.push_back(shard);
+        }
+        shard = nullptr;
+        pool.reset();
+    }
+    ~Lease() {
+        release();
+        t_leaseGone = true;
+    }
+};
+
+FrameArena::FrameArena(size_t bytesPerWorker)
+    : bytesPerWorker_(bytesPerWorker), pool_(std::make_shared<ShardPool>()) {}
+
+FrameArena::~FrameArena() {
+    trim();   // los shards siguen en pool_ hasta que terminen sus hilos
+}
+
+FrameArena::Shard* FrameArena::localShard() const {
+    if (t_leaseGone) return nullptr;   // hilo terminando: sin pool
+    thread_local Lease lease;
+    if (lease.pool != pool_) {
+        lease.release();   // de otro arena usado antes en este hilo
+        std::lock_guard<std::mutex> lock(pool_->mutex);
+        if (!pool_->idle.empty()) {
+            lease.shard = pool_->idle.back();
+            pool_->idle.pop_back();
+        } else {
+            pool_->shards.push_back(std::make_unique<Shard>());
+            lease.shard = pool_->shards.back().get();
+        }
+        lease.pool = pool_;
+    }
+    return lease.shard;
+}
+
+void FrameArena::freeShard(ShardPool& pool, Shard& s) {
+    std::lock_guard<std::mutex> lock(s.mutex);
+    for (auto& kv : s.freeLists) {
+        for (void* p : kv.second) fastFree(p);
+        pool.pooledBytes -= kv.first * kv.second.size();
+    }
+    s.freeLists.clear();
+    s.bytes = 0;
+}
+
+// Igual que el StdMatAllocator de OpenCV, pero intentando primero el pool
+UMatData* FrameArena::allocate(int dims, const int* sizes, int type, void* data0,
+                               size_t* step, AccessFlag, UMatUsageFlags) const
+{
+    size_t total = CV_ELEM_SIZE(type);
+    for (int i = dims - 1; i >= 0; i--) {
+        if (step) {
+            if (data0 && step[i] != CV_AUTOSTEP) {
+                CV_Assert(total <= step[i]);
+                total = step[i];
+            } else {
+                step[i] = total;
+            }
+        }
+        total *= sizes[i];
+    }
+
+    uchar* data = static_cast<uchar*>(data0);
+    if (!data) {
+        Shard* s = total >= kMinPooledBytes ? localShard() : nullptr;
+        if (s) {
+            std::lock_guard<std::mutex> lock(s->mutex);
+            auto it = s->freeLists.find(total);
+            if (it != s->freeLists.end() && !it->second.empty()) {
+                data = static_cast<uchar*>(it->second.back());
+                it->second.pop_back();
+                s->bytes -= total;
+                pool_->pooledBytes -= total;
+                ++hits_;
+            }
+        }
+        if (!data) {
+            data = static_cast<uchar*>(fastMalloc(total));
+            ++misses_;
+        }
+    }
+
+    UMatData* u = new UMatData(this);
+    u->data = u->origdata = data;
+    u->size = total;
+    if (data0) u->flags |= UMatData::USER_ALLOCATED;
+    return u;
+}
+
+bool FrameArena::allocate(UMatData* u, AccessFlag, UMatUsageFlags) const {
+    return u != nullptr;
+}
+
+void FrameArena::deallocate(UMatData* u) const {
+    if (!u) return;
+    CV_Assert(u->urefcount == 0);
+    CV_Assert(u->refcount == 0);
+
+    if (!(u->flags & UMatData::USER_ALLOCATED) && u->origdata) {
+        bool pooled = false;
+        Shard* s = u->size >= kMinPooledBytes ? localShard() : nullptr;
+        if (s) {
+            std::lock_guard<std::mutex> lock(s->mutex);
+            if (s->bytes + u->size <= bytesPerWorker_) {
+                s->freeLists[u->size].push_back(u->origdata);
+                s->bytes += u->size;
+                pool_->pooledBytes += u->size;
+                pooled = true;
+            }
+        }
+        if (!pooled) fastFree(u->origdata);
+        u->origdata = nullptr;
+    }
+    delete u;
+}
+
+FrameArena::Counters FrameArena::counters() const {
+    Counters c;
+    c.hits        = hits_.load();
+    c.misses      = misses_.load();
+    c.pooledBytes = pool_->pooledBytes.load();
+    return c;
+}
+
+void FrameArena::trim() const {
+    std::lock_guard<std::mutex> lock(pool_->mutex);
+    for (auto& s : pool_->shards) freeShard(*pool_, *s);
+}
+
+size_t FrameArena::releaseMemory(size_t) {
+    const size_t before = pool_->pooledBytes.load();
+    trim();
+    const size_t after = pool_->pooledBytes.load();
+    return before > after ? before - after : 0;
+}
+
+// ==========================================================
+// Instalación global
+// ==========================================================
+FrameArena& installFrameArena(size_t bytesPerWorker) {
+    if (g_arena) return *g_arena;
+
+    if (bytesPerWorker == 0) {
+        bytesPerWorker = kDefaultWorkerBytes;
+        // Se llama antes del try de main: un valor malo avisa, no aborta
+        if (const char* env = std::getenv("VISION_ARENA_MB"); env && *env) {
+            char* end = nullptr;
+            errno = 0;
+            const unsigned long long mb = std::strtoull(env, &end, 10);
+            if (errno != 0 || *end != '\0' || env[0] == '-' || mb == 0 || mb > SIZE_MAX / (1024 * 1024))
+                std::fprintf(stderr, "[AVISO] VISION_ARENA_MB='%s' no es un número de MB válido (se usa %zu)\n",
+                             env, kDefaultWorkerBytes / (1024 * 1024));
+            else
+                bytesPerWorker = static_cast<size_t>(mb) * 1024 * 1024;
+        }
+    }
+
+    // Nunca se destruye: puede haber cv::Mat estáticos vivos hasta el final
+    g_arena = new FrameArena(bytesPerWorker);
+    Mat::setDefaultAllocator(g_arena);
+    memoryGovernor().add(g_arena, MemoryPriority::Scratch);
+    return *g_arena;
+}
+
+FrameArena* frameArena() {
+    return g_arena;
+}
@@ -0,0 +1,81 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include <opencv2/core.hpp>
+
+#include "memory_governor.hpp"
+
+// ==========================================================
+// FrameArena: allocator de cv::Mat que recicla buffers
+// ==========================================================
+// Al procesar una serie cada corte pide los mismos tamaños de buffer
+// (HU float, 8-bit, BGR, máscaras...). En vez de devolverlos al sistema,
+// el arena los guarda en listas libres por tamaño exacto, una por hilo
+// (worker), y los reutiliza en el siguiente corte. Cada worker retiene como
+// máximo 'bytesPerWorker', así el pico de memoria es predecible. Al
+// terminar un hilo su pool se devuelve al sistema y su shard queda para el
+// siguiente hilo nuevo.
+// Lo retenido cuenta para el gobernador de memoria y es lo primero que se
+// suelta bajo presión (prioridad Scratch).
+class FrameArena : public cv::MatAllocator, public MemoryConsumer {
+public:
+    struct Counters {
+        uint64_t hits        = 0;   // buffers servidos desde el pool
+        uint64_t misses      = 0;   // buffers pedidos al sistema
+        size_t   pooledBytes = 0;   // bytes retenidos ahora mismo en los pools
+    };
+
+    explicit FrameArena(size_t bytesPerWorker);
+    ~FrameArena() override;
+
+    cv::UMatData* allocate(int dims, const int* sizes, int type, void* data,
+                           size_t* step, cv::AccessFlag flags,
+                           cv::UMatUsageFlags usageFlags) const override;
+    bool allocate(cv::UMatData* u, cv::AccessFlag accessFlags,
+                  cv::UMatUsageFlags usageFlags) const override;
+    void deallocate(cv::UMatData* u) const override;
+
+    Counters counters() const;
+    void     trim() const;   // libera todo lo retenido (p.ej. al cambiar de serie)
+
+    const char* memoryName() const override { return "pools del arena"; }
+    size_t      memoryBytes() const override { return pool_->pooledBytes.load(); }
+    size_t      releaseMemory(size_t bytes) override;
+
+private:
+    struct Shard {
+        std::mutex mutex;
+        std::unordered_map<size_t, std::vector<void*>> freeLists;
+        size_t bytes = 0;
+    };
+
+    // Shards de todos los hilos. Lo comparten los hilos vivos: uno que
+    // termine después del arena aún puede soltar el suyo
+    struct ShardPool {
+        std::mutex mutex;
+        std::vector<std::unique_ptr<Shard>> shards;
+        std::vector<Shard*> idle;   // de hilos terminados: vacíos, para reutilizar
+        std::atomic<size_t> pooledBytes{0};
+    };
+    struct Lease;   // shard del hilo (thread_local), se devuelve al terminar
+
+    Shard* localShard() const;   // nullptr si el hilo está terminando
+    static void freeShard(ShardPool& pool, Shard& s);
+
+    size_t bytesPerWorker_;
+    std::shared_ptr<ShardPool> pool_;
+    mutable std::atomic<uint64_t> hits_{0};
+    mutable std::atomic<uint64_t> misses_{0};
+};
+
+// Instala el arena como allocator por defecto de cv::Mat (llamar al inicio,
+// antes de crear hilos). bytesPerWorker == 0 → valor por defecto o variable
+// de entorno VISION_ARENA_MB.
+FrameArena& installFrameArena(size_t bytesPerWorker = 0);
+
+// Arena instalado (nullptr si no se llamó a installFrameArena)
+FrameArena* frameArena();
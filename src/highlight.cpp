@@ -9,17 +9,19 @@ using namespace cv;
 // ==========================================================
 AnatomyMasks generateAnatomicalMasksHU(const Mat& huInput) {
     AnatomyMasks m;
+    generateAnatomicalMasksHU(huInput, m);
+    return m;
+}
 
+namespace {
+// Umbrales + limpieza morfológica, sin jerarquía (las máscaras pueden solaparse)
+void thresholdTissues(const Mat& huInput, AnatomyMasks& m, const TissueThresholds& t) {
     // Usamos directamente la matriz de entrada (sea cruda o suavizada)
-    // Rangos de HU estándar
-    Mat raw_fat    = (huInput >= -190.f) & (huInput <= -30.f);
-    Mat raw_muscle = (huInput >= 10.f)   & (huInput <= 120.f);
-    Mat raw_bone   = (huInput >= 200.f);
-
-    // Convertir a 8-bit
-    raw_fat.convertTo(m.fat, CV_8U, 255);
-    raw_muscle.convertTo(m.muscle_tendon, CV_8U, 255);
-    raw_bone.convertTo(m.bones, CV_8U, 255);
+    // Rangos de HU estándar. inRange/compare escriben ya 0/255 en 8-bit,
+    // sin máscaras intermedias.
+    inRange(huInput, Scalar(t.fatMin),    Scalar(t.fatMax),    m.fat);
+    inRange(huInput, Scalar(t.muscleMin), Scalar(t.muscleMax), m.muscle_tendon);
+    compare(huInput, Scalar(t.boneMin),   m.bones, CMP_GE);
 
     // Mantenemos la limpieza morfológica (para unir regiones), 
     // pero si la entrada es muy ruidosa, esto no será suficiente para arreglarla.
@@ -32,52 +34,130 @@ AnatomyMasks generateAnatomicalMasksHU(const Mat& huInput) {
     morphologyEx(m.muscle_tendon, m.muscle_tendon, MORPH_CLOSE, kernelLg);
 
     morphologyEx(m.fat, m.fat, MORPH_OPEN, kernel);
+}
+} // namespace
+
+void generateAnatomicalMasksHU(const Mat& huInput, AnatomyMasks& m, const TissueThresholds& t) {
+    thresholdTissues(huInput, m, t);
 
     // Jerarquía
     m.muscle_tendon.setTo(0, m.bones);
     m.fat.setTo(0, m.muscle_tendon);
     m.fat.setTo(0, m.bones);
+}
 
-    return m;
+void generateAnatomicalLabelsHU(const Mat& huInput, RleLabelMap& out, const TissueThresholds& t,
+                                AnatomyMasks& scratch) {
+    thresholdTissues(huInput, scratch, t);
+
+    // Jerarquía como restas de tramos: hueso > músculo > grasa
+    const RleMask bone   = RleMask::fromMask(scratch.bones);
+    const RleMask muscle = RleMask::fromMask(scratch.muscle_tendon).subtract(bone);
+    const RleMask fat    = RleMask::fromMask(scratch.fat).subtract(muscle).subtract(bone);
+    out = RleLabelMap::fromMasks({ &fat, &muscle, &bone }, { 1, 2, 3 });
 }
 
 // ==========================================================
-// IMPLEMENTACIÓN DE colorizeAndOverlay (Se mantiene igual)
+// IMPLEMENTACIÓN DE colorizeAndOverlay (una sola pasada)
 // ==========================================================
 Mat colorizeAndOverlay(const Mat& slice8u, const AnatomyMasks& m) {
-    Mat base_bgr;
-    if (slice8u.channels() == 1) cvtColor(slice8u, base_bgr, COLOR_GRAY2BGR); 
-    else base_bgr = slice8u.clone();
-
-    // Hueso: CYAN BRILLANTE
-    const Scalar COLOR_BONE = Scalar(255, 255, 0); 
-    // Músculo: MAGENTA / ROSA
-    const Scalar COLOR_MUSCLE = Scalar(128, 0, 255); 
-    // Grasa: AMARILLO LIMA
-    const Scalar COLOR_FAT = Scalar(0, 255, 255); 
-
-    Mat colored_fat = Mat::zeros(base_bgr.size(), base_bgr.type());
-    colored_fat.setTo(COLOR_FAT, m.fat);
-
-    Mat colored_muscle = Mat::zeros(base_bgr.size(), base_bgr.type());
-    colored_muscle.setTo(COLOR_MUSCLE, m.muscle_tendon);
-
-    Mat colored_bone = Mat::zeros(base_bgr.size(), base_bgr.type());
-    colored_bone.setTo(COLOR_BONE, m.bones);
-
-    Mat final_overlay = base_bgr.clone();
-
-    // Transparencia
-    double alpha = 0.60; 
-    
-    if (countNonZero(m.fat) > 0)
-        addWeighted(final_overlay, 1.0, colored_fat, alpha, 0, final_overlay);
-        
-    if (countNonZero(m.muscle_tendon) > 0)
-        addWeighted(final_overlay, 1.0, colored_muscle, alpha, 0, final_overlay);
-        
-    if (countNonZero(m.bones) > 0)
-        addWeighted(final_overlay, 1.0, colored_bone, alpha, 0, final_overlay);
-
-    return final_overlay;
-}
\ No newline at end of file
+    Mat out;
+    colorizeAndOverlay(slice8u, m, out);
+    return out;
+}
+
+namespace {
+// LUT por capa y canal: lut[capa][canal][v] = sat(v + alpha*color),
+// capas en el orden de aplicación: grasa, músculo, hueso
+struct OverlayLut {
+    uchar v[3][3][256];
+
+    OverlayLut() {
+        // Hueso: CYAN BRILLANTE
+        const Scalar COLOR_BONE = Scalar(255, 255, 0); 
+        // Músculo: MAGENTA / ROSA
+        const Scalar COLOR_MUSCLE = Scalar(128, 0, 255); 
+        // Grasa: AMARILLO LIMA
+        const Scalar COLOR_FAT = Scalar(0, 255, 255); 
+
+        // Transparencia
+        const float alpha = 0.60f;
+
+        const Scalar colors[3] = { COLOR_FAT, COLOR_MUSCLE, COLOR_BONE };
+        for (int layer = 0; layer < 3; ++layer)
+            for (int ch = 0; ch < 3; ++ch)
+                for (int i = 0; i < 256; ++i)
+                    v[layer][ch][i] = saturate_cast<uchar>(i * 1.0f + static_cast<float>(colors[layer][ch]) * alpha);
+    }
+};
+
+const OverlayLut& overlayLut() {
+    static const OverlayLut lut;
+    return lut;
+}
+} // namespace
+
+// Una sola pasada: cada píxel con máscara recibe base + alpha*color, igual
+// que los addWeighted encadenados de antes pero sin capas de color completas.
+void colorizeAndOverlay(const Mat& slice8u, const AnatomyMasks& m, Mat& out) {
+    CV_Assert(slice8u.depth() == CV_8U && (slice8u.channels() == 1 || slice8u.channels() == 3));
+    const auto& lut = overlayLut().v;
+
+    // El orden de aplicación se mantiene: grasa, músculo, hueso
+    const Mat* masks[3] = { &m.fat, &m.muscle_tendon, &m.bones };
+
+    out.create(slice8u.size(), CV_8UC3);
+    const int cn = slice8u.channels();
+
+    parallel_for_(Range(0, slice8u.rows), [&](const Range& rows) {
+        for (int r = rows.start; r < rows.end; ++r) {
+            const uchar* src = slice8u.ptr<uchar>(r);
+            uchar* dst = out.ptr<uchar>(r);
+            const uchar* mk[3];
+            for (int layer = 0; layer < 3; ++layer)
+                mk[layer] = masks[layer]->empty() ? nullptr : masks[layer]->ptr<uchar>(r);
+
+            for (int c = 0; c < slice8u.cols; ++c) {
+                uchar b, g, rr;
+                if (cn == 1) { b = g = rr = src[c]; }
+                else         { b = src[3*c]; g = src[3*c + 1]; rr = src[3*c + 2]; }
+
+                for (int layer = 0; layer < 3; ++layer) {
+                    if (mk[layer] && mk[layer][c]) {
+                        b  = lut[layer][0][b];
+                        g  = lut[layer][1][g];
+                        rr = lut[layer][2][rr];
+                    }
+                }
+                dst[3*c] = b; dst[3*c + 1] = g; dst[3*c + 2] = rr;
+            }
+        }
+    });
+}
+
+// Versión sobre tramos: la base gris se expande a BGR y solo se recorren los
+// píxeles etiquetados (etiqueta 1..3 = grasa, músculo, hueso)
+void colorizeAndOverlay(const Mat& slice8u, const RleLabelMap& labels, Mat& out) {
+    CV_Assert(slice8u.depth() == CV_8U && (slice8u.channels() == 1 || slice8u.channels() == 3));
+    CV_Assert(labels.size() == slice8u.size());
+    const auto& lut = overlayLut().v;
+
+    if (slice8u.channels() == 1) cvtColor(slice8u, out, COLOR_GRAY2BGR);
+    else                         slice8u.copyTo(out);
+
+    parallel_for_(Range(0, out.rows), [&](const Range& rows) {
+        for (int r = rows.start; r < rows.end; ++r) {
+            uchar* dst = out.ptr<uchar>(r);
+            for (const LabelRun* run = labels.rowBegin(r); run != labels.rowEnd(r); ++run) {
+                if (run->label < 1 || run->label > 3) continue;
+                const auto& l = lut[run->label - 1];
+                uchar* p = dst + 3 * run->start;
+                for (int i = 0; i < run->length; ++i, p += 3) {
+                    p[0] = l[0][p[0]];
+                    p[1] = l[1][p[1]];
+                    p[2] = l[2][p[2]];
+                }
+            }
+        }
+    });
+}
@@ -3,6 +3,8 @@
 
 #include <opencv2/core/core.hpp> 
 
+#include "label_rle.hpp"
+
 // Estructura para contener las 3 máscaras de tejidos
 struct AnatomyMasks {
     cv::Mat fat;
@@ -10,9 +12,28 @@ struct AnatomyMasks {
     cv::Mat bones;
 };
 
+// Rangos HU de cada tejido (los estándar por defecto)
+struct TissueThresholds {
+    float fatMin    = -190.0f, fatMax    = -30.0f;
+    float muscleMin =   10.0f, muscleMax = 120.0f;
+    float boneMin   =  200.0f;
+};
+
 // Declaraciones de funciones (Firmas)
 cv::Mat huTo8u(const cv::Mat& hu32f, float window_center, float window_width);
 AnatomyMasks generateAnatomicalMasksHU(const cv::Mat& hu32f);
 cv::Mat colorizeAndOverlay(const cv::Mat& slice8u, const AnatomyMasks& m);
 
+// Variantes que escriben sobre buffers existentes (se reutilizan entre cortes)
+void generateAnatomicalMasksHU(const cv::Mat& hu32f, AnatomyMasks& out,
+                               const TissueThresholds& t = {});
+void colorizeAndOverlay(const cv::Mat& slice8u, const AnatomyMasks& m, cv::Mat& out);
+
+// Variantes compactas: mapa de etiquetas por tramos (1 grasa, 2 músculo, 3 hueso).
+// La jerarquía se aplica como resta de tramos; 'scratch' son las máscaras
+// 8-bit intermedias (umbral + morfología), reutilizables entre cortes.
+void generateAnatomicalLabelsHU(const cv::Mat& hu, RleLabelMap& out,
+                                const TissueThresholds& t, AnatomyMasks& scratch);
+void colorizeAndOverlay(const cv::Mat& slice8u, const RleLabelMap& labels, cv::Mat& out);
+
 #endif // HIGHLIGHT_HPP
\ No newline at end of file
@@ -1,12 +1,31 @@
 #include "itk_loader.hpp"
+#include "dicom_mmap.hpp"
+#include "dicom_catalog.hpp"
+#include <cmath>
+#include <memory>
+#include <mutex>
 #include <stdexcept>
+#include <opencv2/core/utility.hpp>
 #include <itkImageSeriesReader.h>
+#include <itkImageFileReader.h>
 #include <itkGDCMImageIO.h>
+#include <itkGDCMImageIOFactory.h>
 #include <itkGDCMSeriesFileNames.h>
 #include <itkExtractImageFilter.h>
 
-Volume loadDicomSeries(const std::string& dicomDir) {
-  auto imageIO = itk::GDCMImageIO::New();
+void registerDicomIo() {
+  static std::once_flag once;
+  std::call_once(once, [] {
+    itk::GDCMImageIOFactory::RegisterOneFactory();
+    itk::GDCMImageIO::New();   // diccionario DICOM de GDCM
+  });
+}
+
+std::vector<std::string> listDicomSeriesFiles(const std::string& dicomDir) {
+  // Serie ya indexada con --catalog: sin recorrer el directorio ni GDCM
+  if (auto files = catalogSeriesFiles(dicomDir); !files.empty()) return files;
+
+  registerDicomIo();
   auto nameGen = itk::GDCMSeriesFileNames::New();
   nameGen->SetUseSeriesDetails(true);
   nameGen->SetDirectory(dicomDir);
@@ -14,7 +33,101 @@ Volume loadDicomSeries(const std::string& dicomDir) {
   const auto& seriesUIDs = nameGen->GetSeriesUIDs();
   if (seriesUIDs.empty()) throw std::runtime_error("No se encontraron series DICOM en: " + dicomDir);
 
-  const auto files = nameGen->GetFileNames(seriesUIDs.front());
+  return nameGen->GetFileNames(seriesUIDs.front());
+}
+
+Volume loadDicomSeries(const std::string& dicomDir) {
+  return loadDicomSeries(listDicomSeriesFiles(dicomDir));
+}
+
+namespace {
+// Misma geometría de corte que 'ref': tamaño, PixelSpacing y orientación
+bool sameSliceGeometry(const MappedDicom& a, const MappedDicom& ref) {
+  constexpr double kTol = 1e-4;
+  if (a.rows() != ref.rows() || a.cols() != ref.cols()) return false;
+  if (a.hasOrientation() != ref.hasOrientation() || a.hasPosition() != ref.hasPosition()) return false;
+  for (int i = 0; i < 2; ++i)
+    if (std::abs(a.pixelSpacing()[i] - ref.pixelSpacing()[i]) > kTol) return false;
+  for (int i = 0; i < 6; ++i)
+    if (std::abs(a.orientation()[i] - ref.orientation()[i]) > kTol) return false;
+  return true;
+}
+
+// Serie sin comprimir: cada corte se pasa a HU directamente sobre el buffer
+// del volumen desde el archivo mapeado (una copia, en vez de la lectura de
+// GDCM a su buffer + la copia de ImageSeriesReader). nullptr → usar GDCM
+// (también si los cortes no comparten tamaño, espaciado u orientación).
+ImageType3D::Pointer loadMappedSeries(const std::vector<std::string>& files) {
+  std::vector<std::shared_ptr<MappedDicom>> slices;
+  for (const auto& f : files) {
+    auto m = MappedDicom::open(f);
+    if (!m) return nullptr;
+    if (!slices.empty() && !sameSliceGeometry(*m, *slices[0])) return nullptr;
+    slices.push_back(std::move(m));
+  }
+  const MappedDicom& first = *slices.front();
+  const MappedDicom& last  = *slices.back();
+  const int rows = first.rows(), cols = first.cols();
+  const size_t n = slices.size();
+
+  // Geometría igual que GDCMImageIO + ImageSeriesReader: x = columnas,
+  // normal = fila × columna, Z = distancia media entre cortes sobre la normal
+  const double* o = first.orientation();
+  const double normal[3] = { o[1] * o[5] - o[2] * o[4],
+                             o[2] * o[3] - o[0] * o[5],
+                             o[0] * o[4] - o[1] * o[3] };
+  double dz = 1.0;
+  if (n > 1 && first.hasPosition() && last.hasPosition()) {
+    double d = 0.0;
+    for (int i = 0; i < 3; ++i) d += (last.position()[i] - first.position()[i]) * normal[i];
+    if (std::abs(d) > 1e-6) dz = std::abs(d) / static_cast<double>(n - 1);
+  }
+
+  auto image = ImageType3D::New();
+  ImageType3D::SizeType size;
+  size[0] = cols;
+  size[1] = rows;
+  size[2] = n;
+  ImageType3D::RegionType region;
+  region.SetSize(size);
+  image->SetRegions(region);
+
+  ImageType3D::SpacingType spacing;
+  spacing[0] = first.pixelSpacing()[1];
+  spacing[1] = first.pixelSpacing()[0];
+  spacing[2] = dz;
+  image->SetSpacing(spacing);
+
+  ImageType3D::PointType origin;
+  ImageType3D::DirectionType direction;
+  for (int i = 0; i < 3; ++i) {
+    origin[i] = first.position()[i];
+    direction[i][0] = o[i];
+    direction[i][1] = o[3 + i];
+    direction[i][2] = normal[i];
+  }
+  image->SetOrigin(origin);
+  image->SetDirection(direction);
+  image->Allocate();
+
+  PixelType* buf = image->GetBufferPointer();
+  const size_t plane = static_cast<size_t>(rows) * cols;
+  cv::parallel_for_(cv::Range(0, static_cast<int>(n)), [&](const cv::Range& r) {
+    for (int z = r.start; z < r.end; ++z) {
+      cv::Mat dst(rows, cols, CV_16S, buf + z * plane);   // vista del volumen: readHU escribe aquí
+      slices[z]->readHU(dst);
+    }
+  });
+  return image;
+}
+} // namespace
+
+Volume loadDicomSeries(const std::vector<std::string>& files) {
+  if (files.empty()) throw std::runtime_error("Serie DICOM sin archivos");
+  if (auto image = loadMappedSeries(files)) return { image, files };
+
+  registerDicomIo();
+  auto imageIO = itk::GDCMImageIO::New();
   using ReaderType = itk::ImageSeriesReader<ImageType3D>;
   auto reader = ReaderType::New();
   reader->SetImageIO(imageIO);
@@ -24,6 +137,11 @@ Volume loadDicomSeries(const std::string& dicomDir) {
   return { reader->GetOutput(), files };
 }
 
+size_t volumeBytes(const Volume& vol) {
+  if (vol.image.IsNull()) return 0;
+  return vol.image->GetBufferedRegion().GetNumberOfPixels() * sizeof(PixelType);
+}
+
 ImageType2D::Pointer extractSlice(const ImageType3D::Pointer& vol, unsigned int z) {
   const auto region = vol->GetLargestPossibleRegion();
   const auto size   = region.GetSize();
@@ -39,4 +157,14 @@ ImageType2D::Pointer extractSlice(const ImageType3D::Pointer& vol, unsigned int
   extract->SetInput(vol);
   extract->Update();
   return extract->GetOutput();
-}
\ No newline at end of file
+}
+
+ImageType2D::Pointer loadDicomSlice(const std::string& file) {
+  registerDicomIo();
+  using ReaderType = itk::ImageFileReader<ImageType2D>;
+  auto reader = ReaderType::New();
+  reader->SetImageIO(itk::GDCMImageIO::New());
+  reader->SetFileName(file);
+  reader->Update();
+  return reader->GetOutput();
+}
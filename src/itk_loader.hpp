@@ -13,5 +13,23 @@ struct Volume {
   std::vector<std::string> files;
 };
 
+// Los ejecutables no registran las fábricas de E/S de ITK al arrancar
+// (ITK_NO_IO_FACTORY_REGISTER_MANAGER): solo GDCM, la primera vez que se lee
+// algo. Las funciones de este archivo ya lo llaman; se puede adelantar en
+// segundo plano para que la primera lectura no lo pague.
+void registerDicomIo();
+
 Volume loadDicomSeries(const std::string& dicomDir);
-ImageType2D::Pointer extractSlice(const ImageType3D::Pointer& vol, unsigned int indexZ);
\ No newline at end of file
+// Serie a partir de su lista de archivos ya ordenada (p.ej. del catálogo):
+// sin recorrer el directorio ni descubrir series con GDCM
+Volume loadDicomSeries(const std::vector<std::string>& files);
+ImageType2D::Pointer extractSlice(const ImageType3D::Pointer& vol, unsigned int indexZ);
+// Bytes de los píxeles del volumen (0 si está vacío): lo que se apunta al gobernador de memoria
+size_t volumeBytes(const Volume& vol);
+
+// Archivos de la primera serie del directorio, ordenados por posición: del
+// catálogo si la serie está indexada y sin cambios (catalogSeriesFiles), si no GDCM
+std::vector<std::string> listDicomSeriesFiles(const std::string& dicomDir);
+
+// Lee un único corte DICOM sin cargar el resto de la serie
+ImageType2D::Pointer loadDicomSlice(const std::string& file);
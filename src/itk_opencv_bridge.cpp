@@ -1,6 +1,9 @@
 #include "itk_opencv_bridge.hpp"
 #include <itkImageRegionConstIterator.h>
+#include <opencv2/core/utility.hpp>
 #include <algorithm>
+#include <array>
+#include <cstring>
 
 using namespace cv;
 
@@ -28,18 +31,66 @@ cv::Mat itk2cv32fHU(ImageType2D::Pointer slice, double* outMinHU, double* outMax
   return hu;
 }
 
-// Windowing HU -> 8U
-cv::Mat huTo8u(const cv::Mat& hu32f, float center, float width) {
-  CV_Assert(hu32f.type() == CV_32F);
-  const float low  = center - width * 0.5f;
-  const float high = center + width * 0.5f;
+// Helper: buffer ITK (short) → CV_16S con un único memcpy
+cv::Mat itk2cv16sHU(ImageType2D::Pointer slice, double* outMinHU, double* outMaxHU) {
+  const auto size = slice->GetBufferedRegion().GetSize(); // [x,y], x contiguo
+
+  Mat hu(static_cast<int>(size[1]), static_cast<int>(size[0]), CV_16S);
+  std::memcpy(hu.data, slice->GetBufferPointer(), hu.total() * hu.elemSize());
 
+  if (outMinHU || outMaxHU) {
+    double mn = 0.0, mx = 0.0;
+    minMaxLoc(hu, &mn, &mx);
+    if (outMinHU) *outMinHU = mn;
+    if (outMaxHU) *outMaxHU = mx;
+  }
+  return hu;
+}
+
+// Windowing HU -> 8U
+cv::Mat huTo8u(const cv::Mat& hu, float center, float width) {
   Mat out;
-  // (hu - low) / (high-low) * 255
-  hu32f.convertTo(out, CV_32F, 255.0f / std::max(1e-6f, (high - low)), -low * 255.0f / std::max(1e-6f, (high - low)));
-  // saturar a [0,255] y pasar a 8U
-  cv::min(out, 255, out);
-  cv::max(out, 0, out);
-  out.convertTo(out, CV_8U);
+  huTo8u(hu, center, width, out);
   return out;
-}
\ No newline at end of file
+}
+
+namespace {
+// LUT int16 → uint8 para una ventana; se recalcula solo si cambia la ventana
+struct WindowLut {
+  float center = 0.0f, width = -1.0f;
+  std::array<uchar, 65536> table;
+};
+}
+
+void huTo8u(const cv::Mat& hu, float center, float width, cv::Mat& out) {
+  CV_Assert(hu.type() == CV_32F || hu.type() == CV_16S);
+  const float low   = center - width * 0.5f;
+  const float high  = center + width * 0.5f;
+  const float scale = 255.0f / std::max(1e-6f, (high - low));
+  const float shift = -low * 255.0f / std::max(1e-6f, (high - low));
+
+  if (hu.type() == CV_32F) {
+    // (hu - low) / (high-low) * 255, saturado a [0,255] por convertTo en una pasada
+    hu.convertTo(out, CV_8U, scale, shift);
+    return;
+  }
+
+  // CV_16S: misma fórmula (float + saturate_cast) tabulada para los 65536 valores
+  thread_local WindowLut lut;
+  if (lut.center != center || lut.width != width) {
+    for (int v = -32768; v <= 32767; ++v)
+      lut.table[static_cast<uint16_t>(v)] = saturate_cast<uchar>(v * scale + shift);
+    lut.center = center;
+    lut.width  = width;
+  }
+
+  out.create(hu.size(), CV_8U);
+  const uchar* table = lut.table.data();
+  parallel_for_(Range(0, hu.rows), [&](const Range& rows) {
+    for (int r = rows.start; r < rows.end; ++r) {
+      const short* src = hu.ptr<short>(r);
+      uchar* dst = out.ptr<uchar>(r);
+      for (int c = 0; c < hu.cols; ++c) dst[c] = table[static_cast<uint16_t>(src[c])];
+    }
+  });
+}
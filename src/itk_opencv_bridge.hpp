@@ -8,5 +8,13 @@ cv::Mat itk2cv32fHU(ImageType2D::Pointer slice,
                     double* outMinHU = nullptr,
                     double* outMaxHU = nullptr);
 
-// Ventaneo HU → 8-bit para visualización (center/width estilo DICOM)
-cv::Mat huTo8u(const cv::Mat& hu32f, float center, float width);
\ No newline at end of file
+// Camino nativo: el buffer ITK (signed short) tal cual en CV_16S, con una
+// sola copia de memoria. Mitad de memoria y ancho de banda que CV_32F.
+cv::Mat itk2cv16sHU(ImageType2D::Pointer slice,
+                    double* outMinHU = nullptr,
+                    double* outMaxHU = nullptr);
+
+// Ventaneo HU → 8-bit para visualización (center/width estilo DICOM).
+// Acepta CV_32F o CV_16S (este último por LUT de 64K entradas, mismo redondeo).
+cv::Mat huTo8u(const cv::Mat& hu, float center, float width);
+void    huTo8u(const cv::Mat& hu, float center, float width, cv::Mat& out);
@@ -0,0 +1,309 @@
+#include "label_rle.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+#include <opencv2/core/utility.hpp>
+
+using namespace cv;
+
+namespace {
+
+// Tramos no nulos de una fila (salta de 8 en 8 bytes sobre el fondo)
+template <class Emit>
+void scanRow(const uint8_t* p, int cols, Emit emit) {
+    int c = 0;
+    while (c < cols) {
+        while (c + 8 <= cols) {
+            uint64_t w;
+            std::memcpy(&w, p + c, 8);
+            if (w) break;
+            c += 8;
+        }
+        while (c < cols && p[c] == 0) ++c;
+        if (c >= cols) break;
+        const int start = c;
+        const uint8_t v = p[c];
+        while (c < cols && p[c] == v) ++c;
+        emit(start, c, v);
+    }
+}
+
+// Barrido de dos listas de tramos: el resultado está dentro donde op(inA, inB)
+template <class Op>
+void combineRow(const RleSpan* a, const RleSpan* ae, const RleSpan* b, const RleSpan* be,
+                Op op, std::vector<RleSpan>& out) {
+    constexpr uint32_t kEnd = std::numeric_limits<uint32_t>::max();
+    bool inA = false, inB = false, prev = false;
+    uint32_t startPos = 0;
+    while (true) {
+        const uint32_t na = a == ae ? kEnd : (inA ? a->end : a->start);
+        const uint32_t nb = b == be ? kEnd : (inB ? b->end : b->start);
+        const uint32_t x = std::min(na, nb);
+        if (x == kEnd) break;
+        if (na == x) { if (inA) { inA = false; ++a; } else inA = true; }
+        if (nb == x) { if (inB) { inB = false; ++b; } else inB = true; }
+
+        const bool cur = op(inA, inB);
+        if (cur && !prev) startPos = x;
+        else if (!cur && prev && x > startPos)
+            out.push_back({ static_cast<uint16_t>(startPos), static_cast<uint16_t>(x) });
+        prev = cur;
+    }
+}
+
+void put16(std::vector<uint8_t>& out, uint16_t v) { out.push_back(v & 0xff); out.push_back(v >> 8); }
+void put32(std::vector<uint8_t>& out, uint32_t v) { for (int i = 0; i < 4; ++i) out.push_back((v >> (8 * i)) & 0xff); }
+uint16_t get16(const uint8_t* p) { return static_cast<uint16_t>(p[0] | (p[1] << 8)); }
+uint32_t get32(const uint8_t* p) { return p[0] | (p[1] << 8) | (p[2] << 16) | (uint32_t(p[3]) << 24); }
+
+} // namespace
+
+// ==========================================================
+// RleMask
+// ==========================================================
+RleMask::RleMask(Size size) : size_(size), rowPtr_(size.height + 1, 0) {}
+
+RleMask RleMask::fromMask(const Mat& mask8u) {
+    CV_Assert(mask8u.type() == CV_8U && mask8u.cols <= std::numeric_limits<uint16_t>::max());
+    RleMask m(mask8u.size());
+    for (int r = 0; r < mask8u.rows; ++r) {
+        scanRow(mask8u.ptr<uint8_t>(r), mask8u.cols, [&](int s, int e, uint8_t) {
+            // Valores distintos no nulos seguidos forman un solo tramo
+            if (!m.spans_.empty() && m.spans_.size() > m.rowPtr_[r] && m.spans_.back().end == s)
+                m.spans_.back().end = static_cast<uint16_t>(e);
+            else
+                m.spans_.push_back({ static_cast<uint16_t>(s), static_cast<uint16_t>(e) });
+        });
+        m.rowPtr_[r + 1] = static_cast<uint32_t>(m.spans_.size());
+    }
+    return m;
+}
+
+uint64_t RleMask::count() const {
+    uint64_t n = 0;
+    for (const auto& s : spans_) n += s.end - s.start;
+    return n;
+}
+
+template <class Op>
+RleMask RleMask::combine(const RleMask& o, Op op) const {
+    CV_Assert(size_ == o.size_);
+    RleMask out(size_);
+    for (int r = 0; r < size_.height; ++r) {
+        combineRow(rowBegin(r), rowEnd(r), o.rowBegin(r), o.rowEnd(r), op, out.spans_);
+        out.rowPtr_[r + 1] = static_cast<uint32_t>(out.spans_.size());
+    }
+    return out;
+}
+
+RleMask RleMask::subtract(const RleMask& o) const {
+    return combine(o, [](bool a, bool b) { return a && !b; });
+}
+
+RleMask RleMask::unite(const RleMask& o) const {
+    return combine(o, [](bool a, bool b) { return a || b; });
+}
+
+RleMask RleMask::intersect(const RleMask& o) const {
+    return combine(o, [](bool a, bool b) { return a && b; });
+}
+
+void RleMask::rasterize(Mat& mask8u, uint8_t value) const {
+    mask8u.create(size_, CV_8U);
+    parallel_for_(Range(0, size_.height), [&](const Range& rows) {
+        for (int r = rows.start; r < rows.end; ++r) {
+            uint8_t* dst = mask8u.ptr<uint8_t>(r);
+            std::memset(dst, 0, size_.width);
+            for (const RleSpan* s = rowBegin(r); s != rowEnd(r); ++s)
+                std::memset(dst + s->start, value, s->end - s->start);
+        }
+    });
+}
+
+// ==========================================================
+// RleLabelMap
+// ==========================================================
+RleLabelMap::RleLabelMap(Size size) : size_(size), rowPtr_(size.height + 1, 0) {}
+
+RleLabelMap RleLabelMap::fromLabels(const Mat& labels8u) {
+    CV_Assert(labels8u.type() == CV_8U && labels8u.cols <= std::numeric_limits<uint16_t>::max());
+    RleLabelMap m(labels8u.size());
+    for (int r = 0; r < labels8u.rows; ++r) {
+        scanRow(labels8u.ptr<uint8_t>(r), labels8u.cols, [&](int s, int e, uint8_t v) {
+            m.runs_.push_back({ static_cast<uint16_t>(s), static_cast<uint16_t>(e - s), v });
+        });
+        m.rowPtr_[r + 1] = static_cast<uint32_t>(m.runs_.size());
+    }
+    return m;
+}
+
+RleLabelMap RleLabelMap::fromMasks(const std::vector<const RleMask*>& layers,
+                                   const std::vector<uint8_t>& labels) {
+    CV_Assert(!layers.empty() && layers.size() == labels.size());
+    const Size size = layers.front()->size();
+    RleLabelMap m(size);
+
+    std::vector<LabelRun> row;
+    for (int r = 0; r < size.height; ++r) {
+        row.clear();
+        for (size_t i = 0; i < layers.size(); ++i) {
+            CV_Assert(layers[i]->size() == size);
+            for (const RleSpan* s = layers[i]->rowBegin(r); s != layers[i]->rowEnd(r); ++s)
+                row.push_back({ s->start, static_cast<uint16_t>(s->end - s->start), labels[i] });
+        }
+        // Capas disjuntas: basta con ordenar por inicio
+        std::sort(row.begin(), row.end(), [](const LabelRun& a, const LabelRun& b) { return a.start < b.start; });
+        m.runs_.insert(m.runs_.end(), row.begin(), row.end());
+        m.rowPtr_[r + 1] = static_cast<uint32_t>(m.runs_.size());
+    }
+    return m;
+}
+
+std::vector<uint64_t> RleLabelMap::counts(int numLabels) const {
+    std::vector<uint64_t> n(numLabels, 0);
+    for (const auto& run : runs_)
+        if (run.label < numLabels) n[run.label] += run.length;
+    if (numLabels > 0) {
+        uint64_t labelled = 0;
+        for (int l = 1; l < numLabels; ++l) labelled += n[l];
+        n[0] = static_cast<uint64_t>(size_.area()) - labelled;
+    }
+    return n;
+}
+
+uint64_t RleLabelMap::count(uint8_t label) const {
+    uint64_t n = 0;
+    for (const auto& run : runs_)
+        if (run.label == label) n += run.length;
+    return n;
+}
+
+std::vector<uint64_t> RleLabelMap::overlap(const RleLabelMap& other, int numLabels) const {
+    CV_Assert(other.size_ == size_);
+    std::vector<uint64_t> n(numLabels, 0);
+    for (int r = 0; r < size_.height; ++r) {
+        const LabelRun* a = rowBegin(r);
+        const LabelRun* b = other.rowBegin(r);
+        while (a != rowEnd(r) && b != other.rowEnd(r)) {
+            const int aEnd = a->start + a->length;
+            const int bEnd = b->start + b->length;
+            if (a->label == b->label && a->label < numLabels) {
+                const int len = std::min(aEnd, bEnd) - std::max<int>(a->start, b->start);
+                if (len > 0) n[a->label] += len;
+            }
+            if (aEnd < bEnd) ++a;
+            else             ++b;
+        }
+    }
+    return n;
+}
+
+void RleLabelMap::rasterize(Mat& labels8u) const {
+    labels8u.create(size_, CV_8U);
+    parallel_for_(Range(0, size_.height), [&](const Range& rows) {
+        for (int r = rows.start; r < rows.end; ++r) {
+            uint8_t* dst = labels8u.ptr<uint8_t>(r);
+            std::memset(dst, 0, size_.width);
+            for (const LabelRun* run = rowBegin(r); run != rowEnd(r); ++run)
+                std::memset(dst + run->start, run->label, run->length);
+        }
+    });
+}
+
+void RleLabelMap::rasterize(uint8_t label, Mat& mask8u) const {
+    mask8u.create(size_, CV_8U);
+    parallel_for_(Range(0, size_.height), [&](const Range& rows) {
+        for (int r = rows.start; r < rows.end; ++r) {
+            uint8_t* dst = mask8u.ptr<uint8_t>(r);
+            std::memset(dst, 0, size_.width);
+            for (const LabelRun* run = rowBegin(r); run != rowEnd(r); ++run)
+                if (run->label == label) std::memset(dst + run->start, 255, run->length);
+        }
+    });
+}
+
+RleLabelMap RleLabelMap::crop(const Rect& roi0) const {
+    const Rect roi = roi0 & Rect(0, 0, size_.width, size_.height);
+    RleLabelMap m(roi.size());
+    const int x0 = roi.x, x1 = roi.x + roi.width;
+    for (int r = 0; r < roi.height; ++r) {
+        for (const LabelRun* run = rowBegin(roi.y + r); run != rowEnd(roi.y + r); ++run) {
+            const int s = std::max<int>(run->start, x0);
+            const int e = std::min<int>(run->start + run->length, x1);
+            if (s < e) m.runs_.push_back({ static_cast<uint16_t>(s - x0), static_cast<uint16_t>(e - s), run->label });
+        }
+        m.rowPtr_[r + 1] = static_cast<uint32_t>(m.runs_.size());
+    }
+    return m;
+}
+
+RleLabelMap RleLabelMap::embedded(Size full, Point tl) const {
+    RleLabelMap m(full);
+    for (int r = 0; r < full.height; ++r) {
+        const int src = r - tl.y;
+        if (src >= 0 && src < size_.height) {
+            for (const LabelRun* run = rowBegin(src); run != rowEnd(src); ++run) {
+                const int s = std::max(0, run->start + tl.x);
+                const int e = std::min(full.width, run->start + run->length + tl.x);
+                if (s < e) m.runs_.push_back({ static_cast<uint16_t>(s), static_cast<uint16_t>(e - s), run->label });
+            }
+        }
+        m.rowPtr_[r + 1] = static_cast<uint32_t>(m.runs_.size());
+    }
+    return m;
+}
+
+RleLabelMap RleLabelMap::keepRuns(const uint8_t* keep) const {
+    RleLabelMap m(size_);
+    m.runs_.reserve(runs_.size());
+    for (int r = 0; r < size_.height; ++r) {
+        for (uint32_t i = rowPtr_[r]; i < rowPtr_[r + 1]; ++i)
+            if (keep[i]) m.runs_.push_back(runs_[i]);
+        m.rowPtr_[r + 1] = static_cast<uint32_t>(m.runs_.size());
+    }
+    return m;
+}
+
+size_t RleLabelMap::bytes() const {
+    return rowPtr_.size() * sizeof(uint32_t) + runs_.size() * sizeof(LabelRun);
+}
+
+// u32 rows | u32 cols | u32 nRuns | u16 tramos por fila × rows | (u16 start, u16 length, u8 label) × nRuns
+void RleLabelMap::serialize(std::vector<uint8_t>& out) const {
+    out.clear();
+    out.reserve(12 + size_.height * 2 + runs_.size() * 5);
+    put32(out, static_cast<uint32_t>(size_.height));
+    put32(out, static_cast<uint32_t>(size_.width));
+    put32(out, static_cast<uint32_t>(runs_.size()));
+    for (int r = 0; r < size_.height; ++r) put16(out, static_cast<uint16_t>(rowPtr_[r + 1] - rowPtr_[r]));
+    for (const auto& run : runs_) {
+        put16(out, run.start);
+        put16(out, run.length);
+        out.push_back(run.label);
+    }
+}
+
+bool RleLabelMap::deserialize(const uint8_t* data, size_t size, RleLabelMap& out) {
+    if (size < 12) return false;
+    const uint32_t rows = get32(data), cols = get32(data + 4), nRuns = get32(data + 8);
+    if (rows > 65535 || cols > 65535) return false;
+    if (size != 12 + size_t(rows) * 2 + size_t(nRuns) * 5) return false;
+
+    RleLabelMap m(Size(static_cast<int>(cols), static_cast<int>(rows)));
+    const uint8_t* p = data + 12;
+    for (uint32_t r = 0; r < rows; ++r, p += 2) m.rowPtr_[r + 1] = m.rowPtr_[r] + get16(p);
+    if (m.rowPtr_[rows] != nRuns) return false;
+
+    m.runs_.resize(nRuns);
+    for (uint32_t i = 0; i < nRuns; ++i, p += 5) {
+        LabelRun& run = m.runs_[i];
+        run.start  = get16(p);
+        run.length = get16(p + 2);
+        run.label  = p[4];
+        if (run.start + run.length > cols) return false;
+    }
+    out = std::move(m);
+    return true;
+}
@@ -0,0 +1,106 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <opencv2/core.hpp>
+
+// ==========================================================
+// Máscaras y mapas de etiquetas comprimidos por filas (RLE)
+// ==========================================================
+// Un corte de 512x512 con tres máscaras CV_8U ocupa 768 KB para lo que son
+// 2 bits de información por píxel. Por filas, los tejidos forman pocos tramos
+// largos: guardando solo los tramos no nulos el mapa baja a unos KB, y las
+// operaciones (restas de la jerarquía, conteos, pintado) recorren tramos en
+// vez de píxeles.
+
+// Tramo [start, end) de una fila
+struct RleSpan {
+    uint16_t start = 0;
+    uint16_t end   = 0;
+};
+
+// Máscara binaria: tramos por fila, ordenados y disjuntos
+class RleMask {
+public:
+    RleMask() = default;
+    explicit RleMask(cv::Size size);   // vacía
+
+    static RleMask fromMask(const cv::Mat& mask8u);   // píxel != 0 → dentro
+
+    cv::Size size() const { return size_; }
+    bool     empty() const { return spans_.empty(); }
+    uint64_t count() const;
+
+    // Tramos de la fila r: [rowBegin(r), rowEnd(r))
+    const RleSpan* rowBegin(int r) const { return spans_.data() + rowPtr_[r]; }
+    const RleSpan* rowEnd(int r)   const { return spans_.data() + rowPtr_[r + 1]; }
+
+    // Operaciones de conjuntos (mismo tamaño), fila a fila sobre tramos
+    RleMask subtract(const RleMask& o) const;    // this \ o
+    RleMask unite(const RleMask& o) const;       // this ∪ o
+    RleMask intersect(const RleMask& o) const;   // this ∩ o
+
+    void rasterize(cv::Mat& mask8u, uint8_t value = 255) const;
+
+private:
+    template <class Op> RleMask combine(const RleMask& o, Op op) const;
+
+    cv::Size size_;
+    std::vector<uint32_t> rowPtr_;   // rows + 1
+    std::vector<RleSpan>  spans_;
+};
+
+// Tramo etiquetado [start, start + length) de una fila
+struct LabelRun {
+    uint16_t start  = 0;
+    uint16_t length = 0;
+    uint8_t  label  = 0;
+};
+
+// Mapa de etiquetas (0 = fondo, no se guarda)
+class RleLabelMap {
+public:
+    RleLabelMap() = default;
+    explicit RleLabelMap(cv::Size size);   // todo fondo
+
+    static RleLabelMap fromLabels(const cv::Mat& labels8u);
+    // Capas disjuntas → etiquetas: layers[i] se etiqueta como labels[i]
+    static RleLabelMap fromMasks(const std::vector<const RleMask*>& layers,
+                                 const std::vector<uint8_t>& labels);
+
+    cv::Size size() const { return size_; }
+    bool     empty() const { return size_.area() == 0; }
+
+    const LabelRun* rowBegin(int r) const { return runs_.data() + rowPtr_[r]; }
+    const LabelRun* rowEnd(int r)   const { return runs_.data() + rowPtr_[r + 1]; }
+    size_t          numRuns() const { return runs_.size(); }
+    // Índice de un tramo (orden de filas), p.ej. para tablas paralelas por tramo
+    size_t          runIndex(const LabelRun* run) const { return static_cast<size_t>(run - runs_.data()); }
+
+    // Copia con solo los tramos i tales que keep[i] != 0 (numRuns() entradas)
+    RleLabelMap keepRuns(const uint8_t* keep) const;
+
+    // Píxeles por etiqueta (índice = etiqueta), sin rasterizar
+    std::vector<uint64_t> counts(int numLabels) const;
+    uint64_t count(uint8_t label) const;
+    // Píxeles con la misma etiqueta en los dos mapas (índice = etiqueta, sin el fondo)
+    std::vector<uint64_t> overlap(const RleLabelMap& other, int numLabels) const;
+
+    void rasterize(cv::Mat& labels8u) const;                       // etiquetas tal cual
+    void rasterize(uint8_t label, cv::Mat& mask8u) const;          // 0/255 de una etiqueta
+
+    // Submapa de 'roi' y el mismo mapa colocado en 'tl' dentro de 'full'
+    RleLabelMap crop(const cv::Rect& roi) const;
+    RleLabelMap embedded(cv::Size full, cv::Point tl) const;
+
+    // Memoria ocupada (para comparar con las máscaras CV_8U)
+    size_t bytes() const;
+
+    // Serialización compacta: u32 rows, cols, nRuns | u16 tramos por fila | tramos (5 bytes)
+    void serialize(std::vector<uint8_t>& out) const;
+    static bool deserialize(const uint8_t* data, size_t size, RleLabelMap& out);
+
+private:
+    cv::Size size_;
+    std::vector<uint32_t> rowPtr_;   // rows + 1
+    std::vector<LabelRun> runs_;
+};
@@ -2,14 +2,38 @@
 #include "itk_opencv_bridge.hpp"
 #include "highlight.hpp"
 #include "dnn_denoising.hpp" 
+#include "series_report.hpp"
+#include "pipeline.hpp"
+#include "frame_arena.hpp"
+#include "model_registry.hpp"
+#include "dnn_precision.hpp"
+#include "dicom_catalog.hpp"
+#include "evidence_store.hpp"
+#include "dicom_mmap.hpp"
+#include "slice_server.hpp"
+#include "batch_scheduler.hpp"
+#include "connected_components.hpp"
+#include "denoise_quality.hpp"
+#include "startup_profile.hpp"
+#include "projection.hpp"
+#include "synthetic_volume.hpp"
+#include "memory_governor.hpp"
+#include "regression.hpp"
+#include "metrics.hpp"
 
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
 #include <filesystem>
+#include <future>
 #include <iostream>
 #include <vector>
+#include <sstream>
 #include <algorithm>
 #include <cstdio>
 #include <memory>
 #include <array>
+#include <map>
 #include <opencv2/opencv.hpp>
 #include <opencv2/dnn.hpp>
 #include <opencv2/imgproc.hpp>
@@ -47,7 +71,7 @@ string abrirSelectorDeArchivo() {
 // ======================================================================================
 // 2. PROCESAMIENTO: 13 EVIDENCIAS (CORREGIDO)
 // ======================================================================================
-void procesarArchivoSeleccionado(const string& filePath) {
+void procesarArchivoSeleccionado(const string& filePath, const DnnConfig& dnnCfg) {
     fs::path p(filePath);
     string dicomDir = p.parent_path().string();
     string selectedFileName = p.filename().string();
@@ -57,8 +81,12 @@ void procesarArchivoSeleccionado(const string& filePath) {
     DnnDenoiser* denoiserPtr = nullptr;
     try {
         try {
-            denoiserPtr = new DnnDenoiser("../models/dncnn_compatible.onnx"); 
-            cout << "[INIT] DNN Cargado.\n";
+            if (!dnnCfg.modelPath.empty()) {
+                denoiserPtr = createDnnDenoiser(dnnCfg, dicomDir).release();
+                cout << "[INIT] DNN Cargado (" << describeDnnConfig(dnnCfg) << ").\n";
+            } else {
+                cout << "[AVISO] DNN no disponible.\n";
+            }
         } catch (...) { cout << "[AVISO] DNN no disponible.\n"; }
         
         // --- CARGA ITK ---
@@ -67,6 +95,8 @@ void procesarArchivoSeleccionado(const string& filePath) {
             if (system("zenity --error --text=\"Error al leer DICOM.\"")) {}
             return;
         }
+        MemoryReservation volMemory("serie abierta (CLI)");
+        volMemory.resize(volumeBytes(vol));
 
         vector<string> filesInDir;
         for (const auto & entry : fs::directory_iterator(dicomDir)) {
@@ -83,83 +113,30 @@ void procesarArchivoSeleccionado(const string& filePath) {
 
         auto slice = extractSlice(vol.image, targetIndex);
         double huMin = 0.0, huMax = 0.0;
-        Mat hu32f_raw = itk2cv32fHU(slice, &huMin, &huMax); 
+        Mat hu16s_raw = itk2cv16sHU(slice, &huMin, &huMax);   // HU nativos (short)
         
         // =========================================================
-        // GRUPO A: LIMPIEZA DE IMAGEN (4 IMÁGENES)
+        // 13 EVIDENCIAS (pipeline compartido con la app Qt)
         // =========================================================
-        
-        // 1. ORIGINAL
-        Mat img_1_original = huTo8u(hu32f_raw, 40.0f, 400.0f);
-
-        // 2. SUAVIZADA CON GAUSS (Clásica)
-        Mat img_2_gauss;
-        GaussianBlur(img_1_original, img_2_gauss, Size(5, 5), 1.0);
-
-        // 3. SUAVIZADA CON NLMEANS (Avanzada Matemática)
-        Mat img_3_nlmeans;
-        cout << "[PROCESO] Calculando NLMeans...\n";
-        fastNlMeansDenoising(img_1_original, img_3_nlmeans, 10, 7, 21);
-
-        // 4. SUAVIZADA CON DNCNN (Deep Learning)
-        Mat img_4_dncnn;
-        if (denoiserPtr) {
-            cout << "[PROCESO] Ejecutando DnCNN...\n";
-            img_4_dncnn = denoiserPtr->denoise(img_1_original);
-        } else {
-            img_4_dncnn = img_1_original.clone();
-        }
-
-        // =========================================================
-        // GRUPO B: TÉCNICAS INTERMEDIAS (5 IMÁGENES)
-        // =========================================================
-        Mat k = getStructuringElement(MORPH_RECT, Size(3, 3));
-        
-        // 5. BORDES
-        Mat img_5_bordes;
-        Canny(img_2_gauss, img_5_bordes, 50, 150);
-
-        // 6. TOPHAT
-        Mat img_6_tophat;
-        morphologyEx(img_1_original, img_6_tophat, MORPH_TOPHAT, k);
-
-        // 7. BLACKHAT
-        Mat img_7_blackhat;
-        morphologyEx(img_1_original, img_7_blackhat, MORPH_BLACKHAT, k);
-
-        // 8. EROSIÓN
-        Mat img_8_erosion;
-        erode(img_1_original, img_8_erosion, k);
-
-        // 9. DILATACIÓN
-        Mat img_9_dilatacion;
-        dilate(img_1_original, img_9_dilatacion, k);
-
-
-        // =========================================================
-        // GRUPO C: SEGMENTACIÓN FINAL (4 IMÁGENES)
-        // =========================================================
-        
-        // 10. SEGMENTACIÓN EN ORIGINAL
-        AnatomyMasks masks_raw = generateAnatomicalMasksHU(hu32f_raw);
-        Mat img_10_seg_original = colorizeAndOverlay(img_1_original, masks_raw);
-
-        // 11. SEGMENTACIÓN EN SUAVIZADA CON GAUSS
-        Mat hu_gauss; 
-        GaussianBlur(hu32f_raw, hu_gauss, Size(3, 3), 1.0);
-        AnatomyMasks masks_gauss = generateAnatomicalMasksHU(hu_gauss);
-        Mat img_11_seg_gauss = colorizeAndOverlay(img_2_gauss, masks_gauss);
-
-        // 12. SEGMENTACIÓN EN NLMEANS (Avanzada 1)
-        // Aquí estaba el error: Definimos explícitamente la variable
-        Mat img_12_seg_nlmeans = colorizeAndOverlay(img_3_nlmeans, masks_gauss);
-
-        // 13. SEGMENTACIÓN EN DNCNN (Avanzada 2)
-        Mat hu_dnn_proxy;
-        GaussianBlur(hu32f_raw, hu_dnn_proxy, Size(3, 3), 0.8);
-        AnatomyMasks masks_dnn = generateAnatomicalMasksHU(hu_dnn_proxy);
-        Mat img_13_seg_dncnn = colorizeAndOverlay(img_4_dncnn, masks_dnn);
+        cout << "[PROCESO] Calculando NLMeans" << (denoiserPtr ? " + DnCNN" : "") << "...\n";
+        PipelineResults res;
+        PipelineOptions opts;
+        opts.useCache = false;   // un solo corte: nada que reutilizar
+        runSlicePipeline(hu16s_raw, denoiserPtr, res, opts);
 
+        const Mat& img_1_original      = res.images[0];
+        const Mat& img_2_gauss         = res.images[1];
+        const Mat& img_3_nlmeans       = res.images[2];
+        const Mat& img_4_dncnn         = res.images[3];
+        const Mat& img_5_bordes        = res.images[4];
+        const Mat& img_6_tophat        = res.images[5];
+        const Mat& img_7_blackhat      = res.images[6];
+        const Mat& img_8_erosion       = res.images[7];
+        const Mat& img_9_dilatacion    = res.images[8];
+        const Mat& img_10_seg_original = res.images[9];
+        const Mat& img_11_seg_gauss    = res.images[10];
+        const Mat& img_12_seg_nlmeans  = res.images[11];
+        const Mat& img_13_seg_dncnn    = res.images[12];
 
         // =========================================================
         // GUARDADO Y VISUALIZACIÓN (13 VENTANAS)
@@ -215,10 +192,691 @@ void procesarArchivoSeleccionado(const string& filePath) {
     if (denoiserPtr) delete denoiserPtr;
 }
 
+// ======================================================================================
+// 3. INFORME DE SERIE COMPLETA (sin ventanas)
+// ======================================================================================
+int generarInformeSerie(const string& dicomDir, string outPrefix) {
+    try {
+        if (outPrefix.empty()) {
+            fs::path dir = fs::path(dicomDir);
+            if (!dir.has_filename()) dir = dir.parent_path();
+            outPrefix = (fs::path("outputs/series") / dir.filename()).string();
+        }
+
+        cout << "[SERIE] Procesando: " << dicomDir << "\n";
+        SeriesReport report = buildSeriesReport(dicomDir);
+        writeSeriesReportCsv(report, outPrefix + ".csv");
+        writeSeriesReportJson(report, outPrefix + ".json");
+
+        cout << "[EXITO] " << report.slices.size() << " cortes en " << report.seconds << " s → "
+             << outPrefix << ".csv / .json\n";
+        return 0;
+    } catch (const std::exception& e) {
+        cerr << "Error: " << e.what() << endl;
+        return 1;
+    }
+}
+
+// ======================================================================================
+// 4. OPCIONES DE LÍNEA DE COMANDOS
+// ======================================================================================
+// --clave valor, o --flag sin valor (queda como "1")
+struct CliArgs {
+    map<string, string> values;
+    bool   has(const string& k) const { return values.count(k) > 0; }
+    string get(const string& k, const string& def = "") const {
+        auto it = values.find(k);
+        return it == values.end() ? def : it->second;
+    }
+};
+
+CliArgs parseArgs(int argc, char** argv) {
+    CliArgs args;
+    for (int i = 1; i < argc; ++i) {
+        string k = argv[i];
+        if (k.rfind("--", 0) != 0) continue;
+        k = k.substr(2);
+        if (i + 1 < argc && string(argv[i + 1]).rfind("--", 0) != 0) args.values[k] = argv[++i];
+        else args.values[k] = "1";
+    }
+    return args;
+}
+
+// Modelo + backend/target/hilos: explícitos por CLI o elegidos por benchmark
+DnnConfig dnnConfigFromArgs(const CliArgs& args) {
+    try {
+        const string modelPath = resolveModelPath(args.get("model"));
+        DnnConfig cfg{ modelPath };
+        if (args.has("dnn-backend") || args.has("dnn-target") || args.has("dnn-threads")) {
+            cfg.backend = parseDnnBackend(args.get("dnn-backend", "opencv"));
+            cfg.target  = parseDnnTarget(args.get("dnn-target", "cpu"));
+            cfg.threads = stoi(args.get("dnn-threads", "0"));
+        } else {
+            cfg = selectDnnConfig(modelPath, args.has("dnn-rebench"));
+        }
+        cfg.precision = parseDnnPrecision(args.get("dnn-precision", "fp32"));
+        return cfg;
+    } catch (const std::exception& e) {
+        cout << "[AVISO] DNN no disponible: " << e.what() << "\n";
+        return {};
+    }
+}
+
+// ======================================================================================
+// 5. CHEQUEO DE PRECISIÓN DNN (FP32 vs FP16 vs INT8)
+// ======================================================================================
+int chequearPrecisionDnn(const DnnConfig& base, string dicomDir, int count) {
+    if (base.modelPath.empty()) return 1;
+    if (dicomDir.empty() || dicomDir == "1") dicomDir = findBundledSeriesDir();
+    if (dicomDir.empty()) {
+        cerr << "Error: indica la serie con --dnn-accuracy <dirDICOM>\n";
+        return 1;
+    }
+
+    cout << "[DNN] Precisión sobre " << count << " cortes de " << dicomDir << "\n";
+    cout << "Precisión   ms/corte   PSNR(dB)   SSIM   SSIM mín\n";
+    for (const auto& row : runPrecisionCheck(base, dicomDir, count)) {
+        if (!row.available) {
+            cout << dnnPrecisionName(row.precision) << "        no disponible: " << row.error << "\n";
+            continue;
+        }
+        printf("%-10s %9.1f %10.2f %7.4f %9.4f\n", dnnPrecisionName(row.precision),
+               row.msPerSlice, row.psnr, row.ssim, row.minSsim);
+    }
+    return 0;
+}
+
+// ======================================================================================
+// 6. CATÁLOGO DE SERIES (solo cabeceras, índice incremental)
+// ======================================================================================
+int listarCatalogo(const string& root, const string& indexPath) {
+    try {
+        const DicomCatalog cat = buildDicomCatalog(root, indexPath);
+        cout << "[CATÁLOGO] " << cat.series.size() << " series (" << cat.parsedFiles
+             << " cabeceras leídas, " << cat.reusedFiles << " del índice) → " << cat.indexPath << "\n";
+        cout << "Paciente\tDescripción\tCortes\tTamaño\tEspaciado (mm)\tDirectorio\n";
+        for (const auto& s : cat.series) {
+            printf("%s\t%s\t%zu\t%dx%d\t%.3fx%.3fx%.3f\t%s\n", s.patientId.c_str(), s.description.c_str(),
+                   s.slices.size(), s.cols, s.rows, s.spacing[0], s.spacing[1], s.spacing[2],
+                   s.directory().c_str());
+        }
+        return 0;
+    } catch (const std::exception& e) {
+        cerr << "Error: " << e.what() << endl;
+        return 1;
+    }
+}
+
+// ======================================================================================
+// 7. EVIDENCIAS DE TODA LA SERIE → UN CONTENEDOR .vev
+// ======================================================================================
+int exportarEvidenciasSerie(const string& dicomDir, const DnnConfig& dnnCfg, string outPath) {
+    try {
+        if (outPath.empty()) outPath = evidenceStorePath("outputs/series", dicomDir);
+        const vector<string> files = listDicomSeriesFiles(dicomDir);
+
+        unique_ptr<DnnDenoiser> denoiser;
+        try {
+            if (!dnnCfg.modelPath.empty()) denoiser = createDnnDenoiser(dnnCfg, dicomDir);
+        } catch (...) { cout << "[AVISO] DNN no disponible.\n"; }
+
+        cout << "[EVIDENCIAS] " << files.size() << " cortes → " << outPath << "\n";
+        const auto t0 = chrono::steady_clock::now();
+        EvidenceWriter store(outPath);
+        PipelineResults res;   // buffers reutilizados corte a corte
+        PipelineOptions opts;
+        opts.useCache = false;   // cada corte se ve una vez: el caché solo copiaría
+        int skipped = 0, nlmOnly = 0;
+        for (size_t i = 0; i < files.size(); ++i) {
+            runSlicePipeline(loadSliceHU(files[i]), denoiser.get(), res, opts);
+            store.addSlice(static_cast<uint32_t>(i), res);   // se escribe y se olvida
+            if (!res.denoise.runNlm) ++skipped;
+            else if (!res.denoise.runDnn) ++nlmOnly;
+        }
+        store.close();
+
+        const double secs = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+        printf("[EXITO] %.1f MB (%.1f MB sin comprimir) en %.1f s\n",
+               store.bytesWritten() / 1048576.0, store.rawBytes() / 1048576.0, secs);
+        if (skipped || nlmOnly)
+            printf("  filtrado adaptativo: %d cortes sin filtrar, %d solo NLMeans, %zu con DnCNN\n", skipped,
+                   nlmOnly, files.size() - skipped - nlmOnly);
+        return 0;
+    } catch (const std::exception& e) {
+        cerr << "Error: " << e.what() << endl;
+        return 1;
+    }
+}
+
+// Un corte del contenedor → PNG (las 13 evidencias y los mapas de etiquetas)
+int extraerEvidencias(const string& vevPath, int slice, string outDir) {
+    try {
+        if (outDir.empty()) outDir = "outputs/extract";
+        fs::create_directories(outDir);
+        EvidenceReader store(vevPath);
+        Mat img;
+        for (uint16_t layer = 0; layer < kNumEvidenceLayers; ++layer) {
+            if (!store.read(static_cast<uint32_t>(slice), layer, img)) continue;
+            if (layer >= LAYER_LABELS_RAW) img *= 85;   // etiquetas 0..3 visibles
+            imwrite(outDir + "/" + to_string(slice) + "_" + to_string(layer + 1) + ".png", img);
+        }
+        cout << "[EXITO] Corte " << slice << " → " << outDir << "\n";
+        return 0;
+    } catch (const std::exception& e) {
+        cerr << "Error: " << e.what() << endl;
+        return 1;
+    }
+}
+
+// ======================================================================================
+// 8. SERVIDOR LOCAL Y CLIENTE
+// ======================================================================================
+SliceServer* g_server = nullptr;
+
+int ejecutarServidor(const CliArgs& args, const DnnConfig& dnnCfg) {
+    try {
+        SliceServerOptions opts;
+        opts.socketPath   = args.get("socket");
+        opts.dnn          = dnnCfg;
+        opts.maxBatch     = stoi(args.get("dnn-batch", "8"));
+        opts.batchWaitMs  = stoi(args.get("batch-wait", "4"));
+        opts.sliceWorkers = stoi(args.get("slice-workers", "4"));
+        SliceServer server(opts);
+
+        g_server = &server;
+        signal(SIGINT,  [](int) { if (g_server) g_server->stop(); });
+        signal(SIGTERM, [](int) { if (g_server) g_server->stop(); });
+
+        cout << "[SERVIDOR] Escuchando en " << server.socketPath()
+             << (dnnCfg.modelPath.empty() ? " (sin DnCNN)" : "") << "\n";
+        server.run();
+        g_server = nullptr;
+        cout << "[SERVIDOR] Detenido\n";
+        return 0;
+    } catch (const std::exception& e) {
+        cerr << "Error: " << e.what() << endl;
+        return 1;
+    }
+}
+
+// Cortes [first, last] de una serie pedidos al servidor → contenedor .vev
+int procesarEnServidor(const CliArgs& args) {
+    try {
+        const SliceClient client(args.get("socket"));
+        SliceRequest req;
+        req.dicomDir = fs::absolute(args.get("remote")).string();   // el servidor no comparte cwd
+        req.first    = stoi(args.get("first", "0"));
+        req.last     = stoi(args.get("last", "-1"));
+        string outPath = args.get("out");
+        if (outPath.empty()) outPath = evidenceStorePath("outputs/series", req.dicomDir);
+
+        const auto t0 = chrono::steady_clock::now();
+        EvidenceWriter store(outPath);
+        int n = 0;
+        client.process(req, [&](int index, PipelineResults& res) {
+            store.addSlice(static_cast<uint32_t>(index), res);
+            ++n;
+        });
+        store.close();
+
+        const double secs = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+        printf("[EXITO] %d cortes → %s en %.1f s\n", n, outPath.c_str(), secs);
+        cout << client.stats() << "\n";
+        return 0;
+    } catch (const std::exception& e) {
+        cerr << "Error: " << e.what() << endl;
+        return 1;
+    }
+}
+
+// ======================================================================================
+// 9. COLA DE ESTUDIOS: TODAS LAS SERIES DE UNA RAÍZ A LA VEZ
+// ======================================================================================
+int procesarLote(const CliArgs& args, const DnnConfig& dnnCfg) {
+    try {
+        const DicomCatalog cat = buildDicomCatalog(args.get("batch"));
+        const string outDir = args.get("out", "outputs/batch");
+
+        // Un .vev por serie (nombre del directorio; _2, _3... si se repite)
+        vector<SeriesJob> jobs;
+        map<string, int> seen;
+        for (const auto& s : cat.series) {
+            SeriesJob job;
+            job.name  = s.patientId + " / " + s.description;
+            job.files = s.files();
+            string stem = fs::path(s.directory()).filename().string();
+            if (const int k = ++seen[stem]; k > 1) stem += "_" + to_string(k);
+            job.outPath = (fs::path(outDir) / (stem + ".vev")).string();
+            jobs.push_back(std::move(job));
+        }
+
+        BatchOptions opts;
+        opts.dnn          = dnnCfg;
+        opts.cpuWorkers   = stoi(args.get("workers", "0"));
+        opts.ioWorkers    = stoi(args.get("io-workers", "2"));
+        opts.window       = stoi(args.get("window", "4"));
+        opts.activeSeries = stoi(args.get("active", "0"));
+        opts.maxBatch     = stoi(args.get("dnn-batch", "8"));
+
+        cout << "[LOTE] " << jobs.size() << " series → " << outDir << "\n";
+        const auto t0 = chrono::steady_clock::now();
+        int failed = 0;
+        processSeriesBatch(jobs, opts, [&](const SeriesProgress& p) {
+            if (!p.error.empty()) ++failed;
+            printf("  %-40s %4d/%-4d %6.1f s  %s\n", p.name.c_str(), p.done, p.total, p.seconds,
+                   p.error.empty() ? p.outPath.c_str() : ("ERROR: " + p.error).c_str());
+            fflush(stdout);
+        });
+        const double secs = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+        printf("[EXITO] %zu series (%d con error) en %.1f s\n", jobs.size(), failed, secs);
+        memoryGovernor().print(cout);
+        return failed ? 1 : 0;
+    } catch (const std::exception& e) {
+        cerr << "Error: " << e.what() << endl;
+        return 1;
+    }
+}
+
+// ======================================================================================
+// 10. COMPONENTES CONEXAS 3D DE LOS TEJIDOS
+// ======================================================================================
+int analizarComponentes(const CliArgs& args) {
+    try {
+        const vector<string> files = listDicomSeriesFiles(args.get("components"));
+        const int n = static_cast<int>(files.size());
+        const int top = stoi(args.get("top", "5"));
+        ComponentOptions opts;
+        opts.minVoxels = stoi(args.get("min-voxels", "1000"));
+
+        // Etiquetas por corte en paralelo (HU completo: hace falta para las estadísticas)
+        const auto t0 = chrono::steady_clock::now();
+        vector<Mat> hu(n);
+        vector<RleLabelMap> labels(n);
+        parallel_for_(Range(0, n), [&](const Range& range) {
+            AnatomyMasks masks;
+            for (int i = range.start; i < range.end; ++i) {
+                hu[i] = loadSliceHU(files[i]);
+                generateAnatomicalLabelsHU(hu[i], labels[i], {}, masks);
+            }
+        });
+        const auto t1 = chrono::steady_clock::now();
+        const ComponentResult res = analyzeComponents(labels, hu, opts);
+        const auto t2 = chrono::steady_clock::now();
+
+        printf("[COMPONENTES] %d cortes: etiquetas %.2f s, componentes 3D %.3f s\n", n,
+               chrono::duration<double>(t1 - t0).count(), chrono::duration<double>(t2 - t1).count());
+        printf("  %zu componentes >= %d vóxeles (%llu descartadas, %llu vóxeles)\n", res.components.size(),
+               opts.minVoxels, static_cast<unsigned long long>(res.removedComponents),
+               static_cast<unsigned long long>(res.removedVoxels));
+
+        static const char* kNames[] = { "fondo", "grasa", "músculo", "hueso" };
+        cout << "Tejido\tVóxeles\tCentroide (x,y,z)\tCaja (x0,y0,z0)-(x1,y1,z1)\tHU media ± sd [mín, máx]\n";
+        for (int l = LABEL_FAT; l <= LABEL_BONE; ++l) {
+            int shown = 0;
+            for (const auto& c : res.components) {
+                if (c.label != l || shown++ >= top) continue;
+                printf("%s\t%llu\t(%.1f, %.1f, %.1f)\t(%d,%d,%d)-(%d,%d,%d)\t%.1f ± %.1f [%.0f, %.0f]\n", kNames[l],
+                       static_cast<unsigned long long>(c.voxels), c.centroid[0], c.centroid[1], c.centroid[2],
+                       c.bboxMin[0], c.bboxMin[1], c.bboxMin[2], c.bboxMax[0], c.bboxMax[1], c.bboxMax[2],
+                       c.meanHU, c.stdHU, c.minHU, c.maxHU);
+            }
+        }
+        return 0;
+    } catch (const std::exception& e) {
+        cerr << "Error: " << e.what() << endl;
+        return 1;
+    }
+}
+
+// ======================================================================================
+// 11. MÉTRICAS DE LOS FILTROS SOBRE UNA SERIE
+// ======================================================================================
+int medirCalidadSerie(const CliArgs& args, const DnnConfig& dnnCfg) {
+    try {
+        const string dicomDir = args.get("quality");
+        const vector<string> files = listDicomSeriesFiles(dicomDir);
+        vector<string> refFiles;
+        if (args.has("reference")) refFiles = listDicomSeriesFiles(args.get("reference"));
+        string outPath = args.get("out");
+        if (outPath.empty()) {
+            fs::path dir = fs::path(dicomDir);
+            if (!dir.has_filename()) dir = dir.parent_path();
+            outPath = (fs::path("outputs/series") / (dir.filename().string() + "_calidad.csv")).string();
+        }
+
+        unique_ptr<DnnDenoiser> denoiser;
+        try {
+            if (!dnnCfg.modelPath.empty()) denoiser = createDnnDenoiser(dnnCfg, dicomDir);
+        } catch (...) { cout << "[AVISO] DNN no disponible.\n"; }
+
+        cout << "[CALIDAD] " << files.size() << " cortes"
+             << (refFiles.empty() ? " (PSNR/SSIM frente a la original)" : " con referencia") << "\n";
+        const SeriesQuality q = computeSeriesQuality(files, denoiser.get(), refFiles);
+        writeSeriesQualityCsv(q, outPath);
+
+        cout << "Variante    Ruido(HU)   EPI     PSNR(dB)  SSIM    Dice grasa/músculo/hueso\n";
+        for (int v = 0; v < kNumDenoiseVariants; ++v) {
+            const VariantQuality& m = q.mean.variants[v];
+            printf("%-10s %9.1f %7.3f %9.2f %7.4f   ", kDenoiseVariantNames[v], m.noiseStdHU, m.epi, m.psnr, m.ssim);
+            if (m.hasDice) printf("%.3f / %.3f / %.3f\n", m.dice[LABEL_FAT], m.dice[LABEL_MUSCLE], m.dice[LABEL_BONE]);
+            else printf("- (máscaras de Gauss)\n");
+        }
+        printf("[EXITO] %.1f s → %s\n", q.seconds, outPath.c_str());
+        return 0;
+    } catch (const std::exception& e) {
+        cerr << "Error: " << e.what() << endl;
+        return 1;
+    }
+}
+
+// ======================================================================================
+// 12. BANCO DE ARRANQUE
+// ======================================================================================
+// Desde la creación del proceso hasta el primer corte con las 13 evidencias
+int medirArranque(const CliArgs& args) {
+    try {
+        string file = args.get("startup-bench");
+        if (file.empty() || file == "1") {
+            const string dir = findBundledSeriesDir();
+            if (dir.empty()) throw runtime_error("indica un corte con --startup-bench <archivo>");
+            file = listDicomSeriesFiles(dir).front();
+        }
+        StartupProfile& prof = startupProfile();
+
+        registerDicomIo();
+        prof.mark("GDCM registrado");
+        const Mat hu = loadSliceHU(file);
+        prof.mark("corte leído");
+
+        const DnnConfig cfg = dnnConfigFromArgs(args);
+        unique_ptr<DnnDenoiser> denoiser;
+        if (!cfg.modelPath.empty()) denoiser = createDnnDenoiser(cfg);
+        prof.mark(denoiser ? "DnCNN cargado" : "sin DnCNN");
+
+        PipelineResults res;
+        PipelineOptions opts;
+        opts.useCache = false;   // en frío de verdad
+        runSlicePipeline(hu, denoiser.get(), res, opts);
+        prof.mark("primer corte procesado");
+
+        cout << "[ARRANQUE] " << file << "\n";
+        prof.print(cout);
+        return 0;
+    } catch (const std::exception& e) {
+        cerr << "Error: " << e.what() << endl;
+        return 1;
+    }
+}
+
+// ======================================================================================
+// 13. PROYECCIONES DE LOSA (MIP / MinIP / MEDIA)
+// ======================================================================================
+// Guarda la proyección ventaneada y mide recorrer el eje entero con la losa:
+// incremental (SlabProjector) frente a recalcular cada posición desde cero
+int proyectarLosa(const CliArgs& args) {
+    try {
+        const Volume vol = loadDicomSeries(args.get("project"));
+        if (vol.image.IsNull()) throw runtime_error("Error al leer la serie DICOM.");
+        MemoryReservation volMemory("serie abierta (CLI)");
+        volMemory.resize(volumeBytes(vol));
+        const Plane      plane = parsePlane(args.get("plane", "axial"));
+        const Projection mode  = parseProjection(args.get("mode", "mip"));
+        const int n = planeSliceCount(vol.image, plane);
+        const int thickness = stoi(args.get("thickness", "0"));   // 0 = todo el eje
+        const int index = stoi(args.get("index", to_string(n / 2)));
+        const string out = args.get("out", string("outputs/proyeccion_") + projectionName(mode) + ".png");
+
+        Mat hu;
+        if (thickness <= 0) volumeProjection(vol.image, plane, mode, hu);
+        else SlabProjector().project(vol.image, plane, index, thickness, mode, hu);
+        fs::create_directories(fs::path(out).parent_path().empty() ? "." : fs::path(out).parent_path());
+        imwrite(out, huTo8u(hu, stof(args.get("wc", "40")), stof(args.get("ww", "400"))));
+        printf("[PROYECCIÓN] %s %s, %s → %s\n", projectionName(mode), planeName(plane),
+               thickness <= 0 ? "volumen" : (to_string(thickness) + " cortes").c_str(), out.c_str());
+        if (thickness <= 1) return 0;
+
+        // Barrido del eje: mismo resultado, distinto coste por posición
+        auto sweep = [&](bool incremental, long long& ops) {
+            SlabProjector slab;
+            Mat r;
+            ops = 0;
+            const auto t0 = chrono::steady_clock::now();
+            for (int i = 0; i < n; ++i) {
+                if (!incremental) slab = SlabProjector();
+                slab.project(vol.image, plane, i, thickness, mode, r, /*isotropic*/false);
+                ops += slab.lastPlaneOps();
+            }
+            return chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count() / n;
+        };
+        long long opsInc = 0, opsFull = 0;
+        const double msInc  = sweep(true, opsInc);
+        const double msFull = sweep(false, opsFull);
+        printf("  barrido de %d posiciones: incremental %.2f ms/pos (%.1f planos), desde cero %.2f ms/pos "
+               "(%.1f planos)\n", n, msInc, double(opsInc) / n, msFull, double(opsFull) / n);
+        return 0;
+    } catch (const std::exception& e) {
+        cerr << "Error: " << e.what() << endl;
+        return 1;
+    }
+}
+
+// ======================================================================================
+// 14. SERIES SINTÉTICAS PARA PRUEBAS DE ESCALA
+// ======================================================================================
+// Genera series grandes a partir de la L096 (o de --source) y, con --load, mide
+// la lectura de la primera con el cargador normal
+int generarSeriesSinteticas(const CliArgs& args) {
+    try {
+        const string sourceDir = args.get("source", findBundledSeriesDir());
+        if (sourceDir.empty()) throw runtime_error("no se encontró la serie L096: indica --source <dirDICOM>");
+        SyntheticOptions opts;
+        const int size = stoi(args.get("size", "512"));
+        opts.cols = stoi(args.get("cols", to_string(size)));
+        opts.rows = stoi(args.get("rows", to_string(size)));
+        opts.slices = stoi(args.get("slices", "0"));
+        opts.zStep = stod(args.get("z-step", "1"));
+        opts.inPlane = parseInPlaneMode(args.get("in-plane", "resample"));
+        opts.doseFraction = stod(args.get("dose", "1"));
+        opts.noiseCorrelationPx = stod(args.get("noise-corr", "0.8"));
+        opts.series = stoi(args.get("count", "1"));
+        opts.seed = stoull(args.get("seed", "1"));
+        const string format = args.get("format", "dicom");
+        opts.writeDicom = format == "dicom" || format == "both";
+        opts.writeRaw   = format == "raw" || format == "both";
+        if (!opts.writeDicom && !opts.writeRaw) throw runtime_error("formato desconocido: " + format);
+        const string outDir = args.get("synth") == "1" ? "outputs/sintetico" : args.get("synth");
+
+        const auto t0 = chrono::steady_clock::now();
+        const Volume src = loadDicomSeries(sourceDir);
+        const auto t1 = chrono::steady_clock::now();
+        const auto series = generateSyntheticSeries(src, outDir, opts);
+        const auto t2 = chrono::steady_clock::now();
+
+        const double secs = chrono::duration<double>(t2 - t1).count();
+        const double slices = double(series.size()) * series.front().slices;
+        const double mb = slices * opts.cols * opts.rows * 2 / 1e6;
+        printf("[SINTÉTICO] %zu series de %d x %d x %d (%.3f x %.3f x %.3f mm), dosis %.2f → %s\n",
+               series.size(), opts.cols, opts.rows, series.front().slices, series.front().spacing[0],
+               series.front().spacing[1], series.front().spacing[2], opts.doseFraction, outDir.c_str());
+        printf("  fuente %.2f s; generación %.2f s (%.0f cortes/s, %.0f MB/s de HU)\n",
+               chrono::duration<double>(t1 - t0).count(), secs, slices / secs, mb / secs);
+
+        if (args.has("load") && opts.writeDicom) {
+            const auto t3 = chrono::steady_clock::now();
+            const Volume vol = loadDicomSeries(series.front().dicomDir);
+            const double load = chrono::duration<double>(chrono::steady_clock::now() - t3).count();
+            printf("  lectura de %s: %.2f s (%.0f MB/s)\n", series.front().dicomDir.c_str(), load,
+                   mb / series.size() / load);
+        }
+        return 0;
+    } catch (const std::exception& e) {
+        cerr << "Error: " << e.what() << endl;
+        return 1;
+    }
+}
+
+// ======================================================================================
+// 15. REGRESIÓN CONTRA REFERENCIAS + PRESUPUESTOS DE LATENCIA
+// ======================================================================================
+// DnCNN con la config por defecto (OpenCV/CPU/FP32, sin benchmark): la misma
+// salida en cualquier máquina. Devuelve 1 si algo se sale de tolerancia o de
+// presupuesto y kRegressionSkipCode (77) si no hay serie o referencias con las
+// que comparar (apto para CI: ctest lo cuenta como omitido).
+int ejecutarRegresion(const CliArgs& args) {
+    try {
+        RegressionOptions opts;
+        opts.seriesDir = args.get("source");
+        opts.goldenDir = args.get("golden", opts.goldenDir);
+        opts.slices    = stoi(args.get("slices", to_string(opts.slices)));
+        opts.repeats   = stoi(args.get("repeats", to_string(opts.repeats)));
+        opts.update    = args.has("update");
+        if (const char* s = getenv("VISION_BUDGET_SCALE")) opts.budgetScale = stod(s);
+        if (args.has("budget-scale")) opts.budgetScale = stod(args.get("budget-scale"));
+        if (args.has("sizes")) {
+            opts.sizes.clear();
+            stringstream ss(args.get("sizes"));
+            for (string tok; getline(ss, tok, ',');) opts.sizes.push_back(stoi(tok));
+        }
+
+        unique_ptr<DnnDenoiser> denoiser;
+        try {
+            const DnnConfig cfg{ resolveModelPath(args.get("model")) };
+            denoiser = createDnnDenoiser(cfg);
+            opts.denoiser = denoiser.get();
+            opts.denoiserTag = filesystem::path(cfg.modelPath).filename().string() + " " + describeDnnConfig(cfg);
+        } catch (const std::exception& e) {
+            cout << "[AVISO] Regresión sin DnCNN: " << e.what() << "\n";
+        }
+
+        const RegressionReport report = runRegression(opts, cout);
+        if (!report.skipped.empty()) {
+            cout << "[REGRESIÓN] omitida: " << report.skipped << "\n";
+            return kRegressionSkipCode;
+        }
+        if (opts.update) {
+            cout << "[REGRESIÓN] referencias en " << opts.goldenDir << "\n";
+            return 0;
+        }
+        cout << "[REGRESIÓN] " << (report.ok() ? "OK" : to_string(report.failures.size()) + " fallos") << "\n";
+        return report.ok() ? 0 : 1;
+    } catch (const std::exception& e) {
+        cerr << "Error: " << e.what() << endl;
+        return 1;
+    }
+}
+
 // ======================================================================================
 // MAIN
 // ======================================================================================
+// Uso:
+//   vision_interciclo [--model <nombre|ruta>] [--dnn-backend opencv|openvino]
+//                     [--dnn-target cpu|fp16] [--dnn-threads N] [--dnn-rebench]
+//                     [--dnn-precision fp32|fp16|int8]
+//                     [--denoise-policy full|adaptive]   (o VISION_DENOISE_POLICY)
+//                     [--memory-mb N]   (o VISION_MEMORY_MB; 0 = sin límite)
+//                     [--metrics [<archivo.tsv>]]   (volcado de métricas al salir)
+//   vision_interciclo --dnn-accuracy [<dirDICOM>] [--slices N]
+//   vision_interciclo --list-models
+//   vision_interciclo --series <dirDICOM> [--out <prefijo>]
+//   vision_interciclo --catalog <raíz> [--index <archivo.tsv>]
+//   vision_interciclo --evidences <dirDICOM> [--out <archivo.vev>] [opciones DNN]
+//   vision_interciclo --extract <archivo.vev> [--slice N] [--out <dir>]
+//   vision_interciclo --server [--socket <ruta>] [--dnn-batch N] [--batch-wait ms]
+//                     [--slice-workers N] [opciones DNN]
+//   vision_interciclo --remote <dirDICOM> [--first N] [--last M] [--out <archivo.vev>]
+//                     [--socket <ruta>]
+//   vision_interciclo --server-stop [--socket <ruta>]
+//   vision_interciclo --batch <raíz> [--out <dir>] [--workers N] [--io-workers N]
+//                     [--window N] [--active N] [--dnn-batch N] [opciones DNN]
+//   vision_interciclo --components <dirDICOM> [--min-voxels N] [--top N]
+//   vision_interciclo --startup-bench [<archivo.IMA>] [opciones DNN]
+//   vision_interciclo --quality <dirDICOM> [--reference <dirDICOM>] [--out <archivo.csv>]
+//                     [opciones DNN]
+//   vision_interciclo --project <dirDICOM> [--mode mip|minip|mean] [--plane axial|coronal|sagital]
+//                     [--thickness N (0 = volumen)] [--index N] [--wc C --ww W] [--out <archivo.png>]
+//   vision_interciclo --synth [<dirSalida>] [--source <dirDICOM>] [--size N | --cols N --rows N]
+//                     [--slices N] [--z-step x] [--in-plane resample|mosaic] [--dose 0.25]
+//                     [--noise-corr px] [--count N] [--seed N] [--format dicom|raw|both] [--load]
+//   vision_interciclo --regression [--update] [--golden <dir>] [--source <dirDICOM>]
+//                     [--sizes 256,384,512] [--slices N] [--repeats N] [--budget-scale x]
+//                     [--model <nombre|ruta>]   (o VISION_BUDGET_SCALE)
 int main(int argc, char** argv) {
+    startupProfile().mark("main");
+
+    const CliArgs args = parseArgs(argc, argv);
+
+    // Presupuesto de memoria y política de filtrado antes de que arranque
+    // ningún modo (ni se cree ningún PipelineParams)
+    try {
+        if (args.has("memory-mb")) {
+            const string mbArg = args.get("memory-mb");
+            if (mbArg.empty() || mbArg.find_first_not_of("0123456789") != string::npos)
+                throw runtime_error("--memory-mb espera un número de MB (0 = sin límite): " + mbArg);
+            memoryGovernor().setBudget(static_cast<size_t>(std::stoull(mbArg)) * 1024 * 1024);
+        }
+        if (args.has("denoise-policy")) setDefaultDenoiseMode(parseDenoiseMode(args.get("denoise-policy")));
+    } catch (const std::exception& e) {
+        cerr << "Error: " << e.what() << endl;
+        return 1;
+    }
+
+    // Reciclado de buffers de cv::Mat entre cortes
+    installFrameArena();
+
+    // Métricas del proceso al salir, acabe como acabe el modo (sin archivo → consola)
+    static string metricsPath;
+    if (args.has("metrics")) {
+        metricsPath = args.get("metrics");
+        atexit([] {
+            if (metricsPath == "1") {
+                cout << "[MÉTRICAS]\n";
+                metrics().dump(cout);
+            } else if (!metricsPath.empty() && !metrics().dumpTo(metricsPath)) {
+                cerr << "[AVISO] No se pudieron guardar las métricas en " << metricsPath << "\n";
+            }
+        });
+    }
+
+    if (args.has("list-models")) {
+        for (const auto& m : listDnnModels()) cout << m.name << "\t" << m.path << "\n";
+        return 0;
+    }
+
+    if (args.has("catalog")) return listarCatalogo(args.get("catalog"), args.get("index"));
+    if (args.has("extract"))
+        return extraerEvidencias(args.get("extract"), stoi(args.get("slice", "0")), args.get("out"));
+
+    if (args.has("remote")) return procesarEnServidor(args);
+    if (args.has("server-stop")) {
+        SliceClient(args.get("socket")).shutdown();
+        return 0;
+    }
+
+    // Modo por lotes: informe de serie completa
+    if (args.has("series")) return generarInformeSerie(args.get("series"), args.get("out"));
+    if (args.has("components")) return analizarComponentes(args);
+    if (args.has("project"))    return proyectarLosa(args);
+    if (args.has("synth"))      return generarSeriesSinteticas(args);
+    if (args.has("regression")) return ejecutarRegresion(args);
+
+    if (args.has("startup-bench")) return medirArranque(args);
+
+    // Config DnCNN (puede lanzar el benchmark de backends) y GDCM en segundo
+    // plano: los modos que la usan esperan aquí; el menú se muestra antes
+    shared_future<DnnConfig> dnnAsync = async(launch::async, [&args] {
+        registerDicomIo();
+        return dnnConfigFromArgs(args);
+    }).share();
+    auto dnnCfg = [&]() -> const DnnConfig& { return dnnAsync.get(); };
+
+    if (args.has("server")) return ejecutarServidor(args, dnnCfg());
+    if (args.has("batch"))  return procesarLote(args, dnnCfg());
+    if (args.has("quality"))   return medirCalidadSerie(args, dnnCfg());
+    if (args.has("evidences")) return exportarEvidenciasSerie(args.get("evidences"), dnnCfg(), args.get("out"));
+
+    if (args.has("dnn-accuracy"))
+        return chequearPrecisionDnn(dnnCfg(), args.get("dnn-accuracy"), stoi(args.get("slices", "8")));
+
     while (true) {
         Mat menu = Mat::zeros(Size(600, 300), CV_8UC3);
         putText(menu, "GENERADOR FINAL (13 IMAGENES)", Point(30, 50), FONT_HERSHEY_SIMPLEX, 0.8, Scalar(0, 255, 255), 2);
@@ -232,7 +890,7 @@ int main(int argc, char** argv) {
         if (key == 'o' || key == 'O') {
             destroyWindow("Menu Principal"); 
             string archivo = abrirSelectorDeArchivo();
-            if (!archivo.empty()) procesarArchivoSeleccionado(archivo);
+            if (!archivo.empty()) procesarArchivoSeleccionado(archivo, dnnCfg());
         }
     }
     return 0;
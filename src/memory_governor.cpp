@@ -0,0 +1,381 @@
+#include "memory_governor.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace cv;
+namespace fs = std::filesystem;
+
+namespace {
+
+bool pwriteAll(int fd, const void* data, size_t n, uint64_t offset) {
+    const char* p = static_cast<const char*>(data);
+    while (n > 0) {
+        const ssize_t w = ::pwrite(fd, p, n, static_cast<off_t>(offset));
+        if (w <= 0) return false;
+        p += w;
+        n -= static_cast<size_t>(w);
+        offset += static_cast<uint64_t>(w);
+    }
+    return true;
+}
+
+bool preadAll(int fd, void* data, size_t n, uint64_t offset) {
+    char* p = static_cast<char*>(data);
+    while (n > 0) {
+        const ssize_t r = ::pread(fd, p, n, static_cast<off_t>(offset));
+        if (r <= 0) return false;
+        p += r;
+        n -= static_cast<size_t>(r);
+        offset += static_cast<uint64_t>(r);
+    }
+    return true;
+}
+
+size_t matBytes(const Mat& m) { return m.total() * m.elemSize(); }
+
+std::string mb(uint64_t bytes) {
+    char s[32];
+    std::snprintf(s, sizeof(s), "%.1f MB", bytes / (1024.0 * 1024.0));
+    return s;
+}
+
+const char* priorityName(MemoryPriority p) {
+    switch (p) {
+    case MemoryPriority::Scratch: return "reciclable";
+    case MemoryPriority::Cache:   return "caché";
+    case MemoryPriority::Volume:  return "series";
+    }
+    return "?";
+}
+
+} // namespace
+
+// ==========================================================
+// SpillFile
+//   extensión: uint32 n | n × (int32 rows, cols, type) | píxeles
+// ==========================================================
+SpillFile::SpillFile(std::string dir, size_t capacityBytes)
+    : dir_(std::move(dir)), capacity_(capacityBytes) {}
+
+SpillFile::~SpillFile() {
+    if (fd_ >= 0) ::close(fd_);
+}
+
+bool SpillFile::openLocked() {
+    if (fd_ >= 0) return true;
+    if (failed_) return false;
+    std::error_code ec;
+    fs::create_directories(dir_, ec);
+    std::string path = (fs::path(dir_) / "vision_spill_XXXXXX").string();
+    fd_ = ::mkstemp(path.data());
+    if (fd_ < 0) {
+        failed_ = true;   // sin intercambio: los consumidores sueltan sin volcar
+        return false;
+    }
+    ::unlink(path.c_str());
+    return true;
+}
+
+// Primer hueco que quepa; si no, al final del archivo
+SpillFile::Extent SpillFile::allocateLocked(uint64_t bytes) {
+    for (auto it = holes_.begin(); it != holes_.end(); ++it) {
+        if (it->second < bytes) continue;
+        Extent e{ it->first, bytes };
+        const uint64_t rest = it->second - bytes;
+        const uint64_t restOffset = it->first + bytes;
+        holes_.erase(it);
+        if (rest > 0) holes_[restOffset] = rest;
+        return e;
+    }
+    Extent e{ end_, bytes };
+    end_ += bytes;
+    return e;
+}
+
+SpillFile::Extent SpillFile::write(const std::vector<Mat>& mats) {
+    uint64_t bytes = sizeof(uint32_t);
+    for (const Mat& m : mats) bytes += 3 * sizeof(int32_t) + matBytes(m);
+
+    Extent e;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (used_ + bytes > capacity_ || !openLocked()) return {};
+        e = allocateLocked(bytes);
+        used_ += bytes;
+    }
+
+    std::vector<char> header(sizeof(uint32_t) + mats.size() * 3 * sizeof(int32_t));
+    const uint32_t n = static_cast<uint32_t>(mats.size());
+    std::memcpy(header.data(), &n, sizeof(n));
+    for (size_t i = 0; i < mats.size(); ++i) {
+        const int32_t geom[3] = { mats[i].rows, mats[i].cols, mats[i].type() };
+        std::memcpy(header.data() + sizeof(n) + i * sizeof(geom), geom, sizeof(geom));
+    }
+    bool ok = pwriteAll(fd_, header.data(), header.size(), e.offset);
+    uint64_t offset = e.offset + header.size();
+    for (const Mat& m : mats) {
+        const size_t rowBytes = m.cols * m.elemSize();
+        for (int r = 0; ok && r < m.rows; ++r, offset += rowBytes)
+            ok = pwriteAll(fd_, m.ptr(r), rowBytes, offset);
+    }
+    if (!ok) {
+        release(e);
+        return {};
+    }
+    return e;
+}
+
+bool SpillFile::read(const Extent& e, std::vector<Mat>& out) {
+    if (!e.valid() || fd_ < 0) return false;
+    uint32_t n = 0;
+    if (!preadAll(fd_, &n, sizeof(n), e.offset) || n > 64) return false;
+    std::vector<int32_t> geom(3 * n);
+    if (n > 0 && !preadAll(fd_, geom.data(), geom.size() * sizeof(int32_t), e.offset + sizeof(n))) return false;
+
+    uint64_t offset = e.offset + sizeof(n) + geom.size() * sizeof(int32_t);
+    out.clear();
+    for (uint32_t i = 0; i < n; ++i) {
+        Mat m(geom[3 * i], geom[3 * i + 1], geom[3 * i + 2]);
+        if (!preadAll(fd_, m.data, matBytes(m), offset)) return false;
+        offset += matBytes(m);
+        out.push_back(m);
+    }
+    return true;
+}
+
+void SpillFile::release(const Extent& e) {
+    if (!e.valid()) return;
+    std::lock_guard<std::mutex> lock(mutex_);
+    used_ -= e.bytes;
+    auto it = holes_.emplace(e.offset, e.bytes).first;
+    // Funde con los huecos vecinos
+    if (auto next = std::next(it); next != holes_.end() && it->first + it->second == next->first) {
+        it->second += next->second;
+        holes_.erase(next);
+    }
+    if (it != holes_.begin()) {
+        auto prev = std::prev(it);
+        if (prev->first + prev->second == it->first) {
+            prev->second += it->second;
+            holes_.erase(it);
+            it = prev;
+        }
+    }
+    // Un hueco al final acorta el archivo
+    if (it->first + it->second == end_) {
+        end_ = it->first;
+        holes_.erase(it);
+        if (fd_ >= 0 && ::ftruncate(fd_, static_cast<off_t>(end_)) != 0) { /* solo espacio en disco */ }
+    }
+}
+
+size_t SpillFile::usedBytes() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return used_;
+}
+
+// ==========================================================
+// MemoryGovernor
+// ==========================================================
+MemoryGovernor::MemoryGovernor(size_t budgetBytes, std::string scratchDir, size_t spillBytes)
+    : budget_(budgetBytes), spill_(std::move(scratchDir), spillBytes) {}
+
+void MemoryGovernor::setBudget(size_t budgetBytes) {
+    budget_.store(budgetBytes);
+    makeRoom();
+}
+
+void MemoryGovernor::add(MemoryConsumer* c, MemoryPriority p) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    consumers_.push_back({ c, p });
+}
+
+void MemoryGovernor::remove(MemoryConsumer* c) {
+    std::lock_guard<std::mutex> evict(evictMutex_);   // no está a mitad de una expulsión
+    std::lock_guard<std::mutex> lock(mutex_);
+    consumers_.erase(std::remove_if(consumers_.begin(), consumers_.end(),
+                                    [c](const Registered& r) { return r.consumer == c; }),
+                     consumers_.end());
+}
+
+size_t MemoryGovernor::usedLocked() const {
+    size_t total = reservedTotal_;
+    for (const auto& r : consumers_) total += r.consumer->memoryBytes();
+    return total;
+}
+
+void MemoryGovernor::notePeakLocked() {
+    counters_.peak = std::max(counters_.peak, usedLocked());
+}
+
+size_t MemoryGovernor::used() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return usedLocked();
+}
+
+bool MemoryGovernor::makeRoom(size_t extra) {
+    const size_t budget = budget_.load();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        notePeakLocked();
+        if (budget == 0 || usedLocked() + extra <= budget) return true;
+    }
+
+    std::lock_guard<std::mutex> evict(evictMutex_);
+    std::vector<Registered> order;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        order = consumers_;
+    }
+    std::stable_sort(order.begin(), order.end(),
+                     [](const Registered& a, const Registered& b) { return a.priority < b.priority; });
+
+    // Lo que sueltan las cachés acaba en parte en los pools del arena: una
+    // segunda vuelta los vacía
+    for (int pass = 0; pass < 2; ++pass) {
+        for (const auto& r : order) {
+            const size_t now = used();
+            if (now + extra <= budget) return true;
+            const size_t freed = r.consumer->releaseMemory(now + extra - budget);
+            if (freed == 0) continue;
+            std::lock_guard<std::mutex> lock(mutex_);
+            ++counters_.evictions;
+            counters_.released += freed;
+        }
+    }
+    return used() + extra <= budget;
+}
+
+bool MemoryGovernor::reserve(const char* name, size_t bytes, bool force) {
+    if (bytes == 0) return true;
+    if (!makeRoom(bytes) && !force) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++counters_.denied;
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    reserved_[name] += bytes;
+    reservedTotal_ += bytes;
+    notePeakLocked();
+    return true;
+}
+
+void MemoryGovernor::unreserve(const char* name, size_t bytes) {
+    if (bytes == 0) return;
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = reserved_.find(name);
+    if (it == reserved_.end()) return;
+    const size_t n = std::min(bytes, it->second);
+    it->second -= n;
+    reservedTotal_ -= n;
+}
+
+MemoryGovernor::Counters MemoryGovernor::counters() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Counters c = counters_;
+    c.spilled  = spilled_.load();
+    c.reloaded = reloaded_.load();
+    return c;
+}
+
+void MemoryGovernor::print(std::ostream& os) const {
+    const Counters c = counters();
+    std::lock_guard<std::mutex> lock(mutex_);
+    os << "[MEMORIA] en uso " << mb(usedLocked()) << " (pico " << mb(c.peak) << ") de "
+       << (budget() ? mb(budget()) : std::string("sin límite")) << "\n";
+    for (const auto& r : consumers_)
+        os << "  " << r.consumer->memoryName() << " (" << priorityName(r.priority) << "): "
+           << mb(r.consumer->memoryBytes()) << "\n";
+    for (const auto& [name, bytes] : reserved_)
+        if (bytes) os << "  " << name << " (reserva): " << mb(bytes) << "\n";
+    os << "  expulsiones " << c.evictions << " (" << mb(c.released) << "), intercambio: " << mb(c.spilled)
+       << " volcados, " << mb(c.reloaded) << " recargados, " << mb(spill_.usedBytes()) << " en disco; "
+       << c.denied << " reservas aplazadas\n";
+}
+
+namespace {
+
+// MB de una variable de entorno; si no es un entero válido avisa y deja 'def'
+// (esto corre en la inicialización estática: no puede lanzar)
+size_t envMegabytes(const char* name, size_t def) {
+    const char* env = std::getenv(name);
+    if (!env || !*env) return def;
+    char* end = nullptr;
+    errno = 0;
+    const unsigned long long v = std::strtoull(env, &end, 10);
+    if (errno != 0 || *end != '\0' || env[0] == '-') {
+        std::fprintf(stderr, "[AVISO] %s='%s' no es un número de MB; se ignora\n", name, env);
+        return def;
+    }
+    return static_cast<size_t>(v);
+}
+
+// Límite de memoria del cgroup (contenedores): v2 memory.max, si no v1
+// memory.limit_in_bytes. 0 si no hay límite o no se puede leer.
+size_t cgroupMemoryLimit() {
+    for (const char* path : { "/sys/fs/cgroup/memory.max", "/sys/fs/cgroup/memory/memory.limit_in_bytes" }) {
+        std::ifstream f(path);
+        std::string value;
+        if (!(f >> value) || value == "max") continue;
+        char* end = nullptr;
+        errno = 0;
+        const unsigned long long v = std::strtoull(value.c_str(), &end, 10);
+        // v1 sin límite da un número enorme (PAGE_COUNTER_MAX · página)
+        if (errno == 0 && *end == '\0' && v > 0 && v < (1ull << 60)) return static_cast<size_t>(v);
+    }
+    return 0;
+}
+
+} // namespace
+
+MemoryGovernor& memoryGovernor() {
+    static MemoryGovernor* governor = [] {
+        size_t budget = 0;
+        const long pages = ::sysconf(_SC_PHYS_PAGES), page = ::sysconf(_SC_PAGESIZE);
+        size_t limit = pages > 0 && page > 0 ? static_cast<size_t>(pages) * static_cast<size_t>(page) : 0;
+        if (const size_t cg = cgroupMemoryLimit(); cg && (limit == 0 || cg < limit)) limit = cg;
+        budget = limit / 4 * 3;
+        const size_t envMb = envMegabytes("VISION_MEMORY_MB", SIZE_MAX);   // 0 = sin límite
+        if (envMb != SIZE_MAX) budget = envMb * 1024 * 1024;
+
+        std::error_code ec;
+        std::string dir = fs::temp_directory_path(ec).string();
+        if (ec) dir = "/tmp";
+        if (const char* env = std::getenv("VISION_SCRATCH_DIR")) dir = env;
+
+        const size_t spillMb = envMegabytes("VISION_SPILL_MB", 4096);
+
+        // Nunca se destruye: los consumidores globales (arena, caché) tampoco
+        return new MemoryGovernor(budget, dir, spillMb * 1024 * 1024);
+    }();
+    return *governor;
+}
+
+// ==========================================================
+// MemoryReservation
+// ==========================================================
+bool MemoryReservation::resize(size_t bytes, bool force) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (bytes > bytes_) {
+        if (!memoryGovernor().reserve(name_, bytes - bytes_, force)) return false;
+    } else if (bytes < bytes_) {
+        memoryGovernor().unreserve(name_, bytes_ - bytes);
+    }
+    bytes_ = bytes;
+    return true;
+}
+
+size_t MemoryReservation::bytes() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return bytes_;
+}
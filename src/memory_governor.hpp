@@ -0,0 +1,171 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+#include <opencv2/core.hpp>
+
+// ==========================================================
+// Gobernador de memoria
+// ==========================================================
+// Un presupuesto total para todo el proceso. Lo que ocupa memoria se apunta
+// aquí de dos formas:
+//  - consumidores (MemoryConsumer): cachés que pueden soltar memoria cuando
+//    se les pide (pools del FrameArena, StageCache, VolumeCache);
+//  - reservas (MemoryReservation): memoria en uso que no se puede soltar
+//    (espacio de trabajo DnCNN, cortes en vuelo de la cola de estudios).
+// Cuando consumidores + reservas pasan del presupuesto, se pide memoria a los
+// consumidores de menor prioridad primero. Lo frío que sea caro de rehacer
+// se vuelca al archivo de intercambio (SpillFile) y se recarga al pedirlo;
+// lo que se vuelve a leer de disco sin más (series DICOM) se suelta.
+// Una reserva que no cabe ni vaciando todo puede esperar (cola de estudios):
+// con varios estudios grandes en un nodo de RAM fija el proceso va más lento
+// en vez de acabar muerto por falta de memoria.
+
+// Orden de expulsión: de la primera a la última
+enum class MemoryPriority {
+    Scratch,   // buffers reciclables (pools del FrameArena): soltar no cuesta nada
+    Cache,     // resultados recalculables (StageCache): al intercambio
+    Volume     // series completas (VolumeCache): se vuelven a leer del DICOM
+};
+
+class MemoryConsumer {
+public:
+    virtual ~MemoryConsumer() = default;
+    virtual const char* memoryName() const = 0;
+    // Bytes en memoria ahora mismo (barato: se consulta a menudo)
+    virtual size_t memoryBytes() const = 0;
+    // Suelta al menos 'bytes' si puede (lo menos usado primero) y devuelve lo
+    // liberado. Lo llama el gobernador: no debe volver a llamarlo.
+    virtual size_t releaseMemory(size_t bytes) = 0;
+};
+
+// ==========================================================
+// Archivo de intercambio
+// ==========================================================
+// Un único archivo en el directorio temporal, borrado nada más crearse: se
+// libera solo al salir, también si el proceso muere. Huecos reutilizables
+// (los contiguos se funden); lecturas y escrituras sin cerrojo (pread/pwrite).
+class SpillFile {
+public:
+    struct Extent {
+        uint64_t offset = 0;
+        uint64_t bytes  = 0;
+        bool valid() const { return bytes > 0; }
+    };
+
+    SpillFile(std::string dir, size_t capacityBytes);
+    ~SpillFile();
+    SpillFile(const SpillFile&) = delete;
+    SpillFile& operator=(const SpillFile&) = delete;
+
+    // Extensión inválida si no cabe o falla la escritura
+    Extent write(const std::vector<cv::Mat>& mats);
+    bool   read(const Extent& e, std::vector<cv::Mat>& out);
+    void   release(const Extent& e);
+
+    size_t usedBytes() const;
+
+private:
+    bool openLocked();
+    Extent allocateLocked(uint64_t bytes);
+
+    std::string dir_;
+    size_t capacity_;
+    int fd_ = -1;
+    bool failed_ = false;
+
+    mutable std::mutex mutex_;
+    std::map<uint64_t, uint64_t> holes_;   // offset → bytes
+    uint64_t end_  = 0;
+    uint64_t used_ = 0;
+};
+
+// ==========================================================
+// MemoryGovernor
+// ==========================================================
+class MemoryGovernor {
+public:
+    struct Counters {
+        uint64_t evictions     = 0;   // llamadas a releaseMemory que soltaron algo
+        uint64_t released      = 0;   // bytes soltados por los consumidores
+        uint64_t spilled       = 0;   // bytes escritos al intercambio
+        uint64_t reloaded      = 0;   // bytes recargados del intercambio
+        uint64_t denied        = 0;   // reservas rechazadas (el llamador esperó)
+        size_t   peak          = 0;   // máximo de consumidores + reservas visto
+    };
+
+    // budgetBytes == 0 → sin límite (solo contabilidad)
+    MemoryGovernor(size_t budgetBytes, std::string scratchDir, size_t spillBytes);
+
+    size_t budget() const { return budget_.load(); }
+    // Cambia el presupuesto (p. ej. --memory-mb) y expulsa si ya no cabe
+    void setBudget(size_t budgetBytes);
+    size_t used() const;   // consumidores + reservas
+
+    void add(MemoryConsumer* c, MemoryPriority p);
+    void remove(MemoryConsumer* c);
+
+    // Pide memoria a los consumidores hasta que used() + extra quepa.
+    // true si cabe al terminar.
+    bool makeRoom(size_t extra = 0);
+
+    // Reserva apuntada a 'name'. Si no cabe ni tras makeRoom: con force se
+    // apunta igual (no se puede esperar), sin force devuelve false.
+    bool reserve(const char* name, size_t bytes, bool force);
+    void unreserve(const char* name, size_t bytes);
+
+    SpillFile& spill() { return spill_; }
+    void countSpill(uint64_t bytes)  { spilled_ += bytes; }
+    void countReload(uint64_t bytes) { reloaded_ += bytes; }
+
+    Counters counters() const;
+    void print(std::ostream& os) const;
+
+private:
+    struct Registered {
+        MemoryConsumer* consumer;
+        MemoryPriority  priority;
+    };
+
+    size_t usedLocked() const;
+    void   notePeakLocked();
+
+    std::atomic<size_t> budget_;
+    SpillFile spill_;
+
+    std::mutex evictMutex_;      // una expulsión a la vez (y add/remove fuera de ella)
+    mutable std::mutex mutex_;   // registro y reservas
+    std::vector<Registered> consumers_;
+    std::map<std::string, size_t> reserved_;
+    size_t reservedTotal_ = 0;
+    Counters counters_;
+    std::atomic<uint64_t> spilled_{0}, reloaded_{0};
+};
+
+// Gobernador del proceso. Presupuesto por VISION_MEMORY_MB o setBudget (por
+// defecto 3/4 de la RAM física, o del límite del cgroup si es menor; 0 = sin
+// límite), intercambio en VISION_SCRATCH_DIR (por
+// defecto el temporal del sistema) con VISION_SPILL_MB como máximo (4096).
+MemoryGovernor& memoryGovernor();
+
+// Reserva con nombre que se devuelve al destruirse
+class MemoryReservation {
+public:
+    explicit MemoryReservation(const char* name) : name_(name) {}
+    ~MemoryReservation() { resize(0); }
+    MemoryReservation(const MemoryReservation&) = delete;
+    MemoryReservation& operator=(const MemoryReservation&) = delete;
+
+    // false (y sin cambios) si crece, no cabe y !force
+    bool   resize(size_t bytes, bool force = true);
+    size_t bytes() const;
+
+private:
+    const char* name_;
+    mutable std::mutex mutex_;
+    size_t bytes_ = 0;
+};
@@ -0,0 +1,135 @@
+#include "metrics.hpp"
+
+#include "frame_arena.hpp"
+#include "memory_governor.hpp"
+#include "stage_cache.hpp"
+
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr double kMB = 1024.0 * 1024.0;
+
+template <class T>
+T& lookup(std::mutex& m, std::map<std::string, std::unique_ptr<T>>& table, const std::string& name) {
+    std::lock_guard<std::mutex> lock(m);
+    auto& slot = table[name];
+    if (!slot) slot = std::make_unique<T>();
+    return *slot;
+}
+
+void addBuiltinSources(MetricsRegistry& r) {
+    r.addSource([](MetricsSnapshot& s) {
+        const StageCache* cache = stageCache();
+        if (!cache) return;
+        const StageCache::Counters c = cache->counters();
+        s["cache_etapas.aciertos"]    = double(c.hits);
+        s["cache_etapas.disco"]       = double(c.diskHits);
+        s["cache_etapas.intercambio"] = double(c.spillHits);
+        s["cache_etapas.fallos"]      = double(c.misses);
+        s["cache_etapas.mb"]          = c.bytes / kMB;
+    });
+    r.addSource([](MetricsSnapshot& s) {
+        const FrameArena* arena = frameArena();
+        if (!arena) return;
+        const FrameArena::Counters c = arena->counters();
+        s["arena.aciertos"] = double(c.hits);
+        s["arena.fallos"]   = double(c.misses);
+        s["arena.mb"]       = c.pooledBytes / kMB;
+    });
+    r.addSource([](MetricsSnapshot& s) {
+        const MemoryGovernor& g = memoryGovernor();
+        const MemoryGovernor::Counters c = g.counters();
+        s["memoria.en_uso_mb"]      = g.used() / kMB;
+        s["memoria.presupuesto_mb"] = g.budget() / kMB;   // 0 = sin límite
+        s["memoria.pico_mb"]        = c.peak / kMB;
+        s["memoria.expulsiones"]    = double(c.evictions);
+        s["memoria.volcado_mb"]     = c.spilled / kMB;
+        s["memoria.recargado_mb"]   = c.reloaded / kMB;
+        s["memoria.aplazadas"]      = double(c.denied);
+    });
+}
+
+} // namespace
+
+// ==========================================================
+// MetricTimer
+// ==========================================================
+void MetricTimer::record(double ms) {
+    const uint64_t v = ms > 0.0 ? static_cast<uint64_t>(ms * 1e6) : 0;
+    last_.store(v, std::memory_order_relaxed);
+    total_.fetch_add(v, std::memory_order_relaxed);
+    count_.fetch_add(1, std::memory_order_relaxed);
+    uint64_t prev = max_.load(std::memory_order_relaxed);
+    while (v > prev && !max_.compare_exchange_weak(prev, v, std::memory_order_relaxed)) {}
+}
+
+double MetricTimer::meanMs() const {
+    const uint64_t n = count();
+    return n ? total_.load(std::memory_order_relaxed) / 1e6 / n : 0.0;
+}
+
+// ==========================================================
+// MetricsRegistry
+// ==========================================================
+MetricCounter& MetricsRegistry::counter(const std::string& name) { return lookup(mutex_, counters_, name); }
+MetricGauge&   MetricsRegistry::gauge(const std::string& name)   { return lookup(mutex_, gauges_, name); }
+MetricTimer&   MetricsRegistry::timer(const std::string& name)   { return lookup(mutex_, timers_, name); }
+
+void MetricsRegistry::addSource(Source source) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    sources_.push_back(std::move(source));
+}
+
+MetricsSnapshot MetricsRegistry::snapshot() const {
+    MetricsSnapshot s;
+    std::vector<Source> sources;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const auto& [name, c] : counters_) s[name] = double(c->value());
+        for (const auto& [name, g] : gauges_) s[name] = double(g->value());
+        for (const auto& [name, t] : timers_) {
+            s[name + ".ultimo_ms"] = t->lastMs();
+            s[name + ".media_ms"]  = t->meanMs();
+            s[name + ".max_ms"]    = t->maxMs();
+            s[name + ".n"]         = double(t->count());
+        }
+        sources = sources_;
+    }
+    // Las fuentes toman sus propios cerrojos (caché, gobernador)
+    for (const auto& fill : sources) fill(s);
+    return s;
+}
+
+void MetricsRegistry::dump(std::ostream& os) const {
+    char value[32];
+    for (const auto& [name, v] : snapshot()) {
+        // Enteros (contadores, bytes) exactos; el resto con 6 cifras
+        const bool integral = std::floor(v) == v && std::abs(v) < 9007199254740992.0;   // 2^53
+        std::snprintf(value, sizeof(value), integral ? "%.0f" : "%.6g", v);
+        os << name << '\t' << value << '\n';
+    }
+}
+
+bool MetricsRegistry::dumpTo(const std::string& path) const {
+    std::error_code ec;
+    const fs::path parent = fs::path(path).parent_path();
+    if (!parent.empty()) fs::create_directories(parent, ec);
+    std::ofstream f(path);
+    dump(f);
+    return static_cast<bool>(f);
+}
+
+MetricsRegistry& metrics() {
+    static MetricsRegistry* registry = [] {
+        auto* r = new MetricsRegistry();
+        addBuiltinSources(*r);
+        return r;
+    }();
+    return *registry;
+}
@@ -0,0 +1,91 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// ==========================================================
+// Métricas del proceso
+// ==========================================================
+// Registro con nombre de lo que pasa en caliente (tiempos por etapa, forwards
+// DnCNN, aciertos de volumen, ocupación de los pools) para el panel de la
+// ventana Qt y los volcados (--metrics, botón "Volcar"). Cada métrica se busca
+// una vez (la referencia no cambia nunca) y después se actualiza con atómicos,
+// sin cerrojo. Lo que ya cuenta su dueño (caché de etapas, arena, gobernador
+// de memoria) no se duplica: se lee de una fuente al tomar la foto.
+
+// Monotónico
+class MetricCounter {
+public:
+    void     add(uint64_t n = 1) { value_.fetch_add(n, std::memory_order_relaxed); }
+    uint64_t value() const { return value_.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<uint64_t> value_{0};
+};
+
+// Valor actual (p.ej. workers ocupados)
+class MetricGauge {
+public:
+    void    set(int64_t v) { value_.store(v, std::memory_order_relaxed); }
+    void    add(int64_t d) { value_.fetch_add(d, std::memory_order_relaxed); }
+    int64_t value() const { return value_.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<int64_t> value_{0};
+};
+
+// Duraciones: última, media, máxima y número de muestras
+class MetricTimer {
+public:
+    void record(double ms);
+
+    uint64_t count() const { return count_.load(std::memory_order_relaxed); }
+    double   lastMs() const { return ns(last_); }
+    double   maxMs() const { return ns(max_); }
+    double   meanMs() const;
+
+private:
+    static double ns(const std::atomic<uint64_t>& v) { return v.load(std::memory_order_relaxed) / 1e6; }
+
+    std::atomic<uint64_t> count_{0};
+    std::atomic<uint64_t> total_{0};   // ns
+    std::atomic<uint64_t> last_{0};
+    std::atomic<uint64_t> max_{0};
+};
+
+// Foto: nombre → valor. Un temporizador "x" aparece como x.ultimo_ms,
+// x.media_ms, x.max_ms y x.n
+using MetricsSnapshot = std::map<std::string, double>;
+
+class MetricsRegistry {
+public:
+    using Source = std::function<void(MetricsSnapshot&)>;
+
+    MetricCounter& counter(const std::string& name);
+    MetricGauge&   gauge(const std::string& name);
+    MetricTimer&   timer(const std::string& name);
+
+    // Se llama en cada foto (fuera del cerrojo del registro)
+    void addSource(Source source);
+
+    MetricsSnapshot snapshot() const;
+    void dump(std::ostream& os) const;           // "nombre\tvalor", ordenado
+    bool dumpTo(const std::string& path) const;  // crea el directorio; false si falla
+
+private:
+    mutable std::mutex mutex_;
+    std::map<std::string, std::unique_ptr<MetricCounter>> counters_;
+    std::map<std::string, std::unique_ptr<MetricGauge>>   gauges_;
+    std::map<std::string, std::unique_ptr<MetricTimer>>   timers_;
+    std::vector<Source> sources_;
+};
+
+// Registro del proceso, con las fuentes de la caché de etapas, el arena y el
+// gobernador de memoria ya añadidas. Nunca se destruye.
+MetricsRegistry& metrics();
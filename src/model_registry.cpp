@@ -0,0 +1,204 @@
+#include "model_registry.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <limits>
+#include <sstream>
+#include <thread>
+
+#include <opencv2/core/utility.hpp>
+
+namespace fs = std::filesystem;
+using namespace cv;
+
+namespace {
+
+fs::path executableDir() {
+    std::error_code ec;
+    const fs::path exe = fs::read_symlink("/proc/self/exe", ec);
+    return ec ? fs::path() : exe.parent_path();
+}
+
+fs::path cacheFile() {
+    fs::path base;
+    if (const char* xdg = std::getenv("XDG_CACHE_HOME")) base = xdg;
+    else if (const char* home = std::getenv("HOME")) base = fs::path(home) / ".cache";
+    else base = fs::temp_directory_path();
+    return base / "vision_interciclo" / "dnn_config.yml";
+}
+
+// Identifica modelo + máquina: si algo cambia, se repite el benchmark
+std::string cacheKey(const std::string& modelPath) {
+    std::error_code ec;
+    const auto size  = fs::file_size(modelPath, ec);
+    const auto mtime = fs::last_write_time(modelPath, ec).time_since_epoch().count();
+    std::ostringstream os;
+    os << fs::absolute(modelPath).string() << '|' << size << '|' << mtime
+       << '|' << CV_VERSION << '|' << std::thread::hardware_concurrency();
+    return os.str();
+}
+
+bool isCpuTarget(int target) {
+    if (target == dnn::DNN_TARGET_CPU) return true;
+#if CV_VERSION_MAJOR > 4 || (CV_VERSION_MAJOR == 4 && CV_VERSION_MINOR >= 9)
+    if (target == dnn::DNN_TARGET_CPU_FP16) return true;
+#endif
+    return false;
+}
+
+double benchmarkConfig(const DnnConfig& cfg, const Mat& probe) {
+    DnnDenoiser den(cfg);
+    den.denoise(probe);   // calentamiento (reserva de memoria, compilación OpenVINO...)
+
+    double best = std::numeric_limits<double>::infinity();
+    for (int run = 0; run < 2; ++run) {
+        const auto t0 = std::chrono::steady_clock::now();
+        den.denoise(probe);
+        best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count());
+    }
+    return best;
+}
+
+} // namespace
+
+// ==========================================================
+// Descubrimiento de modelos
+// ==========================================================
+std::string findModelsDir() {
+    std::vector<fs::path> candidates;
+    if (const char* env = std::getenv("VISION_MODELS_DIR")) candidates.emplace_back(env);
+    const fs::path exeDir = executableDir();
+    if (!exeDir.empty()) {
+        candidates.push_back(exeDir / ".." / "models");
+        candidates.push_back(exeDir / "models");
+    }
+    candidates.emplace_back("models");
+    candidates.emplace_back("../models");
+
+    for (const auto& c : candidates) {
+        std::error_code ec;
+        if (fs::is_directory(c, ec)) return fs::canonical(c, ec).string();
+    }
+    return {};
+}
+
+std::vector<DnnModelInfo> listDnnModels(const std::string& modelsDir) {
+    std::vector<DnnModelInfo> models;
+    const std::string dir = modelsDir.empty() ? findModelsDir() : modelsDir;
+    if (dir.empty()) return models;
+
+    std::error_code ec;
+    for (const auto& entry : fs::directory_iterator(dir, ec)) {
+        std::string ext = entry.path().extension().string();
+        std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+        if (entry.is_regular_file() && ext == ".onnx")
+            models.push_back({ entry.path().stem().string(), entry.path().string() });
+    }
+    std::sort(models.begin(), models.end(),
+              [](const DnnModelInfo& a, const DnnModelInfo& b) { return a.name < b.name; });
+    return models;
+}
+
+std::string resolveModelPath(const std::string& nameOrPath) {
+    if (!nameOrPath.empty() && fs::is_regular_file(nameOrPath)) return nameOrPath;
+
+    const auto models = listDnnModels();
+    for (const auto& m : models) {
+        if (m.name == (nameOrPath.empty() ? "dncnn_compatible" : nameOrPath)) return m.path;
+    }
+    if (nameOrPath.empty() && !models.empty()) return models.front().path;
+
+    throw std::runtime_error("Modelo DnCNN no encontrado: " +
+                             (nameOrPath.empty() ? std::string("(directorio models/)") : nameOrPath));
+}
+
+// ==========================================================
+// Backends / targets
+// ==========================================================
+std::vector<DnnConfig> candidateDnnConfigs(const std::string& modelPath) {
+    std::vector<DnnConfig> out;
+
+    for (const auto& bt : dnn::getAvailableBackends()) {
+        const int backend = bt.first;
+        const int target  = bt.second;
+        const bool cpuBackend = backend == dnn::DNN_BACKEND_OPENCV ||
+                                backend == dnn::DNN_BACKEND_INFERENCE_ENGINE;
+        if (!cpuBackend || !isCpuTarget(target)) continue;
+
+        // Sin variantes de hilos: setNumThreads es de todo el proceso y el
+        // elegido cambiaría también NLMeans, CLAHE y el resto de parallel_for_
+        out.push_back({ modelPath, backend, target, 0 });
+    }
+    if (out.empty()) out.push_back({ modelPath, dnn::DNN_BACKEND_OPENCV, dnn::DNN_TARGET_CPU, 0 });
+    return out;
+}
+
+std::string describeDnnConfig(const DnnConfig& cfg) {
+    std::string s = cfg.backend == dnn::DNN_BACKEND_INFERENCE_ENGINE ? "OpenVINO" : "OpenCV";
+    s += cfg.target == dnn::DNN_TARGET_CPU ? "/CPU" : "/CPU_FP16";
+    if (cfg.precision == DnnPrecision::INT8) s += " INT8";
+    if (cfg.threads > 0) s += " x " + std::to_string(cfg.threads) + " hilos";
+    return s;
+}
+
+int parseDnnBackend(const std::string& name) {
+    if (name == "opencv")   return dnn::DNN_BACKEND_OPENCV;
+    if (name == "openvino") return dnn::DNN_BACKEND_INFERENCE_ENGINE;
+    throw std::runtime_error("Backend DNN desconocido: " + name);
+}
+
+int parseDnnTarget(const std::string& name) {
+    if (name == "cpu") return dnn::DNN_TARGET_CPU;
+#if CV_VERSION_MAJOR > 4 || (CV_VERSION_MAJOR == 4 && CV_VERSION_MINOR >= 9)
+    if (name == "fp16") return dnn::DNN_TARGET_CPU_FP16;
+#endif
+    throw std::runtime_error("Target DNN desconocido: " + name);
+}
+
+// ==========================================================
+// Selección con benchmark + caché en disco
+// ==========================================================
+DnnConfig selectDnnConfig(const std::string& modelPath, bool forceBenchmark) {
+    const std::string key = cacheKey(modelPath);
+    const fs::path cache = cacheFile();
+
+    if (!forceBenchmark && fs::exists(cache)) {
+        try {
+            FileStorage fsr(cache.string(), FileStorage::READ);
+            if (fsr.isOpened() && (std::string)fsr["key"] == key) {
+                // "threads" de cachés antiguas se ignora: ya no se elige
+                DnnConfig cfg{ modelPath, (int)fsr["backend"], (int)fsr["target"] };
+                return cfg;
+            }
+        } catch (const cv::Exception&) { /* caché corrupta → se repite */ }
+    }
+
+    Mat probe(256, 256, CV_8U);
+    randu(probe, Scalar(0), Scalar(256));
+
+    DnnConfig best{ modelPath };
+    double bestTime = std::numeric_limits<double>::infinity();
+    const int prevThreads = getNumThreads();
+    for (const auto& cfg : candidateDnnConfigs(modelPath)) {
+        try {
+            setNumThreads(prevThreads);   // todos medidos con los hilos del proceso
+            const double t = benchmarkConfig(cfg, probe);
+            std::cout << "[DNN] " << describeDnnConfig(cfg) << ": " << t * 1000.0 << " ms\n";
+            if (t < bestTime) { bestTime = t; best = cfg; }
+        } catch (const std::exception& e) {
+            std::cout << "[DNN] " << describeDnnConfig(cfg) << " no disponible: " << e.what() << "\n";
+        }
+    }
+    setNumThreads(prevThreads);
+    std::cout << "[DNN] Elegido: " << describeDnnConfig(best) << "\n";
+
+    std::error_code ec;
+    fs::create_directories(cache.parent_path(), ec);
+    FileStorage fsw(cache.string(), FileStorage::WRITE);
+    if (fsw.isOpened()) {
+        fsw << "key" << key << "backend" << best.backend << "target" << best.target;
+    }
+    return best;
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include <string>
+#include <vector>
+
+#include "dnn_denoising.hpp"
+
+// Modelo ONNX encontrado en el directorio de modelos
+struct DnnModelInfo {
+    std::string name;   // nombre de archivo sin extensión
+    std::string path;   // ruta absoluta
+};
+
+// Directorio de modelos: $VISION_MODELS_DIR, <exe>/../models, <exe>/models,
+// ./models o ../models (el primero que exista). Vacío si no hay ninguno.
+std::string findModelsDir();
+
+// Todos los .onnx del directorio (ordenados por nombre)
+std::vector<DnnModelInfo> listDnnModels(const std::string& modelsDir = "");
+
+// Ruta del modelo por nombre o ruta; "" → dncnn_compatible o el primero
+std::string resolveModelPath(const std::string& nameOrPath = "");
+
+// Combinaciones backend/target de CPU disponibles en este OpenCV
+// (OpenCV, OpenVINO si está compilado, FP16 si el target existe), todas con
+// threads = 0: los hilos solo se fijan a mano (--dnn-threads)
+std::vector<DnnConfig> candidateDnnConfigs(const std::string& modelPath);
+
+// "OpenCV/CPU", "OpenVINO/CPU", "OpenCV/CPU_FP16"... (+ " x N hilos")
+std::string describeDnnConfig(const DnnConfig& cfg);
+
+// Traducción de nombres de CLI ("opencv", "openvino" / "cpu", "fp16")
+int parseDnnBackend(const std::string& name);
+int parseDnnTarget(const std::string& name);
+
+// Mini-benchmark: prueba los candidatos sobre una imagen sintética y devuelve
+// el más rápido. El resultado se guarda en ~/.cache/vision_interciclo y se
+// reutiliza mientras no cambien el modelo, OpenCV o el número de núcleos.
+DnnConfig selectDnnConfig(const std::string& modelPath, bool forceBenchmark = false);
@@ -0,0 +1,114 @@
+#include "noise_estimate.hpp"
+
+#include "body_roi.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <stdexcept>
+#include <vector>
+
+using namespace cv;
+
+namespace {
+
+// |residuo| se cuenta con resolución de 1 HU; lo que pase de aquí es borde
+constexpr int kResidualBins = 4096;
+
+// Residuo de Immerkær: su desviación es 6σ (suma de cuadrados del núcleo = 36)
+template <typename T>
+uint64_t residualHistogram(const Mat& hu, const Rect& roi, std::vector<uint32_t>& hist) {
+    uint64_t n = 0;
+    for (int y = std::max(roi.y, 1); y < std::min(roi.y + roi.height, hu.rows - 1); ++y) {
+        const T* a = hu.ptr<T>(y - 1);
+        const T* b = hu.ptr<T>(y);
+        const T* c = hu.ptr<T>(y + 1);
+        for (int x = std::max(roi.x, 1); x < std::min(roi.x + roi.width, hu.cols - 1); ++x) {
+            if (b[x] <= kBodyThresholdHU) continue;
+            const double r = (double(a[x - 1]) + a[x + 1] + c[x - 1] + c[x + 1])
+                           - 2.0 * (double(a[x]) + b[x - 1] + b[x + 1] + c[x])
+                           + 4.0 * b[x];
+            const int bin = std::min(kResidualBins - 1, static_cast<int>(std::fabs(r)));
+            ++hist[bin];
+            ++n;
+        }
+    }
+    return n;
+}
+
+} // namespace
+
+double estimateNoiseHU(const Mat& hu, const Rect& roi0) {
+    CV_Assert(hu.type() == CV_16S || hu.type() == CV_32F);
+    const Rect full(0, 0, hu.cols, hu.rows);
+    const Rect roi = roi0.empty() ? full : (roi0 & full);
+
+    thread_local std::vector<uint32_t> hist;
+    hist.assign(kResidualBins, 0);
+    const uint64_t n = hu.type() == CV_16S ? residualHistogram<short>(hu, roi, hist)
+                                           : residualHistogram<float>(hu, roi, hist);
+    if (n == 0) return -1.0;
+
+    // Mediana de |r| (interpolada dentro del bin) → σ = 1.4826 · MAD / 6
+    const uint64_t half = (n + 1) / 2;
+    uint64_t acc = 0;
+    int bin = 0;
+    while (acc + hist[bin] < half) acc += hist[bin++];
+    const double median = bin + (half - acc - 0.5) / std::max<uint32_t>(hist[bin], 1);
+    return 1.4826 * median / 6.0;
+}
+
+DenoiseDecision decideDenoise(double sigmaHU, float windowWidth, float fixedH, const DenoisePolicy& policy) {
+    DenoiseDecision d;
+    d.nlmH = fixedH;
+    if (policy.mode == DenoiseMode::Full || sigmaHU < 0.0) return d;   // sin estimación: todo
+
+    d.sigmaHU = sigmaHU;
+    if (sigmaHU < policy.cleanSigmaHU) {
+        d.runNlm = d.runDnn = false;
+        return d;
+    }
+    const double sigma8 = sigmaHU * 255.0 / windowWidth;
+    d.nlmH = static_cast<float>(std::clamp(policy.nlmHPerSigma * sigma8,
+                                           double(policy.nlmHMin), double(policy.nlmHMax)));
+    d.runDnn = sigmaHU >= policy.dnnSigmaHU;
+    return d;
+}
+
+DenoiseMode parseDenoiseMode(const std::string& s) {
+    if (s == "full")     return DenoiseMode::Full;
+    if (s == "adaptive") return DenoiseMode::Adaptive;
+    throw std::runtime_error("Política de filtrado desconocida: " + s + " (full|adaptive)");
+}
+
+const char* denoiseModeName(DenoiseMode m) {
+    return m == DenoiseMode::Adaptive ? "adaptive" : "full";
+}
+
+namespace {
+std::atomic<int> g_defaultMode{ -1 };   // -1 → aún sin decidir
+}
+
+DenoiseMode defaultDenoiseMode() {
+    int mode = g_defaultMode.load();
+    if (mode < 0) {
+        DenoiseMode fromEnv = DenoiseMode::Full;
+        if (const char* env = std::getenv("VISION_DENOISE_POLICY"); env && *env) {
+            try {
+                fromEnv = parseDenoiseMode(env);
+            } catch (const std::exception& e) {
+                std::fprintf(stderr, "[AVISO] VISION_DENOISE_POLICY: %s (se usa full)\n", e.what());
+            }
+        }
+        // Si otro hilo (o setDefaultDenoiseMode) se adelantó, vale lo suyo
+        g_defaultMode.compare_exchange_strong(mode, static_cast<int>(fromEnv));
+        mode = g_defaultMode.load();
+    }
+    return static_cast<DenoiseMode>(mode);
+}
+
+void setDefaultDenoiseMode(DenoiseMode mode) {
+    g_defaultMode.store(static_cast<int>(mode));
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include <string>
+#include <opencv2/core.hpp>
+
+// ==========================================================
+// Estimación de ruido y elección del filtrado por corte
+// ==========================================================
+// σ del ruido en HU en una pasada: residuo paso alto con el núcleo de
+// Immerkær (1 -2 1 / -2 4 -2 / 1 -2 1, suprime planos y rampas) y MAD del
+// residuo (robusta a los bordes que se cuelan). Solo cuentan los píxeles de
+// cuerpo (> kBodyThresholdHU): el aire fuera del campo es constante y
+// llevaría la mediana a 0.
+// CV_16S o CV_32F; 'roi' vacía → todo el corte. -1 si no hay cuerpo.
+double estimateNoiseHU(const cv::Mat& hu, const cv::Rect& roi = {});
+
+enum class DenoiseMode {
+    Full,       // siempre Gauss + NLMeans (h fijo) + DnCNN: lo de siempre
+    Adaptive    // según el σ estimado de cada corte (DenoisePolicy)
+};
+
+// Modo por defecto: el fijado con setDefaultDenoiseMode (--denoise-policy),
+// si no VISION_DENOISE_POLICY (full|adaptive), si no Full
+DenoiseMode defaultDenoiseMode();
+void        setDefaultDenoiseMode(DenoiseMode mode);
+
+// Política del modo Adaptive. Umbrales en HU (σ del ruido)
+struct DenoisePolicy {
+    DenoiseMode mode = defaultDenoiseMode();
+    double cleanSigmaHU = 8.0;    // por debajo: sin NLMeans ni DnCNN (copias de la original)
+    double dnnSigmaHU   = 20.0;   // desde aquí DnCNN; por debajo su evidencia = NLMeans
+    double nlmHPerSigma = 0.8;    // h de NLMeans = k · σ en niveles de gris
+    float  nlmHMin = 3.0f, nlmHMax = 20.0f;
+};
+
+// Qué se ejecuta en un corte
+struct DenoiseDecision {
+    double sigmaHU = -1.0;   // -1 → no estimado (modo Full)
+    bool   runNlm  = true;
+    bool   runDnn  = true;
+    float  nlmH    = 10.0f;
+};
+
+// windowWidth: ventaneo de las evidencias (σ en HU → niveles de gris);
+// fixedH: h del modo Full
+DenoiseDecision decideDenoise(double sigmaHU, float windowWidth, float fixedH, const DenoisePolicy& policy);
+
+// "full" | "adaptive"; lanza runtime_error si no se reconoce
+DenoiseMode parseDenoiseMode(const std::string& s);
+const char* denoiseModeName(DenoiseMode m);
@@ -0,0 +1,289 @@
+#include "pipeline.hpp"
+
+#include "itk_opencv_bridge.hpp"
+#include "dnn_denoising.hpp"
+#include "tissue_stats.hpp"
+#include "body_roi.hpp"
+#include "stage_cache.hpp"
+#include "metrics.hpp"
+
+#include <chrono>
+
+#include <opencv2/imgproc.hpp>
+#include <opencv2/photo.hpp>
+
+using namespace cv;
+
+const char* const kPipelineStageNames[kNumPipelineStages] = {
+    "roi", "ruido", "ventaneo", "gauss", "nlmeans", "dncnn", "canny", "morfologia",
+    "etiquetas", "overlays", "recomposicion", "estadisticas"
+};
+
+namespace {
+
+// Temporales del pipeline, uno por hilo: se reutilizan entre cortes
+struct PipelineScratch {
+    Mat huGauss;
+    Mat huDnnProxy;
+    AnatomyMasks masks;           // umbral + morfología antes de pasar a tramos
+    std::vector<uint8_t> packed;  // etiquetas serializadas para la caché
+    PipelineResults roiResults;   // resultados sobre el recorte (cuerpo + halo)
+};
+thread_local PipelineScratch t_scratch;
+
+// Ejecuta 'compute' (que escribe en 'out') salvo que la clave ya esté en caché
+template <class F>
+void cachedStage(StageCache* cache, StageKey key, Mat& out, F&& compute) {
+    if (cache && cache->get(key, out)) return;
+    compute();
+    if (cache) cache->put(key, out);
+}
+
+// Las etiquetas se guardan serializadas (unos KB) en un Mat 1xN
+template <class F>
+void cachedLabels(StageCache* cache, StageKey key, RleLabelMap& out, std::vector<uint8_t>& packed,
+                  F&& compute) {
+    std::vector<Mat> hit;
+    if (cache && cache->get(key, hit) && hit.size() == 1 &&
+        RleLabelMap::deserialize(hit[0].ptr<uint8_t>(), hit[0].total(), out))
+        return;
+    compute();
+    if (cache) {
+        out.serialize(packed);
+        cache->put(key, { Mat(1, static_cast<int>(packed.size()), CV_8U, packed.data()) });
+    }
+}
+
+// Suma a timings->ms[stage] lo que tarde 'f' (sin timings, solo lo ejecuta)
+template <class F>
+void timed(StageTimings* timings, PipelineStage stage, F&& f) {
+    if (!timings) {
+        f();
+        return;
+    }
+    const auto t0 = std::chrono::steady_clock::now();
+    f();
+    timings->ms[stage] += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+}
+
+// Última pasada → métricas "etapa.<nombre>" y "pipeline.total"
+void publishTimings(const StageTimings& run) {
+    static const std::array<MetricTimer*, kNumPipelineStages + 1> timers = [] {
+        std::array<MetricTimer*, kNumPipelineStages + 1> a{};
+        for (int i = 0; i < kNumPipelineStages; ++i)
+            a[i] = &metrics().timer(std::string("etapa.") + kPipelineStageNames[i]);
+        a[kNumPipelineStages] = &metrics().timer("pipeline.total");
+        return a;
+    }();
+    for (int i = 0; i < kNumPipelineStages; ++i) timers[i]->record(run.ms[i]);
+    timers[kNumPipelineStages]->record(run.totalMs);
+}
+
+// Clave de una etapa: clave de la entrada + nombre de la etapa (+ parámetros)
+KeyHasher stageKey(StageKey input, const char* stage) {
+    KeyHasher h;
+    h.add(input).add(stage);
+    return h;
+}
+
+// Las 13 evidencias sobre la imagen HU tal cual (corte completo o recorte)
+void runStages(const Mat& hu, Denoiser* denoiser, const PipelineParams& p, const DenoiseDecision& dd,
+               StageCache* cache, PipelineResults& out, PipelineScratch& s, StageTimings* t) {
+    auto& img = out.images;
+
+    // Sin caché no hace falta hashear nada
+    const StageKey kIn = cache ? hashMat(hu) : 0;
+    KeyHasher thr;
+    thr.bytes(&p.tissue, sizeof(p.tissue)).add(p.minComponentPx);
+    const StageKey kThr = thr.key();
+
+    const StageKey k0 = stageKey(kIn, "window").add(p.windowCenter).add(p.windowWidth).key();
+    const StageKey k1 = stageKey(k0, "gauss5").add(p.gaussSigma).key();
+    const StageKey kCopy = stageKey(k0, "copy").key();
+    const StageKey k2 = dd.runNlm ? stageKey(k0, "nlmeans").add(dd.nlmH).add(p.nlmTemplate).add(p.nlmSearch).key()
+                                  : kCopy;
+    // Sin DnCNN (o no hace falta en este corte): la mejor evidencia disponible
+    const bool runDnn = denoiser && dd.runDnn;
+    StageKey k3 = dd.runDnn ? kCopy : k2;
+    if (runDnn) {
+        const DnnConfig& dc = denoiser->config();
+        k3 = stageKey(k0, "dncnn").add(dc.modelPath).add(dc.backend).add(dc.target)
+                                  .add(static_cast<int>(dc.precision)).add(dc.calibDir).key();
+    }
+
+    // ================== GRUPO A: LIMPIEZA ==================
+    timed(t, STAGE_WINDOW, [&] {
+        cachedStage(cache, k0, img[0], [&] {                                      // 1
+            huTo8u(hu, p.windowCenter, p.windowWidth, img[0]);
+        });
+    });
+    timed(t, STAGE_GAUSS, [&] {
+        cachedStage(cache, k1, img[1], [&] {                                      // 2
+            GaussianBlur(img[0], img[1], Size(5, 5), p.gaussSigma);
+        });
+    });
+    timed(t, STAGE_NLMEANS, [&] {
+        if (dd.runNlm) {                                                          // 3
+            cachedStage(cache, k2, img[2], [&] {
+                fastNlMeansDenoising(img[0], img[2], dd.nlmH, p.nlmTemplate, p.nlmSearch);
+            });
+        } else {
+            img[0].copyTo(img[2]);
+        }
+    });
+    timed(t, STAGE_DNCNN, [&] {
+        if (runDnn) {                                                             // 4
+            cachedStage(cache, k3, img[3], [&] { img[3] = denoiser->denoise(img[0]); });
+        } else {
+            img[dd.runDnn ? 0 : 2].copyTo(img[3]);
+        }
+    });
+
+    // ========== GRUPO B: MORFOLOGÍA + BORDES ==============
+    const Mat k = getStructuringElement(MORPH_RECT, Size(p.morphKernel, p.morphKernel));
+    timed(t, STAGE_CANNY, [&] {
+        cachedStage(cache, stageKey(k1, "canny").add(p.cannyLow).add(p.cannyHigh).key(), img[4], [&] {
+            Canny(img[1], img[4], p.cannyLow, p.cannyHigh);                       // 5
+        });
+    });
+    timed(t, STAGE_MORPHOLOGY, [&] {
+        cachedStage(cache, stageKey(k0, "tophat").add(p.morphKernel).key(), img[5], [&] {
+            morphologyEx(img[0], img[5], MORPH_TOPHAT, k);                        // 6
+        });
+        cachedStage(cache, stageKey(k0, "blackhat").add(p.morphKernel).key(), img[6], [&] {
+            morphologyEx(img[0], img[6], MORPH_BLACKHAT, k);                      // 7
+        });
+        cachedStage(cache, stageKey(k0, "erode").add(p.morphKernel).key(), img[7], [&] {
+            erode(img[0], img[7], k);                                             // 8
+        });
+        cachedStage(cache, stageKey(k0, "dilate").add(p.morphKernel).key(), img[8], [&] {
+            dilate(img[0], img[8], k);                                            // 9
+        });
+    });
+
+    // ================== GRUPO C: SEGMENTACIÓN =============
+    // 10. Seg. en original
+    const StageKey kRaw = stageKey(kIn, "labels").add(kThr).key();
+    const StageKey kGauss = stageKey(kIn, "labels_gauss3").add(1.0).add(kThr).key();
+    const StageKey kDnn = stageKey(kIn, "labels_gauss3").add(0.8).add(kThr).key();
+    timed(t, STAGE_LABELS, [&] {
+        cachedLabels(cache, kRaw, out.labelsRaw, s.packed, [&] {
+            generateAnatomicalLabelsHU(hu, out.labelsRaw, p.tissue, s.masks);
+            if (p.minComponentPx > 0) out.labelsRaw = removeSmallComponents(out.labelsRaw, p.minComponentPx);
+        });
+
+        // 11. Seg. en Gauss (segmentación clásica). En CV_16S el suavizado
+        // redondea a 1 HU y mueve algún píxel junto a los umbrales: la
+        // regresión lo acota frente a CV_32F (kHu16sTolerance).
+        cachedLabels(cache, kGauss, out.labelsGauss, s.packed, [&] {
+            GaussianBlur(hu, s.huGauss, Size(3, 3), 1.0);
+            generateAnatomicalLabelsHU(s.huGauss, out.labelsGauss, p.tissue, s.masks);
+            if (p.minComponentPx > 0) out.labelsGauss = removeSmallComponents(out.labelsGauss, p.minComponentPx);
+        });
+
+        // 13. Seg. en DnCNN (segmentación avanzada)
+        cachedLabels(cache, kDnn, out.labelsDnn, s.packed, [&] {
+            GaussianBlur(hu, s.huDnnProxy, Size(3, 3), 0.8);
+            generateAnatomicalLabelsHU(s.huDnnProxy, out.labelsDnn, p.tissue, s.masks);
+            if (p.minComponentPx > 0) out.labelsDnn = removeSmallComponents(out.labelsDnn, p.minComponentPx);
+        });
+    });
+
+    // Overlays 10..13 (12 usa las mismas máscaras que 11)
+    timed(t, STAGE_OVERLAYS, [&] {
+        cachedStage(cache, stageKey(k0, "overlay").add(kRaw).key(), img[9], [&] {
+            colorizeAndOverlay(img[0], out.labelsRaw, img[9]);
+        });
+        cachedStage(cache, stageKey(k1, "overlay").add(kGauss).key(), img[10], [&] {
+            colorizeAndOverlay(img[1], out.labelsGauss, img[10]);
+        });
+        cachedStage(cache, stageKey(k2, "overlay").add(kGauss).key(), img[11], [&] {
+            colorizeAndOverlay(img[2], out.labelsGauss, img[11]);
+        });
+        cachedStage(cache, stageKey(k3, "overlay").add(kDnn).key(), img[12], [&] {
+            colorizeAndOverlay(img[3], out.labelsDnn, img[12]);
+        });
+    });
+}
+
+} // namespace
+
+void runSlicePipeline(const cv::Mat& hu, Denoiser* denoiser, PipelineResults& out,
+                      const PipelineOptions& opts) {
+    CV_Assert(hu.type() == CV_32F || hu.type() == CV_16S);
+    PipelineScratch& s = t_scratch;
+    const PipelineParams& p = opts.params;
+    StageCache* cache = opts.useCache ? stageCache() : nullptr;
+    const Rect full(0, 0, hu.cols, hu.rows);
+
+    // Tiempos de esta pasada desde la entrada: siempre (unas 20 lecturas de
+    // reloj por corte) para las métricas; se suman a opts.timings si lo hay
+    StageTimings run;
+    StageTimings* t = &run;
+    const auto t0 = std::chrono::steady_clock::now();
+
+    Rect body = full;
+    if (opts.bodyRoi) {
+        timed(t, STAGE_ROI, [&] { body = opts.roi.empty() ? detectBodyRoi(hu) : (opts.roi & full); });
+        if (body.empty()) body = full;   // sin cuerpo detectable: corte completo
+    }
+    const Rect work = expandRoi(body, kRoiHalo, hu.size());
+    out.roi = body;
+
+    // Política de filtrado: σ del ruido sobre el cuerpo (solo en Adaptive)
+    double sigma = -1.0;
+    if (p.denoise.mode == DenoiseMode::Adaptive) timed(t, STAGE_NOISE, [&] { sigma = estimateNoiseHU(hu, body); });
+    out.denoise = decideDenoise(sigma, p.windowWidth, p.nlmH, p.denoise);
+
+    auto finish = [&] {
+        run.totalMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+        publishTimings(run);
+        if (!opts.timings) return;
+        for (int i = 0; i < kNumPipelineStages; ++i) opts.timings->ms[i] += run.ms[i];
+        opts.timings->totalMs += run.totalMs;
+    };
+
+    if (work == full) {
+        runStages(hu, denoiser, p, out.denoise, cache, out, s, t);
+        timed(t, STAGE_STATS, [&] { out.stats = computeSliceStats(hu, out.labelsRaw); });
+        finish();
+        return;
+    }
+
+    // Procesado solo del recorte (cuerpo + halo) ...
+    PipelineResults& r = s.roiResults;
+    runStages(hu(work), denoiser, p, out.denoise, cache, r, s, t);
+    const Rect inner = body - work.tl();   // cuerpo en coordenadas del recorte
+    const auto tCompose = std::chrono::steady_clock::now();
+
+    // ... y vuelta al tamaño completo. Fuera del cuerpo: la original ventaneada
+    // para las evidencias grises, 0 para bordes/TopHat/BlackHat y sin máscaras.
+    auto& img = out.images;
+    huTo8u(hu, p.windowCenter, p.windowWidth, img[0]);
+    for (int i : { 1, 2, 3, 7, 8 }) {
+        img[0].copyTo(img[i]);
+        r.images[i](inner).copyTo(img[i](body));
+    }
+    for (int i : { 4, 5, 6 }) {
+        img[i].create(full.size(), CV_8U);
+        img[i].setTo(0);
+        r.images[i](inner).copyTo(img[i](body));
+    }
+    for (int i : { 9, 10, 11, 12 }) {
+        cvtColor(img[i - 9], img[i], COLOR_GRAY2BGR);   // base gris de cada overlay
+        r.images[i](inner).copyTo(img[i](body));
+    }
+
+    // Etiquetas: solo la caja del cuerpo, desplazada al corte completo
+    const RleLabelMap bodyLabels = r.labelsRaw.crop(inner);
+    out.labelsRaw   = bodyLabels.embedded(full.size(), body.tl());
+    out.labelsGauss = r.labelsGauss.crop(inner).embedded(full.size(), body.tl());
+    out.labelsDnn   = r.labelsDnn.crop(inner).embedded(full.size(), body.tl());
+
+    t->ms[STAGE_COMPOSE] +=
+        std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - tCompose).count();
+
+    // Fuera del cuerpo no hay etiquetas: basta con recorrer la caja
+    timed(t, STAGE_STATS, [&] { out.stats = computeSliceStats(hu(body), bodyLabels); });
+    finish();
+}
@@ -0,0 +1,92 @@
+#pragma once
+#include <array>
+#include <opencv2/core.hpp>
+
+#include "Stats.hpp"
+#include "highlight.hpp"
+#include "connected_components.hpp"
+#include "noise_estimate.hpp"
+
+class Denoiser;
+
+constexpr int kNumEvidences = 13;
+
+// Halo alrededor del cuerpo (opts.bodyRoi): cubre el alcance de la etapa más
+// ancha (DnCNN: 17 convoluciones 3x3 → 17 px; NLMeans 7/21 → 13 px). Los
+// filtros locales salen idénticos a procesar el corte completo; Canny (la
+// histéresis sigue bordes fuera del recorte) y el filtro de islas pequeñas
+// pueden cambiar algún píxel. La regresión mide la diferencia.
+constexpr int kRoiHalo = 24;
+
+// Ventana de visualización de las evidencias grises (tejido blando)
+constexpr float kDisplayWindowCenter = 40.0f;
+constexpr float kDisplayWindowWidth  = 400.0f;
+
+// Resultado del pipeline para un corte (las 13 evidencias + etiquetas + stats).
+// Los tejidos van como mapas por tramos (1 grasa, 2 músculo, 3 hueso).
+//  0 Original        1 Gauss         2 NLMeans        3 DnCNN
+//  4 Bordes Canny    5 TopHat        6 BlackHat       7 Erosión     8 Dilatación
+//  9 Seg. Original  10 Seg. Gauss   11 Seg. NLMeans  12 Seg. DnCNN
+struct PipelineResults {
+    std::array<cv::Mat, kNumEvidences> images;
+    RleLabelMap  labelsRaw;
+    RleLabelMap  labelsGauss;
+    RleLabelMap  labelsDnn;
+    SliceStats   stats;
+    cv::Rect     roi;   // zona procesada (cuerpo); fuera se rellena con fondo
+    DenoiseDecision denoise;   // σ estimado y filtros ejecutados
+};
+
+// Parámetros de las etapas (valores por defecto = los de siempre)
+struct PipelineParams {
+    float  windowCenter = kDisplayWindowCenter;   // ventaneo de la evidencia 1
+    float  windowWidth  = kDisplayWindowWidth;
+    double gaussSigma   = 1.0;                    // evidencia 2 (kernel 5x5)
+    float  nlmH         = 10.0f;                  // evidencia 3: h (modo Full), plantilla, búsqueda
+    int    nlmTemplate  = 7;
+    int    nlmSearch    = 21;
+    double cannyLow     = 50.0;                   // evidencia 5 (sobre Gauss)
+    double cannyHigh    = 150.0;
+    int    morphKernel  = 3;                      // evidencias 6..9
+    TissueThresholds tissue;                      // etiquetas de las evidencias 10..13
+    int    minComponentPx = kMinComponentPx;      // islas de tejido más pequeñas se descartan (0 → no)
+    // Evidencias 3 y 4 según el ruido del corte (Adaptive): limpio → copias de
+    // la original; ruido medio → NLMeans con h ∝ σ y DnCNN = NLMeans; alto → todo
+    DenoisePolicy denoise;
+};
+
+// Etapas con tiempo propio (presupuestos de latencia de la regresión)
+enum PipelineStage {
+    STAGE_ROI, STAGE_NOISE,   // caja del cuerpo y σ del ruido (antes de filtrar)
+    STAGE_WINDOW, STAGE_GAUSS, STAGE_NLMEANS, STAGE_DNCNN, STAGE_CANNY, STAGE_MORPHOLOGY,
+    STAGE_LABELS, STAGE_OVERLAYS, STAGE_COMPOSE, STAGE_STATS,
+    kNumPipelineStages
+};
+extern const char* const kPipelineStageNames[kNumPipelineStages];
+
+// Milisegundos por etapa (se suman: se puede acumular una serie entera)
+struct StageTimings {
+    std::array<double, kNumPipelineStages> ms{};
+    double totalMs = 0.0;
+};
+
+struct PipelineOptions {
+    // Procesar solo dentro de la caja del cuerpo (aire y camilla fuera)
+    bool     bodyRoi = true;
+    // ROI fija (p.ej. una para todo el volumen); vacía → se detecta por corte
+    cv::Rect roi;
+    PipelineParams params;
+    // Reutilizar salidas de etapas ya calculadas (stageCache()): cada etapa se
+    // identifica por la clave de sus entradas + sus parámetros, así que cambiar
+    // un parámetro solo recalcula esa etapa y las que dependen de ella.
+    bool     useCache = true;
+    // Si no es nullptr, se le suman los tiempos de cada etapa
+    StageTimings* timings = nullptr;
+};
+
+// Ejecuta el pipeline completo sobre un corte en HU (CV_16S nativo o CV_32F).
+// Los Mats de 'out' se reutilizan si ya tienen la geometría correcta, así que
+// pasar el mismo PipelineResults corte tras corte no vuelve a reservar memoria.
+// denoiser == nullptr → la evidencia DnCNN es una copia de la original.
+void runSlicePipeline(const cv::Mat& hu, Denoiser* denoiser, PipelineResults& out,
+                      const PipelineOptions& opts = {});
@@ -3,11 +3,13 @@
 
 using namespace cv;
 
+// Devuelve una vista de 'in' si ya es gris 8-bit (sin copiar): los llamadores
+// no deben modificar el resultado en sitio.
 static Mat toGray8(const Mat& in) {
   CV_Assert(!in.empty());
   Mat g;
   if (in.channels() == 3) cvtColor(in, g, COLOR_BGR2GRAY);
-  else g = in.clone();
+  else g = in;
 
   if (g.depth() != CV_8U) {
     double minv, maxv; minMaxLoc(g, &minv, &maxv);
@@ -33,9 +35,10 @@ cv::Mat denoiseClassic(const cv::Mat& g) {
 
 cv::Mat edgesCanny(const cv::Mat& g, double lo, double hi) {
   Mat gray = toGray8(g);
-  GaussianBlur(gray, gray, Size(3,3), 0.8);
+  Mat blurred;
+  GaussianBlur(gray, blurred, Size(3,3), 0.8);
   Mat edges;
-  Canny(gray, edges, lo, hi, 3, true);
+  Canny(blurred, edges, lo, hi, 3, true);
   return edges;
 }
 
@@ -45,15 +48,15 @@ static Mat kernelEllipse(int k) {
 }
 
 cv::Mat morphOpen(const cv::Mat& g, int k) {
-  Mat bin = toGray8(g);
-  threshold(bin, bin, 0, 255, THRESH_BINARY | THRESH_OTSU);
+  Mat bin;
+  threshold(toGray8(g), bin, 0, 255, THRESH_BINARY | THRESH_OTSU);
   Mat out; morphologyEx(bin, out, MORPH_OPEN, kernelEllipse(k));
   return out;
 }
 
 cv::Mat morphClose(const cv::Mat& g, int k) {
-  Mat bin = toGray8(g);
-  threshold(bin, bin, 0, 255, THRESH_BINARY | THRESH_OTSU);
+  Mat bin;
+  threshold(toGray8(g), bin, 0, 255, THRESH_BINARY | THRESH_OTSU);
   Mat out; morphologyEx(bin, out, MORPH_CLOSE, kernelEllipse(k));
   return out;
 }
\ No newline at end of file
@@ -0,0 +1,190 @@
+#include "projection.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <stdexcept>
+
+#include <opencv2/core/utility.hpp>
+
+using namespace cv;
+
+Projection parseProjection(const std::string& name) {
+    if (name == "mip" || name == "max")   return Projection::Max;
+    if (name == "minip" || name == "min") return Projection::Min;
+    if (name == "mean" || name == "media") return Projection::Mean;
+    throw std::runtime_error("Proyección desconocida: " + name + " (mip|minip|mean)");
+}
+
+const char* projectionName(Projection p) {
+    switch (p) {
+    case Projection::Max:  return "mip";
+    case Projection::Min:  return "minip";
+    case Projection::Mean: return "mean";
+    }
+    return "?";
+}
+
+// ==========================================================
+// SlabProjector
+// ==========================================================
+// Corte i del eje del plano en HU, sin remuestrear (vista en axial)
+const Mat& SlabProjector::plane(int i) {
+    ++lastOps_;
+    if (plane_ == Plane::Axial) {
+        const auto size = vol_->GetBufferedRegion().GetSize();
+        const int nx = static_cast<int>(size[0]), ny = static_cast<int>(size[1]);
+        planeTmp_ = Mat(ny, nx, CV_16S, vol_->GetBufferPointer() + static_cast<size_t>(i) * nx * ny);
+    } else {
+        reformatSlice(vol_, plane_, i, planeTmp_, /*isotropic*/false);
+    }
+    return planeTmp_;
+}
+
+void SlabProjector::combine(const Mat& a, const Mat& b, Mat& out) {
+    if (mode_ == Projection::Max) max(a, b, out);
+    else                          min(a, b, out);
+}
+
+// Sufijos del bloque: suffix_[j] = máx/mín de [inicio + j, fin del bloque]
+void SlabProjector::buildSuffix(int block) {
+    const int begin = block * thickness_;
+    const int end   = std::min(n_, begin + thickness_);
+    suffix_.resize(thickness_);
+    plane(end - 1).copyTo(suffix_[end - 1 - begin]);
+    for (int z = end - 2; z >= begin; --z) combine(plane(z), suffix_[z + 1 - begin], suffix_[z - begin]);
+    suffixBlock_ = block;
+}
+
+// Prefijos del bloque: prefix_[j] = máx/mín de [inicio del bloque, inicio + j]
+void SlabProjector::buildPrefix(int block) {
+    const int begin = block * thickness_;
+    const int end   = std::min(n_, begin + thickness_);
+    prefix_.resize(thickness_);
+    plane(begin).copyTo(prefix_[0]);
+    for (int z = begin + 1; z < end; ++z) combine(plane(z), prefix_[z - 1 - begin], prefix_[z - begin]);
+    prefixBlock_ = block;
+}
+
+void SlabProjector::project(const ImageType3D::Pointer& vol, Plane plane, int index, int thickness,
+                            Projection mode, Mat& out, bool isotropic) {
+    const int n = planeSliceCount(vol, plane);
+    if (index < 0 || index >= n) throw std::runtime_error("Proyección: índice fuera de rango");
+    const int N = std::clamp(thickness, 1, n);
+    const int first = std::clamp(index - N / 2, 0, n - N);
+
+    // Otro volumen/plano/grosor/modo: se descarta lo acumulado
+    if (vol.GetPointer() != vol_.GetPointer() || vol->GetBufferPointer() != buffer_ ||
+        vol->GetMTime() != mtime_ || plane != plane_ || N != thickness_ || mode != mode_) {
+        vol_ = vol;
+        buffer_ = vol->GetBufferPointer();
+        mtime_ = vol->GetMTime();
+        plane_ = plane;
+        n_ = n;
+        thickness_ = N;
+        mode_ = mode;
+        suffixBlock_ = prefixBlock_ = sumFirst_ = -1;
+    }
+    lastOps_ = 0;
+
+    if (N == 1) {
+        this->plane(first).copyTo(raw_);
+    } else if (mode == Projection::Mean) {
+        if (sumFirst_ >= 0 && std::abs(first - sumFirst_) == 1) {
+            // Deslizamiento de un corte: sale uno, entra otro
+            const bool forward = first > sumFirst_;
+            subtract(sum_, this->plane(forward ? sumFirst_ : sumFirst_ + N - 1), sum_, noArray(), CV_32S);
+            add(sum_, this->plane(forward ? first + N - 1 : first), sum_, noArray(), CV_32S);
+        } else if (first != sumFirst_) {
+            this->plane(first).convertTo(sum_, CV_32S);
+            for (int z = first + 1; z < first + N; ++z) add(sum_, this->plane(z), sum_, noArray(), CV_32S);
+        }
+        sumFirst_ = first;
+        sum_.convertTo(raw_, CV_16S, 1.0 / N);
+    } else {
+        const int k = first / N;
+        if (suffixBlock_ != k) buildSuffix(k);
+        if (first == k * N) {
+            suffix_[0].copyTo(raw_);   // la losa es el bloque entero
+        } else {
+            if (prefixBlock_ != k + 1) buildPrefix(k + 1);
+            combine(suffix_[first - k * N], prefix_[first + N - 1 - (k + 1) * N], raw_);
+            ++lastOps_;
+        }
+    }
+
+    if (isotropic && plane != Plane::Axial) toIsotropic(vol, plane, raw_, out);
+    else raw_.copyTo(out);
+}
+
+// ==========================================================
+// Proyección de todo el volumen
+// ==========================================================
+namespace {
+
+// Filas por banda en axial: acumulador + banda de entrada caben en L2
+constexpr int kBandRows = 16;
+
+int reduceOp(Projection mode) {
+    switch (mode) {
+    case Projection::Max:  return REDUCE_MAX;
+    case Projection::Min:  return REDUCE_MIN;
+    case Projection::Mean: return REDUCE_AVG;
+    }
+    return REDUCE_MAX;
+}
+
+} // namespace
+
+void volumeProjection(const ImageType3D::Pointer& vol, Plane plane, Projection mode, Mat& out, bool isotropic) {
+    if (vol.IsNull()) throw std::runtime_error("Proyección: volumen vacío");
+    const auto size = vol->GetBufferedRegion().GetSize();
+    const int nx = static_cast<int>(size[0]), ny = static_cast<int>(size[1]), nz = static_cast<int>(size[2]);
+    short* data = vol->GetBufferPointer();
+    auto planeZ = [&](int z) { return Mat(ny, nx, CV_16S, data + static_cast<size_t>(z) * nx * ny); };
+
+    Mat raw;
+    if (plane == Plane::Axial) {
+        // A lo largo de z: cada banda de filas se reduce sobre todos los planos
+        // con el acumulador en caché
+        raw.create(ny, nx, CV_16S);
+        Mat sum;
+        if (mode == Projection::Mean) sum.create(ny, nx, CV_32S);
+        parallel_for_(Range(0, (ny + kBandRows - 1) / kBandRows), [&](const Range& bands) {
+            for (int b = bands.start; b < bands.end; ++b) {
+                const Range rows(b * kBandRows, std::min(ny, (b + 1) * kBandRows));
+                Mat acc = raw.rowRange(rows);
+                if (mode == Projection::Mean) {
+                    Mat s = sum.rowRange(rows);
+                    planeZ(0).rowRange(rows).convertTo(s, CV_32S);
+                    for (int z = 1; z < nz; ++z) add(s, planeZ(z).rowRange(rows), s, noArray(), CV_32S);
+                    s.convertTo(acc, CV_16S, 1.0 / nz);
+                    continue;
+                }
+                planeZ(0).rowRange(rows).copyTo(acc);
+                for (int z = 1; z < nz; ++z) {
+                    if (mode == Projection::Max) max(acc, planeZ(z).rowRange(rows), acc);
+                    else                         min(acc, planeZ(z).rowRange(rows), acc);
+                }
+            }
+        });
+        out = raw;
+        return;
+    }
+
+    // Coronal (a lo largo de y) / sagital (a lo largo de x): cada plano z da
+    // una fila; se reduce por planos, que son contiguos en memoria
+    const bool coronal = plane == Plane::Coronal;
+    raw.create(nz, coronal ? nx : ny, CV_16S);
+    const int op = reduceOp(mode);
+    parallel_for_(Range(0, nz), [&](const Range& zs) {
+        Mat r;
+        for (int z = zs.start; z < zs.end; ++z) {
+            const int dtype = mode == Projection::Mean ? CV_32F : CV_16S;
+            reduce(planeZ(z), r, coronal ? 0 : 1, op, dtype);   // 1 x nx  |  ny x 1
+            if (!coronal) r = r.reshape(1, 1);
+            r.convertTo(raw.row(nz - 1 - z), CV_16S);            // cabeza arriba
+        }
+    });
+    if (isotropic) toIsotropic(vol, plane, raw, out);
+    else out = raw;
+}
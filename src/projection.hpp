@@ -0,0 +1,72 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <opencv2/core.hpp>
+
+#include "itk_loader.hpp"
+#include "reformat.hpp"
+
+// ==========================================================
+// Proyecciones de losa gruesa (MIP / MinIP / media)
+// ==========================================================
+// Una losa son N cortes contiguos del plano; la proyección toma por píxel el
+// máximo, el mínimo o la media de la losa. Todo en HU (CV_16S), así que la
+// salida entra al pipeline (ventaneo, overlays...) como un corte más.
+//
+// SlabProjector mantiene estado entre llamadas para que deslizar la losa un
+// corte cueste O(1) operaciones de plano, sea cual sea N:
+//  - máx/mín: van Herk / Gil-Werman. El eje se parte en bloques de N cortes;
+//    de cada bloque se guardan los máximos acumulados desde su final (sufijos)
+//    y desde su inicio (prefijos). Toda losa [s, s+N) cruza como mucho una
+//    frontera de bloque → max(sufijo[s], prefijo[s+N-1]): una operación por
+//    posición + dos por corte al cambiar de bloque;
+//  - media: suma en int32 que resta el corte que sale y suma el que entra.
+// Las operaciones de plano son cv::max/min/add (SIMD de OpenCV); en axial los
+// planos son vistas del buffer ITK, sin copia.
+
+enum class Projection { Max, Min, Mean };
+
+// "mip" | "minip" | "mean"
+Projection  parseProjection(const std::string& name);
+const char* projectionName(Projection p);
+
+class SlabProjector {
+public:
+    // Losa de 'thickness' cortes centrada en 'index' (se desplaza para caber
+    // en el volumen). En coronal/sagital, orientada y remuestreada como
+    // reformatSlice.
+    void project(const ImageType3D::Pointer& vol, Plane plane, int index, int thickness, Projection mode,
+                 cv::Mat& out, bool isotropic = true);
+
+    // Operaciones de plano de la última llamada (para medir el incremental)
+    int lastPlaneOps() const { return lastOps_; }
+
+private:
+    const cv::Mat& plane(int i);
+    void buildSuffix(int block);
+    void buildPrefix(int block);
+    void combine(const cv::Mat& a, const cv::Mat& b, cv::Mat& out);
+
+    // Estado válido para (volumen, plano, grosor, modo)
+    const void*   buffer_ = nullptr;
+    unsigned long mtime_  = 0;
+    Plane         plane_  = Plane::Axial;
+    int           n_ = 0, thickness_ = 0;
+    Projection    mode_ = Projection::Max;
+    ImageType3D::Pointer vol_;
+
+    // máx/mín: sufijos del bloque suffixBlock_, prefijos de prefixBlock_
+    int suffixBlock_ = -1, prefixBlock_ = -1;
+    std::vector<cv::Mat> suffix_, prefix_;
+    // media: suma de la losa que empieza en sumFirst_
+    int     sumFirst_ = -1;
+    cv::Mat sum_;
+
+    cv::Mat planeTmp_, raw_;
+    int     lastOps_ = 0;
+};
+
+// Proyección de todo el volumen en el plano (MIP clásico). Reducción por
+// bandas de filas que caben en caché (axial) o por planos z (coronal/sagital).
+void volumeProjection(const ImageType3D::Pointer& vol, Plane plane, Projection mode, cv::Mat& out,
+                      bool isotropic = true);
@@ -0,0 +1,56 @@
+#include "quality_metrics.hpp"
+#include <opencv2/imgproc.hpp>
+#include <cmath>
+
+using namespace cv;
+
+double computePSNR(const cv::Mat& a, const cv::Mat& b) {
+    CV_Assert(a.size() == b.size() && a.type() == b.type());
+    const double mse = norm(a, b, NORM_L2SQR) / static_cast<double>(a.total() * a.channels());
+    if (mse <= 1e-10) return 100.0;
+    return 10.0 * std::log10(255.0 * 255.0 / mse);
+}
+
+namespace {
+const Size   kSsimWin(11, 11);
+const double kSsimSigma = 1.5;
+} // namespace
+
+void prepareSsimReference(const cv::Mat& ref, SsimReference& out) {
+    CV_Assert(ref.type() == CV_8UC1);
+    ref.convertTo(out.x, CV_32F);
+    GaussianBlur(out.x, out.mu, kSsimWin, kSsimSigma);
+    GaussianBlur(out.x.mul(out.x), out.sigma2, kSsimWin, kSsimSigma);
+    out.mu2 = out.mu.mul(out.mu);
+    out.sigma2 -= out.mu2;
+}
+
+double computeSSIM(const SsimReference& ref, const cv::Mat& b) {
+    CV_Assert(b.size() == ref.x.size() && b.type() == CV_8UC1);
+    const double C1 = (0.01 * 255) * (0.01 * 255);
+    const double C2 = (0.03 * 255) * (0.03 * 255);
+
+    // Momentos locales con el mismo filtro gaussiano (todo vectorizado en OpenCV)
+    Mat y, my, syy, sxy;
+    b.convertTo(y, CV_32F);
+    GaussianBlur(y, my, kSsimWin, kSsimSigma);
+    GaussianBlur(y.mul(y), syy, kSsimWin, kSsimSigma);
+    GaussianBlur(ref.x.mul(y), sxy, kSsimWin, kSsimSigma);
+
+    Mat my2 = my.mul(my), mxy = ref.mu.mul(my);
+    syy -= my2;
+    sxy -= mxy;
+
+    Mat num = (2 * mxy + C1).mul(2 * sxy + C2);
+    Mat den = (ref.mu2 + my2 + C1).mul(ref.sigma2 + syy + C2);
+    Mat ssimMap;
+    divide(num, den, ssimMap);
+    return mean(ssimMap)[0];
+}
+
+double computeSSIM(const cv::Mat& a, const cv::Mat& b) {
+    CV_Assert(a.size() == b.size() && a.type() == CV_8UC1 && b.type() == CV_8UC1);
+    SsimReference ref;
+    prepareSsimReference(a, ref);
+    return computeSSIM(ref, b);
+}
@@ -0,0 +1,18 @@
+#pragma once
+#include <opencv2/core.hpp>
+
+// Métricas de calidad entre dos imágenes del mismo tamaño (8-bit, 1 canal)
+
+// PSNR en dB (rango 255). Imágenes idénticas → 100 dB por convención.
+double computePSNR(const cv::Mat& a, const cv::Mat& b);
+
+// SSIM medio con ventana gaussiana 11x11, sigma 1.5 (Wang et al. 2004)
+double computeSSIM(const cv::Mat& a, const cv::Mat& b);
+
+// Momentos locales de la referencia (media y varianza): al comparar varias
+// imágenes contra la misma se calculan una sola vez
+struct SsimReference {
+    cv::Mat x, mu, mu2, sigma2;   // CV_32F
+};
+void   prepareSsimReference(const cv::Mat& ref, SsimReference& out);
+double computeSSIM(const SsimReference& ref, const cv::Mat& b);
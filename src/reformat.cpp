@@ -0,0 +1,160 @@
+#include "reformat.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+#include <opencv2/core/utility.hpp>
+#include <opencv2/imgproc.hpp>
+
+using namespace cv;
+
+namespace {
+
+struct VolumeView {
+    const short* data = nullptr;
+    int nx = 0, ny = 0, nz = 0;
+    double sx = 1.0, sy = 1.0, sz = 1.0;
+};
+
+VolumeView viewOf(const ImageType3D::Pointer& vol) {
+    if (vol.IsNull()) throw std::runtime_error("Reformateo: volumen vacío");
+    const auto size    = vol->GetBufferedRegion().GetSize();
+    const auto spacing = vol->GetSpacing();
+    VolumeView v;
+    v.data = vol->GetBufferPointer();
+    v.nx = static_cast<int>(size[0]);
+    v.ny = static_cast<int>(size[1]);
+    v.nz = static_cast<int>(size[2]);
+    v.sx = spacing[0];
+    v.sy = spacing[1];
+    v.sz = spacing[2];
+    return v;
+}
+
+// Bloque de cortes sagitales [first, first + count) ya recogidos (sin remuestrear).
+// Uno por hilo: el visor y los workers no se pisan.
+struct SagittalBundle {
+    const void*   buffer = nullptr;
+    unsigned long mtime  = 0;   // el volumen puede haberse modificado en sitio
+    int first = -1;
+    std::vector<Mat> slices;
+};
+thread_local SagittalBundle t_bundle;
+
+// Recogida por bloques: para cada fila (y) de cada plano z se leen 'count'
+// muestras contiguas (una línea de caché) y se reparten entre 'count' cortes.
+void gatherSagittal(const VolumeView& v, int first, int count, std::vector<Mat>& out) {
+    out.resize(count);
+    for (auto& m : out) m.create(v.nz, v.ny, CV_16S);
+
+    const size_t planeStride = static_cast<size_t>(v.nx) * v.ny;
+    parallel_for_(Range(0, v.nz), [&](const Range& zs) {
+        std::vector<short*> dst(count);
+        for (int z = zs.start; z < zs.end; ++z) {
+            for (int b = 0; b < count; ++b) dst[b] = out[b].ptr<short>(z);
+            const short* plane = v.data + z * planeStride + first;
+            for (int y = 0; y < v.ny; ++y) {
+                const short* line = plane + static_cast<size_t>(y) * v.nx;
+                for (int b = 0; b < count; ++b) dst[b][y] = line[b];
+            }
+        }
+    });
+}
+
+void gatherRaw(const ImageType3D::Pointer& vol, const VolumeView& v, Plane plane, int index, Mat& out) {
+    const size_t planeStride = static_cast<size_t>(v.nx) * v.ny;
+
+    switch (plane) {
+    case Plane::Axial:
+        out.create(v.ny, v.nx, CV_16S);
+        std::memcpy(out.data, v.data + index * planeStride, planeStride * sizeof(short));
+        return;
+
+    case Plane::Coronal:
+        out.create(v.nz, v.nx, CV_16S);
+        for (int z = 0; z < v.nz; ++z)
+            std::memcpy(out.ptr<short>(z), v.data + z * planeStride + static_cast<size_t>(index) * v.nx,
+                        v.nx * sizeof(short));
+        return;
+
+    case Plane::Sagittal: {
+        SagittalBundle& b = t_bundle;
+        const int first = (index / kReformatBundle) * kReformatBundle;
+        if (b.buffer != v.data || b.mtime != vol->GetMTime() || b.first != first) {
+            gatherSagittal(v, first, std::min(kReformatBundle, v.nx - first), b.slices);
+            b.buffer = v.data;
+            b.mtime  = vol->GetMTime();
+            b.first  = first;
+        }
+        b.slices[index - first].copyTo(out);
+        return;
+    }
+    }
+}
+
+} // namespace
+
+int planeSliceCount(const ImageType3D::Pointer& vol, Plane plane) {
+    const VolumeView v = viewOf(vol);
+    switch (plane) {
+    case Plane::Axial:    return v.nz;
+    case Plane::Coronal:  return v.ny;
+    case Plane::Sagittal: return v.nx;
+    }
+    return 0;
+}
+
+void reformatSlice(const ImageType3D::Pointer& vol, Plane plane, int index, cv::Mat& out, bool isotropic) {
+    const VolumeView v = viewOf(vol);
+    if (index < 0 || index >= planeSliceCount(vol, plane))
+        throw std::runtime_error("Reformateo: índice fuera de rango");
+
+    if (plane == Plane::Axial) {
+        gatherRaw(vol, v, plane, index, out);
+        return;
+    }
+
+    // Filas = z: se invierten para dejar la cabeza arriba (z crece hacia craneal)
+    thread_local Mat gathered, raw;
+    gatherRaw(vol, v, plane, index, gathered);
+    if (!isotropic) {
+        flip(gathered, out, 0);
+        return;
+    }
+    flip(gathered, raw, 0);
+    toIsotropic(vol, plane, raw, out);
+}
+
+void toIsotropic(const ImageType3D::Pointer& vol, Plane plane, const cv::Mat& raw, cv::Mat& out) {
+    const VolumeView v = viewOf(vol);
+    const double inPlane = plane == Plane::Coronal ? v.sx : v.sy;
+    const int rows = plane != Plane::Axial && inPlane > 0.0
+                   ? std::max(1, static_cast<int>(std::lround(v.nz * v.sz / inPlane)))
+                   : raw.rows;
+    if (rows == raw.rows) raw.copyTo(out);
+    else resize(raw, out, Size(raw.cols, rows), 0, 0, INTER_LINEAR);
+}
+
+cv::Mat reformatSlice(const ImageType3D::Pointer& vol, Plane plane, int index, bool isotropic) {
+    Mat out;
+    reformatSlice(vol, plane, index, out, isotropic);
+    return out;
+}
+
+Plane parsePlane(const std::string& name) {
+    if (name == "axial")   return Plane::Axial;
+    if (name == "coronal") return Plane::Coronal;
+    if (name == "sagital" || name == "sagittal") return Plane::Sagittal;
+    throw std::runtime_error("Plano desconocido: " + name);
+}
+
+const char* planeName(Plane plane) {
+    switch (plane) {
+    case Plane::Axial:    return "axial";
+    case Plane::Coronal:  return "coronal";
+    case Plane::Sagittal: return "sagital";
+    }
+    return "?";
+}
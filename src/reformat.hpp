@@ -0,0 +1,40 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <opencv2/core.hpp>
+
+#include "itk_loader.hpp"
+
+// ==========================================================
+// Reformateo multiplanar (MPR) desde el volumen en memoria
+// ==========================================================
+// El buffer ITK es x-contiguo, luego y, luego z:
+//  - Axial    (índice z): filas y, columnas x → un memcpy del plano
+//  - Coronal  (índice y): filas z, columnas x → un memcpy por fila
+//  - Sagital  (índice x): filas z, columnas y → paso de nx muestras por píxel
+// El sagital se recoge en bloques de kReformatBundle cortes contiguos: cada
+// línea de caché leída (32 shorts) alimenta 32 cortes a la vez, y el bloque se
+// guarda para que recorrer cortes vecinos cueste lo mismo que en axial.
+enum class Plane { Axial, Coronal, Sagittal };
+
+constexpr int kReformatBundle = 32;
+
+// Número de cortes del volumen en el plano
+int planeSliceCount(const ImageType3D::Pointer& vol, Plane plane);
+
+// Corte 'index' del plano en HU (CV_16S). En coronal/sagital el eje Z (3 mm)
+// se remuestrea linealmente al espaciado en plano (píxeles cuadrados) y se
+// orienta con la cabeza arriba. Sin remuestrear si isotropic == false.
+void reformatSlice(const ImageType3D::Pointer& vol, Plane plane, int index, cv::Mat& out,
+                   bool isotropic = true);
+cv::Mat reformatSlice(const ImageType3D::Pointer& vol, Plane plane, int index,
+                      bool isotropic = true);
+
+// Coronal/sagital ya orientado (cabeza arriba) pero con una fila por corte
+// axial → filas remuestreadas a píxeles cuadrados, como reformatSlice.
+// En axial solo copia.
+void toIsotropic(const ImageType3D::Pointer& vol, Plane plane, const cv::Mat& raw, cv::Mat& out);
+
+// "axial" | "coronal" | "sagital"
+Plane       parsePlane(const std::string& name);
+const char* planeName(Plane plane);
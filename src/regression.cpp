@@ -0,0 +1,427 @@
+#include "regression.hpp"
+
+#include "dicom_mmap.hpp"
+#include "dnn_precision.hpp"
+#include "evidence_store.hpp"
+#include "itk_loader.hpp"
+#include "tissue_stats.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+
+#include <opencv2/imgproc.hpp>
+
+using namespace cv;
+namespace fs = std::filesystem;
+
+namespace {
+
+// Píxeles (o canales) con |diferencia| > maxAbs: como mucho maxFraction
+struct Tolerance {
+    int    maxAbs;
+    double maxFraction;
+};
+
+const Tolerance kEvidenceTolerance[kNumEvidences] = {
+    { 0, 0.0   },   //  0 original ventaneada (LUT entera)
+    { 1, 0.0   },   //  1 Gauss: redondeo
+    { 2, 0.001 },   //  2 NLMeans
+    { 4, 0.005 },   //  3 DnCNN: acumulación float según backend/SIMD
+    { 0, 0.005 },   //  4 Canny: bordes que cambian con el Gauss
+    { 0, 0.0   },   //  5 TopHat
+    { 0, 0.0   },   //  6 BlackHat
+    { 0, 0.0   },   //  7 erosión
+    { 0, 0.0   },   //  8 dilatación
+    { 0, 0.0   },   //  9 seg. original
+    { 1, 0.002 },   // 10 seg. Gauss
+    { 2, 0.002 },   // 11 seg. NLMeans
+    { 4, 0.005 },   // 12 seg. DnCNN
+};
+
+// Etiquetas distintas / píxeles: original exacta; las suavizadas, algún borde
+const double kLabelTolerance[3] = { 0.0, 0.001, 0.001 };
+
+// Recorte al cuerpo (+ kRoiHalo) frente al corte completo, dentro del cuerpo.
+// Los filtros locales no ven el borde del recorte; Canny sigue bordes fuera de
+// él y el filtro de islas pequeñas puede cambiar las que lo cruzan.
+const Tolerance kRoiTolerance[kNumEvidences] = {
+    { 0, 0.0   },   //  0 original
+    { 0, 0.0   },   //  1 Gauss
+    { 0, 0.0   },   //  2 NLMeans
+    { 1, 0.001 },   //  3 DnCNN: otro tamaño de entrada, otro reparto del float
+    { 0, 0.002 },   //  4 Canny: histéresis no local
+    { 0, 0.0   },   //  5 TopHat
+    { 0, 0.0   },   //  6 BlackHat
+    { 0, 0.0   },   //  7 erosión
+    { 0, 0.0   },   //  8 dilatación
+    { 0, 0.001 },   //  9 seg. original: islas en el borde del recorte
+    { 0, 0.001 },   // 10 seg. Gauss
+    { 0, 0.001 },   // 11 seg. NLMeans
+    { 1, 0.002 },   // 12 seg. DnCNN
+};
+const double kRoiLabelTolerance[3] = { 0.001, 0.001, 0.001 };
+
+// HU en CV_16S (nativo) frente a CV_32F, corte completo. El ventaneo puede
+// redondear distinto (±1 nivel); los suavizados en HU de las etiquetas Gauss
+// y DnCNN redondean a 1 HU en 16S y mueven píxeles junto a los umbrales.
+const Tolerance kHu16sTolerance[kNumEvidences] = {
+    { 1, 0.0   },   //  0 original
+    { 1, 0.001 },   //  1 Gauss
+    { 2, 0.002 },   //  2 NLMeans
+    { 2, 0.002 },   //  3 DnCNN
+    { 0, 0.002 },   //  4 Canny
+    { 1, 0.001 },   //  5 TopHat
+    { 1, 0.001 },   //  6 BlackHat
+    { 1, 0.0   },   //  7 erosión
+    { 1, 0.0   },   //  8 dilatación
+    { 1, 0.0   },   //  9 seg. original: mismas etiquetas
+    { 1, 0.005 },   // 10 seg. Gauss
+    { 2, 0.005 },   // 11 seg. NLMeans (máscaras de Gauss)
+    { 2, 0.005 },   // 12 seg. DnCNN
+};
+const double kHu16sLabelTolerance[3] = { 0.0, 0.005, 0.005 };
+constexpr double kStatsTolHU    = 0.5;     // media, sd, mín, máx
+constexpr double kStatsTolCount = 0.001;   // relativo
+
+// Presupuesto al regenerar: medido × holgura + margen fijo (ruido de reloj)
+constexpr double kBudgetHeadroom = 2.0;
+constexpr double kBudgetFloorMs  = 1.0;
+
+const uint16_t kLabelLayers[3] = { LAYER_LABELS_RAW, LAYER_LABELS_GAUSS, LAYER_LABELS_DNN };
+const char* const kLabelNames[3] = { "etiquetas original", "etiquetas Gauss", "etiquetas DnCNN" };
+
+std::string fmt(const char* f, double a, double b = 0.0, double c = 0.0) {
+    char s[160];
+    std::snprintf(s, sizeof(s), f, a, b, c);
+    return s;
+}
+
+// Fracción de elementos con |a - b| > maxAbs (-1 si la geometría no coincide)
+double mismatch(const Mat& a, const Mat& b, int maxAbs) {
+    if (a.size() != b.size() || a.type() != b.type()) return -1.0;
+    Mat diff, over;
+    absdiff(a, b, diff);
+    compare(diff.reshape(1), maxAbs, over, CMP_GT);
+    return static_cast<double>(countNonZero(over)) / over.total();
+}
+
+TissueStats* tissues(SliceStats& s, int i) {
+    TissueStats* t[3] = { &s.fat, &s.muscle, &s.bone };
+    return t[i];
+}
+const TissueStats* tissues(const SliceStats& s, int i) {
+    return tissues(const_cast<SliceStats&>(s), i);
+}
+
+static const char* kTissue[3] = { "grasa", "músculo", "hueso" };
+
+// Diferencias de 'a' frente a 'ref' que pasan de kStatsTolHU / kStatsTolCount
+void compareStats(const SliceStats& a, const SliceStats& ref, const std::string& where,
+                  std::vector<std::string>& failures) {
+    for (int i = 0; i < 3; ++i) {
+        const TissueStats& x = *tissues(a, i);
+        const TissueStats& g = *tissues(ref, i);
+        const double dHU = std::max({ std::abs(x.meanHU - g.meanHU), std::abs(x.stdHU - g.stdHU),
+                                      std::abs(x.minHU - g.minHU), std::abs(x.maxHU - g.maxHU) });
+        const double dCount = std::abs(x.pixelCount - g.pixelCount) / std::max(1.0, double(g.pixelCount));
+        if (dHU > kStatsTolHU || dCount > kStatsTolCount)
+            failures.push_back(where + "estadísticas de " + kTissue[i] +
+                               fmt(" cambian (%.2f HU, %.3f%% píxeles)", dHU, dCount * 100));
+    }
+}
+
+// Dos pasadas del mismo corte con otras opciones: evidencias y etiquetas
+// dentro de 'roi'
+void compareRuns(const PipelineResults& a, const PipelineResults& b, const Rect& roi,
+                 const Tolerance* evidenceTol, const double* labelTol, const std::string& where,
+                 std::vector<std::string>& failures) {
+    for (int e = 0; e < kNumEvidences; ++e) {
+        if (a.images[e].empty() && b.images[e].empty()) continue;
+        const double frac = a.images[e].size() == b.images[e].size()
+                                ? mismatch(a.images[e](roi), b.images[e](roi), evidenceTol[e].maxAbs)
+                                : -1.0;
+        if (frac < 0.0 || frac > evidenceTol[e].maxFraction)
+            failures.push_back(where + "evidencia " + std::to_string(e) +
+                               (frac < 0.0 ? " con otra geometría/tipo"
+                                           : fmt(" difiere en %.3f%% (máx. %.3f%%, |d| > %.0f)", frac * 100,
+                                                 evidenceTol[e].maxFraction * 100, evidenceTol[e].maxAbs)));
+    }
+    const RleLabelMap* la[3] = { &a.labelsRaw, &a.labelsGauss, &a.labelsDnn };
+    const RleLabelMap* lb[3] = { &b.labelsRaw, &b.labelsGauss, &b.labelsDnn };
+    for (int l = 0; l < 3; ++l) {
+        if (la[l]->empty() && lb[l]->empty()) continue;
+        Mat x, y;
+        la[l]->crop(roi).rasterize(x);
+        lb[l]->crop(roi).rasterize(y);
+        const double frac = mismatch(x, y, 0);
+        if (frac < 0.0 || frac > labelTol[l])
+            failures.push_back(where + kLabelNames[l] +
+                               fmt(" difieren en %.3f%% (máx. %.3f%%)", frac * 100, labelTol[l] * 100));
+    }
+}
+
+// ==========================================================
+// Estadísticas de referencia (TSV)
+// ==========================================================
+void writeStats(const std::string& path, const std::string& tag, const std::map<int, SliceStats>& stats) {
+    std::ofstream f(path);
+    f << "# dncnn\t" << tag << "\n"
+      << "# corte\t(grasa, músculo, hueso) × (media, sd, mín, máx, píxeles)\n";
+    f.precision(10);
+    for (const auto& [slice, s] : stats) {
+        f << slice;
+        for (int i = 0; i < 3; ++i) {
+            const TissueStats& t = *tissues(s, i);
+            f << '\t' << t.meanHU << '\t' << t.stdHU << '\t' << t.minHU << '\t' << t.maxHU << '\t' << t.pixelCount;
+        }
+        f << "\n";
+    }
+    if (!f) throw std::runtime_error("No se pudo escribir " + path);
+}
+
+std::map<int, SliceStats> readStats(const std::string& path, std::string& tag) {
+    std::ifstream f(path);
+    if (!f) throw std::runtime_error("Faltan las referencias " + path + " (generarlas con --update)");
+    std::map<int, SliceStats> out;
+    std::string line;
+    while (std::getline(f, line)) {
+        if (line.rfind("# dncnn\t", 0) == 0) tag = line.substr(8);
+        if (line.empty() || line[0] == '#') continue;
+        std::istringstream in(line);
+        int slice = 0;
+        SliceStats s;
+        in >> slice;
+        for (int i = 0; i < 3; ++i) {
+            TissueStats& t = *tissues(s, i);
+            in >> t.meanHU >> t.stdHU >> t.minHU >> t.maxHU >> t.pixelCount;
+        }
+        out[slice] = s;
+    }
+    return out;
+}
+
+// ==========================================================
+// Presupuestos (TSV: resolución, etapa, ms)
+// ==========================================================
+using Budgets = std::map<std::pair<int, std::string>, double>;
+
+Budgets readBudgets(const std::string& path) {
+    Budgets b;
+    std::ifstream f(path);
+    std::string line;
+    while (std::getline(f, line)) {
+        if (line.empty() || line[0] == '#') continue;
+        std::istringstream in(line);
+        int size = 0;
+        std::string stage;
+        double ms = 0.0;
+        if (in >> size >> stage >> ms) b[{ size, stage }] = ms;
+    }
+    return b;
+}
+
+void writeBudgets(const std::string& path, const Budgets& b) {
+    std::ofstream f(path);
+    f << "# resolución\tetapa\tms por corte (medido x" << kBudgetHeadroom << " + " << kBudgetFloorMs
+      << " al regenerar; se pueden ajustar a mano)\n";
+    for (const auto& [key, ms] : b) f << key.first << '\t' << key.second << '\t' << fmt("%.2f", ms) << "\n";
+    if (!f) throw std::runtime_error("No se pudo escribir " + path);
+}
+
+double median(std::vector<double> v) {
+    std::sort(v.begin(), v.end());
+    return v.empty() ? 0.0 : v[v.size() / 2];
+}
+
+} // namespace
+
+RegressionReport runRegression(const RegressionOptions& opts, std::ostream& log) {
+    RegressionReport report;
+    const std::string dir = opts.seriesDir.empty() ? findBundledSeriesDir() : opts.seriesDir;
+    if (dir.empty()) {
+        if (opts.update) throw std::runtime_error("Regresión: no se encontró la serie L096");
+        report.skipped = "no se encontró la serie L096";
+        return report;
+    }
+    if (!opts.update) {
+        bool any = false;
+        for (int size : opts.sizes)
+            any = any || fs::exists(fs::path(opts.goldenDir) / ("golden_" + std::to_string(size) + ".tsv"));
+        if (!any) {
+            report.skipped = "no hay referencias en " + opts.goldenDir + " (generarlas con --update)";
+            return report;
+        }
+    }
+    const std::vector<std::string> files = listDicomSeriesFiles(dir);
+    const int n = static_cast<int>(files.size());
+    if (n == 0) throw std::runtime_error("Regresión: la serie " + dir + " no tiene cortes");
+    const int count = std::clamp(opts.slices, 1, n);
+    const std::string tag = opts.denoiser ? opts.denoiserTag : "sin DnCNN";
+    if (opts.update) fs::create_directories(opts.goldenDir);
+
+    // Cortes fijos repartidos por la serie (mismos siempre para un mismo 'slices')
+    std::vector<int> picks;
+    for (int i = 0; i < count; ++i) picks.push_back(std::min(n - 1, static_cast<int>((i + 0.5) * n / count)));
+
+    PipelineOptions popts;
+    popts.useCache = false;                             // se mide el cálculo, no el caché
+    popts.params.denoise.mode = DenoiseMode::Full;      // independiente de VISION_DENOISE_POLICY
+
+    const std::string budgetPath = (fs::path(opts.goldenDir) / "budgets.tsv").string();
+    Budgets budgets = readBudgets(budgetPath);   // con update se reescriben solo las resoluciones pedidas
+    PipelineResults res, alt;   // alt: las pasadas con otras opciones
+
+    for (int size : opts.sizes) {
+        const std::string base = (fs::path(opts.goldenDir) / ("golden_" + std::to_string(size))).string();
+        std::map<int, SliceStats> goldenStats;
+        std::unique_ptr<EvidenceReader> golden;
+        std::unique_ptr<EvidenceWriter> writer;
+        if (opts.update) {
+            writer = std::make_unique<EvidenceWriter>(base + ".vev");
+        } else {
+            std::string goldenTag;
+            goldenStats = readStats(base + ".tsv", goldenTag);
+            if (goldenTag != tag) {
+                report.failures.push_back(std::to_string(size) + ": referencias generadas con '" + goldenTag +
+                                          "', ahora '" + tag + "' (regenerar con --update)");
+                continue;
+            }
+            golden = std::make_unique<EvidenceReader>(base + ".vev");
+        }
+
+        std::map<int, SliceStats> stats;
+        StageTimings sum;
+        int failuresBefore = static_cast<int>(report.failures.size());
+        for (int slice : picks) {
+            Mat hu = loadSliceHU(files[slice]);
+            if (hu.cols != size || hu.rows != size)
+                resize(hu, hu, Size(size, size), 0, 0, size < hu.cols ? INTER_AREA : INTER_LINEAR);
+
+            // Pasada de comparación (sin cronometrar: incluye inicializaciones)
+            runSlicePipeline(hu, opts.denoiser, res, popts);
+            stats[slice] = res.stats;
+            const std::string where = std::to_string(size) + " corte " + std::to_string(slice) + ": ";
+
+            // Recorte al cuerpo frente al corte completo (no necesita referencias)
+            {
+                PipelineOptions fullOpts = popts;
+                fullOpts.bodyRoi = false;
+                runSlicePipeline(hu, opts.denoiser, alt, fullOpts);
+                compareRuns(res, alt, res.roi, kRoiTolerance, kRoiLabelTolerance, where + "recorte vs completo, ",
+                            report.failures);
+                compareStats(res.stats, computeSliceStats(hu(res.roi), alt.labelsRaw.crop(res.roi)),
+                             where + "recorte vs completo, ", report.failures);
+            }
+            // CV_16S nativo frente a CV_32F
+            if (hu.type() == CV_16S) {
+                Mat hu32;
+                hu.convertTo(hu32, CV_32F);
+                runSlicePipeline(hu32, opts.denoiser, alt, popts);
+                const Rect full(0, 0, hu.cols, hu.rows);
+                compareRuns(res, alt, full, kHu16sTolerance, kHu16sLabelTolerance, where + "16S vs 32F, ",
+                            report.failures);
+                compareStats(res.stats, alt.stats, where + "16S vs 32F, ", report.failures);
+            }
+
+            // Pasadas cronometradas: mediana por etapa
+            std::vector<std::vector<double>> samples(kNumPipelineStages + 1);
+            for (int r = 0; r < std::max(1, opts.repeats); ++r) {
+                StageTimings t;
+                popts.timings = &t;
+                PipelineResults timed;
+                runSlicePipeline(hu, opts.denoiser, timed, popts);
+                popts.timings = nullptr;
+                for (int st = 0; st < kNumPipelineStages; ++st) samples[st].push_back(t.ms[st]);
+                samples[kNumPipelineStages].push_back(t.totalMs);
+            }
+            for (int st = 0; st < kNumPipelineStages; ++st) sum.ms[st] += median(samples[st]);
+            sum.totalMs += median(samples[kNumPipelineStages]);
+
+            if (writer) {
+                writer->addSlice(static_cast<uint32_t>(slice), res);
+                continue;
+            }
+
+            // Evidencias
+            for (int e = 0; e < kNumEvidences; ++e) {
+                Mat ref;
+                if (!golden->read(static_cast<uint32_t>(slice), static_cast<uint16_t>(e), ref)) {
+                    report.failures.push_back(where + "falta la evidencia " + std::to_string(e) + " en la referencia");
+                    continue;
+                }
+                const double frac = mismatch(res.images[e], ref, kEvidenceTolerance[e].maxAbs);
+                if (frac < 0.0 || frac > kEvidenceTolerance[e].maxFraction)
+                    report.failures.push_back(where + "evidencia " + std::to_string(e) +
+                                              (frac < 0.0 ? " con otra geometría/tipo"
+                                                          : fmt(" difiere en %.3f%% (máx. %.3f%%, |d| > %.0f)",
+                                                                frac * 100, kEvidenceTolerance[e].maxFraction * 100,
+                                                                kEvidenceTolerance[e].maxAbs)));
+            }
+
+            // Etiquetas (máscaras de tejido)
+            const RleLabelMap* labels[3] = { &res.labelsRaw, &res.labelsGauss, &res.labelsDnn };
+            for (int l = 0; l < 3; ++l) {
+                RleLabelMap ref;
+                Mat a, b;
+                if (!golden->readLabels(static_cast<uint32_t>(slice), kLabelLayers[l], ref)) {
+                    report.failures.push_back(where + "faltan " + kLabelNames[l] + " en la referencia");
+                    continue;
+                }
+                labels[l]->rasterize(a);
+                ref.rasterize(b);
+                const double frac = mismatch(a, b, 0);
+                if (frac < 0.0 || frac > kLabelTolerance[l])
+                    report.failures.push_back(where + kLabelNames[l] +
+                                              fmt(" difieren en %.3f%% (máx. %.3f%%)", frac * 100,
+                                                  kLabelTolerance[l] * 100));
+            }
+
+            // SliceStats
+            auto it = goldenStats.find(slice);
+            if (it == goldenStats.end()) {
+                report.failures.push_back(where + "faltan las estadísticas en la referencia");
+                continue;
+            }
+            compareStats(res.stats, it->second, where, report.failures);
+        }
+
+        // Latencia media por corte frente al presupuesto
+        std::string line = std::to_string(size) + ":";
+        for (int st = 0; st <= kNumPipelineStages; ++st) {
+            const std::string name = st < kNumPipelineStages ? kPipelineStageNames[st] : "total";
+            const double ms = (st < kNumPipelineStages ? sum.ms[st] : sum.totalMs) / count;
+            line += " " + name + fmt(" %.1f", ms);
+            if (opts.update) {
+                budgets[{ size, name }] = ms * kBudgetHeadroom + kBudgetFloorMs;
+                continue;
+            }
+            auto b = budgets.find({ size, name });
+            if (b == budgets.end()) continue;   // sin presupuesto: solo se informa
+            const double limit = b->second * opts.budgetScale;
+            if (ms > limit)
+                report.failures.push_back(std::to_string(size) + ": " + name +
+                                          fmt(" tarda %.2f ms por corte (presupuesto %.2f ms)", ms, limit));
+        }
+        log << "[REGRESIÓN] " << line << " ms\n";
+
+        if (writer) {
+            writer->close();
+            writeStats(base + ".tsv", tag, stats);
+            log << "  referencias de " << size << " regeneradas (" << count << " cortes)\n";
+        } else {
+            const int failed = static_cast<int>(report.failures.size()) - failuresBefore;
+            log << "  " << size << ": " << (failed ? std::to_string(failed) + " fallos" : std::string("OK")) << "\n";
+        }
+    }
+
+    if (opts.update) writeBudgets(budgetPath, budgets);
+    for (const auto& f : report.failures) log << "  FALLO " << f << "\n";
+    return report;
+}
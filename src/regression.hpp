@@ -0,0 +1,51 @@
+#pragma once
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "pipeline.hpp"
+
+class Denoiser;
+
+// ==========================================================
+// Regresión contra referencias guardadas + presupuestos de latencia
+// ==========================================================
+// Unos cortes fijos de la L096, llevados a cada resolución (remuestreo del HU),
+// pasan por el pipeline completo sin caché y se comparan con las referencias
+// de 'goldenDir':
+//   golden_<N>.vev   13 evidencias + mapas de etiquetas (máscaras) por corte
+//   golden_<N>.tsv   SliceStats por corte (+ la config DnCNN usada)
+//   budgets.tsv      ms por etapa y resolución (media por corte)
+// Cada evidencia tiene su tolerancia (exacta donde el cálculo es entero;
+// holgura en NLMeans, DnCNN y bordes, que dependen de SIMD/backend). Una etapa
+// que pase de su presupuesto (× VISION_BUDGET_SCALE) también es un fallo.
+// Además (también con update) cada corte se procesa sin el
+// recorte al cuerpo y se compara dentro del cuerpo (kRoiTolerance), y con el
+// HU en CV_32F en vez del CV_16S nativo (kHu16sTolerance).
+// Con update = true se regeneran referencias y presupuestos.
+
+struct RegressionOptions {
+    std::string seriesDir;                     // vacío → L096 incluida
+    std::string goldenDir = "data/golden";
+    std::vector<int> sizes = { 256, 384, 512 };  // las de data/Preprocessed_*
+    int  slices  = 5;
+    int  repeats = 3;          // pasadas cronometradas por corte (mediana)
+    bool update  = false;
+    double budgetScale = 1.0;  // >1 en máquinas más lentas que la de referencia
+    Denoiser* denoiser = nullptr;
+    std::string  denoiserTag;  // config DnCNN (debe coincidir con la de las referencias)
+};
+
+struct RegressionReport {
+    std::vector<std::string> failures;
+    std::string skipped;   // motivo si no se pudo comparar (sin serie o sin referencias)
+    bool ok() const { return failures.empty(); }
+};
+
+// Código de salida de --regression cuando se omite (ctest: SKIP_RETURN_CODE)
+constexpr int kRegressionSkipCode = 77;
+
+// Escribe el detalle en 'log'. Sin la serie o, sin update, sin ninguna
+// referencia, no compara y lo indica en 'skipped'. Lanza runtime_error si la
+// serie está vacía o faltan las referencias de solo algunas resoluciones.
+RegressionReport runRegression(const RegressionOptions& opts, std::ostream& log);
@@ -0,0 +1,207 @@
+#include "series_report.hpp"
+
+#include "itk_loader.hpp"
+#include "itk_opencv_bridge.hpp"
+#include "dicom_mmap.hpp"
+#include "highlight.hpp"
+#include "body_roi.hpp"
+#include "connected_components.hpp"
+#include "pipeline.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cmath>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+#include <opencv2/core/utility.hpp>
+
+namespace fs = std::filesystem;
+using namespace cv;
+
+// ==========================================================
+// Streaming de la serie
+// ==========================================================
+SeriesReport buildSeriesReport(const std::string& dicomDir, int maxInFlight) {
+    const auto t0 = std::chrono::steady_clock::now();
+
+    SeriesReport report;
+    report.dicomDir = dicomDir;
+
+    const std::vector<std::string> files = listDicomSeriesFiles(dicomDir);
+    const int n = static_cast<int>(files.size());
+    report.slices.resize(n);
+
+    // Acumuladores por corte sin histograma (se fusionan en orden al final,
+    // así el total no depende del reparto entre hilos)
+    std::vector<SliceStatsAccumulator> perSlice(n);
+    SliceStatsAccumulator histTotal;   // solo histogramas (suma entera, sin orden)
+    std::mutex histMutex;
+
+    const int workers = std::max(1, std::min(n, maxInFlight > 0 ? maxInFlight : getNumThreads()));
+    std::atomic<int> next{0};
+    std::exception_ptr firstError;
+    std::mutex errorMutex;
+
+    auto worker = [&]() {
+        try {
+            AnatomyMasks masks;   // buffers del worker, reutilizados en cada corte
+            RleLabelMap  labels;
+            for (int i = next++; i < n; i = next++) {
+                Mat hu = loadSliceHU(files[i]);   // mapeado si no está comprimido
+
+                // Como el pipeline: máscaras sobre el cuerpo + kRoiHalo y
+                // estadísticas solo dentro de la caja del cuerpo
+                Rect body = detectBodyRoi(hu);
+                if (body.empty()) body = Rect(0, 0, hu.cols, hu.rows);
+                const Rect work = expandRoi(body, kRoiHalo, hu.size());
+
+                generateAnatomicalLabelsHU(hu(work), labels, {}, masks);
+                labels = removeSmallComponents(labels, kMinComponentPx);
+                SliceStatsAccumulator acc;
+                accumulateTissueStats(hu(body), labels.crop(body - work.tl()), acc, /*withHistogram*/true);
+
+                {
+                    std::lock_guard<std::mutex> lock(histMutex);
+                    for (int l = 1; l < kNumTissueLabels; ++l) {
+                        auto& src = acc.tissues[l].histogram;
+                        if (src.empty()) continue;
+                        auto& dst = histTotal.tissues[l].histogram;
+                        if (dst.empty()) dst.assign(kHistBins, 0);
+                        for (int b = 0; b < kHistBins; ++b) dst[b] += src[b];
+                    }
+                }
+                for (auto& t : acc.tissues) t.histogram.clear();
+
+                report.slices[i].index = i;
+                report.slices[i].file  = fs::path(files[i]).filename().string();
+                report.slices[i].stats = acc.finish();
+                perSlice[i] = std::move(acc);
+            }
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(errorMutex);
+            if (!firstError) firstError = std::current_exception();
+            next = n;   // los demás workers terminan en su siguiente iteración
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for (int w = 1; w < workers; ++w) pool.emplace_back(worker);
+    worker();
+    for (auto& t : pool) t.join();
+    if (firstError) std::rethrow_exception(firstError);
+
+    for (const auto& acc : perSlice) report.total.merge(acc);
+    for (int l = 1; l < kNumTissueLabels; ++l)
+        report.total.tissues[l].histogram = std::move(histTotal.tissues[l].histogram);
+
+    report.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    return report;
+}
+
+// ==========================================================
+// Escritura CSV / JSON
+// ==========================================================
+namespace {
+
+void writeTissueCsv(std::ostream& os, const TissueStats& t) {
+    os << ',' << t.pixelCount << ',' << t.meanHU << ',' << t.stdHU
+       << ',' << t.minHU << ',' << t.maxHU;
+}
+
+// Cadena JSON entre comillas: escapa comillas, barras y caracteres de control
+void writeJsonString(std::ostream& os, const std::string& s) {
+    os << '"';
+    for (const unsigned char c : s) {
+        switch (c) {
+        case '"':  os << "\\\""; break;
+        case '\\': os << "\\\\"; break;
+        case '\n': os << "\\n"; break;
+        case '\r': os << "\\r"; break;
+        case '\t': os << "\\t"; break;
+        default:
+            if (c < 0x20) {
+                char buf[8];
+                std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+                os << buf;
+            } else {
+                os << c;
+            }
+        }
+    }
+    os << '"';
+}
+
+void writeTissueJson(std::ostream& os, const char* name, const TissueAccumulator& acc) {
+    const TissueStats t = acc.finish();
+    os << '"' << name << "\":{\"n\":" << t.pixelCount
+       << ",\"mean\":" << t.meanHU << ",\"std\":" << t.stdHU
+       << ",\"min\":" << t.minHU << ",\"max\":" << t.maxHU;
+    const double p50 = acc.percentileHU(0.5);
+    if (!std::isnan(p50)) os << ",\"p50\":" << p50;
+    os << '}';
+}
+
+std::ofstream openOutput(const std::string& path) {
+    const fs::path p(path);
+    if (p.has_parent_path()) fs::create_directories(p.parent_path());
+    std::ofstream os(path);
+    if (!os) throw std::runtime_error("No se pudo escribir: " + path);
+    os.precision(6);
+    return os;
+}
+
+} // namespace
+
+void writeSeriesReportCsv(const SeriesReport& report, const std::string& path) {
+    std::ofstream os = openOutput(path);
+    os << "slice,file";
+    for (const char* t : {"fat", "muscle", "bone"})
+        os << ',' << t << "_n," << t << "_mean," << t << "_std," << t << "_min," << t << "_max";
+    os << '\n';
+
+    for (const auto& row : report.slices) {
+        os << row.index << ',' << row.file;
+        writeTissueCsv(os, row.stats.fat);
+        writeTissueCsv(os, row.stats.muscle);
+        writeTissueCsv(os, row.stats.bone);
+        os << '\n';
+    }
+
+    const SliceStats total = report.total.finish();
+    os << "serie,";
+    writeTissueCsv(os, total.fat);
+    writeTissueCsv(os, total.muscle);
+    writeTissueCsv(os, total.bone);
+    os << '\n';
+}
+
+void writeSeriesReportJson(const SeriesReport& report, const std::string& path) {
+    std::ofstream os = openOutput(path);
+    os << "{\"series\":";
+    writeJsonString(os, fs::path(report.dicomDir).filename().string());
+    os << ",\"slices\":" << report.slices.size()
+       << ",\"seconds\":" << report.seconds
+       << ",\"total\":{";
+    writeTissueJson(os, "fat", report.total.tissues[LABEL_FAT]);
+    os << ',';
+    writeTissueJson(os, "muscle", report.total.tissues[LABEL_MUSCLE]);
+    os << ',';
+    writeTissueJson(os, "bone", report.total.tissues[LABEL_BONE]);
+    os << "},\"columns\":[\"fat_n\",\"fat_mean\",\"fat_std\",\"muscle_n\",\"muscle_mean\",\"muscle_std\","
+          "\"bone_n\",\"bone_mean\",\"bone_std\"],\"per_slice\":[";
+
+    for (size_t i = 0; i < report.slices.size(); ++i) {
+        const SliceStats& s = report.slices[i].stats;
+        if (i) os << ',';
+        os << '[' << s.fat.pixelCount << ',' << s.fat.meanHU << ',' << s.fat.stdHU
+           << ',' << s.muscle.pixelCount << ',' << s.muscle.meanHU << ',' << s.muscle.stdHU
+           << ',' << s.bone.pixelCount << ',' << s.bone.meanHU << ',' << s.bone.stdHU << ']';
+    }
+    os << "]}\n";
+}
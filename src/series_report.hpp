@@ -0,0 +1,30 @@
+#pragma once
+#include <string>
+#include <vector>
+
+#include "Stats.hpp"
+#include "tissue_stats.hpp"
+
+// Fila del informe: un corte de la serie
+struct SliceReportRow {
+    int         index = 0;
+    std::string file;
+    SliceStats  stats;
+};
+
+// Informe completo de una serie (por corte + total de la serie)
+struct SeriesReport {
+    std::string                 dicomDir;
+    std::vector<SliceReportRow> slices;
+    SliceStatsAccumulator       total;     // incluye histograma HU de la serie
+    double                      seconds = 0.0;
+};
+
+// Recorre todos los cortes de la serie en streaming: cada worker lee un corte,
+// genera las máscaras y acumula estadísticas, y lo descarta. En memoria solo
+// hay tantos cortes como workers (maxInFlight <= 0 → número de hilos de OpenCV).
+SeriesReport buildSeriesReport(const std::string& dicomDir, int maxInFlight = 0);
+
+// Tabla compacta por corte + fila "serie" al final
+void writeSeriesReportCsv(const SeriesReport& report, const std::string& path);
+void writeSeriesReportJson(const SeriesReport& report, const std::string& path);
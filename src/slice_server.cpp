@@ -0,0 +1,698 @@
+#include "slice_server.hpp"
+
+#include "dnn_precision.hpp"
+#include "evidence_store.hpp"
+#include "metrics.hpp"
+#include "model_registry.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace cv;
+
+// ==========================================================
+// E/S sobre el socket
+// ==========================================================
+class SocketConnection {
+public:
+    explicit SocketConnection(int fd) : fd_(fd) {}
+    ~SocketConnection() { if (fd_ >= 0) ::close(fd_); }
+
+    SocketConnection(const SocketConnection&) = delete;
+    SocketConnection& operator=(const SocketConnection&) = delete;
+
+    bool readLine(std::string& line) {
+        while (true) {
+            const size_t nl = buf_.find('\n');
+            if (nl != std::string::npos) {
+                line = buf_.substr(0, nl);
+                buf_.erase(0, nl + 1);
+                return true;
+            }
+            if (!fill()) return false;
+        }
+    }
+
+    bool readExact(void* dst, size_t n) {
+        uint8_t* p = static_cast<uint8_t*>(dst);
+        const size_t fromBuf = std::min(n, buf_.size());
+        std::memcpy(p, buf_.data(), fromBuf);
+        buf_.erase(0, fromBuf);
+        for (size_t got = fromBuf; got < n;) {
+            const ssize_t r = ::recv(fd_, p + got, n - got, 0);
+            if (r <= 0) return false;
+            got += static_cast<size_t>(r);
+        }
+        return true;
+    }
+
+    bool writeAll(const void* src, size_t n) {
+        const uint8_t* p = static_cast<const uint8_t*>(src);
+        for (size_t sent = 0; sent < n;) {
+            const ssize_t w = ::send(fd_, p + sent, n - sent, MSG_NOSIGNAL);
+            if (w <= 0) return false;
+            sent += static_cast<size_t>(w);
+        }
+        return true;
+    }
+
+    bool writeLine(const std::string& line) { return writeAll((line + "\n").data(), line.size() + 1); }
+
+private:
+    bool fill() {
+        char tmp[4096];
+        const ssize_t r = ::recv(fd_, tmp, sizeof(tmp), 0);
+        if (r <= 0) return false;
+        buf_.append(tmp, static_cast<size_t>(r));
+        return true;
+    }
+
+    int fd_;
+    std::string buf_;
+};
+
+namespace {
+
+std::vector<std::string> split(const std::string& s, char sep) {
+    std::vector<std::string> out;
+    std::string item;
+    std::istringstream is(s);
+    while (std::getline(is, item, sep)) out.push_back(item);
+    return out;
+}
+
+sockaddr_un socketAddress(const std::string& path) {
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path))
+        throw std::runtime_error("Ruta de socket demasiado larga: " + path);
+    std::strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+    return addr;
+}
+
+int connectTo(const std::string& path) {
+    const sockaddr_un addr = socketAddress(path);
+    const int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    if (::connect(fd, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) != 0) {
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// ==========================================================
+// Codificación de la petición
+// ==========================================================
+// Parámetros como clave=valor separados por comas (los que falten, por defecto)
+std::string encodeParams(const PipelineParams& p) {
+    std::ostringstream os;
+    os.precision(9);
+    os << "wc=" << p.windowCenter << ",ww=" << p.windowWidth << ",gauss=" << p.gaussSigma
+       << ",nlmh=" << p.nlmH << ",nlmt=" << p.nlmTemplate << ",nlms=" << p.nlmSearch
+       << ",clo=" << p.cannyLow << ",chi=" << p.cannyHigh << ",morph=" << p.morphKernel
+       << ",fatmin=" << p.tissue.fatMin << ",fatmax=" << p.tissue.fatMax
+       << ",musmin=" << p.tissue.muscleMin << ",musmax=" << p.tissue.muscleMax
+       << ",bonemin=" << p.tissue.boneMin << ",minpx=" << p.minComponentPx
+       << ",denoise=" << static_cast<int>(p.denoise.mode);
+    return os.str();
+}
+
+PipelineParams decodeParams(const std::string& s) {
+    PipelineParams p;
+    for (const auto& kv : split(s, ',')) {
+        const size_t eq = kv.find('=');
+        if (eq == std::string::npos) continue;
+        const std::string k = kv.substr(0, eq);
+        const double v = std::stod(kv.substr(eq + 1));
+        if      (k == "wc")      p.windowCenter     = static_cast<float>(v);
+        else if (k == "ww")      p.windowWidth      = static_cast<float>(v);
+        else if (k == "gauss")   p.gaussSigma       = v;
+        else if (k == "nlmh")    p.nlmH             = static_cast<float>(v);
+        else if (k == "nlmt")    p.nlmTemplate      = static_cast<int>(v);
+        else if (k == "nlms")    p.nlmSearch        = static_cast<int>(v);
+        else if (k == "clo")     p.cannyLow         = v;
+        else if (k == "chi")     p.cannyHigh        = v;
+        else if (k == "morph")   p.morphKernel      = static_cast<int>(v);
+        else if (k == "fatmin")  p.tissue.fatMin    = static_cast<decltype(p.tissue.fatMin)>(v);
+        else if (k == "fatmax")  p.tissue.fatMax    = static_cast<decltype(p.tissue.fatMax)>(v);
+        else if (k == "musmin")  p.tissue.muscleMin = static_cast<decltype(p.tissue.muscleMin)>(v);
+        else if (k == "musmax")  p.tissue.muscleMax = static_cast<decltype(p.tissue.muscleMax)>(v);
+        else if (k == "bonemin") p.tissue.boneMin   = static_cast<decltype(p.tissue.boneMin)>(v);
+        else if (k == "minpx")   p.minComponentPx   = static_cast<int>(v);
+        else if (k == "denoise") {
+            if (v != static_cast<int>(DenoiseMode::Full) && v != static_cast<int>(DenoiseMode::Adaptive))
+                throw std::runtime_error("Modo de filtrado no válido: " + kv.substr(eq + 1));
+            p.denoise.mode = static_cast<DenoiseMode>(static_cast<int>(v));
+        }
+    }
+    return p;
+}
+
+// Config DnCNN de la petición: modelo, "backend,target,hilos,precisión", calibración
+std::string encodeDnn(const DnnConfig& c) {
+    std::ostringstream os;
+    os << c.modelPath << '\t' << c.backend << ',' << c.target << ',' << c.threads << ','
+       << static_cast<int>(c.precision) << '\t' << c.calibDir;
+    return os.str();
+}
+
+DnnConfig decodeDnn(const std::vector<std::string>& f, size_t at) {
+    DnnConfig c;
+    c.modelPath = f[at];
+    const auto v = split(f[at + 1], ',');
+    if (v.size() != 4) throw std::runtime_error("Config DnCNN mal formada: " + f[at + 1]);
+    c.backend   = std::stoi(v[0]);
+    c.target    = std::stoi(v[1]);
+    c.threads   = std::stoi(v[2]);
+    c.precision = static_cast<DnnPrecision>(std::clamp(std::stoi(v[3]), 0, 2));
+    if (f.size() > at + 2) c.calibDir = f[at + 2];   // getline no deja el campo vacío final
+    return c;
+}
+
+std::string encodeStats(const SliceStats& s) {
+    std::ostringstream os;
+    os.precision(17);
+    bool first = true;
+    for (const TissueStats* t : { &s.fat, &s.muscle, &s.bone }) {
+        for (double v : { double(t->pixelCount), t->meanHU, t->stdHU, t->minHU, t->maxHU }) {
+            os << (first ? "" : ",") << v;
+            first = false;
+        }
+    }
+    return os.str();
+}
+
+SliceStats decodeStats(const std::string& s) {
+    SliceStats out;
+    const auto v = split(s, ',');
+    if (v.size() != 15) return out;
+    TissueStats* ts[3] = { &out.fat, &out.muscle, &out.bone };
+    for (int i = 0; i < 3; ++i) {
+        ts[i]->pixelCount = static_cast<int>(std::stod(v[5 * i]));
+        ts[i]->meanHU     = std::stod(v[5 * i + 1]);
+        ts[i]->stdHU      = std::stod(v[5 * i + 2]);
+        ts[i]->minHU      = std::stod(v[5 * i + 3]);
+        ts[i]->maxHU      = std::stod(v[5 * i + 4]);
+    }
+    return out;
+}
+
+// Un corte: cabecera + evidencias pedidas + los 3 mapas de etiquetas
+bool sendSlice(SocketConnection& conn, int index, const PipelineResults& r, const std::vector<int>& evidences) {
+    const RleLabelMap* labels[3] = { &r.labelsRaw, &r.labelsGauss, &r.labelsDnn };
+    std::ostringstream head;
+    head << "SLICE\t" << index << "\t" << evidences.size() + 3 << "\t"
+         << r.roi.x << "," << r.roi.y << "," << r.roi.width << "," << r.roi.height << "\t"
+         << encodeStats(r.stats);
+    if (!conn.writeLine(head.str())) return false;
+
+    for (int e : evidences) {
+        const Mat img = r.images[e].isContinuous() ? r.images[e] : r.images[e].clone();
+        const size_t bytes = img.total() * img.elemSize();
+        std::ostringstream h;
+        h << "LAYER\t" << e << "\t" << img.rows << "\t" << img.cols << "\t" << img.type() << "\t" << bytes;
+        if (!conn.writeLine(h.str()) || !conn.writeAll(img.data, bytes)) return false;
+    }
+
+    std::vector<uint8_t> packed;
+    for (int i = 0; i < 3; ++i) {
+        labels[i]->serialize(packed);
+        std::ostringstream h;
+        h << "LAYER\t" << LAYER_LABELS_RAW + i << "\t" << labels[i]->size().height << "\t"
+          << labels[i]->size().width << "\t" << CV_8U << "\t" << packed.size();
+        if (!conn.writeLine(h.str()) || !conn.writeAll(packed.data(), packed.size())) return false;
+    }
+    return true;
+}
+
+// El proceso al otro lado del socket es del mismo usuario que el servidor
+bool samePeerUser(int fd) {
+    ucred cred{};
+    socklen_t len = sizeof(cred);
+    return ::getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) == 0 && len == sizeof(cred) &&
+           cred.uid == ::getuid();
+}
+
+} // namespace
+
+std::string defaultServerSocketPath() {
+    if (const char* env = std::getenv("VISION_SERVER")) return env;
+    if (const char* run = std::getenv("XDG_RUNTIME_DIR")) return std::string(run) + "/vision_interciclo.sock";
+    return "/tmp/vision_interciclo-" + std::to_string(::getuid()) + ".sock";
+}
+
+// ==========================================================
+// BatchingDenoiser
+// ==========================================================
+BatchingDenoiser::BatchingDenoiser(std::unique_ptr<DnnDenoiser> inner, int maxBatch, int waitMs)
+    : inner_(std::move(inner)), maxBatch_(std::max(1, maxBatch)), waitMs_(std::max(0, waitMs)) {
+    worker_ = std::thread([this] { loop(); });
+}
+
+BatchingDenoiser::~BatchingDenoiser() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    cv_.notify_all();
+    worker_.join();
+}
+
+Mat BatchingDenoiser::denoise(const Mat& input8u) {
+    Pending p;
+    p.input = input8u;
+    std::future<Mat> result = p.result.get_future();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stop_) throw std::runtime_error("Denoiser detenido");
+        queue_.push_back(&p);
+    }
+    cv_.notify_all();
+    return result.get();
+}
+
+void BatchingDenoiser::loop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        cv_.wait(lock, [&] { return stop_ || !queue_.empty(); });
+        if (queue_.empty()) return;   // stop_ y nada pendiente
+
+        // Espera corta a que otros hilos completen el lote
+        if (static_cast<int>(queue_.size()) < maxBatch_ && !stop_) {
+            cv_.wait_for(lock, std::chrono::milliseconds(waitMs_), [&] {
+                return stop_ || static_cast<int>(queue_.size()) >= maxBatch_;
+            });
+        }
+
+        // Lote: las primeras pendientes del mismo tamaño y tipo que la más antigua
+        std::vector<Pending*> batch;
+        const Size size = queue_.front()->input.size();
+        const int  type = queue_.front()->input.type();
+        for (auto it = queue_.begin(); it != queue_.end() && static_cast<int>(batch.size()) < maxBatch_;) {
+            if ((*it)->input.size() == size && (*it)->input.type() == type) {
+                batch.push_back(*it);
+                it = queue_.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        lock.unlock();
+
+        try {
+            std::vector<Mat> inputs;
+            for (Pending* p : batch) inputs.push_back(p->input);
+            std::vector<Mat> outputs = inner_->denoiseBatch(inputs);
+            for (size_t i = 0; i < batch.size(); ++i) batch[i]->result.set_value(outputs[i]);
+        } catch (...) {
+            for (Pending* p : batch) p->result.set_exception(std::current_exception());
+        }
+        ++forwards_;
+        images_ += batch.size();
+
+        lock.lock();
+    }
+}
+
+// ==========================================================
+// VolumeCache
+// ==========================================================
+VolumeCache::VolumeCache(size_t capacity) : capacity_(capacity) {
+    memoryGovernor().add(this, MemoryPriority::Volume);
+}
+
+VolumeCache::~VolumeCache() {
+    memoryGovernor().remove(this);
+}
+
+void VolumeCache::eraseLocked(std::map<std::string, Entry>::iterator it) {
+    bytes_ -= it->second.bytes;
+    entries_.erase(it);
+}
+
+std::shared_ptr<const Volume> VolumeCache::get(const std::string& dicomDir) {
+    std::promise<std::shared_ptr<const Volume>> promise;
+    std::shared_future<std::shared_ptr<const Volume>> volume;
+    bool loader = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = entries_.find(dicomDir);
+        if (it != entries_.end()) {
+            it->second.lastUse = ++tick_;
+            volume = it->second.volume;
+        } else {
+            volume = promise.get_future().share();
+            entries_[dicomDir] = { volume, ++tick_, 0 };
+            loader = true;
+
+            // Fuera la menos usada (quien la tenga en uso conserva su shared_ptr)
+            while (entries_.size() > std::max<size_t>(1, capacity_)) {
+                auto oldest = entries_.end();
+                for (auto e = entries_.begin(); e != entries_.end(); ++e)
+                    if (e->first != dicomDir && (oldest == entries_.end() || e->second.lastUse < oldest->second.lastUse))
+                        oldest = e;
+                if (oldest == entries_.end()) break;
+                eraseLocked(oldest);
+            }
+        }
+    }
+
+    static MetricCounter& hits   = metrics().counter("volumen.aciertos");
+    static MetricCounter& misses = metrics().counter("volumen.fallos");
+    (loader ? misses : hits).add();
+
+    if (loader) {
+        try {
+            auto v = std::make_shared<Volume>(loadDicomSeries(dicomDir));
+            if (v->image.IsNull()) throw std::runtime_error("No se pudo leer la serie: " + dicomDir);
+            const size_t bytes = volumeBytes(*v);
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                auto it = entries_.find(dicomDir);
+                if (it != entries_.end()) {
+                    it->second.bytes = bytes;
+                    bytes_ += bytes;
+                }
+            }
+            promise.set_value(std::move(v));
+            memoryGovernor().makeRoom();
+        } catch (...) {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                auto it = entries_.find(dicomDir);
+                if (it != entries_.end()) eraseLocked(it);   // el siguiente intento vuelve a cargar
+            }
+            promise.set_exception(std::current_exception());
+        }
+    }
+    return volume.get();
+}
+
+// Series ya cargadas que solo tiene la caché, de la menos usada a la más
+size_t VolumeCache::releaseMemory(size_t bytes) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_t freed = 0;
+    while (freed < bytes) {
+        auto oldest = entries_.end();
+        for (auto e = entries_.begin(); e != entries_.end(); ++e) {
+            if (e->second.bytes == 0 || e->second.volume.get().use_count() > 1) continue;
+            if (oldest == entries_.end() || e->second.lastUse < oldest->second.lastUse) oldest = e;
+        }
+        if (oldest == entries_.end()) break;
+        freed += oldest->second.bytes;
+        eraseLocked(oldest);
+    }
+    return freed;
+}
+
+// ==========================================================
+// SliceServer
+// ==========================================================
+SliceServer::SliceServer(const SliceServerOptions& opts)
+    : opts_(opts), volumes_(opts.volumeCacheSize) {
+    if (opts_.socketPath.empty()) opts_.socketPath = defaultServerSocketPath();
+
+    if (!opts_.dnn.modelPath.empty()) {
+        denoiser_ = std::make_shared<BatchingDenoiser>(createDnnDenoiser(opts_.dnn, opts_.calibDir),
+                                                       opts_.maxBatch, opts_.batchWaitMs);
+    }
+
+    // Un socket que responde es otro servidor vivo; si no, es un resto
+    if (const int fd = connectTo(opts_.socketPath); fd >= 0) {
+        ::close(fd);
+        throw std::runtime_error("Ya hay un servidor en " + opts_.socketPath);
+    }
+    ::unlink(opts_.socketPath.c_str());
+
+    const sockaddr_un addr = socketAddress(opts_.socketPath);
+    listenFd_ = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    // Solo el usuario del servidor: permisos 0600 antes de listen (nadie puede
+    // conectar entre bind y chmod) y, por si el sistema los ignora en sockets,
+    // credenciales del otro extremo en cada accept
+    if (listenFd_ < 0 ||
+        ::bind(listenFd_, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) != 0 ||
+        ::chmod(opts_.socketPath.c_str(), S_IRUSR | S_IWUSR) != 0 ||
+        ::listen(listenFd_, 16) != 0) {
+        if (listenFd_ >= 0) ::close(listenFd_);
+        throw std::runtime_error("No se pudo abrir el socket: " + opts_.socketPath);
+    }
+}
+
+SliceServer::~SliceServer() {
+    stop_ = true;
+    {
+        std::unique_lock<std::mutex> lock(clientsMutex_);
+        clientsDone_.wait(lock, [&] { return activeClients_ == 0; });
+    }
+    if (listenFd_ >= 0) {
+        ::close(listenFd_);
+        ::unlink(opts_.socketPath.c_str());
+    }
+}
+
+void SliceServer::run() {
+    while (!stop_) {
+        pollfd pfd{ listenFd_, POLLIN, 0 };
+        if (::poll(&pfd, 1, 200) <= 0) continue;   // timeout: mira stop_
+        const int fd = ::accept(listenFd_, nullptr, nullptr);
+        if (fd < 0) continue;
+        if (!samePeerUser(fd)) {
+            std::fprintf(stderr, "[SERVIDOR] conexión rechazada: otro usuario\n");
+            ::close(fd);
+            continue;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(clientsMutex_);
+            ++activeClients_;
+        }
+        std::thread([this, fd] {
+            try { serveClient(fd); } catch (...) {}
+            std::lock_guard<std::mutex> lock(clientsMutex_);
+            --activeClients_;
+            clientsDone_.notify_all();
+        }).detach();
+    }
+}
+
+void SliceServer::serveClient(int fd) {
+    SocketConnection conn(fd);
+    std::string line;
+    if (!conn.readLine(line)) return;
+
+    const std::string cmd = line.substr(0, line.find('\t'));
+    if (cmd == "PING") {
+        conn.writeLine("PONG");
+    } else if (cmd == "STATS") {
+        std::ostringstream os;
+        os << "STATS\trequests=" << requests_ << "\tslices=" << slices_;
+        if (denoiser_) os << "\tforwards=" << denoiser_->forwards() << "\tdenoised=" << denoiser_->images();
+        conn.writeLine(os.str());
+    } else if (cmd == "SHUTDOWN") {
+        conn.writeLine("BYE");
+        stop_ = true;
+    } else if (cmd == "PROCESS") {
+        serveProcess(conn, line);
+    } else {
+        conn.writeLine("ERR\tOrden desconocida: " + cmd);
+    }
+}
+
+void SliceServer::serveProcess(SocketConnection& conn, const std::string& line) {
+    ++requests_;
+    const auto f = split(line, '\t');
+
+    try {
+        if (f.size() < 7) throw std::runtime_error("PROCESS mal formado");
+        SliceRequest req;
+        req.dicomDir = f[1];
+        req.first    = std::stoi(f[2]);
+        req.last     = std::stoi(f[3]);
+        if (f[4] != "all")
+            for (const auto& e : split(f[4], ',')) req.evidences.push_back(std::stoi(e));
+        req.plane  = parsePlane(f[5]);
+        req.params = decodeParams(f[6]);
+        if (f.size() >= 9) req.dnn = decodeDnn(f, 7);
+        if (req.evidences.empty())
+            for (int e = 0; e < kNumEvidences; ++e) req.evidences.push_back(e);
+        for (int e : req.evidences)
+            if (e < 0 || e >= kNumEvidences) throw std::runtime_error("Evidencia fuera de rango: " + std::to_string(e));
+
+        const std::shared_ptr<BatchingDenoiser> denoiser = denoiserFor(req.dnn);
+        const std::shared_ptr<const Volume> vol = volumes_.get(req.dicomDir);
+        const int n = planeSliceCount(vol->image, req.plane);
+        const int first = std::clamp(req.first, 0, n - 1);
+        const int last  = req.last < 0 ? n - 1 : std::clamp(req.last, first, n - 1);
+        if (!conn.writeLine("OK\t" + std::to_string(last - first + 1))) return;
+
+        // Varios cortes en vuelo: sus forwards DnCNN coinciden y se agrupan
+        std::atomic<int> next{ first };
+        std::atomic<bool> failed{ false };
+        std::mutex writeMutex;
+        std::string error;
+        auto worker = [&] {
+            PipelineResults res;   // buffers del worker
+            PipelineOptions opts;
+            opts.params = req.params;
+            for (int i = next++; i <= last && !failed; i = next++) {
+                try {
+                    runSlicePipeline(reformatSlice(vol->image, req.plane, i), denoiser.get(), res, opts);
+                } catch (const std::exception& e) {
+                    std::lock_guard<std::mutex> lock(writeMutex);
+                    if (!failed.exchange(true)) error = e.what();
+                    return;
+                }
+                std::lock_guard<std::mutex> lock(writeMutex);
+                if (failed) return;
+                if (!sendSlice(conn, i, res, req.evidences)) { failed = true; return; }
+                ++slices_;
+            }
+        };
+        const int workers = std::max(1, std::min(opts_.sliceWorkers, last - first + 1));
+        std::vector<std::thread> pool;
+        for (int w = 1; w < workers; ++w) pool.emplace_back(worker);
+        worker();
+        for (auto& t : pool) t.join();
+
+        if (!error.empty()) conn.writeLine("ERR\t" + error);
+        else if (!failed)   conn.writeLine("END");
+    } catch (const std::exception& e) {
+        conn.writeLine(std::string("ERR\t") + e.what());
+    }
+}
+
+std::shared_ptr<BatchingDenoiser> SliceServer::denoiserFor(const DnnConfig& cfg) {
+    if (cfg.modelPath.empty()) return denoiser_;
+    DnnConfig startup = opts_.dnn;
+    startup.calibDir = startup.precision == DnnPrecision::INT8 ? opts_.calibDir : std::string();
+    const std::string key = encodeDnn(cfg);
+    if (denoiser_ && key == encodeDnn(startup)) return denoiser_;
+
+    // Se carga con el cerrojo tomado: dos peticiones iguales esperan a una
+    // sola carga. Pocos modelos a la vez (cada uno retiene su espacio de
+    // trabajo); los que siguen en uso viven hasta que acabe su petición.
+    constexpr size_t kMaxLoadedModels = 2;
+    std::lock_guard<std::mutex> lock(denoisersMutex_);
+    auto it = denoisers_.find(key);
+    if (it != denoisers_.end()) {
+        it->second.lastUse = ++denoiserTick_;
+        return it->second.denoiser;
+    }
+    auto den = std::make_shared<BatchingDenoiser>(createDnnDenoiser(cfg, cfg.calibDir), opts_.maxBatch,
+                                                  opts_.batchWaitMs);
+    if (denoisers_.size() >= kMaxLoadedModels) {   // fuera el menos usado recientemente
+        auto oldest = denoisers_.begin();
+        for (auto e = denoisers_.begin(); e != denoisers_.end(); ++e)
+            if (e->second.lastUse < oldest->second.lastUse) oldest = e;
+        denoisers_.erase(oldest);
+    }
+    denoisers_[key] = { den, ++denoiserTick_ };
+    std::printf("[SERVIDOR] DnCNN cargado para un cliente: %s\n", describeDnnConfig(den->config()).c_str());
+    return den;
+}
+
+// ==========================================================
+// SliceClient
+// ==========================================================
+SliceClient::SliceClient(std::string socketPath)
+    : path_(socketPath.empty() ? defaultServerSocketPath() : std::move(socketPath)) {}
+
+bool SliceClient::ping() const {
+    const int fd = connectTo(path_);
+    if (fd < 0) return false;
+    SocketConnection conn(fd);
+    std::string line;
+    return conn.writeLine("PING") && conn.readLine(line) && line == "PONG";
+}
+
+std::string SliceClient::stats() const {
+    const int fd = connectTo(path_);
+    if (fd < 0) throw std::runtime_error("Servidor no disponible: " + path_);
+    SocketConnection conn(fd);
+    std::string line;
+    if (!conn.writeLine("STATS") || !conn.readLine(line)) throw std::runtime_error("Sin respuesta del servidor");
+    return line;
+}
+
+void SliceClient::shutdown() const {
+    const int fd = connectTo(path_);
+    if (fd < 0) return;
+    SocketConnection conn(fd);
+    std::string line;
+    if (conn.writeLine("SHUTDOWN")) conn.readLine(line);
+}
+
+void SliceClient::process(const SliceRequest& req,
+                          const std::function<void(int, PipelineResults&)>& onSlice) const {
+    const int fd = connectTo(path_);
+    if (fd < 0) throw std::runtime_error("Servidor no disponible: " + path_);
+    SocketConnection conn(fd);
+
+    std::string evidences;
+    for (int e : req.evidences) evidences += (evidences.empty() ? "" : ",") + std::to_string(e);
+    std::ostringstream os;
+    os << "PROCESS\t" << req.dicomDir << "\t" << req.first << "\t" << req.last << "\t"
+       << (evidences.empty() ? "all" : evidences) << "\t" << planeName(req.plane) << "\t"
+       << encodeParams(req.params);
+    if (!req.dnn.modelPath.empty()) os << '\t' << encodeDnn(req.dnn);
+    if (!conn.writeLine(os.str())) throw std::runtime_error("No se pudo enviar la petición");
+
+    std::string line;
+    auto fail = [&](const std::string& what) -> void {
+        throw std::runtime_error(line.rfind("ERR\t", 0) == 0 ? line.substr(4) : what);
+    };
+    if (!conn.readLine(line) || line.rfind("OK", 0) != 0) fail("Respuesta inesperada del servidor");
+
+    PipelineResults res;
+    std::vector<uint8_t> packed;
+    while (conn.readLine(line)) {
+        if (line == "END") return;
+        const auto f = split(line, '\t');
+        if (f.size() < 5 || f[0] != "SLICE") fail("Respuesta inesperada del servidor");
+
+        const int index   = std::stoi(f[1]);
+        const int nLayers = std::stoi(f[2]);
+        const auto roi = split(f[3], ',');
+        if (roi.size() == 4)
+            res.roi = Rect(std::stoi(roi[0]), std::stoi(roi[1]), std::stoi(roi[2]), std::stoi(roi[3]));
+        res.stats = decodeStats(f[4]);
+        for (auto& img : res.images) img.release();
+
+        for (int l = 0; l < nLayers; ++l) {
+            if (!conn.readLine(line)) fail("Conexión cerrada a mitad de corte");
+            const auto h = split(line, '\t');
+            if (h.size() != 6 || h[0] != "LAYER") fail("Capa mal formada");
+            const int    layer = std::stoi(h[1]);
+            const int    rows  = std::stoi(h[2]);
+            const int    cols  = std::stoi(h[3]);
+            const int    type  = std::stoi(h[4]);
+            const size_t bytes = std::stoull(h[5]);
+
+            if (layer < kNumEvidences) {
+                Mat& img = res.images[layer];
+                img.create(rows, cols, type);
+                if (img.total() * img.elemSize() != bytes || !conn.readExact(img.data, bytes))
+                    fail("Capa incompleta");
+            } else {
+                packed.resize(bytes);
+                RleLabelMap* labels[3] = { &res.labelsRaw, &res.labelsGauss, &res.labelsDnn };
+                if (layer > LAYER_LABELS_DNN || !conn.readExact(packed.data(), bytes) ||
+                    !RleLabelMap::deserialize(packed.data(), bytes, *labels[layer - LAYER_LABELS_RAW]))
+                    fail("Etiquetas incompletas");
+            }
+        }
+        onSlice(index, res);
+    }
+    fail("Conexión cerrada antes de END");
+}
@@ -0,0 +1,192 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <opencv2/core.hpp>
+
+#include "dnn_denoising.hpp"
+#include "itk_loader.hpp"
+#include "memory_governor.hpp"
+#include "pipeline.hpp"
+#include "reformat.hpp"
+
+// ==========================================================
+// Servidor local de procesado (socket Unix)
+// ==========================================================
+// Un proceso de larga duración con ITK, las series cargadas y el DnCNN ya
+// caliente; la app Qt y los trabajos por lotes le piden cortes como clientes.
+// Protocolo por líneas de texto (campos separados por tabuladores) con las
+// imágenes en binario detrás de su cabecera:
+//
+//   → PROCESS  dir  primero  último  evidencias  plano  parámetros  [modelo  config  calibración]
+//   ← OK  nCortes
+//   ← SLICE  índice  nCapas  roi(x,y,w,h)  stats(15 valores)      (por corte)
+//   ← LAYER  capa  filas  cols  tipo  bytes  + bytes               (por capa)
+//   ← END                     (o ERR mensaje en cualquier momento)
+//
+//   → PING / STATS / SHUTDOWN   ← PONG / STATS ... / BYE
+//
+// Las capas 0..12 son las evidencias pedidas (Mat tal cual) y las 13..15 los
+// mapas de etiquetas serializados (ver evidence_store.hpp). Los cortes de una
+// petición pueden llegar desordenados: cada uno lleva su índice.
+// Sin modelo se usa el DnCNN con el que arrancó el servidor; con modelo
+// (config = backend,target,hilos,precisión) el servidor carga ese y lo guarda
+// para las siguientes peticiones.
+
+// $VISION_SERVER, $XDG_RUNTIME_DIR/vision_interciclo.sock o /tmp/vision_interciclo-<uid>.sock
+std::string defaultServerSocketPath();
+
+// Junta las llamadas concurrentes a denoise() (una por hilo/petición) en un
+// solo forward por lotes: espera como mucho 'waitMs' a completar 'maxBatch'
+// imágenes del mismo tamaño. La red solo la usa el hilo del lote.
+class BatchingDenoiser : public Denoiser {
+public:
+    explicit BatchingDenoiser(std::unique_ptr<DnnDenoiser> inner, int maxBatch = 8, int waitMs = 4);
+    ~BatchingDenoiser() override;
+
+    cv::Mat denoise(const cv::Mat& input8u) override;
+    // La del modelo real: mismas claves del caché de etapas que sin lotes
+    const DnnConfig& config() const override { return inner_->config(); }
+
+    uint64_t forwards() const { return forwards_; }   // forwards ejecutados
+    uint64_t images()   const { return images_; }     // imágenes procesadas
+
+private:
+    struct Pending {
+        cv::Mat input;
+        std::promise<cv::Mat> result;
+    };
+    void loop();
+
+    std::unique_ptr<DnnDenoiser> inner_;
+    int maxBatch_;
+    int waitMs_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<Pending*> queue_;
+    bool stop_ = false;
+    std::atomic<uint64_t> forwards_{0};
+    std::atomic<uint64_t> images_{0};
+    std::thread worker_;
+};
+
+// Series en memoria compartidas entre peticiones: dos clientes que piden la
+// misma serie a la vez esperan a una única carga. LRU de 'capacity' series.
+// Bajo presión de memoria suelta las series que nadie está usando (la
+// siguiente petición las vuelve a leer).
+class VolumeCache : public MemoryConsumer {
+public:
+    explicit VolumeCache(size_t capacity = 2);
+    ~VolumeCache() override;
+
+    std::shared_ptr<const Volume> get(const std::string& dicomDir);   // lanza si no carga
+
+    const char* memoryName() const override { return "series en memoria"; }
+    size_t      memoryBytes() const override { return bytes_; }
+    size_t      releaseMemory(size_t bytes) override;
+
+private:
+    struct Entry {
+        std::shared_future<std::shared_ptr<const Volume>> volume;
+        uint64_t lastUse = 0;
+        size_t   bytes   = 0;   // 0 mientras carga
+    };
+    void eraseLocked(std::map<std::string, Entry>::iterator it);
+
+    size_t   capacity_;
+    uint64_t tick_ = 0;
+    std::mutex mutex_;
+    std::map<std::string, Entry> entries_;
+    std::atomic<size_t> bytes_{0};
+};
+
+struct SliceRequest {
+    std::string dicomDir;
+    int   first = 0;
+    int   last  = -1;            // -1 → hasta el último corte
+    std::vector<int> evidences;  // vacío → las 13
+    Plane plane = Plane::Axial;
+    PipelineParams params;
+    DnnConfig dnn;               // modelPath vacío → el DnCNN del servidor
+};
+
+class SocketConnection;
+
+struct SliceServerOptions {
+    std::string socketPath;          // vacío → defaultServerSocketPath()
+    DnnConfig   dnn;                 // modelPath vacío → sin DnCNN
+    std::string calibDir;            // cortes de calibración INT8
+    int    maxBatch          = 8;    // imágenes por forward DnCNN
+    int    batchWaitMs       = 4;    // espera máxima para llenar un lote
+    int    sliceWorkers      = 4;    // cortes en vuelo por petición
+    size_t volumeCacheSize   = 2;    // series en memoria
+};
+
+class SliceServer {
+public:
+    explicit SliceServer(const SliceServerOptions& opts);   // carga el modelo
+    ~SliceServer();
+
+    SliceServer(const SliceServer&) = delete;
+    SliceServer& operator=(const SliceServer&) = delete;
+
+    // Acepta clientes hasta stop() o SHUTDOWN (un hilo por conexión)
+    void run();
+    void stop() { stop_ = true; }   // apto para un manejador de señales
+
+    const std::string& socketPath() const { return opts_.socketPath; }
+
+private:
+    void serveClient(int fd);
+    void serveProcess(SocketConnection& conn, const std::string& line);
+    // DnCNN de una petición: el del arranque o uno cargado para otra config
+    std::shared_ptr<BatchingDenoiser> denoiserFor(const DnnConfig& cfg);
+
+    SliceServerOptions opts_;
+    std::shared_ptr<BatchingDenoiser> denoiser_;
+    struct LoadedDenoiser {
+        std::shared_ptr<BatchingDenoiser> denoiser;
+        uint64_t lastUse = 0;
+    };
+    std::mutex denoisersMutex_;
+    uint64_t denoiserTick_ = 0;
+    std::map<std::string, LoadedDenoiser> denoisers_;   // pedidos por clientes (LRU)
+    VolumeCache volumes_;
+    std::atomic<bool> stop_{false};
+    int listenFd_ = -1;
+
+    std::mutex clientsMutex_;
+    std::condition_variable clientsDone_;
+    int activeClients_ = 0;
+
+    std::atomic<uint64_t> requests_{0};
+    std::atomic<uint64_t> slices_{0};
+};
+
+// Cliente: una conexión por llamada
+class SliceClient {
+public:
+    explicit SliceClient(std::string socketPath = "");
+
+    bool ping() const;
+    std::string stats() const;
+    void shutdown() const;
+
+    // Llama a onSlice(índice, resultados) por cada corte recibido (las
+    // evidencias no pedidas quedan vacías). Lanza std::runtime_error si el
+    // servidor no responde o devuelve ERR.
+    void process(const SliceRequest& req,
+                 const std::function<void(int, PipelineResults&)>& onSlice) const;
+
+private:
+    std::string path_;
+};
@@ -0,0 +1,328 @@
+#include "stage_cache.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+namespace fs = std::filesystem;
+using namespace cv;
+
+namespace {
+constexpr uint64_t kMul = 0x9e3779b97f4a7c15ull;
+constexpr char     kDiskMagic[4] = { 'V', 'S', 'C', '1' };
+
+inline uint64_t rotl(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+
+// Mezcla final (splitmix64): reparte bien los bits para usar la clave en tablas
+inline uint64_t fmix(uint64_t x) {
+    x ^= x >> 30; x *= 0xbf58476d1ce4e5b9ull;
+    x ^= x >> 27; x *= 0x94d049bb133111ebull;
+    x ^= x >> 31;
+    return x;
+}
+
+size_t matBytes(const Mat& m) { return m.total() * m.elemSize(); }
+
+size_t matsBytes(const std::vector<Mat>& mats) {
+    size_t bytes = 0;
+    for (const Mat& m : mats) bytes += matBytes(m);
+    return bytes;
+}
+
+// Algún Mat de la entrada sigue compartido con quien lo pidió con get():
+// soltarlo no libera nada hasta que el llamador lo suelte
+bool sharedWithCallers(const std::vector<Mat>& mats) {
+    for (const Mat& m : mats)
+        if (m.u && CV_XADD(&m.u->refcount, 0) > 1) return true;
+    return false;
+}
+} // namespace
+
+// ==========================================================
+// KeyHasher
+// ==========================================================
+KeyHasher& KeyHasher::bytes(const void* data, size_t n) {
+    const auto* p = static_cast<const unsigned char*>(data);
+    len_ += n;
+
+    // Palabras de 8 bytes: un multiply-rotate por palabra (~GB/s)
+    for (; n >= 8; p += 8, n -= 8) {
+        uint64_t w;
+        std::memcpy(&w, p, 8);
+        h_ = rotl(h_ ^ (w * kMul), 29) * kMul;
+    }
+    if (n) {
+        uint64_t w = 0;
+        std::memcpy(&w, p, n);
+        h_ = rotl(h_ ^ (w * kMul), 29) * kMul;
+    }
+    return *this;
+}
+
+KeyHasher& KeyHasher::add(const std::string& s) {
+    const uint64_t n = s.size();
+    bytes(&n, sizeof(n));
+    return bytes(s.data(), s.size());
+}
+
+KeyHasher& KeyHasher::add(const Mat& m) {
+    const int geom[3] = { m.rows, m.cols, m.type() };
+    bytes(geom, sizeof(geom));
+    if (m.empty()) return *this;
+
+    const size_t rowBytes = m.cols * m.elemSize();
+    if (m.isContinuous()) return bytes(m.data, rowBytes * m.rows);
+    for (int r = 0; r < m.rows; ++r) bytes(m.ptr(r), rowBytes);
+    return *this;
+}
+
+StageKey KeyHasher::key() const {
+    return fmix(h_ ^ len_);
+}
+
+StageKey hashMat(const Mat& m) {
+    return KeyHasher().add(m).key();
+}
+
+// ==========================================================
+// StageCache
+// ==========================================================
+StageCache::StageCache(size_t budgetBytes, std::string diskDir)
+    : budget_(budgetBytes), diskDir_(std::move(diskDir))
+{
+    if (!diskDir_.empty()) {
+        std::error_code ec;
+        fs::create_directories(diskDir_, ec);
+        if (ec) diskDir_.clear();   // sin permisos → solo memoria
+    }
+    memoryGovernor().add(this, MemoryPriority::Cache);
+}
+
+StageCache::~StageCache() {
+    memoryGovernor().remove(this);
+    clear();
+}
+
+bool StageCache::get(StageKey key, std::vector<Mat>& out) {
+    bool reloaded = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = entries_.find(key);
+        if (it != entries_.end() && it->second.spilled.valid()) {
+            // Volcada al intercambio: se recarga y vuelve a la cabeza del LRU
+            std::vector<Mat> mats;
+            const bool ok = memoryGovernor().spill().read(it->second.spilled, mats);
+            eraseLocked(it);
+            if (ok) {
+                memoryGovernor().countReload(matsBytes(mats));
+                ++counters_.spillHits;
+                out = mats;
+                insertLocked(key, std::move(mats));
+                reloaded = true;
+            }
+        } else if (it != entries_.end()) {
+            lru_.splice(lru_.begin(), lru_, it->second.lru);
+            out = it->second.mats;   // cabeceras: los datos siguen siendo del caché
+            ++counters_.hits;
+            return true;
+        }
+    }
+    if (reloaded) {
+        memoryGovernor().makeRoom();
+        return true;
+    }
+
+    std::vector<Mat> mats;
+    if (!diskDir_.empty() && readDisk(key, mats)) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            ++counters_.diskHits;
+            out = mats;
+            insertLocked(key, std::move(mats));
+        }
+        memoryGovernor().makeRoom();
+        return true;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++counters_.misses;
+    return false;
+}
+
+bool StageCache::get(StageKey key, Mat& out) {
+    std::vector<Mat> mats;
+    if (!get(key, mats) || mats.size() != 1) return false;
+    mats[0].copyTo(out);   // el Mat de salida se sigue reutilizando corte a corte
+    return true;
+}
+
+void StageCache::put(StageKey key, const std::vector<Mat>& outputs) {
+    if (budget_ == 0) return;
+
+    std::vector<Mat> mats;
+    mats.reserve(outputs.size());
+    for (const Mat& m : outputs) mats.push_back(m.clone());
+
+    if (!diskDir_.empty()) writeDisk(key, mats);
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        insertLocked(key, std::move(mats));
+    }
+    memoryGovernor().makeRoom();
+}
+
+void StageCache::insertLocked(StageKey key, std::vector<Mat> mats) {
+    const size_t bytes = matsBytes(mats);
+    if (bytes > budget_) return;
+
+    auto it = entries_.find(key);
+    if (it != entries_.end()) eraseLocked(it);
+
+    // Expulsa lo menos usado hasta que quepa
+    while (counters_.bytes + bytes > budget_ && !lru_.empty()) eraseLocked(entries_.find(lru_.back()));
+
+    lru_.push_front(key);
+    entries_[key] = Entry{ std::move(mats), bytes, lru_.begin(), {} };
+    counters_.bytes += bytes;
+    residentBytes_ = counters_.bytes;
+}
+
+void StageCache::eraseLocked(std::unordered_map<StageKey, Entry>::iterator it) {
+    if (it->second.spilled.valid()) memoryGovernor().spill().release(it->second.spilled);
+    else counters_.bytes -= it->second.bytes;
+    residentBytes_ = counters_.bytes;
+    lru_.erase(it->second.lru);
+    entries_.erase(it);
+}
+
+// Gobernador: las entradas menos usadas salen de memoria. Con directorio en
+// disco ya están allí y basta con soltarlas; si no, van al intercambio (o se
+// pierden si no cabe). Las que aún comparte un llamador se quedan: no
+// contarían como liberadas.
+size_t StageCache::releaseMemory(size_t bytes) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    SpillFile& spill = memoryGovernor().spill();
+    size_t freed = 0;
+    auto pos = lru_.end();
+    while (pos != lru_.begin() && freed < bytes) {
+        --pos;
+        auto it = entries_.find(*pos);
+        Entry& e = it->second;
+        if (e.spilled.valid() || sharedWithCallers(e.mats)) continue;
+        freed += e.bytes;
+        if (diskDir_.empty()) e.spilled = spill.write(e.mats);
+        if (e.spilled.valid()) {
+            memoryGovernor().countSpill(e.bytes);
+            e.mats.clear();
+            counters_.bytes -= e.bytes;
+            residentBytes_ = counters_.bytes;
+        } else {
+            const auto keep = std::next(pos);
+            eraseLocked(it);
+            pos = keep;
+        }
+    }
+    return freed;
+}
+
+void StageCache::clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& kv : entries_)
+        if (kv.second.spilled.valid()) memoryGovernor().spill().release(kv.second.spilled);
+    entries_.clear();
+    lru_.clear();
+    counters_.bytes = 0;
+    residentBytes_ = 0;
+}
+
+StageCache::Counters StageCache::counters() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return counters_;
+}
+
+// ==========================================================
+// Disco: <dir>/<clave hex>.vsc
+//   "VSC1" | uint32 n | n × (int32 rows, cols, type | píxeles)
+// ==========================================================
+std::string StageCache::diskPath(StageKey key) const {
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.vsc", static_cast<unsigned long long>(key));
+    return (fs::path(diskDir_) / name).string();
+}
+
+bool StageCache::readDisk(StageKey key, std::vector<Mat>& out) const {
+    const std::string path = diskPath(key);
+    std::ifstream in(path, std::ios::binary);
+    if (!in) return false;
+    std::error_code ec;
+    const uint64_t fileBytes = fs::file_size(path, ec);
+    if (ec) return false;
+
+    char magic[4];
+    uint32_t n = 0;
+    if (!in.read(magic, 4) || std::memcmp(magic, kDiskMagic, 4) != 0) return false;
+    if (!in.read(reinterpret_cast<char*>(&n), sizeof(n)) || n > 64) return false;
+    uint64_t remaining = fileBytes - std::min<uint64_t>(fileBytes, 4 + sizeof(n));
+
+    out.clear();
+    for (uint32_t i = 0; i < n; ++i) {
+        int32_t geom[3];
+        if (!in.read(reinterpret_cast<char*>(geom), sizeof(geom))) return false;
+        if (geom[0] < 0 || geom[1] < 0 || geom[0] > 65536 || geom[1] > 65536) return false;
+        // Tipo conocido (profundidad de OpenCV, 1..4 canales) y píxeles que
+        // de verdad estén en el archivo: uno corrupto no reserva gigas
+        if (geom[2] < 0 || geom[2] > CV_MAKETYPE(CV_DEPTH_MAX - 1, 4)) return false;
+        const uint64_t bytes = uint64_t(geom[0]) * uint64_t(geom[1]) * CV_ELEM_SIZE(geom[2]);
+        remaining -= std::min<uint64_t>(remaining, sizeof(geom));
+        if (bytes > remaining) return false;
+        remaining -= bytes;
+        Mat m(geom[0], geom[1], geom[2]);
+        if (!in.read(reinterpret_cast<char*>(m.data), static_cast<std::streamsize>(matBytes(m))))
+            return false;
+        out.push_back(m);
+    }
+    return true;
+}
+
+void StageCache::writeDisk(StageKey key, const std::vector<Mat>& mats) const {
+    // Se escribe a un temporal y se renombra: nunca queda un archivo a medias
+    const std::string path = diskPath(key);
+    const std::string tmp  = path + ".tmp";
+    {
+        std::ofstream os(tmp, std::ios::binary | std::ios::trunc);
+        if (!os) return;
+        const uint32_t n = static_cast<uint32_t>(mats.size());
+        os.write(kDiskMagic, 4);
+        os.write(reinterpret_cast<const char*>(&n), sizeof(n));
+        for (const Mat& m : mats) {
+            const int32_t geom[3] = { m.rows, m.cols, m.type() };
+            os.write(reinterpret_cast<const char*>(geom), sizeof(geom));
+            os.write(reinterpret_cast<const char*>(m.data), static_cast<std::streamsize>(matBytes(m)));
+        }
+        if (!os) { std::error_code ec; fs::remove(tmp, ec); return; }
+    }
+    std::error_code ec;
+    fs::rename(tmp, path, ec);
+}
+
+// ==========================================================
+// Instancia global
+// ==========================================================
+StageCache* stageCache() {
+    static StageCache* cache = []() -> StageCache* {
+        size_t mb = 256;
+        if (const char* env = std::getenv("VISION_STAGE_CACHE_MB"))
+            mb = static_cast<size_t>(std::stoull(env));
+        if (mb == 0) return nullptr;
+
+        std::string dir;
+        if (const char* env = std::getenv("VISION_STAGE_CACHE_DIR")) dir = env;
+        // Nunca se destruye (mismo motivo que el FrameArena: Mats vivos al salir)
+        return new StageCache(mb * 1024 * 1024, dir);
+    }();
+    return cache;
+}
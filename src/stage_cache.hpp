@@ -0,0 +1,108 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <opencv2/core.hpp>
+
+#include "memory_governor.hpp"
+
+// ==========================================================
+// Claves de contenido (hash de 64 bits)
+// ==========================================================
+// La clave de una etapa = clave de sus entradas + sus parámetros. Si nada de
+// eso cambia, la salida es la misma y se puede reutilizar.
+using StageKey = uint64_t;
+
+class KeyHasher {
+public:
+    explicit KeyHasher(uint64_t seed = 0x5bd1e9955bd1e995ull) : h_(seed) {}
+
+    KeyHasher& bytes(const void* data, size_t n);
+    KeyHasher& add(const std::string& s);
+    KeyHasher& add(const char* s) { return add(std::string(s)); }
+    KeyHasher& add(const cv::Mat& m);   // geometría, tipo y píxeles (admite ROIs)
+    KeyHasher& add(StageKey k)        { return bytes(&k, sizeof(k)); }
+    KeyHasher& add(int v)             { return bytes(&v, sizeof(v)); }
+    KeyHasher& add(float v)           { return bytes(&v, sizeof(v)); }
+    KeyHasher& add(double v)          { return bytes(&v, sizeof(v)); }
+
+    StageKey key() const;
+
+private:
+    uint64_t h_;
+    uint64_t len_ = 0;
+};
+
+// Atajo: hash del contenido de un Mat
+StageKey hashMat(const cv::Mat& m);
+
+// ==========================================================
+// StageCache: salidas de etapas del pipeline por clave
+// ==========================================================
+// LRU en memoria con presupuesto en bytes y, opcionalmente, un directorio en
+// disco (un archivo por clave) que sobrevive entre ejecuciones. Las salidas se
+// guardan como copias propias: quien llama puede seguir reutilizando sus Mats.
+// Consumidor del gobernador de memoria (prioridad Cache): bajo presión, las
+// entradas frías se vuelcan al intercambio y get() las recarga.
+class StageCache : public MemoryConsumer {
+public:
+    struct Counters {
+        uint64_t hits      = 0;
+        uint64_t diskHits  = 0;
+        uint64_t spillHits = 0;   // recargadas del intercambio
+        uint64_t misses    = 0;
+        size_t   bytes     = 0;   // en memoria (sin contar lo volcado)
+    };
+
+    explicit StageCache(size_t budgetBytes, std::string diskDir = {});
+    ~StageCache() override;
+
+    // true y 'out' rellenado si la clave está en memoria o en disco. Los Mats
+    // de 'out' comparten datos con el caché: leerlos o copiarlos, no escribirlos.
+    bool get(StageKey key, std::vector<cv::Mat>& out);
+    // Atajo para etapas de una sola salida (se copia sobre 'out')
+    bool get(StageKey key, cv::Mat& out);
+
+    void put(StageKey key, const std::vector<cv::Mat>& outputs);
+    void put(StageKey key, const cv::Mat& output) { put(key, std::vector<cv::Mat>{ output }); }
+
+    void     clear();
+    Counters counters() const;
+    const std::string& diskDir() const { return diskDir_; }
+
+    const char* memoryName() const override { return "caché de etapas"; }
+    size_t      memoryBytes() const override { return residentBytes_; }
+    size_t      releaseMemory(size_t bytes) override;
+
+private:
+    struct Entry {
+        std::vector<cv::Mat> mats;    // vacío si está volcada
+        size_t bytes = 0;
+        std::list<StageKey>::iterator lru;
+        SpillFile::Extent spilled;    // válida si está volcada
+    };
+
+    void insertLocked(StageKey key, std::vector<cv::Mat> mats);
+    void eraseLocked(std::unordered_map<StageKey, Entry>::iterator it);
+    std::string diskPath(StageKey key) const;
+    bool readDisk(StageKey key, std::vector<cv::Mat>& out) const;
+    void writeDisk(StageKey key, const std::vector<cv::Mat>& mats) const;
+
+    size_t budget_;
+    std::string diskDir_;
+
+    mutable std::mutex mutex_;
+    std::list<StageKey> lru_;   // delante = usado más recientemente
+    std::unordered_map<StageKey, Entry> entries_;
+    Counters counters_;
+    std::atomic<size_t> residentBytes_{0};   // = counters_.bytes, leído sin cerrojo
+};
+
+// Caché global del pipeline. Presupuesto por VISION_STAGE_CACHE_MB (256 por
+// defecto; 0 la desactiva) y disco opcional con VISION_STAGE_CACHE_DIR.
+// nullptr si está desactivada.
+StageCache* stageCache();
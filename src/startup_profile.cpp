@@ -0,0 +1,85 @@
+#include "startup_profile.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <ostream>
+#include <sstream>
+
+#include <unistd.h>
+
+namespace {
+
+// Segundos entre la creación del proceso y la primera llamada (Linux);
+// 0 si /proc no está disponible
+double uptimeAtFirstCall() {
+    std::ifstream statFile("/proc/self/stat");
+    std::ifstream uptimeFile("/proc/uptime");
+    std::string stat;
+    double uptime = 0.0;
+    if (!std::getline(statFile, stat) || !(uptimeFile >> uptime)) return 0.0;
+
+    // El nombre (campo 2) puede llevar espacios: se sigue tras el último ')'
+    const size_t close = stat.rfind(')');
+    if (close == std::string::npos) return 0.0;
+    std::istringstream fields(stat.substr(close + 2));
+    std::string field;
+    unsigned long long startTicks = 0;
+    for (int i = 3; i <= 22 && fields >> field; ++i)
+        if (i == 22) startTicks = std::stoull(field);   // starttime
+    const long hz = sysconf(_SC_CLK_TCK);
+    if (hz <= 0 || startTicks == 0) return 0.0;
+    const double elapsed = uptime - static_cast<double>(startTicks) / hz;
+    return elapsed > 0.0 ? elapsed : 0.0;
+}
+
+struct Origin {
+    std::chrono::steady_clock::time_point anchor = std::chrono::steady_clock::now();
+    double offset = uptimeAtFirstCall();
+};
+
+const Origin& origin() {
+    static const Origin o;
+    return o;
+}
+
+// Fija el origen en la inicialización estática de este archivo, lo antes posible
+const Origin& g_originInit = origin();
+
+} // namespace
+
+double StartupProfile::now() const {
+    const Origin& o = origin();
+    return o.offset + std::chrono::duration<double>(std::chrono::steady_clock::now() - o.anchor).count();
+}
+
+void StartupProfile::mark(const std::string& name) {
+    const double t = now();
+    std::lock_guard<std::mutex> lock(mutex_);
+    marks_.emplace_back(name, t);
+}
+
+std::vector<std::pair<std::string, double>> StartupProfile::marks() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return marks_;
+}
+
+void StartupProfile::print(std::ostream& os) const {
+    // Los hilos de precarga marcan desordenados: por tiempo
+    auto sorted = marks();
+    std::stable_sort(sorted.begin(), sorted.end(), [](const auto& a, const auto& b) { return a.second < b.second; });
+    double prev = 0.0;
+    char line[160];
+    for (const auto& [name, t] : sorted) {
+        std::snprintf(line, sizeof(line), "  %-32s %8.1f ms  (+%.1f ms)\n", name.c_str(), t * 1000.0,
+                      (t - prev) * 1000.0);
+        os << line;
+        prev = t;
+    }
+}
+
+StartupProfile& startupProfile() {
+    static StartupProfile profile;
+    return profile;
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include <iosfwd>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+// ==========================================================
+// Tiempos de arranque
+// ==========================================================
+// Marcas en segundos desde que el kernel creó el proceso (no desde main):
+// así entran la carga de librerías y la inicialización estática (fábricas
+// de ITK, plugins de OpenCV...). El origen se lee una vez de /proc (10 ms de
+// resolución) y las marcas siguientes van con steady_clock.
+class StartupProfile {
+public:
+    void   mark(const std::string& name);
+    double now() const;   // segundos desde el inicio del proceso
+
+    std::vector<std::pair<std::string, double>> marks() const;
+    void print(std::ostream& os) const;   // una línea por marca + delta
+
+private:
+    mutable std::mutex mutex_;
+    std::vector<std::pair<std::string, double>> marks_;
+};
+
+// Global (main, ventana Qt, hilos de precarga)
+StartupProfile& startupProfile();
@@ -0,0 +1,390 @@
+#include "synthetic_volume.hpp"
+#include "noise_estimate.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <opencv2/core/utility.hpp>
+#include <opencv2/imgproc.hpp>
+
+using namespace cv;
+namespace fs = std::filesystem;
+
+namespace {
+
+// Límites del rango HU que produce un escáner: lo que quede por debajo de
+// kAirHU en la fuente es relleno fuera del campo y no recibe ruido
+constexpr float kAirHU = -1024.0f;
+constexpr float kMaxHU = 3071.0f;
+
+// Fracción áurea de la serie entre alturas iniciales de series consecutivas:
+// nunca coinciden y quedan repartidas
+constexpr double kSeriesPhase = 0.381966;
+
+uint64_t mix64(uint64_t x) {   // splitmix64
+    x += 0x9e3779b97f4a7c15ull;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+}
+
+uint64_t seedFor(const SyntheticOptions& o, uint64_t series, uint64_t kind, uint64_t index) {
+    uint64_t h = mix64(o.seed);
+    for (uint64_t v : { uint64_t(o.cols), uint64_t(o.rows), uint64_t(o.slices), uint64_t(o.inPlane),
+                        uint64_t(std::llround(o.zStep * 1e6)), uint64_t(std::llround(o.doseFraction * 1e6)),
+                        series, kind, index })
+        h = mix64(h ^ v);
+    return h;
+}
+
+// Posición s (en cortes) recorrida en vaivén dentro de [0, n-1]
+double pingPong(double s, int n) {
+    if (n <= 1) return 0.0;
+    const double period = 2.0 * (n - 1);
+    double t = std::fmod(s, period);
+    if (t < 0.0) t += period;
+    return t > n - 1 ? period - t : t;
+}
+
+struct SourceGeometry {
+    int nx = 0, ny = 0, nz = 0;
+    const short* data = nullptr;
+
+    explicit SourceGeometry(const ImageType3D::Pointer& src) {
+        const auto size = src->GetBufferedRegion().GetSize();
+        nx = static_cast<int>(size[0]);
+        ny = static_cast<int>(size[1]);
+        nz = static_cast<int>(size[2]);
+        data = src->GetBufferPointer();
+    }
+    Mat plane(int z) const {
+        return Mat(ny, nx, CV_16S, const_cast<short*>(data) + static_cast<size_t>(z) * nx * ny);
+    }
+    // Corte en la posición s (interpolado entre los dos vecinos), CV_32F
+    void planeAt(double s, Mat& out) const {
+        const int z0 = std::clamp(static_cast<int>(std::floor(s)), 0, nz - 1);
+        const int z1 = std::min(z0 + 1, nz - 1);
+        const double w = s - z0;
+        if (w < 1e-6 || z1 == z0) plane(z0).convertTo(out, CV_32F);
+        else addWeighted(plane(z0), 1.0 - w, plane(z1), w, 0.0, out, CV_32F);
+    }
+};
+
+struct SliceScratch {
+    Mat plane, canvas, img, noise, pad;
+};
+
+// ==========================================================
+// DICOM mínimo: CT, explícita little-endian, sin comprimir
+// ==========================================================
+// Lo justo para que GDCM agrupe la serie y MappedDicom la lea por mapeo.
+// Se escribe a mano (sin GDCM) para poder generar miles de cortes en
+// paralelo sin estado compartido.
+class DicomWriter {
+public:
+    void str(uint16_t g, uint16_t e, const char* vr, std::string v) {
+        if (v.size() % 2) v.push_back(std::strcmp(vr, "UI") == 0 ? '\0' : ' ');
+        header(g, e, vr, static_cast<uint32_t>(v.size()));
+        out_ += v;
+    }
+    void us(uint16_t g, uint16_t e, uint16_t v) {
+        header(g, e, "US", 2);
+        put16(v);
+    }
+    void ob(uint16_t g, uint16_t e, const std::string& v) {
+        header(g, e, "OB", static_cast<uint32_t>(v.size()));
+        out_ += v;
+    }
+    // Cabecera del PixelData; los bytes van detrás
+    void pixelHeader(uint32_t bytes) { header(0x7fe0, 0x0010, "OW", bytes); }
+    void ul(uint16_t g, uint16_t e, uint32_t v) {
+        header(g, e, "UL", 4);
+        put32(v);
+    }
+    const std::string& bytes() const { return out_; }
+
+private:
+    void put16(uint16_t v) { out_.push_back(char(v & 0xff)); out_.push_back(char(v >> 8)); }
+    void put32(uint32_t v) { put16(uint16_t(v & 0xffff)); put16(uint16_t(v >> 16)); }
+    void header(uint16_t g, uint16_t e, const char* vr, uint32_t len) {
+        put16(g);
+        put16(e);
+        out_.append(vr, 2);
+        const bool longVr = std::strcmp(vr, "OB") == 0 || std::strcmp(vr, "OW") == 0;
+        if (longVr) {
+            put16(0);
+            put32(len);
+        } else {
+            put16(static_cast<uint16_t>(len));
+        }
+    }
+    std::string out_;
+};
+
+std::string ds(double v) {
+    char s[32];
+    std::snprintf(s, sizeof(s), "%.6g", v);
+    return s;
+}
+
+std::string dsList(const double* v, int n) {
+    std::string s;
+    for (int i = 0; i < n; ++i) s += (i ? "\\" : "") + ds(v[i]);
+    return s;
+}
+
+std::string uid(uint64_t h) { return "2.25." + std::to_string(h); }
+
+struct SeriesHeader {
+    std::string studyUid, seriesUid, frameUid, description;
+    int    seriesNumber = 1;
+    double spacing[3] = { 1.0, 1.0, 1.0 };
+    double origin[3] = { 0.0, 0.0, 0.0 };
+    double direction[9] = { 1, 0, 0, 0, 1, 0, 0, 0, 1 };   // columnas: x, y, normal
+};
+
+void writeDicomSlice(const std::string& path, const SeriesHeader& h, const std::string& sopUid, int z,
+                     const Mat& hu) {
+    const char* kCtImageStorage = "1.2.840.10008.5.1.4.1.1.2";
+    const char* kExplicitLE     = "1.2.840.10008.1.2.1";
+
+    DicomWriter meta;
+    meta.ob(0x0002, 0x0001, std::string("\0\1", 2));
+    meta.str(0x0002, 0x0002, "UI", kCtImageStorage);
+    meta.str(0x0002, 0x0003, "UI", sopUid);
+    meta.str(0x0002, 0x0010, "UI", kExplicitLE);
+    meta.str(0x0002, 0x0012, "UI", "2.25.1");
+    DicomWriter group;
+    group.ul(0x0002, 0x0000, static_cast<uint32_t>(meta.bytes().size()));
+
+    double pos[3];
+    for (int i = 0; i < 3; ++i) pos[i] = h.origin[i] + h.direction[6 + i] * z * h.spacing[2];
+    const double orientation[6] = { h.direction[0], h.direction[1], h.direction[2],
+                                    h.direction[3], h.direction[4], h.direction[5] };
+    const double location = pos[0] * h.direction[6] + pos[1] * h.direction[7] + pos[2] * h.direction[8];
+    const double pixelSpacing[2] = { h.spacing[1], h.spacing[0] };   // fila, columna
+
+    DicomWriter d;
+    d.str(0x0008, 0x0008, "CS", "DERIVED\\SECONDARY\\AXIAL");
+    d.str(0x0008, 0x0016, "UI", kCtImageStorage);
+    d.str(0x0008, 0x0018, "UI", sopUid);
+    d.str(0x0008, 0x0020, "DA", "20000101");   // fija: la salida es determinista
+    d.str(0x0008, 0x0060, "CS", "CT");
+    d.str(0x0008, 0x103e, "LO", h.description);
+    d.str(0x0010, 0x0010, "PN", "SINTETICO");
+    d.str(0x0010, 0x0020, "LO", "SYNTH");
+    d.str(0x0018, 0x0050, "DS", ds(h.spacing[2]));
+    d.str(0x0020, 0x000d, "UI", h.studyUid);
+    d.str(0x0020, 0x000e, "UI", h.seriesUid);
+    d.str(0x0020, 0x0011, "IS", std::to_string(h.seriesNumber));
+    d.str(0x0020, 0x0013, "IS", std::to_string(z + 1));
+    d.str(0x0020, 0x0032, "DS", dsList(pos, 3));
+    d.str(0x0020, 0x0037, "DS", dsList(orientation, 6));
+    d.str(0x0020, 0x0052, "UI", h.frameUid);
+    d.str(0x0020, 0x1041, "DS", ds(location));
+    d.us(0x0028, 0x0002, 1);
+    d.str(0x0028, 0x0004, "CS", "MONOCHROME2");
+    d.us(0x0028, 0x0010, static_cast<uint16_t>(hu.rows));
+    d.us(0x0028, 0x0011, static_cast<uint16_t>(hu.cols));
+    d.str(0x0028, 0x0030, "DS", dsList(pixelSpacing, 2));
+    d.us(0x0028, 0x0100, 16);
+    d.us(0x0028, 0x0101, 16);
+    d.us(0x0028, 0x0102, 15);
+    d.us(0x0028, 0x0103, 1);   // con signo: se guardan HU tal cual
+    d.str(0x0028, 0x1050, "DS", "40");
+    d.str(0x0028, 0x1051, "DS", "400");
+    d.str(0x0028, 0x1052, "DS", "0");
+    d.str(0x0028, 0x1053, "DS", "1");
+    const size_t pixelBytes = hu.total() * hu.elemSize();
+    d.pixelHeader(static_cast<uint32_t>(pixelBytes));
+
+    std::ofstream f(path, std::ios::binary);
+    const char preamble[128] = {};
+    f.write(preamble, sizeof(preamble));
+    f.write("DICM", 4);
+    f.write(group.bytes().data(), group.bytes().size());
+    f.write(meta.bytes().data(), meta.bytes().size());
+    f.write(d.bytes().data(), d.bytes().size());
+    f.write(reinterpret_cast<const char*>(hu.data), pixelBytes);   // CV_16S continuo, LE
+    if (!f) throw std::runtime_error("No se pudo escribir " + path);
+}
+
+// Cabecera MetaImage (la lee ITK y la mayoría de visores)
+void writeMetaImageHeader(const std::string& path, const std::string& rawName, const SeriesHeader& h, int cols,
+                          int rows, int slices) {
+    std::ofstream f(path);
+    f << "ObjectType = Image\nNDims = 3\nBinaryData = True\nBinaryDataByteOrderMSB = False\n"
+      << "CompressedData = False\nTransformMatrix =";
+    for (double v : h.direction) f << ' ' << v;
+    f << "\nOffset = " << h.origin[0] << ' ' << h.origin[1] << ' ' << h.origin[2]
+      << "\nElementSpacing = " << h.spacing[0] << ' ' << h.spacing[1] << ' ' << h.spacing[2]
+      << "\nDimSize = " << cols << ' ' << rows << ' ' << slices
+      << "\nElementType = MET_SHORT\nElementDataFile = " << rawName << "\n";
+    if (!f) throw std::runtime_error("No se pudo escribir " + path);
+}
+
+} // namespace
+
+InPlaneMode parseInPlaneMode(const std::string& name) {
+    if (name == "resample") return InPlaneMode::Resample;
+    if (name == "mosaic")   return InPlaneMode::Mosaic;
+    throw std::runtime_error("Modo de plano desconocido: " + name + " (resample|mosaic)");
+}
+
+// ==========================================================
+// Corte sintético
+// ==========================================================
+void synthesizeSlice(const ImageType3D::Pointer& src, const SyntheticOptions& opts, int series, int z, Mat& out) {
+    if (opts.doseFraction <= 0.0 || opts.doseFraction > 1.0)
+        throw std::runtime_error("La fracción de dosis debe estar en (0, 1]");
+    const SourceGeometry g(src);
+    thread_local SliceScratch s;
+    const double pos = series * kSeriesPhase * g.nz + z * opts.zStep;
+
+    if (opts.inPlane == InPlaneMode::Mosaic) {
+        // Rejilla de cortes de la fuente a alturas repartidas, recortada al centro
+        const int tx = (opts.cols + g.nx - 1) / g.nx, ty = (opts.rows + g.ny - 1) / g.ny;
+        s.canvas.create(ty * g.ny, tx * g.nx, CV_32F);
+        for (int t = 0; t < tx * ty; ++t) {
+            g.planeAt(pingPong(pos + t * double(g.nz) / (tx * ty), g.nz), s.plane);
+            s.plane.copyTo(s.canvas(Rect((t % tx) * g.nx, (t / tx) * g.ny, g.nx, g.ny)));
+        }
+        s.canvas(Rect((s.canvas.cols - opts.cols) / 2, (s.canvas.rows - opts.rows) / 2, opts.cols, opts.rows))
+            .copyTo(s.img);
+    } else {
+        g.planeAt(pingPong(pos, g.nz), s.plane);
+        if (s.plane.cols == opts.cols && s.plane.rows == opts.rows) {
+            s.plane.copyTo(s.img);
+        } else {
+            const bool up = opts.cols * opts.rows > g.nx * g.ny;
+            resize(s.plane, s.img, Size(opts.cols, opts.rows), 0, 0, up ? INTER_CUBIC : INTER_AREA);
+        }
+    }
+    compare(s.img, kAirHU, s.pad, CMP_LT);   // relleno fuera del campo
+
+    if (opts.doseFraction < 1.0) {
+        const double sigma = estimateNoiseHU(s.img);
+        if (sigma > 0.0) {
+            s.noise.create(s.img.size(), CV_32F);
+            RNG rng(seedFor(opts, series, /*kind*/0, z));
+            rng.fill(s.noise, RNG::NORMAL, 0.0, 1.0);
+            if (opts.noiseCorrelationPx > 0.0) {
+                // El suavizado baja la varianza: se vuelve a σ = 1
+                GaussianBlur(s.noise, s.noise, Size(), opts.noiseCorrelationPx);
+                Scalar mean, sd;
+                meanStdDev(s.noise, mean, sd);
+                if (sd[0] > 0.0) s.noise.convertTo(s.noise, CV_32F, 1.0 / sd[0], -mean[0] / sd[0]);
+            }
+            scaleAdd(s.noise, sigma * std::sqrt(1.0 / opts.doseFraction - 1.0), s.img, s.plane);
+            max(s.plane, kAirHU, s.plane);
+            s.img.copyTo(s.plane, s.pad);
+            std::swap(s.img, s.plane);
+        }
+    }
+    min(s.img, kMaxHU, s.img);
+    s.img.convertTo(out, CV_16S);
+}
+
+// ==========================================================
+// Series completas
+// ==========================================================
+std::vector<SyntheticSeries> generateSyntheticSeries(const Volume& src, const std::string& outDir,
+                                                     const SyntheticOptions& optsIn) {
+    if (src.image.IsNull()) throw std::runtime_error("Serie fuente vacía");
+    SyntheticOptions opts = optsIn;
+    const SourceGeometry g(src.image);
+    if (opts.slices <= 0) opts.slices = g.nz;
+    if (opts.cols <= 0 || opts.rows <= 0 || opts.cols > 65535 || opts.rows > 65535 || opts.zStep <= 0.0)
+        throw std::runtime_error("Tamaño de serie sintética no válido");
+    if (opts.series < 1) throw std::runtime_error("Número de series sintéticas no válido");
+    fs::create_directories(outDir);
+
+    const auto sp  = src.image->GetSpacing();
+    const auto org = src.image->GetOrigin();
+    const auto dir = src.image->GetDirection();
+
+    SeriesHeader base;
+    const bool resample = opts.inPlane == InPlaneMode::Resample;
+    base.spacing[0] = resample ? sp[0] * g.nx / opts.cols : sp[0];
+    base.spacing[1] = resample ? sp[1] * g.ny / opts.rows : sp[1];
+    base.spacing[2] = sp[2] * opts.zStep;
+    for (int c = 0; c < 3; ++c)
+        for (int r = 0; r < 3; ++r) base.direction[c * 3 + r] = dir[r][c];
+    // Mismo borde exterior que la fuente aunque cambie el tamaño de píxel
+    for (int i = 0; i < 3; ++i)
+        base.origin[i] = org[i] + 0.5 * (base.spacing[0] - sp[0]) * base.direction[i] +
+                         0.5 * (base.spacing[1] - sp[1]) * base.direction[3 + i];
+    base.studyUid = uid(seedFor(opts, 0, /*kind*/1, 0));
+    base.frameUid = uid(seedFor(opts, 0, /*kind*/2, 0));
+
+    std::vector<SyntheticSeries> result;
+    for (int k = 0; k < opts.series; ++k) {
+        char name[32];
+        std::snprintf(name, sizeof(name), "serie_%03d", k);
+        SeriesHeader h = base;
+        h.seriesNumber = k + 1;
+        h.seriesUid = uid(seedFor(opts, k, /*kind*/3, 0));
+        h.description = "Sintetica " + std::to_string(opts.cols) + "x" + std::to_string(opts.rows) + " dosis " +
+                        ds(opts.doseFraction);
+
+        SyntheticSeries info;
+        info.slices = opts.slices;
+        std::copy(h.spacing, h.spacing + 3, info.spacing);
+        if (opts.writeDicom) {
+            info.dicomDir = (fs::path(outDir) / name).string();
+            fs::create_directories(info.dicomDir);
+        }
+
+        // .raw preasignado: cada corte va a su offset (pwrite) desde cualquier hilo
+        int rawFd = -1;
+        const size_t planeBytes = size_t(opts.cols) * opts.rows * sizeof(short);
+        if (opts.writeRaw) {
+            const std::string rawName = std::string(name) + ".raw";
+            info.rawHeader = (fs::path(outDir) / (std::string(name) + ".mhd")).string();
+            writeMetaImageHeader(info.rawHeader, rawName, h, opts.cols, opts.rows, opts.slices);
+            const std::string rawPath = (fs::path(outDir) / rawName).string();
+            rawFd = ::open(rawPath.c_str(), O_CREAT | O_WRONLY | O_TRUNC, 0644);
+            if (rawFd < 0 || ::ftruncate(rawFd, static_cast<off_t>(planeBytes * opts.slices)) != 0) {
+                if (rawFd >= 0) ::close(rawFd);
+                throw std::runtime_error("No se pudo crear " + rawPath);
+            }
+        }
+
+        // Los errores dentro de parallel_for_ se anotan y se lanzan al final
+        std::atomic<bool> failed{ false };
+        std::string error;
+        parallel_for_(Range(0, opts.slices), [&](const Range& r) {
+            Mat hu;
+            for (int z = r.start; z < r.end && !failed; ++z) {
+                try {
+                    synthesizeSlice(src.image, opts, k, z, hu);
+                    if (opts.writeDicom) {
+                        char file[32];
+                        std::snprintf(file, sizeof(file), "IM%05d.dcm", z + 1);
+                        writeDicomSlice((fs::path(info.dicomDir) / file).string(), h,
+                                        uid(seedFor(opts, k, /*kind*/4, z)), z, hu);
+                    }
+                    if (rawFd >= 0 &&
+                        ::pwrite(rawFd, hu.data, planeBytes, static_cast<off_t>(planeBytes * z)) !=
+                            static_cast<ssize_t>(planeBytes))
+                        throw std::runtime_error("Escritura incompleta del volumen .raw");
+                } catch (const std::exception& e) {
+                    if (!failed.exchange(true)) error = e.what();
+                }
+            }
+        });
+        if (rawFd >= 0) ::close(rawFd);
+        if (failed) throw std::runtime_error(error);
+        result.push_back(std::move(info));
+    }
+    return result;
+}
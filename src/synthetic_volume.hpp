@@ -0,0 +1,60 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <opencv2/core.hpp>
+
+#include "itk_loader.hpp"
+
+// ==========================================================
+// Series sintéticas grandes para pruebas de escala
+// ==========================================================
+// Derivadas de una serie real (la L096 incluida): cada corte generado sale del
+// volumen fuente, así que la anatomía, el rango HU y la textura son creíbles.
+//  - Z: 'slices' cortes a paso 'zStep' en cortes de la fuente (interpolación
+//    lineal); al llegar a un extremo se recorre en sentido contrario (vaivén),
+//    sin saltos, para series más largas que la fuente.
+//  - Plano: Resample reescala el corte a cols x rows (misma anatomía, píxel
+//    más fino); Mosaic coloca cortes de la fuente de distintas alturas en
+//    rejilla, a resolución nativa (más cuerpo por corte, misma textura).
+//  - Baja dosis: el ruido cuántico crece como 1/√dosis, así que se añade ruido
+//    de σ = σ_fuente · √(1/dosis − 1) (σ_fuente estimado en cada corte),
+//    gaussiano y suavizado para imitar la correlación espacial del TC.
+// Se genera corte a corte y en paralelo, sin tener la serie entera en memoria:
+// miles de cortes de 1024² caben en cualquier máquina. Todo es determinista
+// para una misma semilla.
+
+enum class InPlaneMode { Resample, Mosaic };
+
+struct SyntheticOptions {
+    int cols = 512, rows = 512;
+    int slices = 0;              // 0 → los de la fuente
+    double zStep = 1.0;          // cortes de la fuente por corte generado (< 1 interpola)
+    InPlaneMode inPlane = InPlaneMode::Resample;
+    double doseFraction = 1.0;   // 1 → sin ruido añadido; 0.25 → cuarto de dosis
+    double noiseCorrelationPx = 0.8;   // σ del suavizado del ruido (0 → blanco)
+    int series = 1;              // series independientes (otra altura inicial y otro ruido)
+    uint64_t seed = 1;
+    bool writeDicom = true;      // serie_NNN/ con un .dcm por corte
+    bool writeRaw = false;       // serie_NNN.mhd + .raw (MetaImage, int16 HU)
+};
+
+struct SyntheticSeries {
+    std::string dicomDir;   // vacío si no se escribió DICOM
+    std::string rawHeader;  // .mhd; vacío si no se escribió
+    int    slices = 0;
+    double spacing[3] = { 1.0, 1.0, 1.0 };   // x, y, z (mm)
+};
+
+// Corte z de la serie 'series' en HU (CV_16S, rows x cols)
+void synthesizeSlice(const ImageType3D::Pointer& src, const SyntheticOptions& opts, int series, int z,
+                     cv::Mat& out);
+
+// Genera opts.series series en outDir (lo crea). Lanza runtime_error si la
+// fuente está vacía, el tamaño o el número de series no es válido o no se
+// puede escribir.
+std::vector<SyntheticSeries> generateSyntheticSeries(const Volume& src, const std::string& outDir,
+                                                     const SyntheticOptions& opts);
+
+// "resample" | "mosaic"
+InPlaneMode parseInPlaneMode(const std::string& name);
@@ -0,0 +1,239 @@
+#include "tissue_stats.hpp"
+#include <opencv2/core/utility.hpp>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+using namespace cv;
+
+// ==========================================================
+// TissueAccumulator
+// ==========================================================
+void TissueAccumulator::merge(const TissueAccumulator& o) {
+    if (o.count == 0) return;
+    if (count == 0) {
+        *this = o;
+        return;
+    }
+
+    const double n     = static_cast<double>(count + o.count);
+    const double delta = o.mean - mean;
+    mean += delta * static_cast<double>(o.count) / n;
+    m2   += o.m2 + delta * delta * static_cast<double>(count) * static_cast<double>(o.count) / n;
+    count += o.count;
+    minHU = std::min(minHU, o.minHU);
+    maxHU = std::max(maxHU, o.maxHU);
+
+    if (!o.histogram.empty()) {
+        if (histogram.empty()) histogram.assign(kHistBins, 0);
+        for (int b = 0; b < kHistBins; ++b) histogram[b] += o.histogram[b];
+    }
+}
+
+double TissueAccumulator::percentileHU(double p) const {
+    if (count == 0 || histogram.empty()) return std::numeric_limits<double>::quiet_NaN();
+    const uint64_t target = static_cast<uint64_t>(std::ceil(std::clamp(p, 0.0, 1.0) * count));
+    uint64_t acc = 0;
+    for (int b = 0; b < kHistBins; ++b) {
+        acc += histogram[b];
+        if (acc >= std::max<uint64_t>(target, 1)) return kHistMinHU + b;
+    }
+    return kHistMaxHU;
+}
+
+TissueStats TissueAccumulator::finish() const {
+    TissueStats ts;
+    ts.pixelCount = static_cast<int>(count);
+    if (count == 0) return ts;
+    ts.meanHU = mean;
+    ts.stdHU  = std::sqrt(std::max(0.0, m2 / static_cast<double>(count)));  // poblacional, igual que meanStdDev
+    ts.minHU  = minHU;
+    ts.maxHU  = maxHU;
+    return ts;
+}
+
+// ==========================================================
+// SliceStatsAccumulator
+// ==========================================================
+void SliceStatsAccumulator::merge(const SliceStatsAccumulator& o) {
+    for (int l = 0; l < kNumTissueLabels; ++l) tissues[l].merge(o.tissues[l]);
+}
+
+SliceStats SliceStatsAccumulator::finish() const {
+    SliceStats s;
+    s.fat    = tissues[LABEL_FAT].finish();
+    s.muscle = tissues[LABEL_MUSCLE].finish();
+    s.bone   = tissues[LABEL_BONE].finish();
+    return s;
+}
+
+// ==========================================================
+// Mapa de etiquetas
+// ==========================================================
+cv::Mat makeLabelMap(const AnatomyMasks& m) {
+    CV_Assert(!m.fat.empty());
+    Mat labels = Mat::zeros(m.fat.size(), CV_8U);
+    labels.setTo(LABEL_FAT, m.fat);
+    labels.setTo(LABEL_MUSCLE, m.muscle_tendon);
+    labels.setTo(LABEL_BONE, m.bones);
+    return labels;
+}
+
+// ==========================================================
+// Pasada única por franjas
+// ==========================================================
+namespace {
+
+// Sumas desplazadas por franja (el desplazamiento evita cancelación numérica)
+struct StripeSums {
+    int64_t count = 0;
+    double  shift = 0.0;
+    double  sum   = 0.0;
+    double  sumSq = 0.0;
+    double  mn    = std::numeric_limits<double>::infinity();
+    double  mx    = -std::numeric_limits<double>::infinity();
+};
+
+struct StripeState {
+    std::array<StripeSums, kNumTissueLabels> s;
+    std::array<std::vector<uint64_t>, kNumTissueLabels> hist;
+
+    explicit StripeState(bool withHistogram) {
+        if (withHistogram) {
+            for (int l = 1; l < kNumTissueLabels; ++l) hist[l].assign(kHistBins, 0);
+        }
+    }
+
+    inline void add(int l, double v) {
+        StripeSums& a = s[l];
+        if (a.count == 0) a.shift = v;
+        const double d = v - a.shift;
+        a.sum   += d;
+        a.sumSq += d * d;
+        ++a.count;
+        if (v < a.mn) a.mn = v;
+        if (v > a.mx) a.mx = v;
+        if (!hist[l].empty()) {
+            const int b = std::clamp(cvRound(v) - kHistMinHU, 0, kHistBins - 1);
+            ++hist[l][b];
+        }
+    }
+
+    void finish(SliceStatsAccumulator& out);
+};
+
+template <typename T>
+void accumulateStripe(const Mat& hu, const Mat& labels, int r0, int r1,
+                      SliceStatsAccumulator& out, bool withHistogram)
+{
+    StripeState st(withHistogram);
+    for (int r = r0; r < r1; ++r) {
+        const T*       h  = hu.ptr<T>(r);
+        const uint8_t* lb = labels.ptr<uint8_t>(r);
+        for (int c = 0; c < hu.cols; ++c) {
+            const int l = lb[c];
+            if (l == LABEL_NONE || l >= kNumTissueLabels) continue;
+            st.add(l, static_cast<double>(h[c]));
+        }
+    }
+    st.finish(out);
+}
+
+// Igual, pero recorriendo solo los tramos etiquetados (el fondo no se toca)
+template <typename T>
+void accumulateStripeRuns(const Mat& hu, const RleLabelMap& labels, int r0, int r1,
+                          SliceStatsAccumulator& out, bool withHistogram)
+{
+    StripeState st(withHistogram);
+    for (int r = r0; r < r1; ++r) {
+        const T* h = hu.ptr<T>(r);
+        for (const LabelRun* run = labels.rowBegin(r); run != labels.rowEnd(r); ++run) {
+            const int l = run->label;
+            if (l == LABEL_NONE || l >= kNumTissueLabels) continue;
+            const T* p = h + run->start;
+            for (int i = 0; i < run->length; ++i) st.add(l, static_cast<double>(p[i]));
+        }
+    }
+    st.finish(out);
+}
+
+void StripeState::finish(SliceStatsAccumulator& out) {
+    for (int l = 1; l < kNumTissueLabels; ++l) {
+        const StripeSums& a = s[l];
+        if (a.count == 0) continue;
+        TissueAccumulator& t = out.tissues[l];
+        const double n  = static_cast<double>(a.count);
+        const double md = a.sum / n;
+        t.count = a.count;
+        t.mean  = a.shift + md;
+        t.m2    = std::max(0.0, a.sumSq - a.sum * md);
+        t.minHU = a.mn;
+        t.maxHU = a.mx;
+        t.histogram = std::move(hist[l]);
+    }
+}
+
+} // namespace
+
+void accumulateTissueStats(const cv::Mat& hu, const cv::Mat& labels,
+                           SliceStatsAccumulator& acc, bool withHistogram)
+{
+    CV_Assert(hu.type() == CV_32F || hu.type() == CV_16S);
+    CV_Assert(labels.type() == CV_8U && labels.size() == hu.size());
+
+    // Franjas de ~32 filas: suficientes para repartir, pocas para fusionar
+    const int stripeRows = 32;
+    const int nStripes   = (hu.rows + stripeRows - 1) / stripeRows;
+    std::vector<SliceStatsAccumulator> partial(nStripes);
+
+    parallel_for_(Range(0, nStripes), [&](const Range& range) {
+        for (int i = range.start; i < range.end; ++i) {
+            const int r0 = i * stripeRows;
+            const int r1 = std::min(hu.rows, r0 + stripeRows);
+            if (hu.type() == CV_32F)
+                accumulateStripe<float>(hu, labels, r0, r1, partial[i], withHistogram);
+            else
+                accumulateStripe<short>(hu, labels, r0, r1, partial[i], withHistogram);
+        }
+    });
+
+    for (const auto& p : partial) acc.merge(p);
+}
+
+void accumulateTissueStats(const cv::Mat& hu, const RleLabelMap& labels,
+                           SliceStatsAccumulator& acc, bool withHistogram)
+{
+    CV_Assert(hu.type() == CV_32F || hu.type() == CV_16S);
+    CV_Assert(labels.size() == hu.size());
+
+    const int stripeRows = 32;
+    const int nStripes   = (hu.rows + stripeRows - 1) / stripeRows;
+    std::vector<SliceStatsAccumulator> partial(nStripes);
+
+    parallel_for_(Range(0, nStripes), [&](const Range& range) {
+        for (int i = range.start; i < range.end; ++i) {
+            const int r0 = i * stripeRows;
+            const int r1 = std::min(hu.rows, r0 + stripeRows);
+            if (hu.type() == CV_32F)
+                accumulateStripeRuns<float>(hu, labels, r0, r1, partial[i], withHistogram);
+            else
+                accumulateStripeRuns<short>(hu, labels, r0, r1, partial[i], withHistogram);
+        }
+    });
+
+    for (const auto& p : partial) acc.merge(p);
+}
+
+SliceStats computeSliceStats(const cv::Mat& hu, const AnatomyMasks& m) {
+    if (hu.empty() || m.fat.empty()) return {};
+    SliceStatsAccumulator acc;
+    accumulateTissueStats(hu, makeLabelMap(m), acc, /*withHistogram*/false);
+    return acc.finish();
+}
+
+SliceStats computeSliceStats(const cv::Mat& hu, const RleLabelMap& labels) {
+    if (hu.empty() || labels.empty()) return {};
+    SliceStatsAccumulator acc;
+    accumulateTissueStats(hu, labels, acc, /*withHistogram*/false);
+    return acc.finish();
+}
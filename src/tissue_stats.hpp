@@ -0,0 +1,71 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <vector>
+#include <opencv2/core.hpp>
+
+#include "Stats.hpp"
+#include "highlight.hpp"
+#include "label_rle.hpp"
+
+// Etiquetas del mapa de tejidos (un byte por píxel)
+enum TissueLabel : uint8_t {
+    LABEL_NONE   = 0,
+    LABEL_FAT    = 1,
+    LABEL_MUSCLE = 2,
+    LABEL_BONE   = 3
+};
+constexpr int kNumTissueLabels = 4;
+
+// Histograma HU con bins de 1 HU (fuera de rango se satura a los extremos)
+constexpr int kHistMinHU = -1024;
+constexpr int kHistMaxHU = 3071;
+constexpr int kHistBins  = kHistMaxHU - kHistMinHU + 1;
+
+// Acumulador de un tejido: media/varianza estilo Welford (fusionable),
+// mínimo, máximo e histograma HU completo.
+struct TissueAccumulator {
+    int64_t count = 0;
+    double  mean  = 0.0;
+    double  m2    = 0.0;   // suma de cuadrados de desviaciones
+    double  minHU = 0.0;
+    double  maxHU = 0.0;
+    std::vector<uint64_t> histogram;   // kHistBins o vacío
+
+    // Fusión de Chan et al. (dos acumuladores parciales → uno)
+    void merge(const TissueAccumulator& o);
+
+    // Percentil p en [0,1] a partir del histograma (NaN si no hay datos)
+    double percentileHU(double p) const;
+
+    TissueStats finish() const;
+};
+
+// Acumulador de todos los tejidos a la vez (índice = TissueLabel).
+// Sirve para un corte o, fusionando cortes, para un volumen completo.
+struct SliceStatsAccumulator {
+    std::array<TissueAccumulator, kNumTissueLabels> tissues;
+
+    void merge(const SliceStatsAccumulator& o);
+    SliceStats finish() const;
+};
+
+// Mapa de etiquetas CV_8U a partir de las máscaras (hueso > músculo > grasa)
+cv::Mat makeLabelMap(const AnatomyMasks& m);
+
+// Una sola pasada sobre HU (CV_32F o CV_16S) + etiquetas (CV_8U),
+// paralela por franjas de filas. Suma sobre lo que ya tenga 'acc'.
+void accumulateTissueStats(const cv::Mat& hu,
+                           const cv::Mat& labels,
+                           SliceStatsAccumulator& acc,
+                           bool withHistogram = true);
+
+// Igual sobre el mapa por tramos: solo se leen los píxeles etiquetados
+void accumulateTissueStats(const cv::Mat& hu,
+                           const RleLabelMap& labels,
+                           SliceStatsAccumulator& acc,
+                           bool withHistogram = true);
+
+// Atajo: estadísticas de grasa/músculo/hueso de un corte
+SliceStats computeSliceStats(const cv::Mat& hu, const AnatomyMasks& m);
+SliceStats computeSliceStats(const cv::Mat& hu, const RleLabelMap& labels);
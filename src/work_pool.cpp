@@ -0,0 +1,114 @@
+#include "work_pool.hpp"
+#include "metrics.hpp"
+
+#include <algorithm>
+
+namespace {
+// Worker actual (pool + índice de su cola); nullptr fuera del pool
+thread_local const WorkStealingPool* t_pool = nullptr;
+thread_local int t_worker = -1;
+
+// Ocupación sumada de todos los pools del proceso
+struct PoolGauges {
+    MetricGauge& workers = metrics().gauge("pools.workers");
+    MetricGauge& busy    = metrics().gauge("pools.ocupados");
+    MetricGauge& queued  = metrics().gauge("pools.en_cola");
+};
+PoolGauges& poolGauges() {
+    static PoolGauges g;
+    return g;
+}
+} // namespace
+
+WorkStealingPool::WorkStealingPool(int workers) {
+    if (workers <= 0) workers = std::max(1u, std::thread::hardware_concurrency());
+    for (int i = 0; i < workers; ++i) queues_.push_back(std::make_unique<Queue>());
+    for (int i = 0; i < workers; ++i) threads_.emplace_back([this, i] { workerLoop(i); });
+    poolGauges().workers.add(workers);
+}
+
+WorkStealingPool::~WorkStealingPool() {
+    waitIdle();
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex_);
+        stop_ = true;
+    }
+    wake_.notify_all();
+    for (auto& t : threads_) t.join();
+    poolGauges().workers.add(-static_cast<int64_t>(threads_.size()));
+}
+
+void WorkStealingPool::submit(Task task) {
+    const int n = static_cast<int>(queues_.size());
+    const int q = (t_pool == this) ? t_worker : static_cast<int>(nextQueue_++ % n);
+    ++pending_;
+    poolGauges().queued.add(1);   // antes de encolar: un worker puede sacarla ya
+    {
+        std::lock_guard<std::mutex> lock(queues_[q]->mutex);
+        queues_[q]->tasks.push_back(std::move(task));
+        ++queued_;
+    }
+    {
+        // Bajo sleepMutex_: un worker que acaba de ver las colas vacías no
+        // puede dormirse sin recibir este aviso
+        std::lock_guard<std::mutex> lock(sleepMutex_);
+    }
+    wake_.notify_one();
+}
+
+bool WorkStealingPool::tryPop(int self, Task& task) {
+    {
+        Queue& own = *queues_[self];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            --queued_;
+            return true;
+        }
+    }
+    const int n = static_cast<int>(queues_.size());
+    for (int k = 1; k < n; ++k) {
+        Queue& victim = *queues_[(self + k) % n];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            --queued_;
+            ++stolen_;
+            return true;
+        }
+    }
+    return false;
+}
+
+void WorkStealingPool::workerLoop(int self) {
+    t_pool   = this;
+    t_worker = self;
+    Task task;
+    while (true) {
+        if (tryPop(self, task)) {
+            PoolGauges& g = poolGauges();
+            g.queued.add(-1);
+            g.busy.add(1);
+            try { task(); } catch (...) {}
+            task = nullptr;
+            g.busy.add(-1);
+            ++executed_;
+            if (--pending_ == 0) {
+                std::lock_guard<std::mutex> lock(sleepMutex_);
+                idle_.notify_all();
+            }
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(sleepMutex_);
+        wake_.wait(lock, [&] { return stop_ || queued_ > 0; });
+        if (stop_ && queued_ == 0) return;
+    }
+}
+
+void WorkStealingPool::waitIdle() {
+    std::unique_lock<std::mutex> lock(sleepMutex_);
+    idle_.wait(lock, [&] { return pending_ == 0; });
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// ==========================================================
+// Pool de hilos con robo de tareas (work-stealing)
+// ==========================================================
+// Cada worker tiene su cola: las tareas que encola un worker van a la suya y
+// las saca por el final (LIFO, datos aún en caché); las de fuera se reparten
+// en turno rotatorio. Un worker sin trabajo roba del principio de la cola de
+// otro (FIFO, las tareas más antiguas), así ninguna cola se queda atascada
+// mientras hay hilos parados.
+class WorkStealingPool {
+public:
+    using Task = std::function<void()>;
+
+    struct Counters {
+        uint64_t executed = 0;   // tareas ejecutadas
+        uint64_t stolen   = 0;   // de ellas, robadas de otra cola
+    };
+
+    explicit WorkStealingPool(int workers = 0);   // 0 → núcleos de la máquina
+    ~WorkStealingPool();                          // termina lo pendiente y une los hilos
+
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    // Las excepciones de una tarea se tragan: quien la encola debe capturarlas
+    void submit(Task task);
+    void waitIdle();   // hasta que no quede ninguna tarea pendiente ni en curso
+
+    int      workers() const { return static_cast<int>(threads_.size()); }
+    Counters counters() const { return { executed_, stolen_ }; }
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    bool tryPop(int self, Task& task);
+    void workerLoop(int self);
+
+    std::vector<std::unique_ptr<Queue>> queues_;
+    std::vector<std::thread> threads_;
+
+    std::mutex sleepMutex_;
+    std::condition_variable wake_;
+    std::condition_variable idle_;
+    std::atomic<int>  pending_{0};   // encoladas + en curso
+    std::atomic<int>  queued_{0};    // solo encoladas
+    std::atomic<bool> stop_{false};
+    std::atomic<unsigned> nextQueue_{0};
+
+    std::atomic<uint64_t> executed_{0};
+    std::atomic<uint64_t> stolen_{0};
+};